@@ -0,0 +1,242 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "Bench.h"
+#include <IceUtil/Time.h>
+#include <ctime>
+#include <iomanip>
+
+#ifndef _WIN32
+#   include <unistd.h>
+#endif
+
+namespace bench
+{
+    
+    int64_t now()
+    {
+        return IceUtil::Time::now(IceUtil::Time::Monotonic).toMicroSeconds();
+    }
+    
+    static std::string s_io = "poll";
+    
+    void setIo(const std::string& io)
+    {
+        s_io = io;
+    }
+    
+    const std::string& io()
+    {
+        return s_io;
+    }
+    
+    static volatile uint64_t s_sink = 0;
+    
+    void sink(uint64_t value)
+    {
+        s_sink += value;
+    }
+    
+    //////////////////////////////////////////////////////////////////////
+    
+    State::State(uint64_t iterations, double duration)
+    : _iterations(iterations)
+    , _duration(duration)
+    , _start(0)
+    , _elapsed(0)
+    , _items(0)
+    , _itemsSet(false)
+    {
+        
+    }
+    
+    uint64_t State::iterations() const
+    {
+        return _iterations;
+    }
+    
+    double State::duration() const
+    {
+        return _duration;
+    }
+    
+    void State::start()
+    {
+        _start = now();
+    }
+    
+    void State::stop()
+    {
+        _elapsed += now() - _start;
+    }
+    
+    double State::seconds() const
+    {
+        return _elapsed / 1e6;
+    }
+    
+    void State::setItems(uint64_t items)
+    {
+        _items = items;
+        _itemsSet = true;
+    }
+    
+    uint64_t State::items() const
+    {
+        return _itemsSet ? _items : _iterations;
+    }
+    
+    void State::counter(const std::string& name, double value)
+    {
+        _counters[name] = value;
+    }
+    
+    const std::map<std::string, double>& State::counters() const
+    {
+        return _counters;
+    }
+    
+    //////////////////////////////////////////////////////////////////////
+    
+    std::vector<Benchmark>& benchmarks()
+    {
+        static std::vector<Benchmark> s_benchmarks;
+        return s_benchmarks;
+    }
+    
+    Registrar::Registrar(const char* name, Kind kind, Function function)
+    {
+        Benchmark benchmark;
+        benchmark.name = name;
+        benchmark.kind = kind;
+        benchmark.function = function;
+        benchmarks().push_back(benchmark);
+    }
+    
+    double Result::nsPerItem() const
+    {
+        return items > 0 ? seconds * 1e9 / items : 0;
+    }
+    
+    double Result::itemsPerSecond() const
+    {
+        return seconds > 0 ? items / seconds : 0;
+    }
+    
+    Result run(const Benchmark& benchmark, double minTime, double duration)
+    {
+        uint64_t iterations = 1;
+        while(true)
+        {
+            State state(iterations, duration);
+            int64_t start = now();
+            benchmark.function(state);
+            int64_t elapsed = now() - start;
+            
+            // A run not timed with start()/stop() is timed as a whole
+            double seconds = state.seconds() > 0 ? state.seconds() : elapsed / 1e6;
+            if(benchmark.kind == MACRO || seconds >= minTime || iterations >= ((uint64_t)1 << 40))
+            {
+                Result result;
+                result.name = benchmark.name;
+                result.kind = benchmark.kind;
+                result.iterations = iterations;
+                result.items = state.items();
+                result.seconds = seconds;
+                result.counters = state.counters();
+                return result;
+            }
+            
+            // Aim past the minimum time, growing 2 to 10 times a run
+            double scale = seconds > 0 ? minTime * 1.4 / seconds : 10;
+            iterations = (uint64_t)(iterations * std::min(std::max(scale, 2.0), 10.0));
+        }
+    }
+    
+    static std::string quote(const std::string& s)
+    {
+        std::string q = "\"";
+        for(size_t i = 0; i < s.size(); ++i)
+        {
+            if(s[i] == '"' || s[i] == '\\')
+            {
+                q += '\\';
+            }
+            q += s[i];
+        }
+        return q + "\"";
+    }
+    
+    std::string toJson(const std::vector<Result>& results)
+    {
+        std::ostringstream oss;
+        oss << std::setprecision(6);
+        
+        char host[256] = "unknown";
+    #ifndef _WIN32
+        gethostname(host, sizeof(host) - 1);
+    #endif
+        
+        char date[64];
+        time_t t = time(NULL);
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+        
+        oss << "{\n";
+        oss << "  \"context\": {\"date\": " << quote(date) << ", \"host\": " << quote(host) 
+            << ", \"io\": " << quote(s_io) << "},\n";
+        oss << "  \"benchmarks\": [";
+        for(size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& r = results[i];
+            oss << (i > 0 ? ",\n" : "\n");
+            oss << "    {\"name\": " << quote(r.name)
+                << ", \"kind\": " << (r.kind == MICRO ? "\"micro\"" : "\"macro\"")
+                << ", \"iterations\": " << r.iterations
+                << ", \"items\": " << r.items
+                << ", \"seconds\": " << r.seconds
+                << ", \"ns_per_item\": " << r.nsPerItem()
+                << ", \"items_per_second\": " << r.itemsPerSecond()
+                << ", \"counters\": {";
+            
+            for(std::map<std::string, double>::const_iterator it = r.counters.begin(); it != r.counters.end(); ++it)
+            {
+                oss << (it == r.counters.begin() ? "" : ", ") << quote(it->first) << ": " << it->second;
+            }
+            oss << "}}";
+        }
+        oss << "\n  ]\n}\n";
+        return oss.str();
+    }
+    
+}
@@ -0,0 +1,144 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <pputil/Config.h>
+
+namespace bench
+{
+    //
+    // State of a benchmark run
+    // Micro benchmarks repeat their operation iterations() times, and are
+    // run with more iterations until they take the minimum time
+    // Macro benchmarks run for duration() seconds, count what they did 
+    // with setItems(), and are run once
+    //
+    class State
+    {
+    public:
+        State(uint64_t iterations, double duration);
+        
+        uint64_t iterations() const;
+        double duration() const;
+        
+        // Timed part, the whole run if not called
+        void start();
+        void stop();
+        double seconds() const;
+        
+        // Operations done, iterations if not set
+        void setItems(uint64_t items);
+        uint64_t items() const;
+        
+        // Other results (bytes, allocations, latency), written with result
+        void counter(const std::string& name, double value);
+        const std::map<std::string, double>& counters() const;
+        
+    private:
+        uint64_t _iterations;
+        double _duration;
+        int64_t _start;
+        int64_t _elapsed;
+        uint64_t _items;
+        bool _itemsSet;
+        std::map<std::string, double> _counters;
+    };
+    
+    typedef void (*Function)(State& state);
+    
+    enum Kind { MICRO, MACRO };
+    
+    //
+    // Benchmarks are registered by static Registrar objects (BENCH macros)
+    //
+    struct Benchmark
+    {
+        std::string name;
+        Kind kind;
+        Function function;
+    };
+    
+    std::vector<Benchmark>& benchmarks();
+    
+    struct Registrar
+    {
+        Registrar(const char* name, Kind kind, Function function);
+    };
+    
+    //
+    // Result of a run, written as a JSON object
+    //
+    struct Result
+    {
+        std::string name;
+        Kind kind;
+        uint64_t iterations;
+        uint64_t items;
+        double seconds;
+        std::map<std::string, double> counters;
+        
+        double nsPerItem() const;
+        double itemsPerSecond() const;
+    };
+    
+    // Run a benchmark, micro ones for at least minTime seconds
+    Result run(const Benchmark& benchmark, double minTime, double duration);
+    
+    // {"benchmarks": [...]} with a context of the run
+    std::string toJson(const std::vector<Result>& results);
+    
+    // Server I/O of macro benchmarks, "poll" (default) or "uring"
+    void setIo(const std::string& io);
+    const std::string& io();
+    
+    // Monotonic microseconds
+    int64_t now();
+    
+    // Keep the compiler from dropping a result
+    void sink(uint64_t value);
+}
+
+#define BENCH_MICRO(name) \
+    static void name(bench::State& state); \
+    static bench::Registrar name##Registrar(#name, bench::MICRO, name); \
+    static void name(bench::State& state)
+
+#define BENCH_MACRO(name) \
+    static void name(bench::State& state); \
+    static bench::Registrar name##Registrar(#name, bench::MACRO, name); \
+    static void name(bench::State& state)
+
+#endif
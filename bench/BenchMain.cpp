@@ -0,0 +1,151 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+//
+// Micro and macro benchmarks of pputil and rtsp hot paths
+// Usage: rtsp_bench [--filter text] [--json file] [--min-time seconds] 
+//                   [--duration seconds] [--io poll|uring] [--list]
+//
+// Servers of macro benchmarks run on the I/O backend of --io, threads 
+// polling their sockets by default, or io_uring of the server thread
+//
+// Results are printed as a table, and written as JSON to file 
+// ("-" for stdout) for regression tracking
+//
+
+#include "Bench.h"
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+int main(int argc, char* argv[])
+{
+    std::string filter;
+    std::string json;
+    double minTime = 0.5;
+    double duration = 3;
+    bool list = false;
+    
+#ifndef _WIN32
+    // Peers of the server and the load generator close while writes are in flight
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool value = i + 1 < argc;
+        if(arg == "--filter" && value)
+        {
+            filter = argv[++i];
+        }
+        else if(arg == "--json" && value)
+        {
+            json = argv[++i];
+        }
+        else if(arg == "--min-time" && value)
+        {
+            minTime = atof(argv[++i]);
+        }
+        else if(arg == "--duration" && value)
+        {
+            duration = atof(argv[++i]);
+        }
+        else if(arg == "--io" && value && (std::string(argv[i + 1]) == "poll" || std::string(argv[i + 1]) == "uring"))
+        {
+            bench::setIo(argv[++i]);
+        }
+        else if(arg == "--list")
+        {
+            list = true;
+        }
+        else
+        {
+            std::cerr << "Usage: rtsp_bench [--filter text] [--json file] [--min-time seconds] [--duration seconds] [--io poll|uring] [--list]\n";
+            return 2;
+        }
+    }
+    
+    // Table goes to stderr when JSON is on stdout
+    std::ostream& out = json == "-" ? std::cerr : std::cout;
+    
+    std::vector<bench::Result> results;
+    const std::vector<bench::Benchmark>& benchmarks = bench::benchmarks();
+    for(size_t i = 0; i < benchmarks.size(); ++i)
+    {
+        const bench::Benchmark& b = benchmarks[i];
+        if(!filter.empty() && b.name.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+        
+        if(list)
+        {
+            out << b.name << (b.kind == bench::MICRO ? " (micro)\n" : " (macro)\n");
+            continue;
+        }
+        
+        bench::Result r = bench::run(b, minTime, duration);
+        results.push_back(r);
+        
+        char line[256];
+        snprintf(line, sizeof(line), "%-32s %14.1f ns/op %16.0f op/s", 
+                 r.name.c_str(), r.nsPerItem(), r.itemsPerSecond());
+        out << line;
+        for(std::map<std::string, double>::const_iterator it = r.counters.begin(); it != r.counters.end(); ++it)
+        {
+            out << "  " << it->first << "=" << it->second;
+        }
+        out << "\n" << std::flush;
+    }
+    
+    if(json == "-")
+    {
+        std::cout << bench::toJson(results);
+    }
+    else if(!json.empty())
+    {
+        std::ofstream file(json.c_str());
+        file << bench::toJson(results);
+        if(!file)
+        {
+            std::cerr << "Failed to write " << json << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,163 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef BENCH_BENCH_SERVER_H
+#define BENCH_BENCH_SERVER_H
+
+#include <rtsp/RtspServer.h>
+
+namespace bench
+{
+    //
+    // Media of benchmarks, each stream sends burst RTP packets of 
+    // payload bytes every time the session runs while it is playing
+    //
+    class BenchSession : public rtsp::RtspSession
+    {
+    public:
+        BenchSession(const std::string& sid, const std::string& mid, size_t burst, size_t payload)
+        : rtsp::RtspSession(sid, mid)
+        , _burst(burst)
+        , _payload(payload)
+        , _timestamp(0)
+        {
+        }
+        
+        virtual int seek(int pos)
+        {
+            return 0;
+        }
+        
+        virtual bool run()
+        {
+            if(m_state != PLAYING)
+            {
+                return true;
+            }
+            
+            _timestamp += 3000;
+            for(std::vector<rtsp::RtspStream*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+            {
+                for(size_t i = 0; i < _burst; ++i)
+                {
+                    unsigned int seq = (*it)->seq();
+                    
+                    pputil::BlobPtr packet = new pputil::Blob(12 + _payload);
+                    pputil::byte* b = packet->data();
+                    memset(b, 0, packet->size());
+                    b[0] = 0x80;
+                    b[1] = 96;
+                    b[2] = (pputil::byte)(seq >> 8);
+                    b[3] = (pputil::byte)seq;
+                    b[4] = (pputil::byte)(_timestamp >> 24);
+                    b[5] = (pputil::byte)(_timestamp >> 16);
+                    b[6] = (pputil::byte)(_timestamp >> 8);
+                    b[7] = (pputil::byte)_timestamp;
+                    
+                    (*it)->sendData(packet);
+                }
+            }
+            return true;
+        }
+        
+    private:
+        size_t _burst;
+        size_t _payload;
+        uint32_t _timestamp;
+    };
+    
+    //
+    // Server of one video track for any mid, sessions of BenchSession
+    //
+    class BenchServer : public rtsp::RtspServer
+    {
+    public:
+        BenchServer(unsigned short port, size_t burst = 0, size_t payload = 1200)
+        : rtsp::RtspServer(port)
+        , _burst(burst)
+        , _payload(payload)
+        {
+        }
+        
+        // Sessions without streams, to look up
+        void addSessions(size_t count)
+        {
+            for(size_t i = 0; i < count; ++i)
+            {
+                std::ostringstream oss;
+                oss << ++_sid;
+                _sessions.push_back(createSession(oss.str(), "bench"));
+            }
+        }
+        
+        // Sessions created by requests, of a server not activated
+        void removeSessions()
+        {
+            IceUtil::RecMutex::Lock lock(_sessionsMutex);
+            for(std::vector<rtsp::RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); ++it)
+            {
+                closeSession(*it);
+            }
+            _sessions.clear();
+        }
+        
+        using rtsp::RtspServer::findSession;
+        using rtsp::RtspServer::removeMedia;
+        
+    protected:
+        virtual std::string mediaSDP(const std::string& mid)
+        {
+            std::ostringstream oss;
+            oss << "v=0\r\n"
+                << "o=- " << mid << " 1 IN IP4 127.0.0.1\r\n"
+                << "s=" << mid << "\r\n"
+                << "t=0 0\r\n"
+                << "m=video 0 RTP/AVP 96\r\n"
+                << "a=rtpmap:96 H264/90000\r\n"
+                << "a=control:video\r\n";
+            return oss.str();
+        }
+        
+        virtual rtsp::RtspSession* createSession(const std::string& sid, const std::string& mid)
+        {
+            return new BenchSession(sid, mid, _burst, _payload);
+        }
+        
+    private:
+        size_t _burst;
+        size_t _payload;
+    };
+}
+
+#endif
@@ -0,0 +1,211 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+//
+// Macro benchmarks on loopback, a BenchServer loaded for duration seconds
+//
+
+#include "Bench.h"
+#include "BenchServer.h"
+#include <rtsp/LoadGenerator.h>
+#include <pputil/Socket.h>
+
+using namespace bench;
+
+// Latency of all requests, and what the generator saw
+static void report(State& state, const rtsp::LoadGenerator::Report& report)
+{
+    rtsp::LatencyHistogram all;
+    for(std::map<std::string, rtsp::LatencyHistogram>::const_iterator it = report.latency.begin(); it != report.latency.end(); ++it)
+    {
+        all.merge(it->second);
+    }
+    
+    state.counter("latency_p50_us", (double)all.percentile(50));
+    state.counter("latency_p99_us", (double)all.percentile(99));
+    state.counter("errors", (double)report.errors);
+    state.counter("clients", (double)report.connected);
+}
+
+// Server runs on the backend of --io, a run io_uring is not supported
+// on counts an error and nothing else
+static bool activate(State& state, BenchServer& server)
+{
+    if(io() == "uring" && !server.setIoBackend(pputil::TcpServer::IO_URING))
+    {
+        std::cerr << "io_uring is not supported\n";
+        state.counter("errors", 1);
+        return false;
+    }
+    return server.activate();
+}
+
+static void load(State& state, BenchServer& server, const rtsp::LoadGenerator::Scenario& scenario, size_t clients, bool packets)
+{
+    if(!activate(state, server))
+    {
+        return;
+    }
+    
+    rtsp::LoadGenerator generator;
+    state.start();
+    generator.start(scenario, clients);
+    IceUtil::ThreadControl::sleep(IceUtil::Time::microSeconds((int64_t)(state.duration() * 1e6)));
+    generator.stop();
+    state.stop();
+    
+    rtsp::LoadGenerator::Report r = generator.report();
+    report(state, r);
+    if(packets)
+    {
+        state.setItems(r.packets);
+        state.counter("bits_per_second", r.bytes * 8 / state.seconds());
+    }
+    else
+    {
+        state.setItems(r.requests);
+    }
+    
+    server.shutdown();
+}
+
+// Rounds of OPTIONS, DESCRIBE, SETUP, PLAY and TEARDOWN by 32 clients
+BENCH_MACRO(requests_per_sec)
+{
+    BenchServer server(19960);
+    
+    rtsp::LoadGenerator::Scenario scenario;
+    scenario.port = 19960;
+    scenario.mid = "bench";
+    scenario.hold = 0;
+    scenario.keepalive = 0;
+    scenario.rounds = 0;
+    
+    load(state, server, scenario, 32, false);
+}
+
+// RTP of 8 sessions interleaved in their connections, sent as fast as
+// the server runs sessions, and written once per tick
+BENCH_MACRO(packets_per_sec)
+{
+    BenchServer server(19962, 16, 1200);
+    server.setRunInterval(0);
+    server.setBatching(true);
+    
+    rtsp::LoadGenerator::Scenario scenario;
+    scenario.port = 19962;
+    scenario.mid = "bench";
+    scenario.hold = (int64_t)(state.duration() * 2e6);
+    scenario.keepalive = 0;
+    
+    load(state, server, scenario, 8, true);
+}
+
+// RTP of 8 sessions over UDP
+BENCH_MACRO(packets_per_sec_udp)
+{
+    BenchServer server(19964, 16, 1200);
+    server.setRunInterval(0);
+    
+    rtsp::LoadGenerator::Scenario scenario;
+    scenario.port = 19964;
+    scenario.mid = "bench";
+    scenario.udp = true;
+    scenario.udpPort = 41000;
+    scenario.hold = (int64_t)(state.duration() * 2e6);
+    scenario.keepalive = 0;
+    
+    load(state, server, scenario, 8, true);
+}
+
+// Connect, OPTIONS and close, one connection after another
+BENCH_MACRO(connections_per_sec)
+{
+    BenchServer server(19966);
+    if(!activate(state, server))
+    {
+        return;
+    }
+    
+    static const char* request = 
+        "OPTIONS rtsp://127.0.0.1:19966/bench RTSP/1.0\r\n"
+        "CSeq: 1\r\n"
+        "\r\n";
+    
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(19966);
+    
+    uint64_t connections = 0;
+    uint64_t errors = 0;
+    char buf[4096];
+    
+    state.start();
+    int64_t end = now() + (int64_t)(state.duration() * 1e6);
+    while(now() < end)
+    {
+        try
+        {
+            SOCKET fd = pputil::createTcpSocket();
+            pputil::doConnect(fd, addr);
+            
+            // Response ends with a blank line
+            bool ok = ::send(fd, request, strlen(request), 0) == (long)strlen(request);
+            std::string response;
+            while(ok && response.find("\r\n\r\n") == std::string::npos)
+            {
+                long n = ::recv(fd, buf, sizeof(buf), 0);
+                ok = n > 0;
+                if(ok)
+                {
+                    response.append(buf, n);
+                }
+            }
+            pputil::closeSocket(fd);
+            
+            ok ? connections++ : errors++;
+        }
+        catch(pputil::SocketException& ex)
+        {
+            errors++;
+        }
+    }
+    state.stop();
+    
+    state.setItems(connections);
+    state.counter("errors", (double)errors);
+    server.shutdown();
+}
@@ -0,0 +1,165 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+//
+// Allocator calls per RTSP request, parsed and answered by RtspConnection 
+// and RtspServer the way a client connection is served, without sockets
+// Usage: MessageBench [requests]
+//
+// Requests, responses and the blobs they are sent in come from the 
+// connection's MessagePool, and batches of the send queue are reused, so 
+// steady requests are answered without allocation. What is left is 
+// strings longer than the short string buffer.
+//
+
+#include "BenchServer.h"
+#include <rtsp/RtspConnection.h>
+#include <IceUtil/Time.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <cstdlib>
+#include <new>
+
+using namespace rtsp;
+
+static size_t s_allocations = 0;
+
+// Not inlined, so that free() is not seen paired with operator new
+__attribute__((noinline)) void* operator new(size_t n) throw(std::bad_alloc)
+{
+    s_allocations++;
+    void* p = malloc(n ? n : 1);
+    if(p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) throw()
+{
+    free(p);
+}
+
+void* operator new[](size_t n) throw(std::bad_alloc)
+{
+    return operator new(n);
+}
+
+void operator delete[](void* p) throw()
+{
+    operator delete(p);
+}
+
+static const char* s_requests[] = 
+{
+    "OPTIONS rtsp://127.0.0.1:8554/3012 RTSP/1.0\r\n"
+    "CSeq: 1\r\n"
+    "User-Agent: MessageBench\r\n"
+    "\r\n",
+    
+    "GET_PARAMETER rtsp://127.0.0.1:8554/3012 RTSP/1.0\r\n"
+    "CSeq: 2\r\n"
+    "Session: 12345678\r\n"
+    "User-Agent: MessageBench\r\n"
+    "\r\n"
+};
+
+// Take queued responses, as the server ring would send them
+static size_t drain(pputil::TcpConnection* conn)
+{
+    size_t total = 0;
+    pputil::TcpConnection::SendBatchPtr batch;
+    while(conn->ringTake(batch))
+    {
+        size_t bytes = 0;
+        for(size_t i = 0; i < batch->chunks.size(); ++i)
+        {
+            bytes += batch->chunks[i].headLen + batch->chunks[i].body->size();
+        }
+        conn->ringSent(bytes);
+        total += bytes;
+        batch = 0;
+    }
+    return total;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t requests = argc > 1 ? atoi(argv[1]) : 100000;
+    
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    int wake = eventfd(0, EFD_NONBLOCK);
+    
+    bench::BenchServer server(0);
+    RtspConnection* conn = new RtspConnection(fds[0], &server);
+    conn->attach(wake);
+    
+    // Warm up pools and strings
+    const size_t kinds = sizeof(s_requests) / sizeof(s_requests[0]);
+    for(size_t i = 0; i < 16; ++i)
+    {
+        const char* r = s_requests[i % kinds];
+        conn->ringReceive((const pputil::byte*)r, strlen(r));
+        drain(conn);
+    }
+    
+    size_t created = conn->pool().created();
+    size_t reused = conn->pool().reused();
+    size_t bytes = 0;
+    
+    s_allocations = 0;
+    IceUtil::Time start = IceUtil::Time::now(IceUtil::Time::Monotonic);
+    for(size_t i = 0; i < requests; ++i)
+    {
+        const char* r = s_requests[i % kinds];
+        conn->ringReceive((const pputil::byte*)r, strlen(r));
+        bytes += drain(conn);
+    }
+    IceUtil::Time elapsed = IceUtil::Time::now(IceUtil::Time::Monotonic) - start;
+    size_t allocations = s_allocations;
+    
+    printf("requests %lu, %.0f requests/s, response bytes %lu\n", 
+           (unsigned long)requests, requests / elapsed.toSecondsDouble(), (unsigned long)bytes);
+    printf("allocations per request %.2f\n", (double)allocations / requests);
+    printf("messages created %lu, reused %lu\n", 
+           (unsigned long)(conn->pool().created() - created), (unsigned long)(conn->pool().reused() - reused));
+    
+    conn->ringClosed();
+    delete conn;
+    close(fds[1]);
+    close(wake);
+    return 0;
+}
@@ -0,0 +1,321 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+//
+// Micro benchmarks, one operation of a hot path per item
+//
+
+#include "Bench.h"
+#include "BenchServer.h"
+#include <pputil/Buffer.h>
+#include <pputil/Logger.h>
+#include <pputil/Metrics.h>
+#include <pputil/Trace.h>
+#include <rtsp/RtspClient.h>
+#include <rtsp/UrlRouter.h>
+
+#ifndef _WIN32
+#   include <sys/socket.h>
+#   include <unistd.h>
+#endif
+
+using namespace bench;
+
+// Fixed width writes and reads, in and out of a warm buffer
+BENCH_MICRO(buffer_write_read32)
+{
+    pputil::Buffer buffer;
+    uint64_t sum = 0;
+    
+    state.start();
+    for(uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        buffer.write32u((uint32_t)i);
+        sum += buffer.read32u();
+    }
+    state.stop();
+    sink(sum);
+}
+
+// Peek of interleaved header: '$', channel and length
+BENCH_MICRO(buffer_peek_interleaved)
+{
+    pputil::Buffer buffer;
+    pputil::byte head[4] = { '$', 0, 0x05, 0xdc };
+    buffer.writeBlob(head, sizeof(head));
+    uint64_t sum = 0;
+    
+    state.start();
+    for(uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        sum += buffer.peek8u() + buffer.peek8u(1) + (((size_t)buffer.peek8u(2) << 8) | buffer.peek8u(3));
+    }
+    state.stop();
+    sink(sum);
+}
+
+// Header lines of a request, into a reused string
+BENCH_MICRO(buffer_readline)
+{
+    static const char* lines = 
+        "CSeq: 2\r\n"
+        "Session: 12345678\r\n"
+        "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n"
+        "User-Agent: rtsp_bench\r\n";
+    size_t n = strlen(lines);
+    
+    pputil::Buffer buffer;
+    std::string line;
+    uint64_t sum = 0;
+    
+    state.start();
+    for(uint64_t i = 0; i < state.iterations(); i += 4)
+    {
+        buffer.writeBlob((pputil::byte*)lines, n);
+        while(buffer.readLine(line))
+        {
+            sum += line.size();
+        }
+    }
+    state.stop();
+    sink(sum);
+}
+
+// Client on a socket it does not connect
+class ParseClient : public rtsp::RtspClient
+{
+public:
+    ParseClient(SOCKET fd)
+    {
+        _fd = fd;
+    }
+};
+
+// Response parsed by a client connection, messages from its pool
+BENCH_MICRO(message_parse)
+{
+#ifndef _WIN32
+    static const char* response = 
+        "RTSP/1.0 200 OK\r\n"
+        "CSeq: 3\r\n"
+        "Session: 12345678;timeout=60\r\n"
+        "Transport: RTP/AVP/TCP;unicast;interleaved=0-1;ssrc=bedf8d2d;mode=PLAY\r\n"
+        "Server: rtsp_bench\r\n"
+        "\r\n";
+    size_t n = strlen(response);
+    
+    int fds[2];
+    int wake[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0 || pipe(wake) != 0)
+    {
+        return;
+    }
+    
+    ParseClient* client = new ParseClient(fds[0]);
+    client->attach(wake[1]);
+    
+    state.start();
+    for(uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        client->ringReceive((const pputil::byte*)response, n);
+    }
+    state.stop();
+    
+    client->ringClosed();
+    delete client;
+    close(fds[1]);
+    close(wake[0]);
+    close(wake[1]);
+#endif
+}
+
+// Response of SETUP serialized into a buffer
+BENCH_MICRO(message_serialize)
+{
+    rtsp::RtspResponse response;
+    response.setStatus(200);
+    response.setVersion("1.0");
+    response.setHeader("CSeq", "3");
+    response.setHeader("Session", "12345678");
+    response.setHeader("Transport", "RTP/AVP/TCP;unicast;interleaved=0-1;ssrc=bedf8d2d;mode=PLAY");
+    response.setHeader("Server", "rtsp_bench");
+    
+    std::vector<pputil::byte> b(response.length());
+    uint64_t sum = 0;
+    
+    state.start();
+    for(uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        sum += response.serialize(&b[0]);
+    }
+    state.stop();
+    sink(sum);
+}
+
+// Session by id among 1000
+BENCH_MICRO(session_lookup)
+{
+    const size_t sessions = 1000;
+    BenchServer server(0);
+    server.addSessions(sessions);
+    
+    std::vector<std::string> sids;
+    for(size_t i = 1; i <= sessions; ++i)
+    {
+        std::ostringstream oss;
+        oss << i;
+        sids.push_back(oss.str());
+    }
+    
+    uint64_t found = 0;
+    state.start();
+    for(uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        found += server.findSession(sids[(i * 7919) % sessions]) != NULL;
+    }
+    state.stop();
+    sink(found);
+    state.counter("sessions", sessions);
+    server.removeMedia("bench");
+}
+
+// Track URL of SETUP to mid and track ids, among 10000 mount points
+BENCH_MICRO(url_route)
+{
+    const size_t mids = 10000;
+    rtsp::UrlRouter router(mids + 1);
+    
+    std::vector<std::string> urls;
+    for(size_t i = 0; i < mids; ++i)
+    {
+        std::ostringstream oss;
+        oss << 100000 + i;
+        urls.push_back("rtsp://127.0.0.1:8554/" + oss.str() + "/video");
+        router.mid(oss.str());
+    }
+    router.track("video");
+    
+    uint64_t sum = 0;
+    rtsp::UrlRouter::Route route;
+    state.start();
+    for(uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        router.route(urls[(i * 7919) % mids], true, route);
+        sum += route.mid + route.track;
+    }
+    state.stop();
+    sink(sum);
+    state.counter("mids", mids);
+}
+
+// Counter update on a hot path, to the shard of calling thread
+BENCH_MICRO(metrics_add)
+{
+    pputil::Metrics& metrics = pputil::Metrics::instance();
+    int id = metrics.counter("bench_add_total");
+    
+    state.start();
+    for(uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        metrics.add(id);
+    }
+    state.stop();
+}
+
+// Latency record to a histogram
+BENCH_MICRO(metrics_record)
+{
+    pputil::Metrics& metrics = pputil::Metrics::instance();
+    int id = metrics.histogram("bench_record_us");
+    
+    state.start();
+    for(uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        metrics.record(id, (int64_t)(i & 4095));
+    }
+    state.stop();
+}
+
+// Message with arguments put to the logger ring, written to /dev/null
+// by the flusher, messages are dropped when it falls behind
+BENCH_MICRO(log_message)
+{
+    pputil::Logger& logger = pputil::Logger::instance();
+    FILE* null = fopen("/dev/null", "w");
+    if(null == NULL)
+    {
+        return;
+    }
+    logger.setOutput(null);
+    logger.setRateLimit(0);
+    
+    state.start();
+    for(uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        PP_LOG_INFO("Message {} of {} on {}", i, state.iterations(), "bench");
+    }
+    state.stop();
+    
+    logger.flush();
+    logger.setRateLimit(100);
+    logger.setOutput(stderr);
+    fclose(null);
+}
+
+// Span of a scope, as it costs when tracing is disabled and enabled
+static void traceSpans(State& state, bool enable)
+{
+    pputil::Trace::enable(enable);
+    
+    state.start();
+    for(uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        PP_TRACE_SPAN("bench");
+        sink(i);
+    }
+    state.stop();
+    
+    pputil::Trace::enable(false);
+    pputil::Trace::clear();
+}
+
+BENCH_MICRO(trace_span_disabled)
+{
+    traceSpans(state, false);
+}
+
+BENCH_MICRO(trace_span_enabled)
+{
+    traceSpans(state, true);
+}
@@ -0,0 +1,362 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+//
+// Replay of a capture written by pputil::Capture (RTSP_CAPTURE of demo),
+// to reproduce what a server was given, as a repeatable benchmark
+// Usage: rtsp_replay [--port N] [--max] [--repeat N] [--target host:port] capture.pcapng
+//
+//   --port      Port of the server in the capture, bytes of TCP streams 
+//               to it are replayed (default 9960)
+//   --max       Send as fast as possible instead of at recorded speed
+//   --repeat    Rounds of replay (default 1)
+//   --target    Send to a running server, a connection for each captured
+//               one, otherwise bytes are parsed and handled in process by 
+//               RtspConnection and a BenchServer, without sockets
+//
+// Requests are replayed as they are, those referring to sessions of the 
+// capture (PLAY, TEARDOWN...) find no session on a server that gave out 
+// other session ids. Datagrams (RTP, RTCP) are not replayed.
+//
+
+#include "BenchServer.h"
+#include <rtsp/RtspConnection.h>
+#include <pputil/Capture.h>
+#include <IceUtil/Time.h>
+#include <IceUtil/Thread.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <signal.h>
+
+using namespace rtsp;
+
+// Bytes a client sent in one segment, on the i-th captured connection
+struct Segment
+{
+    int64_t time;
+    size_t connection;
+    std::vector<pputil::byte> bytes;
+};
+
+static bool load(const char* path, unsigned short port, std::vector<Segment>& segments, size_t& connections)
+{
+    pputil::CaptureReader reader;
+    if(!reader.open(path))
+    {
+        return false;
+    }
+    
+    std::map<uint64_t, size_t> clients;
+    pputil::CaptureReader::Packet packet;
+    while(reader.next(packet))
+    {
+        if(packet.protocol != IPPROTO_TCP || ntohs(packet.to.sin_port) != port)
+        {
+            continue;
+        }
+        
+        uint64_t key = ((uint64_t)ntohl(packet.from.sin_addr.s_addr) << 16) | ntohs(packet.from.sin_port);
+        std::map<uint64_t, size_t>::iterator it = clients.find(key);
+        if(it == clients.end())
+        {
+            it = clients.insert(std::make_pair(key, clients.size())).first;
+        }
+        
+        Segment segment;
+        segment.time = packet.time;
+        segment.connection = it->second;
+        segments.push_back(segment);
+        segments.back().bytes.swap(packet.payload);
+    }
+    
+    connections = clients.size();
+    return true;
+}
+
+// Wait until the time of a segment, relative to the first
+static void pace(const std::vector<Segment>& segments, size_t i, const IceUtil::Time& start)
+{
+    IceUtil::Time due = start + IceUtil::Time::microSeconds(segments[i].time - segments[0].time);
+    IceUtil::Time wait = due - IceUtil::Time::now(IceUtil::Time::Monotonic);
+    if(wait.toMicroSeconds() > 0)
+    {
+        IceUtil::ThreadControl::sleep(wait);
+    }
+}
+
+// Take queued responses, as the server ring would send them
+static size_t drain(pputil::TcpConnection* conn)
+{
+    size_t total = 0;
+    pputil::TcpConnection::SendBatchPtr batch;
+    while(conn->ringTake(batch))
+    {
+        size_t bytes = 0;
+        for(size_t i = 0; i < batch->chunks.size(); ++i)
+        {
+            bytes += batch->chunks[i].headLen + batch->chunks[i].body->size();
+        }
+        conn->ringSent(bytes);
+        total += bytes;
+        batch = 0;
+    }
+    return total;
+}
+
+// Fed to connections of a server in process, return bytes of responses
+static size_t replayInProcess(const std::vector<Segment>& segments, size_t connections, bool max)
+{
+    bench::BenchServer* server = new bench::BenchServer(0);
+    
+    std::vector<RtspConnection*> conns;
+    std::vector<int> peers;
+    int wake = eventfd(0, EFD_NONBLOCK);
+    for(size_t i = 0; i < connections; ++i)
+    {
+        int fds[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        {
+            break;
+        }
+        RtspConnection* conn = new RtspConnection(fds[0], server);
+        conn->attach(wake);
+        conns.push_back(conn);
+        peers.push_back(fds[1]);
+    }
+    
+    size_t bytes = 0;
+    IceUtil::Time start = IceUtil::Time::now(IceUtil::Time::Monotonic);
+    for(size_t i = 0; i < segments.size(); ++i)
+    {
+        const Segment& segment = segments[i];
+        if(segment.connection >= conns.size())
+        {
+            continue;
+        }
+        if(!max)
+        {
+            pace(segments, i, start);
+        }
+        
+        RtspConnection* conn = conns[segment.connection];
+        conn->ringReceive(&segment.bytes[0], segment.bytes.size());
+        bytes += drain(conn);
+    }
+    
+    // Connections detach streams of sessions through the server, 
+    // so they go before it
+    for(size_t i = 0; i < conns.size(); ++i)
+    {
+        conns[i]->ringClosed();
+        delete conns[i];
+        close(peers[i]);
+    }
+    server->removeSessions();
+    delete server;
+    close(wake);
+    return bytes;
+}
+
+// Read what is waiting on sockets, return bytes read
+static size_t receive(const std::vector<SOCKET>& fds)
+{
+    size_t total = 0;
+    char b[16 * 1024];
+    for(size_t i = 0; i < fds.size(); ++i)
+    {
+        long n;
+        while(fds[i] != INVALID_SOCKET && (n = recv(fds[i], b, sizeof(b), MSG_DONTWAIT)) > 0)
+        {
+            total += n;
+        }
+    }
+    return total;
+}
+
+// Sent to a running server, return bytes of responses
+static size_t replayToServer(const std::vector<Segment>& segments, size_t connections, bool max, 
+                             const sockaddr_in& target)
+{
+    std::vector<SOCKET> fds(connections, INVALID_SOCKET);
+    size_t bytes = 0;
+    
+    IceUtil::Time start = IceUtil::Time::now(IceUtil::Time::Monotonic);
+    for(size_t i = 0; i < segments.size(); ++i)
+    {
+        const Segment& segment = segments[i];
+        if(!max)
+        {
+            pace(segments, i, start);
+        }
+        
+        // Connect when the captured connection sent its first bytes
+        SOCKET& fd = fds[segment.connection];
+        if(fd == INVALID_SOCKET)
+        {
+            try
+            {
+                fd = pputil::createTcpSocket();
+                sockaddr_in addr = target;
+                pputil::doConnect(fd, addr);
+                pputil::setTcpNoDelay(fd);
+            }
+            catch(pputil::SocketException& ex)
+            {
+                fprintf(stderr, "connect failed: %s\n", ex.what());
+                break;
+            }
+        }
+        
+        size_t sent = 0;
+        while(sent < segment.bytes.size())
+        {
+            long n = ::send(fd, (const char*)&segment.bytes[sent], segment.bytes.size() - sent, 0);
+            if(n <= 0)
+            {
+                break;
+            }
+            sent += n;
+        }
+        bytes += receive(fds);
+    }
+    
+    // Responses of the last requests, until the server is quiet
+    size_t quiet = 0;
+    while(quiet < 20)
+    {
+        IceUtil::ThreadControl::sleep(IceUtil::Time::milliSeconds(10));
+        size_t n = receive(fds);
+        bytes += n;
+        quiet = n > 0 ? 0 : quiet + 1;
+    }
+    
+    for(size_t i = 0; i < fds.size(); ++i)
+    {
+        if(fds[i] != INVALID_SOCKET)
+        {
+            pputil::closeSocket(fds[i]);
+        }
+    }
+    return bytes;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned short port = 9960;
+    bool max = false;
+    size_t repeat = 1;
+    const char* target = NULL;
+    const char* path = NULL;
+    
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+        {
+            port = (unsigned short)atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--max") == 0)
+        {
+            max = true;
+        }
+        else if(strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            repeat = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--target") == 0 && i + 1 < argc)
+        {
+            target = argv[++i];
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    
+    if(path == NULL)
+    {
+        fprintf(stderr, "Usage: rtsp_replay [--port N] [--max] [--repeat N] [--target host:port] capture.pcapng\n");
+        return 1;
+    }
+    
+    signal(SIGPIPE, SIG_IGN);
+    
+    std::vector<Segment> segments;
+    size_t connections = 0;
+    if(!load(path, port, segments, connections))
+    {
+        fprintf(stderr, "Failed to read %s\n", path);
+        return 1;
+    }
+    if(segments.empty())
+    {
+        fprintf(stderr, "No bytes sent to port %d in %s\n", port, path);
+        return 1;
+    }
+    
+    sockaddr_in addr;
+    if(target != NULL)
+    {
+        std::string s(target);
+        size_t colon = s.rfind(':');
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(s.substr(0, colon).c_str());
+        addr.sin_port = htons(colon == std::string::npos ? port : (unsigned short)atoi(s.c_str() + colon + 1));
+    }
+    
+    size_t bytes = 0;
+    for(size_t i = 0; i < segments.size(); ++i)
+    {
+        bytes += segments[i].bytes.size();
+    }
+    
+    printf("connections %lu, segments %lu, bytes %lu, recorded %.3f s\n", 
+           (unsigned long)connections, (unsigned long)segments.size(), (unsigned long)bytes, 
+           (segments.back().time - segments.front().time) / 1e6);
+    
+    for(size_t round = 0; round < repeat; ++round)
+    {
+        IceUtil::Time start = IceUtil::Time::now(IceUtil::Time::Monotonic);
+        size_t responses = target != NULL 
+            ? replayToServer(segments, connections, max, addr)
+            : replayInProcess(segments, connections, max);
+        double elapsed = (IceUtil::Time::now(IceUtil::Time::Monotonic) - start).toSecondsDouble();
+        
+        printf("round %lu: %.3f s, %.0f segments/s, %.1f MB/s, response bytes %lu\n", 
+               (unsigned long)round + 1, elapsed, segments.size() / elapsed, bytes / elapsed / 1e6, 
+               (unsigned long)responses);
+    }
+    
+    return 0;
+}
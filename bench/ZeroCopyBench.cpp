@@ -0,0 +1,187 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+//
+// CPU cost of sending interleaved packets through TcpConnection over 
+// loopback, with and without MSG_ZEROCOPY
+// Usage: ZeroCopyBench [megabytes] [payload bytes]
+//
+// Loopback delivery copies on the receive side, and the kernel may fall
+// back to copying zero copy sends, so the gain on a NIC is larger than 
+// here. CPU per Gbit counts the whole process except the receiving thread.
+//
+
+#include <pputil/TcpConnection.h>
+#include <pputil/Socket.h>
+#include <IceUtil/Time.h>
+#include <sys/resource.h>
+#include <time.h>
+
+using namespace pputil;
+
+static double threadCpu()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double processCpu()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+// Read and drop everything, until total bytes
+class Receiver : public Thread
+{
+public:
+    Receiver(SOCKET fd, uint64_t total)
+    : _fd(fd)
+    , _total(total)
+    , _received(0)
+    , _cpu(0)
+    {
+    }
+    
+    virtual void run()
+    {
+        double start = threadCpu();
+        std::vector<char> buf(256 * 1024);
+        while(_received < _total)
+        {
+            long n = ::recv(_fd, &buf[0], buf.size(), 0);
+            if(n <= 0)
+            {
+                break;
+            }
+            _received += n;
+        }
+        _cpu = threadCpu() - start;
+    }
+    
+    uint64_t received() const { return _received; }
+    double cpu() const { return _cpu; }
+    
+private:
+    SOCKET _fd;
+    uint64_t _total;
+    uint64_t _received;
+    double _cpu;
+};
+
+typedef IceUtil::Handle<Receiver> ReceiverPtr;
+
+static bool run(bool zeroCopy, uint64_t total, size_t payload)
+{
+    // Loopback pair
+    SOCKET listener = createTcpSocket();
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = 0;
+    doBind(listener, addr);
+    doListen(listener, 1);
+    fdToLocalAddress(listener, addr);
+    
+    SOCKET client = createTcpSocket();
+    doConnect(client, addr);
+    SOCKET server = doAccept(listener);
+    closeSocket(listener);
+    
+    TcpConnection* conn = new TcpConnection(server, NULL);
+    if(zeroCopy && !conn->setZeroCopy(true))
+    {
+        std::cout << "MSG_ZEROCOPY is not supported\n";
+        delete conn;
+        closeSocket(client);
+        return false;
+    }
+    conn->receive();
+    
+    // Each packet is '$' + channel + length, and a payload shared by all
+    BlobPtr body = new Blob(payload);
+    byte head[4] = { '$', 0, (byte)(payload >> 8), (byte)payload };
+    uint64_t count = total / (payload + 4);
+    
+    ReceiverPtr receiver = new Receiver(client, count * (payload + 4));
+    IceUtil::ThreadControl control = receiver->start();
+    
+    double cpu = processCpu();
+    IceUtil::Time start = IceUtil::Time::now(IceUtil::Time::Monotonic);
+    
+    for(uint64_t i = 0; i < count; )
+    {
+        if(conn->asynSend(head, sizeof(head), body))
+        {
+            ++i;
+        }
+        else
+        {
+            // Queue is full
+            IceUtil::ThreadControl::sleep(IceUtil::Time::microSeconds(50));
+        }
+    }
+    control.join();
+    
+    double seconds = (IceUtil::Time::now(IceUtil::Time::Monotonic) - start).toMicroSeconds() / 1e6;
+    cpu = processCpu() - cpu - receiver->cpu();
+    double gbits = receiver->received() * 8 / 1e9;
+    
+    std::cout << (zeroCopy ? "zerocopy" : "copy    ") 
+              << "  payload " << payload
+              << "  " << gbits / seconds << " Gbps"
+              << "  " << cpu / gbits << " cpu-s/Gbit\n";
+    
+    conn->close();
+    delete conn;
+    closeSocket(client);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t megabytes = argc > 1 ? atoi(argv[1]) : 4096;
+    size_t payload = argc > 2 ? atoi(argv[2]) : 60000;
+    if(payload > 0xffff)
+    {
+        payload = 0xffff;
+    }
+    
+    run(false, megabytes << 20, payload);
+    run(true, megabytes << 20, payload);
+    return 0;
+}
@@ -33,8 +33,155 @@
 // **********************************************************************
 
 #include "rtsp/RtspServer.h"
+#include "rtsp/LoadGenerator.h"
+#include "rtsp/StatusServer.h"
+#include "pputil/Capture.h"
+#include "pputil/Trace.h"
+#include <IceUtil/Time.h>
+#ifndef _WIN32
+#include <signal.h>
+#endif
 
+using namespace rtsp;
+
+//
+// Media of the demo, each stream sends a 1000 byte RTP packet 
+// every 20ms while it is playing
+//
+class DemoSession : public RtspSession
+{
+public:
+    DemoSession(const std::string& sid, const std::string& mid)
+    : RtspSession(sid, mid)
+    , _next(0)
+    , _timestamp(0)
+    {
+    }
+    
+    virtual int seek(int pos)
+    {
+        return 0;
+    }
+    
+    virtual bool run()
+    {
+        int64_t now = IceUtil::Time::now(IceUtil::Time::Monotonic).toMilliSeconds();
+        if(m_state != PLAYING || now < _next)
+        {
+            return true;
+        }
+        _next = now + 20;
+        _timestamp += 90 * 20;
+        
+        for(std::vector<RtspStream*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+        {
+            unsigned int seq = (*it)->seq();
+            
+            pputil::byte packet[1000];
+            memset(packet, 0, sizeof(packet));
+            packet[0] = 0x80;
+            packet[1] = 96;
+            packet[2] = (pputil::byte)(seq >> 8);
+            packet[3] = (pputil::byte)seq;
+            packet[4] = (pputil::byte)(_timestamp >> 24);
+            packet[5] = (pputil::byte)(_timestamp >> 16);
+            packet[6] = (pputil::byte)(_timestamp >> 8);
+            packet[7] = (pputil::byte)_timestamp;
+            
+            (*it)->sendData(packet, sizeof(packet));
+        }
+        return true;
+    }
+    
+private:
+    int64_t _next;
+    uint32_t _timestamp;
+};
+
+class DemoServer : public RtspServer
+{
+public:
+    DemoServer(unsigned short port)
+    : RtspServer(port)
+    {
+    }
+    
+protected:
+    virtual std::string mediaSDP(const std::string& mid)
+    {
+        std::ostringstream oss;
+        oss << "v=0\r\n"
+            << "o=- " << mid << " 1 IN IP4 127.0.0.1\r\n"
+            << "s=" << mid << "\r\n"
+            << "t=0 0\r\n"
+            << "m=video 0 RTP/AVP 96\r\n"
+            << "a=rtpmap:96 H264/90000\r\n"
+            << "a=control:video\r\n";
+        return oss.str();
+    }
+    
+    virtual RtspSession* createSession(const std::string& sid, const std::string& mid)
+    {
+        return new DemoSession(sid, mid);
+    }
+};
+
+//
+// Load test on loopback: a server with demo media, and clients 
+// playing it in rounds of SETUP, PLAY, keepalives and TEARDOWN
+// demo [clients] [seconds] [tcp|udp]
+// Metrics and sessions are served at http://127.0.0.1:9961/metrics
+// and http://127.0.0.1:9961/sessions while it runs
+// With RTSP_TRACE set, spans of requests are at http://127.0.0.1:9961/trace
+// With RTSP_CAPTURE set to a path, traffic is captured to it as pcapng
+//
 int main(int argc, const char * argv[])
 {
+    size_t clients = argc > 1 ? atoi(argv[1]) : 100;
+    int seconds = argc > 2 ? atoi(argv[2]) : 10;
+    bool udp = argc > 3 && strcmp(argv[3], "udp") == 0;
+    
+#ifndef _WIN32
+    // Peers of the server and the load generator close while writes are in flight
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    
+    DemoServer server(9960);
+    if(!server.activate())
+    {
+        return 1;
+    }
+    
+    if(getenv("RTSP_TRACE") != NULL)
+    {
+        pputil::Trace::enable(true);
+    }
+    
+    const char* capture = getenv("RTSP_CAPTURE");
+    if(capture != NULL && !pputil::Capture::open(capture))
+    {
+        std::cerr << "Failed to open capture " << capture << std::endl;
+    }
+    
+    StatusServer status(9961, &server);
+    status.activate();
+    
+    LoadGenerator::Scenario scenario;
+    scenario.port = 9960;
+    scenario.mid = "demo";
+    scenario.udp = udp;
+    scenario.hold = 2000000;
+    scenario.keepalive = 500000;
+    scenario.rounds = 0;
+    
+    LoadGenerator generator;
+    generator.start(scenario, clients, clients);
+    IceUtil::ThreadControl::sleep(IceUtil::Time::seconds(seconds));
+    generator.stop();
+    
+    std::cout << generator.report().str();
+    
+    status.shutdown();
+    server.shutdown();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,161 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+//
+// libFuzzer target of requests parsed and handled by RtspConnection and
+// RtspServer, the way a client connection is served, without sockets
+// The first byte sets how many bytes are received at a time, so lines
+// and bodies are split across receives
+//
+
+#include <rtsp/RtspServer.h>
+#include <rtsp/RtspConnection.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace rtsp;
+
+namespace
+{
+    class FuzzSession : public RtspSession
+    {
+    public:
+        FuzzSession(const std::string& sid, const std::string& mid)
+        : RtspSession(sid, mid)
+        {
+        }
+        
+        // RtspSession does not delete its streams, they go here so 
+        // leaks reported are of what is fuzzed
+        virtual ~FuzzSession()
+        {
+            for(std::vector<RtspStream*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+            {
+                delete *it;
+            }
+        }
+        
+        virtual int seek(int pos)
+        {
+            return 0;
+        }
+        
+        virtual bool run()
+        {
+            return true;
+        }
+    };
+    
+    class FuzzServer : public RtspServer
+    {
+    public:
+        FuzzServer()
+        : RtspServer(0)
+        {
+        }
+        
+        // Sessions set up by an input go with it
+        void removeSessions()
+        {
+            IceUtil::RecMutex::Lock lock(_sessionsMutex);
+            for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); ++it)
+            {
+                closeSession(*it);
+            }
+            _sessions.clear();
+        }
+        
+    protected:
+        virtual std::string mediaSDP(const std::string& mid)
+        {
+            return "v=0\r\no=- 0 1 IN IP4 127.0.0.1\r\ns=fuzz\r\nt=0 0\r\n"
+                   "m=video 0 RTP/AVP 96\r\na=rtpmap:96 H264/90000\r\na=control:video\r\n";
+        }
+        
+        virtual RtspSession* createSession(const std::string& sid, const std::string& mid)
+        {
+            return new FuzzSession(sid, mid);
+        }
+    };
+    
+    // Take queued responses, as the server ring would send them
+    void drain(pputil::TcpConnection* conn)
+    {
+        pputil::TcpConnection::SendBatchPtr batch;
+        while(conn->ringTake(batch))
+        {
+            size_t bytes = 0;
+            for(size_t i = 0; i < batch->chunks.size(); ++i)
+            {
+                bytes += batch->chunks[i].headLen + batch->chunks[i].body->size();
+            }
+            conn->ringSent(bytes);
+            batch = 0;
+        }
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if(size < 1)
+    {
+        return 0;
+    }
+    
+    static FuzzServer* server = new FuzzServer();
+    static int wake = eventfd(0, EFD_NONBLOCK);
+    
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    {
+        return 0;
+    }
+    
+    RtspConnection* conn = new RtspConnection(fds[0], server);
+    conn->attach(wake);
+    
+    size_t chunk = data[0] + 1;
+    for(size_t i = 1; i < size; i += chunk)
+    {
+        conn->ringReceive(data + i, std::min(chunk, size - i));
+        drain(conn);
+    }
+    
+    conn->ringClosed();
+    server->removeSessions();
+    delete conn;
+    close(fds[1]);
+    return 0;
+}
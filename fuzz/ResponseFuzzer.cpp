@@ -0,0 +1,87 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+//
+// libFuzzer target of responses and interleaved data parsed by a client
+// connection, as RtspClient receives them from a server
+// The first byte sets how many bytes are received at a time
+//
+
+#include <rtsp/RtspClient.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+    // Client on a socket it does not connect
+    class FuzzClient : public rtsp::RtspClient
+    {
+    public:
+        FuzzClient(SOCKET fd)
+        {
+            _fd = fd;
+        }
+    };
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if(size < 1)
+    {
+        return 0;
+    }
+    
+    static int wake = eventfd(0, EFD_NONBLOCK);
+    
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    {
+        return 0;
+    }
+    
+    FuzzClient* client = new FuzzClient(fds[0]);
+    client->attach(wake);
+    
+    size_t chunk = data[0] + 1;
+    for(size_t i = 1; i < size; i += chunk)
+    {
+        client->ringReceive(data + i, std::min(chunk, size - i));
+    }
+    
+    client->ringClosed();
+    delete client;
+    close(fds[1]);
+    return 0;
+}
@@ -0,0 +1,151 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef PPUTIL_ATOMIC_H
+#define PPUTIL_ATOMIC_H
+
+#include <pputil/Config.h>
+
+namespace pputil
+{
+    //
+    // Atomic operations on plain variables shared between threads
+    // Relaxed loads and stores keep readers free of torn values without 
+    // the cost of locked instructions, acquire and release ones publish 
+    // what was written before. Read-modify-write operations are relaxed
+    //
+    // GCC and Clang builtins, or volatile and Interlocked on Windows, 
+    // where aligned loads and stores are atomic and ordered on x86
+    //
+#if defined(__GNUC__)
+    template<typename T> inline T load(const T* p)
+    {
+        return __atomic_load_n(p, __ATOMIC_RELAXED);
+    }
+    
+    template<typename T> inline void store(T* p, T v)
+    {
+        __atomic_store_n(p, v, __ATOMIC_RELAXED);
+    }
+    
+    template<typename T> inline T loadAcquire(const T* p)
+    {
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    }
+    
+    template<typename T> inline void storeRelease(T* p, T v)
+    {
+        __atomic_store_n(p, v, __ATOMIC_RELEASE);
+    }
+    
+    template<typename T> inline T fetchAdd(T* p, T v)
+    {
+        return __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+    }
+    
+    template<typename T> inline T exchange(T* p, T v)
+    {
+        return __atomic_exchange_n(p, v, __ATOMIC_RELAXED);
+    }
+    
+    // On failure expected is updated to the current value
+    template<typename T> inline bool compareExchange(T* p, T& expected, T v)
+    {
+        return __atomic_compare_exchange_n(p, &expected, v, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+#else
+    template<typename T> inline T load(const T* p)
+    {
+        return *(volatile const T*)p;
+    }
+    
+    template<typename T> inline void store(T* p, T v)
+    {
+        *(volatile T*)p = v;
+    }
+    
+    template<typename T> inline T loadAcquire(const T* p)
+    {
+        return *(volatile const T*)p;
+    }
+    
+    template<typename T> inline void storeRelease(T* p, T v)
+    {
+        *(volatile T*)p = v;
+    }
+    
+#if defined(_WIN32)
+    inline uint32_t fetchAdd(uint32_t* p, uint32_t v)
+    {
+        return (uint32_t)InterlockedExchangeAdd((volatile LONG*)p, (LONG)v);
+    }
+    
+    inline uint64_t fetchAdd(uint64_t* p, uint64_t v)
+    {
+        return (uint64_t)InterlockedExchangeAdd64((volatile LONGLONG*)p, (LONGLONG)v);
+    }
+    
+    inline uint32_t exchange(uint32_t* p, uint32_t v)
+    {
+        return (uint32_t)InterlockedExchange((volatile LONG*)p, (LONG)v);
+    }
+    
+    inline uint64_t exchange(uint64_t* p, uint64_t v)
+    {
+        return (uint64_t)InterlockedExchange64((volatile LONGLONG*)p, (LONGLONG)v);
+    }
+    
+    inline bool compareExchange(int64_t* p, int64_t& expected, int64_t v)
+    {
+        int64_t old = (int64_t)InterlockedCompareExchange64((volatile LONGLONG*)p, (LONGLONG)v, (LONGLONG)expected);
+        if(old == expected)
+        {
+            return true;
+        }
+        expected = old;
+        return false;
+    }
+    
+    inline bool compareExchange(uint64_t* p, uint64_t& expected, uint64_t v)
+    {
+        int64_t e = (int64_t)expected;
+        bool exchanged = compareExchange((int64_t*)p, e, (int64_t)v);
+        expected = (uint64_t)e;
+        return exchanged;
+    }
+#endif
+#endif
+}
+
+#endif
@@ -0,0 +1,74 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef PPUTIL_BLOB_H
+#define PPUTIL_BLOB_H
+
+#include <pputil/Config.h>
+#include <IceUtil/Shared.h>
+#include <IceUtil/Handle.h>
+
+namespace pputil
+{
+    //
+    // A Blob is a block of bytes shared by reference count
+    // Packets are queued, paced and sent by passing BlobPtr around, 
+    // so that holding a packet costs a reference rather than a copy
+    // 
+    // A Blob is filled by its creator and is not changed after it is shared
+    //
+    class PPUTIL_API Blob : public IceUtil::Shared
+    {
+    public:
+        Blob(size_t n);
+        Blob(const byte* b, size_t n);
+        virtual ~Blob();
+        
+        // Bytes in the blob
+        size_t size() const;
+        byte* data();
+        const byte* data() const;
+        
+        // Resize a blob no one else holds, to fill it again
+        // Memory is kept, a blob grown once is reused without allocation
+        void resize(size_t n);
+        
+    protected:
+        std::vector<byte> _v;
+    };
+    
+    typedef IceUtil::Handle<Blob> BlobPtr;
+}
+
+#endif
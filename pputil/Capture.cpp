@@ -0,0 +1,572 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "Capture.h"
+#include <IceUtil/Mutex.h>
+#include <IceUtil/Time.h>
+
+namespace pputil
+{
+    int Capture::_enabled = 0;
+    
+    namespace
+    {
+        // Block types and options of pcapng
+        const uint32_t SECTION_HEADER = 0x0A0D0D0A;
+        const uint32_t INTERFACE_DESCRIPTION = 0x00000001;
+        const uint32_t ENHANCED_PACKET = 0x00000006;
+        const uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+        const uint16_t OPTION_TSRESOL = 9;
+        
+        const uint16_t LINKTYPE_ETHERNET = 1;
+        const uint16_t LINKTYPE_RAW = 101;
+        const uint16_t LINKTYPE_IPV4 = 228;
+        
+        // IPv4 and TCP headers without options
+        const size_t IP_HEADER = 20;
+        const size_t TCP_HEADER = 20;
+        const size_t UDP_HEADER = 8;
+        
+        // Largest payload of a made up packet, longer TCP writes are split
+        const size_t MAX_PAYLOAD = 65535 - IP_HEADER - TCP_HEADER;
+        
+        // File being written, never deleted as sockets may send while 
+        // static objects are destroyed
+        struct State
+        {
+            State()
+            : file(NULL)
+            , id(0)
+            {
+            }
+            
+            IceUtil::Mutex mutex;
+            FILE* file;
+            
+            // Next sequence number of each direction of TCP streams
+            typedef std::pair<uint64_t, uint64_t> Flow;
+            std::map<Flow, uint32_t> seqs;
+            
+            uint16_t id;
+            std::vector<byte> packet;
+            std::vector<byte> payload;
+        };
+        
+        State& state()
+        {
+            static State* s = new State();
+            return *s;
+        }
+        
+        uint64_t key(const sockaddr_in& addr)
+        {
+            return ((uint64_t)ntohl(addr.sin_addr.s_addr) << 16) | ntohs(addr.sin_port);
+        }
+        
+        void put16(byte* b, uint16_t v)
+        {
+            b[0] = (byte)(v >> 8);
+            b[1] = (byte)v;
+        }
+        
+        void put32(byte* b, uint32_t v)
+        {
+            b[0] = (byte)(v >> 24);
+            b[1] = (byte)(v >> 16);
+            b[2] = (byte)(v >> 8);
+            b[3] = (byte)v;
+        }
+        
+        uint16_t get16(const byte* b)
+        {
+            return (uint16_t)((b[0] << 8) | b[1]);
+        }
+        
+        uint16_t checksum(const byte* b, size_t n)
+        {
+            uint32_t sum = 0;
+            for(size_t i = 0; i + 1 < n; i += 2)
+            {
+                sum += get16(b + i);
+            }
+            while(sum >> 16)
+            {
+                sum = (sum & 0xffff) + (sum >> 16);
+            }
+            return (uint16_t)~sum;
+        }
+        
+        // Block of pcapng, in byte order of the host as the section says
+        void writeBlock(FILE* file, uint32_t type, const void* body, size_t n)
+        {
+            static const byte pad[4] = { 0, 0, 0, 0 };
+            size_t padding = (4 - n % 4) % 4;
+            uint32_t length = (uint32_t)(12 + n + padding);
+            
+            fwrite(&type, 4, 1, file);
+            fwrite(&length, 4, 1, file);
+            fwrite(body, 1, n, file);
+            fwrite(pad, 1, padding, file);
+            fwrite(&length, 4, 1, file);
+        }
+        
+        // Section header and the interface all packets are on
+        void writeHeader(FILE* file)
+        {
+            byte section[16];
+            uint32_t magic = BYTE_ORDER_MAGIC;
+            uint16_t major = 1;
+            uint16_t minor = 0;
+            int64_t length = -1;
+            memcpy(section, &magic, 4);
+            memcpy(section + 4, &major, 2);
+            memcpy(section + 6, &minor, 2);
+            memcpy(section + 8, &length, 8);
+            writeBlock(file, SECTION_HEADER, section, sizeof(section));
+            
+            // Microseconds, the default resolution, so no options
+            byte iface[8];
+            uint16_t link = LINKTYPE_RAW;
+            uint16_t reserved = 0;
+            uint32_t snaplen = 0;
+            memcpy(iface, &link, 2);
+            memcpy(iface + 2, &reserved, 2);
+            memcpy(iface + 4, &snaplen, 4);
+            writeBlock(file, INTERFACE_DESCRIPTION, iface, sizeof(iface));
+        }
+        
+        // A packet of payload with IPv4 and TCP or UDP headers, with state locked
+        void writePacket(State& s, int protocol, const sockaddr_in& from, const sockaddr_in& to, 
+                         const byte* payload, size_t n, int64_t time)
+        {
+            size_t transport = protocol == IPPROTO_TCP ? TCP_HEADER : UDP_HEADER;
+            size_t total = IP_HEADER + transport + n;
+            
+            s.packet.resize(20 + total);
+            byte* b = &s.packet[0];
+            
+            // Enhanced packet block, before the packet
+            uint32_t iface = 0;
+            uint32_t high = (uint32_t)((uint64_t)time >> 32);
+            uint32_t low = (uint32_t)time;
+            uint32_t length = (uint32_t)total;
+            memcpy(b, &iface, 4);
+            memcpy(b + 4, &high, 4);
+            memcpy(b + 8, &low, 4);
+            memcpy(b + 12, &length, 4);
+            memcpy(b + 16, &length, 4);
+            
+            byte* ip = b + 20;
+            memset(ip, 0, IP_HEADER + transport);
+            ip[0] = 0x45;
+            put16(ip + 2, (uint16_t)total);
+            put16(ip + 4, s.id++);
+            put16(ip + 6, 0x4000); // Don't fragment
+            ip[8] = 64;
+            ip[9] = (byte)protocol;
+            memcpy(ip + 12, &from.sin_addr.s_addr, 4);
+            memcpy(ip + 16, &to.sin_addr.s_addr, 4);
+            put16(ip + 10, checksum(ip, IP_HEADER));
+            
+            byte* t = ip + IP_HEADER;
+            memcpy(t, &from.sin_port, 2);
+            memcpy(t + 2, &to.sin_port, 2);
+            if(protocol == IPPROTO_TCP)
+            {
+                // Sequence of this direction, and acknowledge what the 
+                // other direction has sent so far
+                // Checksum is left 0, Wireshark does not check it by default
+                State::Flow flow(key(from), key(to));
+                std::map<State::Flow, uint32_t>::iterator it = s.seqs.find(flow);
+                if(it == s.seqs.end())
+                {
+                    it = s.seqs.insert(std::make_pair(flow, (uint32_t)1)).first;
+                }
+                std::map<State::Flow, uint32_t>::iterator peer = s.seqs.find(State::Flow(flow.second, flow.first));
+                
+                put32(t + 4, it->second);
+                put32(t + 8, peer == s.seqs.end() ? 1 : peer->second);
+                t[12] = (TCP_HEADER / 4) << 4;
+                t[13] = 0x18; // PSH, ACK
+                put16(t + 14, 0xffff);
+                it->second += (uint32_t)n;
+            }
+            else
+            {
+                put16(t + 4, (uint16_t)(UDP_HEADER + n));
+            }
+            
+            if(n > 0)
+            {
+                memcpy(t + transport, payload, n);
+            }
+            writeBlock(s.file, ENHANCED_PACKET, b, s.packet.size());
+        }
+        
+        void write(int protocol, const sockaddr_in& from, const sockaddr_in& to, const byte* head, size_t headLen, 
+                   const byte* body, size_t bodyLen, int64_t time)
+        {
+            if(time == 0)
+            {
+                time = IceUtil::Time::now().toMicroSeconds();
+            }
+            
+            State& s = state();
+            IceUtil::Mutex::Lock lock(s.mutex);
+            if(s.file == NULL)
+            {
+                return;
+            }
+            
+            const byte* payload = head;
+            size_t n = headLen;
+            if(bodyLen > 0)
+            {
+                s.payload.resize(headLen + bodyLen);
+                if(headLen > 0)
+                {
+                    memcpy(&s.payload[0], head, headLen);
+                }
+                memcpy(&s.payload[headLen], body, bodyLen);
+                payload = &s.payload[0];
+                n = s.payload.size();
+            }
+            
+            // Datagrams are not split, the longest fits in a packet
+            size_t offset = 0;
+            do
+            {
+                size_t len = std::min(n - offset, MAX_PAYLOAD);
+                writePacket(s, protocol, from, to, payload + offset, len, time);
+                offset += len;
+            }
+            while(offset < n);
+        }
+        
+        void flushAtExit()
+        {
+            Capture::flush();
+        }
+    }
+    
+    bool Capture::open(const std::string& path)
+    {
+        close();
+        
+        FILE* file = fopen(path.c_str(), "wb");
+        if(file == NULL)
+        {
+            return false;
+        }
+        writeHeader(file);
+        
+        State& s = state();
+        {
+            IceUtil::Mutex::Lock lock(s.mutex);
+            s.file = file;
+            s.seqs.clear();
+        }
+        
+        static bool registered = false;
+        if(!registered)
+        {
+            registered = true;
+            atexit(flushAtExit);
+        }
+        
+        store(&_enabled, 1);
+        return true;
+    }
+    
+    void Capture::close()
+    {
+        store(&_enabled, 0);
+        
+        State& s = state();
+        IceUtil::Mutex::Lock lock(s.mutex);
+        if(s.file != NULL)
+        {
+            fclose(s.file);
+            s.file = NULL;
+        }
+    }
+    
+    void Capture::flush()
+    {
+        State& s = state();
+        IceUtil::Mutex::Lock lock(s.mutex);
+        if(s.file != NULL)
+        {
+            fflush(s.file);
+        }
+    }
+    
+    void Capture::tcp(const sockaddr_in& from, const sockaddr_in& to, const byte* head, size_t headLen, 
+                      const byte* body, size_t bodyLen)
+    {
+        if(headLen + bodyLen > 0)
+        {
+            write(IPPROTO_TCP, from, to, head, headLen, body, bodyLen, 0);
+        }
+    }
+    
+    void Capture::udp(const sockaddr_in& from, const sockaddr_in& to, const byte* head, size_t headLen, 
+                      const byte* body, size_t bodyLen, int64_t time)
+    {
+        write(IPPROTO_UDP, from, to, head, headLen, body, bodyLen, time);
+    }
+    
+    //////////////////////////////////////////////////////////////////////
+    
+    CaptureReader::CaptureReader()
+    : _file(NULL)
+    , _swapped(false)
+    {
+    }
+    
+    CaptureReader::~CaptureReader()
+    {
+        close();
+    }
+    
+    bool CaptureReader::open(const std::string& path)
+    {
+        close();
+        
+        _file = fopen(path.c_str(), "rb");
+        return _file != NULL;
+    }
+    
+    void CaptureReader::close()
+    {
+        if(_file != NULL)
+        {
+            fclose(_file);
+            _file = NULL;
+        }
+        _links.clear();
+        _units.clear();
+        _swapped = false;
+    }
+    
+    uint32_t CaptureReader::read32(const byte* b) const
+    {
+        uint32_t v;
+        memcpy(&v, b, 4);
+        if(_swapped)
+        {
+            v = (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+        }
+        return v;
+    }
+    
+    uint16_t CaptureReader::read16(const byte* b) const
+    {
+        uint16_t v;
+        memcpy(&v, b, 2);
+        if(_swapped)
+        {
+            v = (uint16_t)((v >> 8) | (v << 8));
+        }
+        return v;
+    }
+    
+    // Link type, and resolution of timestamps from option if_tsresol,
+    // a power of 10, or of 2 if the high bit is set
+    void CaptureReader::addInterface(const byte* b, size_t n)
+    {
+        int64_t unit = 1000000;
+        for(size_t i = 8; i + 4 <= n; )
+        {
+            uint16_t code = read16(b + i);
+            uint16_t len = read16(b + i + 2);
+            if(code == 0 || i + 4 + len > n)
+            {
+                break;
+            }
+            if(code == OPTION_TSRESOL && len >= 1)
+            {
+                byte r = b[i + 4];
+                int exp = r & 0x7f;
+                if(exp < 63)
+                {
+                    unit = 1;
+                    for(int j = 0; j < exp; ++j)
+                    {
+                        unit *= (r & 0x80) ? 2 : 10;
+                    }
+                }
+            }
+            i += 4 + ((len + 3) & ~3);
+        }
+        
+        _links.push_back(n >= 2 ? read16(b) : 0);
+        _units.push_back(unit);
+    }
+    
+    bool CaptureReader::next(Packet& packet)
+    {
+        while(_file != NULL)
+        {
+            byte head[12];
+            if(fread(head, 1, 8, _file) != 8)
+            {
+                return false;
+            }
+            
+            // Byte order of a section is given by its header
+            size_t skipped = 8;
+            uint32_t type;
+            memcpy(&type, head, 4);
+            if(type == SECTION_HEADER)
+            {
+                if(fread(head + 8, 1, 4, _file) != 4)
+                {
+                    return false;
+                }
+                uint32_t magic;
+                memcpy(&magic, head + 8, 4);
+                if(magic != BYTE_ORDER_MAGIC && magic != 0x4D3C2B1A)
+                {
+                    return false;
+                }
+                _swapped = magic != BYTE_ORDER_MAGIC;
+                _links.clear();
+                _units.clear();
+                skipped = 12;
+            }
+            else
+            {
+                type = read32(head);
+            }
+            
+            uint32_t length = read32(head + 4);
+            if(length < 12 || length % 4 != 0 || length > 16 * 1024 * 1024)
+            {
+                return false;
+            }
+            
+            _block.resize(length - skipped);
+            if(fread(&_block[0], 1, _block.size(), _file) != _block.size())
+            {
+                return false;
+            }
+            
+            // Body without the trailing length
+            const byte* b = &_block[0];
+            size_t n = _block.size() - 4;
+            
+            if(type == INTERFACE_DESCRIPTION)
+            {
+                addInterface(b, n);
+                continue;
+            }
+            if(type != ENHANCED_PACKET || n < 20)
+            {
+                continue;
+            }
+            
+            uint32_t iface = read32(b);
+            if(iface >= _links.size())
+            {
+                continue;
+            }
+            
+            uint64_t ts = ((uint64_t)read32(b + 4) << 32) | read32(b + 8);
+            int64_t unit = _units[iface];
+            packet.time = unit >= 1000000 ? (int64_t)(ts / (unit / 1000000)) : (int64_t)ts * (1000000 / unit);
+            
+            size_t captured = std::min((size_t)read32(b + 12), n - 20);
+            const byte* p = b + 20;
+            
+            // IPv4 from link layer
+            if(_links[iface] == LINKTYPE_ETHERNET)
+            {
+                if(captured < 14 || get16(p + 12) != 0x0800)
+                {
+                    continue;
+                }
+                p += 14;
+                captured -= 14;
+            }
+            else if(_links[iface] != LINKTYPE_RAW && _links[iface] != LINKTYPE_IPV4)
+            {
+                continue;
+            }
+            
+            if(captured < IP_HEADER || (p[0] >> 4) != 4)
+            {
+                continue;
+            }
+            size_t ihl = (p[0] & 0x0f) * 4;
+            size_t total = std::min((size_t)get16(p + 2), captured);
+            int protocol = p[9];
+            
+            size_t transport = 0;
+            if(protocol == IPPROTO_TCP && total >= ihl + TCP_HEADER)
+            {
+                transport = (p[ihl + 12] >> 4) * 4;
+            }
+            else if(protocol == IPPROTO_UDP && total >= ihl + UDP_HEADER)
+            {
+                transport = UDP_HEADER;
+            }
+            if(transport == 0 || total < ihl + transport)
+            {
+                continue;
+            }
+            
+            // Segments without data (handshakes, acknowledgements) are skipped
+            size_t len = total - ihl - transport;
+            if(protocol == IPPROTO_TCP && len == 0)
+            {
+                continue;
+            }
+            
+            packet.protocol = protocol;
+            memset(&packet.from, 0, sizeof(packet.from));
+            memset(&packet.to, 0, sizeof(packet.to));
+            packet.from.sin_family = AF_INET;
+            packet.to.sin_family = AF_INET;
+            memcpy(&packet.from.sin_addr.s_addr, p + 12, 4);
+            memcpy(&packet.to.sin_addr.s_addr, p + 16, 4);
+            memcpy(&packet.from.sin_port, p + ihl, 2);
+            memcpy(&packet.to.sin_port, p + ihl + 2, 2);
+            packet.payload.assign(p + ihl + transport, p + total);
+            return true;
+        }
+        
+        return false;
+    }
+}
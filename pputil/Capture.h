@@ -0,0 +1,124 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef PPUTIL_CAPTURE_H
+#define PPUTIL_CAPTURE_H
+
+#include <pputil/Config.h>
+#include <pputil/Socket.h>
+#include <pputil/Atomic.h>
+
+namespace pputil
+{
+    //
+    // Capture of bytes sent and received into a pcapng file, to look at 
+    // in Wireshark or to replay later
+    // Payloads are written as IPv4 packets (LINKTYPE_RAW) with TCP or UDP 
+    // headers made up from the addresses of sockets, TCP sequence numbers 
+    // follow the bytes of each direction so streams can be reassembled
+    // When capture is not open a call costs a check of a flag
+    //
+    class PPUTIL_API Capture
+    {
+    public:
+        // Start writing to a file, closing the one being written
+        static bool open(const std::string& path);
+        static void close();
+        
+        static bool enabled()
+        {
+            return load(&_enabled) != 0;
+        }
+        
+        // Bytes of a TCP stream from and to addresses, in the order they 
+        // are sent or received, gathered from a head and a body
+        static void tcp(const sockaddr_in& from, const sockaddr_in& to, const byte* head, size_t headLen, 
+                        const byte* body = NULL, size_t bodyLen = 0);
+        
+        // A datagram, stamped with time in microseconds since epoch, 
+        // or now if time is 0
+        static void udp(const sockaddr_in& from, const sockaddr_in& to, const byte* head, size_t headLen, 
+                        const byte* body = NULL, size_t bodyLen = 0, int64_t time = 0);
+        
+        // Write buffered packets to file
+        static void flush();
+        
+    private:
+        static int _enabled;
+    };
+    
+    //
+    // Packets read back from a capture file written by Capture
+    // Other captures of IPv4 on link type RAW or Ethernet are read as well,
+    // segments are given as captured, retransmissions are not removed
+    //
+    class PPUTIL_API CaptureReader
+    {
+    public:
+        CaptureReader();
+        ~CaptureReader();
+        
+        bool open(const std::string& path);
+        void close();
+        
+        struct Packet
+        {
+            int64_t time;       // Microseconds since epoch
+            int protocol;       // IPPROTO_TCP or IPPROTO_UDP
+            sockaddr_in from;
+            sockaddr_in to;
+            std::vector<byte> payload;
+        };
+        
+        // Next TCP or UDP packet, false at end of file or on a broken block
+        bool next(Packet& packet);
+        
+    private:
+        FILE* _file;
+        bool _swapped;
+        std::vector<byte> _block;
+        
+        // Link type and time resolution of interfaces
+        std::vector<int> _links;
+        std::vector<int64_t> _units;
+        
+        uint32_t read32(const byte* b) const;
+        uint16_t read16(const byte* b) const;
+        
+        // Interface description, with options after the fixed part
+        void addInterface(const byte* b, size_t n);
+    };
+}
+
+#endif
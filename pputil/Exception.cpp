@@ -0,0 +1,114 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "Exception.h"
+
+namespace pputil
+{
+    
+    Exception::Exception(const std::string& file, int line)
+    : _file(file)
+    , _line(line)
+    {
+        
+    }
+    
+    Exception::~Exception() throw()
+    {
+        
+    }
+    
+    // file:line: 
+    std::string Exception::toString() const
+    {
+        std::ostringstream oss;
+        oss << _file << ":" << _line << ": ";
+        return oss.str();
+    }
+    
+    const char* Exception::what() const throw()
+    {
+        try
+        {
+            _what = toString();
+            return _what.c_str();
+        }
+        catch(...)
+        {
+            return "pputil::Exception";
+        }
+    }
+    
+    const std::string& Exception::file() const
+    {
+        return _file;
+    }
+    
+    int Exception::line() const
+    {
+        return _line;
+    }
+    
+    //////////////////////////////////////////////////////////////////////
+    
+    SyscallException::SyscallException(const std::string& file, int line, int error)
+    : Exception(file, line)
+    , _error(error)
+    {
+        
+    }
+    
+    SyscallException::~SyscallException() throw()
+    {
+        
+    }
+    
+    // file:line: syscall error <n>: <message>
+    std::string SyscallException::toString() const
+    {
+        std::ostringstream oss;
+        oss << Exception::toString();
+        if(_error != 0)
+        {
+            oss << "syscall error " << _error << ": " << strerror(_error) << " ";
+        }
+        return oss.str();
+    }
+    
+    int SyscallException::error() const
+    {
+        return _error;
+    }
+    
+}
@@ -0,0 +1,83 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef PPUTIL_EXCEPTION_H
+#define PPUTIL_EXCEPTION_H
+
+#include <pputil/Config.h>
+#include <exception>
+
+namespace pputil
+{
+    //
+    // Base of exceptions, with the place it is thrown
+    //
+    class PPUTIL_API Exception : public std::exception
+    {
+    public:
+        Exception(const std::string& file, int line);
+        virtual ~Exception() throw();
+        
+        virtual std::string toString() const;
+        virtual const char* what() const throw();
+        
+        const std::string& file() const;
+        int line() const;
+        
+    protected:
+        std::string _file;
+        int _line;
+        
+        mutable std::string _what;
+    };
+    
+    //
+    // Failure of a system call, with its error number
+    //
+    class PPUTIL_API SyscallException : public Exception
+    {
+    public:
+        SyscallException(const std::string& file, int line, int error);
+        virtual ~SyscallException() throw();
+        
+        virtual std::string toString() const;
+        
+        int error() const;
+        
+    protected:
+        int _error;
+    };
+}
+
+#endif
@@ -0,0 +1,142 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "Histogram.h"
+
+namespace pputil
+{
+    Histogram::Histogram()
+    : _count(0)
+    , _sum(0)
+    , _max(0)
+    {
+        memset(_counts, 0, sizeof(_counts));
+    }
+    
+    // Values below STEPS have a bucket each, then each power of 2 
+    // is split into STEPS buckets
+    size_t Histogram::bucket(int64_t value)
+    {
+        if(value < STEPS)
+        {
+            return value < 0 ? 0 : (size_t)value;
+        }
+        
+        int log = 0;
+        for(int64_t v = value; v >= 2 * STEPS; v >>= 1)
+        {
+            log++;
+        }
+        
+        size_t b = (log + 1) * STEPS + (size_t)((value >> log) - STEPS);
+        return std::min(b, (size_t)BUCKETS - 1);
+    }
+    
+    int64_t Histogram::bound(size_t bucket)
+    {
+        if(bucket < STEPS)
+        {
+            return (int64_t)bucket;
+        }
+        
+        int log = (int)(bucket / STEPS) - 1;
+        return ((int64_t)(bucket % STEPS + STEPS + 1) << log) - 1;
+    }
+    
+    void Histogram::add(int64_t value)
+    {
+        _counts[bucket(value)]++;
+        _count++;
+        _sum += value;
+        _max = std::max(_max, value);
+    }
+    
+    void Histogram::merge(const Histogram& other)
+    {
+        for(size_t i = 0; i < BUCKETS; ++i)
+        {
+            _counts[i] += other._counts[i];
+        }
+        _count += other._count;
+        _sum += other._sum;
+        _max = std::max(_max, other._max);
+    }
+    
+    uint64_t Histogram::count() const
+    {
+        return _count;
+    }
+    
+    int64_t Histogram::sum() const
+    {
+        return _sum;
+    }
+    
+    int64_t Histogram::max() const
+    {
+        return _max;
+    }
+    
+    int64_t Histogram::mean() const
+    {
+        return _count > 0 ? _sum / (int64_t)_count : 0;
+    }
+    
+    int64_t Histogram::percentile(double p) const
+    {
+        if(_count == 0)
+        {
+            return 0;
+        }
+        
+        uint64_t rank = (uint64_t)(p / 100 * _count + 0.5);
+        rank = std::max(rank, (uint64_t)1);
+        
+        uint64_t seen = 0;
+        for(size_t i = 0; i < BUCKETS; ++i)
+        {
+            seen += _counts[i];
+            if(seen >= rank)
+            {
+                return std::min(bound(i), _max);
+            }
+        }
+        return _max;
+    }
+    
+    uint64_t Histogram::at(size_t bucket) const
+    {
+        return bucket < BUCKETS ? _counts[bucket] : 0;
+    }
+}
@@ -0,0 +1,81 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef PPUTIL_HISTOGRAM_H
+#define PPUTIL_HISTOGRAM_H
+
+#include <pputil/Config.h>
+
+namespace pputil
+{
+    //
+    // Histogram of non-negative values, e.g. latency in microseconds
+    // Buckets are powers of 2 split in 8 linear steps, so a percentile 
+    // is within 12.5% of the actual value, with a fixed memory of 
+    // 320 buckets up to 2^40
+    //
+    class PPUTIL_API Histogram
+    {
+    public:
+        enum { STEPS = 8, BUCKETS = 40 * STEPS };
+        
+        Histogram();
+        
+        void add(int64_t value);
+        void merge(const Histogram& other);
+        
+        uint64_t count() const;
+        int64_t sum() const;
+        int64_t max() const;
+        int64_t mean() const;
+        
+        // Upper bound of bucket holding the percentile (0 - 100)
+        int64_t percentile(double p) const;
+        
+        // Count of values in a bucket, and the bucket's range
+        uint64_t at(size_t bucket) const;
+        static size_t bucket(int64_t value);
+        static int64_t bound(size_t bucket);
+        
+    protected:
+        friend class Metrics;
+        
+        uint64_t _counts[BUCKETS];
+        uint64_t _count;
+        int64_t _sum;
+        int64_t _max;
+    };
+}
+
+#endif
@@ -0,0 +1,827 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "IoUring.h"
+#include "TcpServer.h"
+#include "Atomic.h"
+
+#ifdef PP_HAVE_IO_URING
+#   include <sys/syscall.h>
+#   include <sys/mman.h>
+#   include <sys/eventfd.h>
+#   include <unistd.h>
+#   include <errno.h>
+#endif
+
+namespace pputil
+{
+#ifdef PP_HAVE_IO_URING
+    
+    static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p)
+    {
+        return (int)syscall(__NR_io_uring_setup, entries, p);
+    }
+    
+    static int sys_io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+    {
+        return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+    }
+    
+    static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned n)
+    {
+        return (int)syscall(__NR_io_uring_register, fd, opcode, arg, n);
+    }
+    
+    IoUring::IoUring()
+    : _fd(-1)
+    , _sqRing(MAP_FAILED)
+    , _sqRingSize(0)
+    , _sqHead(NULL)
+    , _sqTail(NULL)
+    , _sqMask(0)
+    , _sqEntries(0)
+    , _sqLocalTail(0)
+    , _sqes((struct io_uring_sqe*)MAP_FAILED)
+    , _sqesSize(0)
+    , _cqRing(MAP_FAILED)
+    , _cqRingSize(0)
+    , _cqHead(NULL)
+    , _cqTail(NULL)
+    , _cqMask(0)
+    , _cqes(NULL)
+    , _bufRing((struct io_uring_buf_ring*)MAP_FAILED)
+    , _bufRingSize(0)
+    , _bufMask(0)
+    , _bufGroup(0)
+    , _bufSize(0)
+    {
+        
+    }
+    
+    IoUring::~IoUring()
+    {
+        close();
+    }
+    
+    bool IoUring::init(unsigned entries)
+    {
+        close();
+        
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        _fd = sys_io_uring_setup(entries, &p);
+        if(_fd < 0)
+        {
+            _fd = -1;
+            return false;
+        }
+        
+        // Rings share one mapping on kernels with IORING_FEAT_SINGLE_MMAP
+        _sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        _cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if(single)
+        {
+            _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+        }
+        
+        _sqRing = mmap(NULL, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+        if(_sqRing == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+        
+        if(single)
+        {
+            _cqRing = _sqRing;
+        }
+        else
+        {
+            _cqRing = mmap(NULL, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+            if(_cqRing == MAP_FAILED)
+            {
+                close();
+                return false;
+            }
+        }
+        
+        _sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+        _sqes = (struct io_uring_sqe*)mmap(NULL, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+        if(_sqes == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+        
+        char* sq = (char*)_sqRing;
+        _sqHead = (unsigned*)(sq + p.sq_off.head);
+        _sqTail = (unsigned*)(sq + p.sq_off.tail);
+        _sqMask = *(unsigned*)(sq + p.sq_off.ring_mask);
+        _sqEntries = p.sq_entries;
+        _sqLocalTail = *_sqTail;
+        
+        // Entries are always used in order, so the index array is fixed
+        unsigned* array = (unsigned*)(sq + p.sq_off.array);
+        for(unsigned i = 0; i < _sqEntries; ++i)
+        {
+            array[i] = i;
+        }
+        
+        char* cq = (char*)_cqRing;
+        _cqHead = (unsigned*)(cq + p.cq_off.head);
+        _cqTail = (unsigned*)(cq + p.cq_off.tail);
+        _cqMask = *(unsigned*)(cq + p.cq_off.ring_mask);
+        _cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+        
+        return true;
+    }
+    
+    void IoUring::close()
+    {
+        if(_bufRing != MAP_FAILED)
+        {
+            if(_fd >= 0)
+            {
+                struct io_uring_buf_reg reg;
+                memset(&reg, 0, sizeof(reg));
+                reg.bgid = _bufGroup;
+                sys_io_uring_register(_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+            }
+            munmap(_bufRing, _bufRingSize);
+            _bufRing = (struct io_uring_buf_ring*)MAP_FAILED;
+        }
+        _bufs.clear();
+        
+        if(_sqes != MAP_FAILED)
+        {
+            munmap(_sqes, _sqesSize);
+            _sqes = (struct io_uring_sqe*)MAP_FAILED;
+        }
+        
+        if(_cqRing != MAP_FAILED && _cqRing != _sqRing)
+        {
+            munmap(_cqRing, _cqRingSize);
+        }
+        _cqRing = MAP_FAILED;
+        
+        if(_sqRing != MAP_FAILED)
+        {
+            munmap(_sqRing, _sqRingSize);
+            _sqRing = MAP_FAILED;
+        }
+        
+        if(_fd >= 0)
+        {
+            ::close(_fd);
+            _fd = -1;
+        }
+    }
+    
+    int IoUring::fd()
+    {
+        return _fd;
+    }
+    
+    struct io_uring_sqe* IoUring::get()
+    {
+        if(space() == 0)
+        {
+            return NULL;
+        }
+        
+        struct io_uring_sqe* sqe = &_sqes[_sqLocalTail & _sqMask];
+        memset(sqe, 0, sizeof(*sqe));
+        ++_sqLocalTail;
+        return sqe;
+    }
+    
+    unsigned IoUring::space()
+    {
+        return _sqEntries - (_sqLocalTail - loadAcquire(_sqHead));
+    }
+    
+    int IoUring::submit()
+    {
+        unsigned tail = *_sqTail;
+        unsigned n = _sqLocalTail - tail;
+        if(n == 0)
+        {
+            return 0;
+        }
+        
+        storeRelease(_sqTail, _sqLocalTail);
+        int rc = sys_io_uring_enter(_fd, n, 0, 0);
+        return rc < 0 ? -errno : rc;
+    }
+    
+    struct io_uring_cqe* IoUring::peek()
+    {
+        unsigned head = *_cqHead;
+        if(head == loadAcquire(_cqTail))
+        {
+            return NULL;
+        }
+        return &_cqes[head & _cqMask];
+    }
+    
+    void IoUring::seen()
+    {
+        storeRelease(_cqHead, *_cqHead + 1);
+    }
+    
+    bool IoUring::provide(uint16_t group, unsigned count, size_t size)
+    {
+        if(_fd < 0 || _bufRing != MAP_FAILED || count == 0 || (count & (count - 1)) != 0 || count > 32768)
+        {
+            return false;
+        }
+        
+        _bufRingSize = count * sizeof(struct io_uring_buf);
+        _bufRing = (struct io_uring_buf_ring*)mmap(NULL, _bufRingSize, PROT_READ | PROT_WRITE, 
+                                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(_bufRing == MAP_FAILED)
+        {
+            return false;
+        }
+        
+        struct io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = (uint64_t)(uintptr_t)_bufRing;
+        reg.ring_entries = count;
+        reg.bgid = group;
+        if(sys_io_uring_register(_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        {
+            munmap(_bufRing, _bufRingSize);
+            _bufRing = (struct io_uring_buf_ring*)MAP_FAILED;
+            return false;
+        }
+        
+        _bufGroup = group;
+        _bufMask = (uint16_t)(count - 1);
+        _bufSize = size;
+        _bufs.resize(count * size);
+        
+        _bufRing->tail = 0;
+        for(unsigned i = 0; i < count; ++i)
+        {
+            recycle((uint16_t)i);
+        }
+        return true;
+    }
+    
+    byte* IoUring::buffer(uint16_t bid)
+    {
+        return &_bufs[bid * _bufSize];
+    }
+    
+    void IoUring::recycle(uint16_t bid)
+    {
+        // Entries start at the ring base, tail overlays the first one
+        // (bufs of io_uring_buf_ring is not at offset 0 when built as C++)
+        uint16_t tail = _bufRing->tail;
+        struct io_uring_buf* buf = (struct io_uring_buf*)_bufRing + (tail & _bufMask);
+        buf->addr = (uint64_t)(uintptr_t)buffer(bid);
+        buf->len = (uint32_t)_bufSize;
+        buf->bid = bid;
+        storeRelease(&_bufRing->tail, (uint16_t)(tail + 1));
+    }
+    
+    //
+    // TcpServerRing
+    //
+    
+    // Operation of an entry in top byte of user data, id in the rest
+    enum 
+    {
+        RING_ACCEPT = 1,
+        RING_RECV = 2,
+        RING_SEND = 3,
+        RING_CANCEL = 4
+    };
+    
+    static const uint64_t RING_ID_MASK = (((uint64_t)1) << 56) - 1;
+    static const uint16_t RING_BUFFER_GROUP = 0;
+    static const unsigned RING_BUFFERS = 256;
+    static const size_t RING_BUFFER_SIZE = 16 * 1024;
+    static const size_t RING_CHUNKS_PER_SEND = 32;
+    
+    static inline uint64_t ringData(uint64_t op, uint64_t id)
+    {
+        return (op << 56) | (id & RING_ID_MASK);
+    }
+    
+    TcpServerRing::TcpServerRing(TcpServer* server)
+    : _server(server)
+    , _wakeFd(-1)
+    , _accepting(false)
+    , _nextId(1)
+    , _nextChain(1)
+    {
+        
+    }
+    
+    TcpServerRing::~TcpServerRing()
+    {
+        close();
+    }
+    
+    // Multishot receive (Linux 6.0) is tried on a socket pair with a byte 
+    // waiting, older kernels fail it with EINVAL or end it at once
+    bool TcpServerRing::supported()
+    {
+        IoUring ring;
+        int fds[2];
+        if(!ring.init(2) || !ring.provide(0, 1, 64) || socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+        {
+            return false;
+        }
+        
+        bool multishot = false;
+        struct io_uring_sqe* sqe = ring.get();
+        if(sqe != NULL && ::send(fds[1], "", 1, 0) == 1)
+        {
+            sqe->opcode = IORING_OP_RECV;
+            sqe->fd = fds[0];
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = 0;
+            
+            PollSet polls;
+            size_t index = polls.add(ring.fd());
+            if(ring.submit() == 1 && polls.wait(1000) > 0 && polls.readable(index, ring.fd()))
+            {
+                struct io_uring_cqe* cqe = ring.peek();
+                multishot = cqe != NULL && cqe->res == 1 && (cqe->flags & IORING_CQE_F_MORE) != 0;
+            }
+        }
+        
+        // Closing the ring cancels the receive before sockets are closed
+        ring.close();
+        ::close(fds[0]);
+        ::close(fds[1]);
+        return multishot;
+    }
+    
+    bool TcpServerRing::init()
+    {
+        close();
+        
+        if(!_ring.init(256) || !_ring.provide(RING_BUFFER_GROUP, RING_BUFFERS, RING_BUFFER_SIZE))
+        {
+            _ring.close();
+            return false;
+        }
+        
+        _wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(_wakeFd < 0)
+        {
+            _ring.close();
+            return false;
+        }
+        
+        _accepting = false;
+        return true;
+    }
+    
+    void TcpServerRing::close()
+    {
+        // Closing the ring cancels all in flight, then chains are freed
+        _ring.close();
+        
+        for(std::map<uint64_t, Chain*>::iterator it = _chains.begin(); it != _chains.end(); ++it)
+        {
+            delete it->second;
+        }
+        _chains.clear();
+        _entries.clear();
+        _ids.clear();
+        _accepting = false;
+        
+        if(_wakeFd >= 0)
+        {
+            ::close(_wakeFd);
+            _wakeFd = -1;
+        }
+    }
+    
+    struct io_uring_sqe* TcpServerRing::get()
+    {
+        struct io_uring_sqe* sqe = _ring.get();
+        if(sqe == NULL)
+        {
+            _ring.submit();
+            sqe = _ring.get();
+        }
+        return sqe;
+    }
+    
+    void TcpServerRing::accept()
+    {
+        struct io_uring_sqe* sqe = get();
+        if(sqe == NULL)
+        {
+            return;
+        }
+        
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = _server->_fd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->user_data = ringData(RING_ACCEPT, 0);
+        _accepting = true;
+    }
+    
+    void TcpServerRing::receive(uint64_t id, SOCKET fd)
+    {
+        struct io_uring_sqe* sqe = get();
+        if(sqe == NULL)
+        {
+            return;
+        }
+        
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = RING_BUFFER_GROUP;
+        sqe->user_data = ringData(RING_RECV, id);
+        _entries[id].receiving = true;
+    }
+    
+    // Queued data of a connection goes out as a chain of sendmsg entries
+    // Links keep them in order, and MSG_WAITALL makes each one complete 
+    // in full or fail, so a failure cancels the rest of the chain
+    void TcpServerRing::send(uint64_t id, Entry& entry)
+    {
+        TcpConnection::SendBatchPtr batch;
+        if(!entry.conn->ringTake(batch))
+        {
+            return;
+        }
+        
+        Chain* chain = new Chain();
+        chain->id = id;
+        chain->batch = batch;
+        chain->bytes = 0;
+        chain->failed = false;
+        
+        std::vector<TcpConnection::SendChunk>& chunks = batch->chunks;
+        size_t nmsgs = (chunks.size() + RING_CHUNKS_PER_SEND - 1) / RING_CHUNKS_PER_SEND;
+        chain->msgs.resize(nmsgs);
+        chain->iovs.resize(chunks.size() * 2);
+        
+        size_t niov = 0;
+        for(size_t m = 0; m < nmsgs; ++m)
+        {
+            struct msghdr& msg = chain->msgs[m];
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &chain->iovs[niov];
+            
+            size_t end = std::min(chunks.size(), (m + 1) * RING_CHUNKS_PER_SEND);
+            for(size_t i = m * RING_CHUNKS_PER_SEND; i < end; ++i)
+            {
+                TcpConnection::SendChunk& chunk = chunks[i];
+                if(chunk.headLen > 0)
+                {
+                    chain->iovs[niov].iov_base = chunk.head;
+                    chain->iovs[niov].iov_len = chunk.headLen;
+                    chain->bytes += chunk.headLen;
+                    ++niov;
+                }
+                if(chunk.body && chunk.body->size() > 0)
+                {
+                    chain->iovs[niov].iov_base = chunk.body->data();
+                    chain->iovs[niov].iov_len = chunk.body->size();
+                    chain->bytes += chunk.body->size();
+                    ++niov;
+                }
+            }
+            msg.msg_iovlen = &chain->iovs[niov] - msg.msg_iov;
+        }
+        
+        // A chain does not span submissions
+        if(_ring.space() < nmsgs)
+        {
+            _ring.submit();
+        }
+        
+        uint64_t chainId = _nextChain++;
+        chain->pending = 0;
+        for(size_t m = 0; m < nmsgs; ++m)
+        {
+            struct io_uring_sqe* sqe = _ring.get();
+            assert(sqe != NULL);
+            
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = entry.conn->fd();
+            sqe->addr = (uint64_t)(uintptr_t)&chain->msgs[m];
+            sqe->len = 1;
+            sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+            sqe->user_data = ringData(RING_SEND, chainId);
+            if(m + 1 < nmsgs)
+            {
+                sqe->flags = IOSQE_IO_LINK;
+            }
+            ++chain->pending;
+        }
+        
+        _chains[chainId] = chain;
+        entry.sending = true;
+    }
+    
+    void TcpServerRing::closed(uint64_t id)
+    {
+        std::map<uint64_t, Entry>::iterator it = _entries.find(id);
+        if(it != _entries.end())
+        {
+            it->second.conn->ringClosed();
+        }
+    }
+    
+    void TcpServerRing::complete(struct io_uring_cqe* cqe)
+    {
+        uint64_t op = cqe->user_data >> 56;
+        uint64_t id = cqe->user_data & RING_ID_MASK;
+        bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+        
+        switch(op)
+        {
+        case RING_ACCEPT:
+            {
+                if(!more)
+                {
+                    _accepting = false;
+                }
+                if(cqe->res < 0)
+                {
+                    break;
+                }
+                
+                SOCKET fd = cqe->res;
+                if(!_server->admit(fd))
+                {
+                    break;
+                }
+                
+                TcpConnection* conn = _server->createConnection(fd);
+                if(conn == NULL)
+                {
+                    closeSocket(fd);
+                    break;
+                }
+                
+                if(!conn->attach(_wakeFd))
+                {
+                    delete conn;
+                    break;
+                }
+                _server->addConnection(conn);
+                
+                uint64_t connId = _nextId++;
+                Entry entry;
+                entry.conn = conn;
+                entry.receiving = false;
+                entry.sending = false;
+                _entries[connId] = entry;
+                _ids[conn] = connId;
+                receive(connId, fd);
+                
+                if(_server->_connectCallback != NULL)
+                {
+                    _server->_connectCallback->onConnect(conn);
+                }
+            }
+            break;
+            
+        case RING_RECV:
+            {
+                std::map<uint64_t, Entry>::iterator it = _entries.find(id);
+                if(it != _entries.end() && !more)
+                {
+                    it->second.receiving = false;
+                }
+                
+                if(cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER))
+                {
+                    uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+                    if(it != _entries.end())
+                    {
+                        it->second.conn->ringReceive(_ring.buffer(bid), cqe->res);
+                    }
+                    _ring.recycle(bid);
+                }
+                else if(cqe->res == -ENOBUFS)
+                {
+                    // Out of buffers for now, rearmed below
+                }
+                else if(cqe->res <= 0 && cqe->res != -ECANCELED)
+                {
+                    closed(id);
+                }
+            }
+            break;
+            
+        case RING_SEND:
+            {
+                std::map<uint64_t, Chain*>::iterator it = _chains.find(id);
+                if(it == _chains.end())
+                {
+                    break;
+                }
+                
+                Chain* chain = it->second;
+                if(cqe->res < 0)
+                {
+                    chain->failed = true;
+                }
+                
+                if(--chain->pending == 0)
+                {
+                    std::map<uint64_t, Entry>::iterator e = _entries.find(chain->id);
+                    if(e != _entries.end())
+                    {
+                        e->second.sending = false;
+                        e->second.conn->ringSent(chain->bytes);
+                        if(chain->failed)
+                        {
+                            e->second.conn->ringClosed();
+                        }
+                    }
+                    
+                    _chains.erase(it);
+                    delete chain;
+                }
+            }
+            break;
+            
+        default:
+            break;
+        }
+    }
+    
+    bool TcpServerRing::run()
+    {
+        if(!_accepting)
+        {
+            accept();
+        }
+        
+        // Ring is readable when it has completions, wake fd when a 
+        // connection has data queued
+        PollSet& fds = _server->_polls;
+        fds.clear();
+        fds.add(_ring.fd());
+        size_t wake = fds.add(_wakeFd);
+        _server->preparePoll(fds);
+        
+        _ring.submit();
+        
+        int timeout = (int)((_server->_timeout + 999) / 1000);
+        if(_ring.peek() != NULL)
+        {
+            timeout = 0;
+        }
+        
+        int rc = fds.wait(timeout);
+        if(rc > 0)
+        {
+            if(fds.readable(wake, _wakeFd))
+            {
+                uint64_t n;
+                while(read(_wakeFd, &n, sizeof(n)) > 0)
+                {
+                    
+                }
+            }
+            
+            _server->handlePoll(fds);
+        }
+        
+        struct io_uring_cqe* cqe;
+        while((cqe = _ring.peek()) != NULL)
+        {
+            struct io_uring_cqe copy = *cqe;
+            _ring.seen();
+            complete(&copy);
+        }
+        
+        // Rearm receives that ended, and send what is queued
+        for(std::map<uint64_t, Entry>::iterator it = _entries.begin(); it != _entries.end(); ++it)
+        {
+            Entry& entry = it->second;
+            if(!entry.conn->isAlive())
+            {
+                continue;
+            }
+            
+            if(!entry.receiving)
+            {
+                receive(it->first, entry.conn->fd());
+            }
+            
+            if(!entry.sending)
+            {
+                send(it->first, entry);
+            }
+        }
+        
+        _ring.submit();
+        return true;
+    }
+    
+    void TcpServerRing::detach(TcpConnection* conn)
+    {
+        std::map<TcpConnection*, uint64_t>::iterator it = _ids.find(conn);
+        if(it == _ids.end())
+        {
+            return;
+        }
+        
+        // Kernel holds its own reference to the socket, so it can be closed
+        // right after; chains in flight are freed when they complete
+        struct io_uring_sqe* sqe = get();
+        if(sqe != NULL)
+        {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = conn->fd();
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+            sqe->user_data = ringData(RING_CANCEL, it->second);
+            _ring.submit();
+        }
+        
+        _entries.erase(it->second);
+        _ids.erase(it);
+    }
+    
+#else
+    
+    TcpServerRing::TcpServerRing(TcpServer* server)
+    : _server(server)
+    {
+        
+    }
+    
+    TcpServerRing::~TcpServerRing()
+    {
+        
+    }
+    
+    bool TcpServerRing::supported()
+    {
+        return false;
+    }
+    
+    bool TcpServerRing::init()
+    {
+        return false;
+    }
+    
+    void TcpServerRing::close()
+    {
+        
+    }
+    
+    bool TcpServerRing::run()
+    {
+        return false;
+    }
+    
+    void TcpServerRing::detach(TcpConnection* conn)
+    {
+        
+    }
+    
+#endif
+}
@@ -0,0 +1,194 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef PPUTIL_IO_URING_H
+#define PPUTIL_IO_URING_H
+
+#include <pputil/Config.h>
+#include <pputil/TcpConnection.h>
+#include <map>
+
+#if defined(__linux__) && defined(__has_include)
+#   if __has_include(<linux/io_uring.h>)
+#       define PP_HAVE_IO_URING
+#   endif
+#endif
+
+#ifdef PP_HAVE_IO_URING
+#   include <linux/io_uring.h>
+#   include <sys/uio.h>
+#endif
+
+namespace pputil
+{
+    class TcpServer;
+    
+#ifdef PP_HAVE_IO_URING
+    //
+    // Minimal io_uring on raw system calls (Linux 6.0+ for multishot receive)
+    // Not thread safe, owned by the thread driving it
+    //
+    class PPUTIL_API IoUring
+    {
+    public:
+        IoUring();
+        ~IoUring();
+        
+        bool init(unsigned entries);
+        void close();
+        int fd();
+        
+        // Free submission entry, NULL if the queue is full
+        struct io_uring_sqe* get();
+        unsigned space();
+        
+        // Submit entries got so far, return number submitted or -errno
+        int submit();
+        
+        // Next completion, NULL if none, and mark it consumed
+        struct io_uring_cqe* peek();
+        void seen();
+        
+        // Ring of provided buffers, count is a power of 2
+        // Receives with IOSQE_BUFFER_SELECT pick a buffer of the group,
+        // which is given back with recycle() once the data is consumed
+        bool provide(uint16_t group, unsigned count, size_t size);
+        byte* buffer(uint16_t bid);
+        void recycle(uint16_t bid);
+        
+    private:
+        int _fd;
+        
+        // Submission queue
+        void* _sqRing;
+        size_t _sqRingSize;
+        unsigned* _sqHead;
+        unsigned* _sqTail;
+        unsigned _sqMask;
+        unsigned _sqEntries;
+        unsigned _sqLocalTail;
+        struct io_uring_sqe* _sqes;
+        size_t _sqesSize;
+        
+        // Completion queue
+        void* _cqRing;
+        size_t _cqRingSize;
+        unsigned* _cqHead;
+        unsigned* _cqTail;
+        unsigned _cqMask;
+        struct io_uring_cqe* _cqes;
+        
+        // Provided buffers
+        struct io_uring_buf_ring* _bufRing;
+        size_t _bufRingSize;
+        uint16_t _bufMask;
+        uint16_t _bufGroup;
+        std::vector<byte> _bufs;
+        size_t _bufSize;
+    };
+#endif
+    
+    //
+    // io_uring backend of TcpServer
+    // Listener is accepted with a multishot accept, connections receive with
+    // multishot receives into provided buffer slabs, and queued data of a 
+    // connection is sent as a chain of linked sendmsg entries
+    // Completions are reaped on server thread, which also polls the
+    // sockets of TcpServer::preparePoll() along with the ring
+    //
+    class PPUTIL_API TcpServerRing
+    {
+    public:
+        TcpServerRing(TcpServer* server);
+        ~TcpServerRing();
+        
+        // Whether kernel supports it
+        static bool supported();
+        
+        bool init();
+        void close();
+        
+        // One round of server loop
+        bool run();
+        
+        // Cancel pending operations of a connection before it is closed
+        void detach(TcpConnection* conn);
+        
+    private:
+        TcpServer* _server;
+        
+#ifdef PP_HAVE_IO_URING
+        IoUring _ring;
+        int _wakeFd;
+        bool _accepting;
+        
+        // Attached connections by id, ids are carried in user data of entries
+        // so that late completions of removed connections are dropped
+        struct Entry
+        {
+            TcpConnection* conn;
+            bool receiving;
+            bool sending;
+        };
+        
+        std::map<uint64_t, Entry> _entries;
+        std::map<TcpConnection*, uint64_t> _ids;
+        uint64_t _nextId;
+        
+        // Send chain in flight, owns what kernel refers to
+        struct Chain
+        {
+            uint64_t id;
+            TcpConnection::SendBatchPtr batch;
+            std::vector<struct msghdr> msgs;
+            std::vector<struct iovec> iovs;
+            size_t pending;
+            size_t bytes;
+            bool failed;
+        };
+        
+        std::map<uint64_t, Chain*> _chains;
+        uint64_t _nextChain;
+        
+        void accept();
+        void receive(uint64_t id, SOCKET fd);
+        void send(uint64_t id, Entry& entry);
+        void complete(struct io_uring_cqe* cqe);
+        void closed(uint64_t id);
+        struct io_uring_sqe* get();
+#endif
+    };
+}
+
+#endif
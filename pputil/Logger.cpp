@@ -0,0 +1,414 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "Logger.h"
+#include "Atomic.h"
+#include <IceUtil/Time.h>
+#include <cstdlib>
+#include <ctime>
+
+namespace pputil
+{
+    // Producers on any thread claim ring slots and count sites with 
+    // atomic operations, the flusher owns the head of the ring
+    
+    //
+    // LogArg
+    //
+    
+    LogArg::LogArg(int v) : type(INT) { value.i = v; }
+    LogArg::LogArg(unsigned int v) : type(UINT) { value.u = v; }
+    LogArg::LogArg(long v) : type(INT) { value.i = v; }
+    LogArg::LogArg(unsigned long v) : type(UINT) { value.u = v; }
+    LogArg::LogArg(long long v) : type(INT) { value.i = v; }
+    LogArg::LogArg(unsigned long long v) : type(UINT) { value.u = v; }
+    LogArg::LogArg(double v) : type(DOUBLE) { value.d = v; }
+    
+    LogArg::LogArg(const char* s)
+    : type(STRING)
+    {
+        value.s.data = s != NULL ? s : "(null)";
+        value.s.length = strlen(value.s.data);
+    }
+    
+    LogArg::LogArg(const std::string& s)
+    : type(STRING)
+    {
+        value.s.data = s.data();
+        value.s.length = s.length();
+    }
+    
+    //
+    // Logger
+    //
+    
+    // A message in the ring, arguments are kept in binary and 
+    // strings are copied in text
+    struct Logger::Record
+    {
+        enum { MAX_ARGS = 4, TEXT = 168 };
+        
+        uint64_t seq;           // Position of the slot when it is free, 
+                                // position + 1 when it holds a message
+        int64_t time;           // Microseconds since epoch
+        const LogSite* site;
+        const char* format;
+        uint32_t suppressed;
+        uint8_t level;
+        uint8_t argc;
+        uint8_t types[MAX_ARGS];
+        union
+        {
+            int64_t i;
+            uint64_t u;
+            double d;
+            struct
+            {
+                uint16_t offset;
+                uint16_t length;
+            } s;
+        } args[MAX_ARGS];
+        char text[TEXT];
+    };
+    
+    int Logger::_level = Logger::LEVEL_INFO;
+    
+    static void flushAtExit()
+    {
+        Logger::instance().flush();
+    }
+    
+    // Threads may log while static objects are destroyed, 
+    // so the logger is never deleted, and flushed at exit
+    Logger& Logger::instance()
+    {
+        static Logger* logger = new Logger();
+        return *logger;
+    }
+    
+    Logger::Logger()
+    : _ring(new Record[CAPACITY])
+    , _tail(0)
+    , _head(0)
+    , _dropped(0)
+    , _rateLimit(100)
+    , _output(stderr)
+    {
+        for(uint64_t i = 0; i < CAPACITY; ++i)
+        {
+            _ring[i].seq = i;
+        }
+        
+        atexit(flushAtExit);
+        
+        try
+        {
+            _thread = new FlushThread(this);
+            _thread->start();
+        }
+        catch(IceUtil::Exception& ex)
+        {
+            std::cerr << ex.what() << "\n";
+        }
+    }
+    
+    Logger::~Logger()
+    {
+    }
+    
+    void Logger::setLevel(Level level)
+    {
+        store(&_level, (int)level);
+    }
+    
+    bool Logger::enabled(Level level)
+    {
+        return (int)level >= load(&_level);
+    }
+    
+    void Logger::setRateLimit(uint32_t messages)
+    {
+        store(&_rateLimit, messages);
+    }
+    
+    void Logger::setOutput(FILE* output)
+    {
+        flush();
+        
+        IceUtil::Mutex::Lock lock(_drainMutex);
+        _output = output != NULL ? output : stderr;
+    }
+    
+    void Logger::flush()
+    {
+        while(drain() > 0)
+        {
+        }
+    }
+    
+    void Logger::log(Level level, LogSite& site, const char* format)
+    {
+        write(level, site, format, NULL, 0);
+    }
+    
+    void Logger::log(Level level, LogSite& site, const char* format, const LogArg& a1)
+    {
+        const LogArg* args[] = { &a1 };
+        write(level, site, format, args, 1);
+    }
+    
+    void Logger::log(Level level, LogSite& site, const char* format, const LogArg& a1, const LogArg& a2)
+    {
+        const LogArg* args[] = { &a1, &a2 };
+        write(level, site, format, args, 2);
+    }
+    
+    void Logger::log(Level level, LogSite& site, const char* format, const LogArg& a1, const LogArg& a2, 
+                     const LogArg& a3)
+    {
+        const LogArg* args[] = { &a1, &a2, &a3 };
+        write(level, site, format, args, 3);
+    }
+    
+    void Logger::log(Level level, LogSite& site, const char* format, const LogArg& a1, const LogArg& a2, 
+                     const LogArg& a3, const LogArg& a4)
+    {
+        const LogArg* args[] = { &a1, &a2, &a3, &a4 };
+        write(level, site, format, args, 4);
+    }
+    
+    void Logger::write(Level level, LogSite& site, const char* format, const LogArg** args, size_t n)
+    {
+        int64_t now = IceUtil::Time::now().toMicroSeconds();
+        
+        // Rate limit of the site, the window is reset by whichever 
+        // thread first sees a new second
+        uint32_t limit = load(&_rateLimit);
+        if(limit > 0)
+        {
+            int64_t second = now / 1000000;
+            if(load(&site.second) != second)
+            {
+                store(&site.second, second);
+                store(&site.count, (uint32_t)0);
+            }
+            
+            if(fetchAdd(&site.count, (uint32_t)1) >= limit)
+            {
+                fetchAdd(&site.suppressed, (uint32_t)1);
+                return;
+            }
+        }
+        
+        // Claim a slot, or drop the message when the ring is full
+        uint64_t pos = load(&_tail);
+        Record* r = NULL;
+        for(;;)
+        {
+            r = &_ring[pos & (CAPACITY - 1)];
+            int64_t diff = (int64_t)(loadAcquire(&r->seq) - pos);
+            if(diff == 0)
+            {
+                if(compareExchange(&_tail, pos, pos + 1))
+                {
+                    break;
+                }
+            }
+            else if(diff < 0)
+            {
+                fetchAdd(&_dropped, (uint64_t)1);
+                return;
+            }
+            else
+            {
+                pos = load(&_tail);
+            }
+        }
+        
+        r->time = now;
+        r->site = &site;
+        r->format = format;
+        r->suppressed = exchange(&site.suppressed, (uint32_t)0);
+        r->level = (uint8_t)level;
+        r->argc = (uint8_t)std::min(n, (size_t)Record::MAX_ARGS);
+        
+        size_t used = 0;
+        for(size_t i = 0; i < r->argc; ++i)
+        {
+            const LogArg& arg = *args[i];
+            r->types[i] = (uint8_t)arg.type;
+            switch(arg.type)
+            {
+            case LogArg::INT:
+                r->args[i].i = arg.value.i;
+                break;
+            case LogArg::UINT:
+                r->args[i].u = arg.value.u;
+                break;
+            case LogArg::DOUBLE:
+                r->args[i].d = arg.value.d;
+                break;
+            case LogArg::STRING:
+                {
+                    size_t length = std::min(arg.value.s.length, (size_t)Record::TEXT - used);
+                    memcpy(r->text + used, arg.value.s.data, length);
+                    r->args[i].s.offset = (uint16_t)used;
+                    r->args[i].s.length = (uint16_t)length;
+                    used += length;
+                }
+                break;
+            }
+        }
+        
+        storeRelease(&r->seq, pos + 1);
+    }
+    
+    size_t Logger::drain()
+    {
+        IceUtil::Mutex::Lock lock(_drainMutex);
+        
+        std::string out;
+        size_t n = 0;
+        for(;;)
+        {
+            Record& r = _ring[_head & (CAPACITY - 1)];
+            if(loadAcquire(&r.seq) != _head + 1)
+            {
+                break;
+            }
+            
+            out += format(r);
+            storeRelease(&r.seq, _head + CAPACITY);
+            _head++;
+            n++;
+        }
+        
+        uint64_t dropped = exchange(&_dropped, (uint64_t)0);
+        if(dropped > 0)
+        {
+            std::ostringstream oss;
+            oss << dropped << " log messages dropped, logger is behind\n";
+            out += oss.str();
+        }
+        
+        if(!out.empty())
+        {
+            fwrite(out.data(), 1, out.size(), _output);
+            fflush(_output);
+        }
+        return n;
+    }
+    
+    // Time, level, source and message, one line
+    std::string Logger::format(const Record& r)
+    {
+        static const char* levels[] = { "DEBUG", "INFO ", "WARN ", "ERROR" };
+        
+        char head[64];
+        time_t seconds = (time_t)(r.time / 1000000);
+        struct tm t;
+    #ifdef _WIN32
+        localtime_s(&t, &seconds);
+    #else
+        localtime_r(&seconds, &t);
+    #endif
+        size_t len = strftime(head, sizeof(head), "%Y-%m-%d %H:%M:%S", &t);
+        snprintf(head + len, sizeof(head) - len, ".%06d %s ", (int)(r.time % 1000000), levels[std::min((int)r.level, 3)]);
+        
+        const char* file = r.site->file;
+        for(const char* p = file; *p != '\0'; ++p)
+        {
+            if(*p == '/' || *p == '\\')
+            {
+                file = p + 1;
+            }
+        }
+        
+        std::ostringstream oss;
+        oss << head << file << ":" << r.site->line << " ";
+        
+        size_t arg = 0;
+        for(const char* p = r.format; *p != '\0'; ++p)
+        {
+            if(p[0] != '{' || p[1] != '}' || arg >= r.argc)
+            {
+                oss << *p;
+                continue;
+            }
+            
+            switch(r.types[arg])
+            {
+            case LogArg::INT:
+                oss << r.args[arg].i;
+                break;
+            case LogArg::UINT:
+                oss << r.args[arg].u;
+                break;
+            case LogArg::DOUBLE:
+                oss << r.args[arg].d;
+                break;
+            case LogArg::STRING:
+                oss.write(r.text + r.args[arg].s.offset, r.args[arg].s.length);
+                break;
+            }
+            arg++;
+            p++;
+        }
+        
+        if(r.suppressed > 0)
+        {
+            oss << " (" << r.suppressed << " suppressed)";
+        }
+        oss << "\n";
+        return oss.str();
+    }
+    
+    Logger::FlushThread::FlushThread(Logger* logger)
+    : _logger(logger)
+    {
+    }
+    
+    // Messages are written in batches, the ring is checked 
+    // every few milliseconds when it is empty
+    void Logger::FlushThread::run()
+    {
+        for(;;)
+        {
+            if(_logger->drain() == 0)
+            {
+                IceUtil::ThreadControl::sleep(IceUtil::Time::milliSeconds(5));
+            }
+        }
+    }
+}
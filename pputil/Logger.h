@@ -0,0 +1,195 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef PPUTIL_LOGGER_H
+#define PPUTIL_LOGGER_H
+
+#include <pputil/Config.h>
+#include <IceUtil/Thread.h>
+#include <IceUtil/Mutex.h>
+
+namespace pputil
+{
+    //
+    // Call site of log messages, static at each PP_LOG_* macro
+    // Messages of a site are limited per second, those over the limit
+    // are counted and reported with the next message let through
+    //
+    struct LogSite
+    {
+        const char* file;
+        int line;
+        int64_t second;         // Window of rate limit
+        uint32_t count;         // Messages in the window
+        uint32_t suppressed;    // Messages dropped since last one written
+    };
+    
+    //
+    // Argument of a log message, kept in binary in the record and 
+    // formatted by the flusher thread
+    // Strings are copied into the record, up to the room it has
+    //
+    class PPUTIL_API LogArg
+    {
+    public:
+        enum Type { INT, UINT, DOUBLE, STRING };
+        
+        LogArg(int v);
+        LogArg(unsigned int v);
+        LogArg(long v);
+        LogArg(unsigned long v);
+        LogArg(long long v);
+        LogArg(unsigned long long v);
+        LogArg(double v);
+        LogArg(const char* s);
+        LogArg(const std::string& s);
+        
+        Type type;
+        union
+        {
+            int64_t i;
+            uint64_t u;
+            double d;
+            struct
+            {
+                const char* data;
+                size_t length;
+            } s;
+        } value;
+    };
+    
+    //
+    // Asynchronous logger
+    // Messages are put in a ring buffer by the calling thread without
+    // locking, and formatted and written by a background thread
+    // A message is dropped rather than waited for when the ring is full
+    //
+    // Format strings must be literals, "{}" is replaced with arguments 
+    // in order, e.g. PP_LOG_INFO("Connection {} closed: {}", fd, reason)
+    //
+    class PPUTIL_API Logger
+    {
+    public:
+        enum Level
+        {
+            LEVEL_DEBUG,
+            LEVEL_INFO,
+            LEVEL_WARN,
+            LEVEL_ERROR,
+            LEVEL_OFF
+        };
+        
+        static Logger& instance();
+        
+        // Messages below the level are skipped at call sites, INFO by default
+        static void setLevel(Level level);
+        static bool enabled(Level level);
+        
+        // Messages a site may write per second, 0 for no limit, 100 by default
+        void setRateLimit(uint32_t messages);
+        
+        // Output of flusher, stderr by default
+        void setOutput(FILE* output);
+        
+        // Write messages queued so far, e.g. before exit
+        void flush();
+        
+        void log(Level level, LogSite& site, const char* format);
+        void log(Level level, LogSite& site, const char* format, const LogArg& a1);
+        void log(Level level, LogSite& site, const char* format, const LogArg& a1, const LogArg& a2);
+        void log(Level level, LogSite& site, const char* format, const LogArg& a1, const LogArg& a2, 
+                 const LogArg& a3);
+        void log(Level level, LogSite& site, const char* format, const LogArg& a1, const LogArg& a2, 
+                 const LogArg& a3, const LogArg& a4);
+        
+    private:
+        Logger();
+        ~Logger();
+        
+        struct Record;
+        
+        void write(Level level, LogSite& site, const char* format, const LogArg** args, size_t n);
+        
+        // Write out records in the ring, return the number written
+        size_t drain();
+        std::string format(const Record& record);
+        
+        // Ring of records, producers claim slots by sequence numbers
+        // (bounded MPMC queue of D. Vyukov), flusher is the only consumer
+        enum { CAPACITY = 8192 };
+        Record* _ring;
+        uint64_t _tail;         // Next slot to claim
+        uint64_t _head;         // Next slot to write out
+        uint64_t _dropped;      // Messages lost as the ring was full
+        uint32_t _rateLimit;
+        
+        FILE* _output;
+        IceUtil::Mutex _drainMutex;
+        
+        static int _level;
+        
+        class FlushThread : public IceUtil::Thread
+        {
+        public:
+            FlushThread(Logger* logger);
+            virtual void run();
+            
+        private:
+            Logger* _logger;
+        };
+        
+        friend class FlushThread;
+        IceUtil::ThreadPtr _thread;
+    };
+}
+
+//
+// Log macros, arguments are not evaluated when the level is disabled
+//
+#define PP_LOG(level, ...) \
+    do \
+    { \
+        if(pputil::Logger::enabled(level)) \
+        { \
+            static pputil::LogSite ppLogSite = { __FILE__, __LINE__, 0, 0, 0 }; \
+            pputil::Logger::instance().log(level, ppLogSite, __VA_ARGS__); \
+        } \
+    } while(0)
+
+#define PP_LOG_DEBUG(...)   PP_LOG(pputil::Logger::LEVEL_DEBUG, __VA_ARGS__)
+#define PP_LOG_INFO(...)    PP_LOG(pputil::Logger::LEVEL_INFO, __VA_ARGS__)
+#define PP_LOG_WARN(...)    PP_LOG(pputil::Logger::LEVEL_WARN, __VA_ARGS__)
+#define PP_LOG_ERROR(...)   PP_LOG(pputil::Logger::LEVEL_ERROR, __VA_ARGS__)
+
+#endif
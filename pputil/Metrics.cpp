@@ -0,0 +1,229 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "Metrics.h"
+#include "Atomic.h"
+
+namespace pputil
+{
+    // A shard is written by its thread and read by snapshots with relaxed
+    // loads and stores, its histogram is published after it is cleared
+    
+    Metrics::Shard::Shard()
+    {
+        memset(values, 0, sizeof(values));
+        memset(histograms, 0, sizeof(histograms));
+    }
+    
+    Metrics& Metrics::instance()
+    {
+        static Metrics metrics;
+        return metrics;
+    }
+    
+    Metrics::Metrics()
+    : _values(0)
+    , _histograms(0)
+    , _shards(ThreadBlocks::create(&Metrics::newShard))
+    {
+    }
+    
+    Metrics::~Metrics()
+    {
+    }
+    
+    int Metrics::counter(const std::string& name, const std::string& labels, const std::string& help)
+    {
+        return add(name, labels, help, COUNTER);
+    }
+    
+    int Metrics::gauge(const std::string& name, const std::string& labels, const std::string& help)
+    {
+        return add(name, labels, help, GAUGE);
+    }
+    
+    int Metrics::histogram(const std::string& name, const std::string& labels, const std::string& help)
+    {
+        return add(name, labels, help, HISTOGRAM);
+    }
+    
+    // Counters and gauges have ids of their slots in values of shards, 
+    // histograms have ids of MAX_VALUES and up, so an update finds its 
+    // slot without reading the registry
+    int Metrics::add(const std::string& name, const std::string& labels, const std::string& help, Type type)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        for(size_t i = 0; i < _metrics.size(); ++i)
+        {
+            if(_metrics[i].name == name && _metrics[i].labels == labels)
+            {
+                return _metrics[i].type == type ? _ids[i] : -1;
+            }
+        }
+        
+        int id = -1;
+        if(type == HISTOGRAM && _histograms < MAX_HISTOGRAMS)
+        {
+            id = MAX_VALUES + (int)_histograms++;
+        }
+        else if(type != HISTOGRAM && _values < MAX_VALUES)
+        {
+            id = (int)_values++;
+        }
+        
+        if(id < 0)
+        {
+            return -1;
+        }
+        
+        Sample sample;
+        sample.name = name;
+        sample.labels = labels;
+        sample.help = help;
+        sample.type = type;
+        sample.value = 0;
+        _metrics.push_back(sample);
+        _ids.push_back(id);
+        return id;
+    }
+    
+    std::string Metrics::label(const std::string& key, const std::string& value)
+    {
+        std::string s = key + "=\"";
+        for(size_t i = 0; i < value.length(); ++i)
+        {
+            char c = value[i];
+            if(c == '\\' || c == '"')
+            {
+                s += '\\';
+                s += c;
+            }
+            else if(c == '\n')
+            {
+                s += "\\n";
+            }
+            else
+            {
+                s += c;
+            }
+        }
+        return s + "\"";
+    }
+    
+    void Metrics::add(int id, int64_t n)
+    {
+        if(id < 0 || id >= MAX_VALUES)
+        {
+            return;
+        }
+        
+        int64_t* p = &shard()->values[id];
+        store(p, load(p) + n);
+    }
+    
+    void Metrics::record(int id, int64_t value)
+    {
+        if(id < MAX_VALUES || id >= MAX_VALUES + MAX_HISTOGRAMS)
+        {
+            return;
+        }
+        
+        Shard* s = shard();
+        Histogram* h = s->histograms[id - MAX_VALUES];
+        if(h == NULL)
+        {
+            h = new Histogram();
+            storeRelease(&s->histograms[id - MAX_VALUES], h);
+        }
+        
+        uint64_t* bucket = &h->_counts[Histogram::bucket(value)];
+        store(bucket, load(bucket) + 1);
+        store(&h->_count, load(&h->_count) + 1);
+        store(&h->_sum, load(&h->_sum) + value);
+        if(value > load(&h->_max))
+        {
+            store(&h->_max, value);
+        }
+    }
+    
+    // Shard of calling thread, taken on its first update
+    // Values of exited threads are kept in the sums
+    Metrics::Shard* Metrics::shard()
+    {
+        return static_cast<Shard*>(_shards->get());
+    }
+    
+    ThreadBlocks::Block* Metrics::newShard()
+    {
+        return new Shard();
+    }
+    
+    void Metrics::snapshot(std::vector<Sample>& samples)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        IceUtil::Mutex::Lock shardsLock(_shards->mutex());
+        samples = _metrics;
+        
+        for(size_t i = 0; i < samples.size(); ++i)
+        {
+            Sample& sample = samples[i];
+            int id = _ids[i];
+            
+            for(ThreadBlocks::Block* b = _shards->head(); b != NULL; b = b->next)
+            {
+                const Shard* s = static_cast<const Shard*>(b);
+                if(sample.type != HISTOGRAM)
+                {
+                    sample.value += load(&s->values[id]);
+                    continue;
+                }
+                
+                const Histogram* h = loadAcquire(&s->histograms[id - MAX_VALUES]);
+                if(h == NULL)
+                {
+                    continue;
+                }
+                
+                Histogram& total = sample.histogram;
+                for(size_t b = 0; b < Histogram::BUCKETS; ++b)
+                {
+                    total._counts[b] += load(&h->_counts[b]);
+                }
+                total._count += load(&h->_count);
+                total._sum += load(&h->_sum);
+                total._max = std::max(total._max, load(&h->_max));
+            }
+        }
+    }
+}
@@ -0,0 +1,117 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef PPUTIL_METRICS_H
+#define PPUTIL_METRICS_H
+
+#include <pputil/Config.h>
+#include <pputil/Histogram.h>
+#include <pputil/ThreadBlocks.h>
+#include <IceUtil/Mutex.h>
+
+namespace pputil
+{
+    //
+    // Registry of process wide metrics
+    // Counters, gauges and histograms are registered once by name and 
+    // labels (e.g. method="PLAY"), and updated by id on hot paths
+    // Each thread updates its own shard of values without locking or 
+    // atomic read-modify-write, shards are summed when a snapshot is taken
+    //
+    class PPUTIL_API Metrics
+    {
+    public:
+        enum Type { COUNTER, GAUGE, HISTOGRAM };
+        enum { MAX_VALUES = 256, MAX_HISTOGRAMS = 64 };
+        
+        static Metrics& instance();
+        
+        // Register a metric, or return the one of the same name and labels
+        // Return -1 when the registry is full, updates to -1 are ignored
+        int counter(const std::string& name, const std::string& labels = "", const std::string& help = "");
+        int gauge(const std::string& name, const std::string& labels = "", const std::string& help = "");
+        int histogram(const std::string& name, const std::string& labels = "", const std::string& help = "");
+        
+        // Label of key and value, e.g. method="PLAY", value is escaped
+        static std::string label(const std::string& key, const std::string& value);
+        
+        // Count up a counter, or move a gauge up or down
+        void add(int id, int64_t n = 1);
+        
+        // Record a value, e.g. latency in microseconds, to a histogram
+        void record(int id, int64_t value);
+        
+        struct Sample
+        {
+            std::string name;
+            std::string labels;
+            std::string help;
+            Type type;
+            int64_t value;          // Counter or gauge
+            Histogram histogram;    // Histogram
+        };
+        
+        // Metrics summed over threads, in order of registration
+        // Updates in flight may be seen partly, e.g. a histogram's count 
+        // ahead of its buckets
+        void snapshot(std::vector<Sample>& samples);
+        
+    private:
+        Metrics();
+        ~Metrics();
+        
+        int add(const std::string& name, const std::string& labels, const std::string& help, Type type);
+        
+        // Values of a thread, written by the thread only
+        struct Shard : public ThreadBlocks::Block
+        {
+            Shard();
+            
+            int64_t values[MAX_VALUES];
+            Histogram* histograms[MAX_HISTOGRAMS];  // Created on first record
+        };
+        
+        Shard* shard();
+        static ThreadBlocks::Block* newShard();
+        
+        IceUtil::Mutex _mutex;
+        std::vector<Sample> _metrics;   // Descriptions, in order of registration
+        std::vector<int> _ids;          // and their ids
+        size_t _values;
+        size_t _histograms;
+        ThreadBlocks* _shards;
+    };
+}
+
+#endif
@@ -33,7 +33,8 @@
 // **********************************************************************
 
 #include "Server.h"
-#include "ThreadException.h"
+#include "Logger.h"
+#include <IceUtil/ThreadException.h>
 
 namespace pputil
 {
@@ -49,7 +50,7 @@ namespace pputil
     {
         if(_running)
         {
-            std::cout << "Server is not shutdown before delete.\n";
+            PP_LOG_WARN("Server is not shutdown before delete");
             shutdown();	// Note: this call local shutdown rather than that in derived
         }        
     }
@@ -124,7 +125,7 @@ namespace pputil
                 _thread->start();
                 return true;
             }
-            catch(ThreadException& ex)
+            catch(IceUtil::Exception& ex)
             {
                 return false;
             }
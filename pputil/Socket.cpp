@@ -223,7 +223,7 @@ namespace pputil
         fdToLocalAddress(fd, localAddr);
         if(compareAddress(addr, localAddr) == 0)
         {
-            SocketException ex(__FILE__, __LINE__);
+            SocketException ex(__FILE__, __LINE__, ECONNREFUSED);
             throw ex;
         }
         #endif
@@ -278,7 +278,7 @@ namespace pputil
         struct sockaddr_in remoteAddr;
         if(!fdToRemoteAddress(fd, remoteAddr) && compareAddress(remoteAddr, localAddr) == 0)
         {
-            SocketException ex(__FILE__, __LINE__);
+            SocketException ex(__FILE__, __LINE__, ECONNREFUSED);
             throw ex;
         }
     #endif
@@ -490,6 +490,21 @@ namespace pputil
         }
     }
         
+    // Hold partial segments until uncorked, so a batch of small writes 
+    // goes out in full segments. Return false where it is not supported,
+    // the socket is left usable in any case.
+    bool setCork(SOCKET fd, bool cork)
+    {
+        int flag = cork ? 1 : 0;
+    #if defined(TCP_CORK)
+        return setsockopt(fd, IPPROTO_TCP, TCP_CORK, (char*)&flag, int(sizeof(int))) != SOCKET_ERROR;
+    #elif defined(TCP_NOPUSH)
+        return setsockopt(fd, IPPROTO_TCP, TCP_NOPUSH, (char*)&flag, int(sizeof(int))) != SOCKET_ERROR;
+    #else
+        return false;
+    #endif
+    }
+        
     void setKeepAlive(SOCKET fd)
     {
         int flag = 1;
@@ -705,4 +720,42 @@ namespace pputil
         return s;
     }
     
+    void PollSet::clear()
+    {
+        _fds.clear();
+    }
+    
+    size_t PollSet::add(SOCKET fd)
+    {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        _fds.push_back(pfd);
+        return _fds.size() - 1;
+    }
+    
+    int PollSet::wait(int timeout)
+    {
+#ifdef _WIN32
+        // WSAPoll fails on an empty set, sleep as select() would
+        if(_fds.empty())
+        {
+            Sleep(timeout);
+            return 0;
+        }
+        return WSAPoll(&_fds[0], (ULONG)_fds.size(), timeout);
+#else
+        return poll(_fds.empty() ? NULL : &_fds[0], (nfds_t)_fds.size(), timeout);
+#endif
+    }
+    
+    // The socket is checked along with the index, so a stale index
+    // of an object that did not add this round reads as not ready
+    bool PollSet::readable(size_t index, SOCKET fd) const
+    {
+        return index < _fds.size() && _fds[index].fd == fd && 
+               (_fds[index].revents & (POLLIN | POLLERR | POLLHUP)) != 0;
+    }
+    
 }
@@ -47,6 +47,7 @@ typedef int ssize_t;
 #   include <unistd.h>
 #   include <fcntl.h>
 #   include <sys/socket.h>
+#   include <sys/uio.h>
 #   include <sys/poll.h>
 #   include <netinet/in.h>
 #   include <netinet/tcp.h>
@@ -125,6 +126,7 @@ namespace pputil
     PPUTIL_API void setBlock(SOCKET, bool);
     PPUTIL_API void setTcpNoDelay(SOCKET);
     PPUTIL_API void setKeepAlive(SOCKET);
+    PPUTIL_API bool setCork(SOCKET, bool);
     PPUTIL_API void setReuseAddress(SOCKET, bool);
     PPUTIL_API int getSendBufferSize(SOCKET);
     PPUTIL_API void setSendBufferSize(SOCKET, int);
@@ -139,6 +141,29 @@ namespace pputil
     PPUTIL_API void fdToLocalAddress(SOCKET, struct sockaddr_in&);
     PPUTIL_API bool fdToRemoteAddress(SOCKET, struct sockaddr_in&);
     PPUTIL_API std::string addrToString(const struct sockaddr_in&);
+    
+    //
+    // Sockets polled for reading by loops of servers
+    // Unlike fd_set it takes descriptors of any value, not only those 
+    // under FD_SETSIZE, so it is safe with thousands of streams open
+    //
+    class PPUTIL_API PollSet
+    {
+    public:
+        void clear();
+        
+        // Add a socket, return its index to check after wait()
+        size_t add(SOCKET fd);
+        
+        // Wait up to timeout milliseconds, return as poll()
+        int wait(int timeout);
+        
+        // Readable, or failed so a read returns the error
+        bool readable(size_t index, SOCKET fd) const;
+        
+    private:
+        std::vector<struct pollfd> _fds;
+    };
 }
 
 #endif
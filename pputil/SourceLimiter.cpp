@@ -0,0 +1,191 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "SourceLimiter.h"
+#include "Atomic.h"
+
+namespace pputil
+{
+    // Readers on any thread find slots and take tokens with atomic 
+    // operations, writers of addresses hold the mutex
+    
+    // Spread addresses of a subnet over sets
+    static inline size_t hash(uint32_t addr)
+    {
+        uint32_t h = addr * 2654435761u;
+        return (size_t)(h ^ (h >> 16));
+    }
+    
+    SourceLimiter::SourceLimiter(size_t capacity)
+    : _slots(NULL)
+    , _mask(0)
+    {
+        size_t sets = 1;
+        while(sets * WAYS < capacity)
+        {
+            sets <<= 1;
+        }
+        _mask = sets - 1;
+        
+        _slots = new Slot[sets * WAYS];
+        memset(_slots, 0, sizeof(Slot) * sets * WAYS);
+        memset(_limits, 0, sizeof(_limits));
+    }
+    
+    SourceLimiter::~SourceLimiter()
+    {
+        delete[] _slots;
+    }
+    
+    // A burst of n is taken at once, then one per interval
+    void SourceLimiter::setConnectRate(double rate, uint32_t burst)
+    {
+        _limits[CONNECT].interval = rate > 0 ? std::max<int64_t>((int64_t)(1000000 / rate), 1) : 0;
+        _limits[CONNECT].tolerance = _limits[CONNECT].interval * (burst > 1 ? burst - 1 : 0);
+    }
+    
+    void SourceLimiter::setRequestRate(double rate, uint32_t burst)
+    {
+        _limits[REQUEST].interval = rate > 0 ? std::max<int64_t>((int64_t)(1000000 / rate), 1) : 0;
+        _limits[REQUEST].tolerance = _limits[REQUEST].interval * (burst > 1 ? burst - 1 : 0);
+    }
+    
+    bool SourceLimiter::enabled() const
+    {
+        return _limits[CONNECT].interval > 0 || _limits[REQUEST].interval > 0;
+    }
+    
+    int64_t SourceLimiter::connect(uint32_t addr, int64_t now)
+    {
+        return take(CONNECT, addr, now);
+    }
+    
+    int64_t SourceLimiter::request(uint32_t addr, int64_t now)
+    {
+        return take(REQUEST, addr, now);
+    }
+    
+    size_t SourceLimiter::size() const
+    {
+        size_t n = 0;
+        for(size_t i = 0; i < (_mask + 1) * WAYS; ++i)
+        {
+            if(load(&_slots[i].addr) != 0)
+            {
+                n++;
+            }
+        }
+        return n;
+    }
+    
+    int64_t SourceLimiter::take(int limit, uint32_t addr, int64_t now)
+    {
+        const Limit& l = _limits[limit];
+        if(l.interval == 0 || addr == 0)
+        {
+            return 0;
+        }
+        
+        Slot* slot = find(addr, now);
+        
+        // Allowed while the next arrival is within tolerance of now
+        int64_t tat = load(&slot->tat[limit]);
+        while(true)
+        {
+            int64_t next = std::max(tat, now);
+            if(next - now > l.tolerance)
+            {
+                return next - now - l.tolerance;
+            }
+            if(compareExchange(&slot->tat[limit], tat, next + l.interval))
+            {
+                return 0;
+            }
+        }
+    }
+    
+    // Slot of a source, taken if it is not in table
+    // A slot is reused under a reader that found it by the old address, 
+    // it takes a token of the new source at most
+    SourceLimiter::Slot* SourceLimiter::find(uint32_t addr, int64_t now)
+    {
+        Slot* set = _slots + (hash(addr) & _mask) * WAYS;
+        for(int i = 0; i < WAYS; ++i)
+        {
+            if(loadAcquire(&set[i].addr) == addr)
+            {
+                // Recency is coarse, it only picks what to evict
+                if(now - load(&set[i].seen) > 1000000)
+                {
+                    store(&set[i].seen, now);
+                }
+                return &set[i];
+            }
+        }
+        
+        IceUtil::Mutex::Lock lock(_mutex);
+        
+        // Taken by another thread meanwhile
+        Slot* victim = set;
+        for(int i = 0; i < WAYS; ++i)
+        {
+            uint32_t a = load(&set[i].addr);
+            if(a == addr)
+            {
+                return &set[i];
+            }
+            if(a == 0)
+            {
+                if(load(&victim->addr) != 0)
+                {
+                    victim = &set[i];
+                }
+            }
+            else if(load(&victim->addr) != 0 && load(&set[i].seen) < load(&victim->seen))
+            {
+                victim = &set[i];
+            }
+        }
+        
+        // Free or least recently seen
+        store(&victim->addr, (uint32_t)0);
+        for(int i = 0; i < LIMITS; ++i)
+        {
+            store(&victim->tat[i], (int64_t)0);
+        }
+        store(&victim->seen, now);
+        storeRelease(&victim->addr, addr);
+        return victim;
+    }
+}
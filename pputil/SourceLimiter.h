@@ -0,0 +1,111 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef PPUTIL_SOURCE_LIMITER_H
+#define PPUTIL_SOURCE_LIMITER_H
+
+#include <pputil/Config.h>
+#include <IceUtil/Mutex.h>
+
+namespace pputil
+{
+    //
+    // Rates of connections and requests per source IPv4 address
+    //
+    // Sources are kept in a table of fixed size, in sets of WAYS slots 
+    // by hash of address. A new source takes the slot of its set seen 
+    // least recently, so a storm of sources costs no memory, and the 
+    // sources evicted are those that have been quiet longest
+    //
+    // Each limit is a token bucket kept as a single time (GCRA), checked
+    // and taken with compare and swap, so checks of known sources do 
+    // not lock, only taking a slot for a new source does
+    //
+    class PPUTIL_API SourceLimiter
+    {
+    public:
+        // Slots of the table, rounded up to a power of 2
+        SourceLimiter(size_t capacity = 16384);
+        ~SourceLimiter();
+        
+        // Connections or requests per second of a source, up to burst 
+        // at once, rate 0 for no limit
+        // Set before the limiter is used
+        void setConnectRate(double rate, uint32_t burst);
+        void setRequestRate(double rate, uint32_t burst);
+        
+        bool enabled() const;
+        
+        // Take a connection or a request of a source (network order) at 
+        // time now in microseconds
+        // Return 0 if it is allowed, or microseconds until it would be
+        int64_t connect(uint32_t addr, int64_t now);
+        int64_t request(uint32_t addr, int64_t now);
+        
+        // Sources in table
+        size_t size() const;
+        
+        enum { WAYS = 8 };
+        
+    private:
+        enum { CONNECT, REQUEST, LIMITS };
+        
+        struct Slot
+        {
+            uint32_t addr;          // 0 if free
+            int64_t seen;
+            int64_t tat[LIMITS];    // Theoretical arrival time of next
+        };
+        
+        struct Limit
+        {
+            int64_t interval;       // Microseconds between, 0 for no limit
+            int64_t tolerance;      // Burst ahead of interval
+        };
+        
+        int64_t take(int limit, uint32_t addr, int64_t now);
+        Slot* find(uint32_t addr, int64_t now);
+        
+        Slot* _slots;
+        size_t _mask;               // Of sets
+        Limit _limits[LIMITS];
+        IceUtil::Mutex _mutex;      // Taking slots
+        
+        // Not copyable
+        SourceLimiter(const SourceLimiter&);
+        void operator=(const SourceLimiter&);
+    };
+}
+
+#endif
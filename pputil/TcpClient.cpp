@@ -33,6 +33,7 @@
 // **********************************************************************
 
 #include "TcpClient.h"
+#include "Logger.h"
 
 namespace pputil 
 {
@@ -58,7 +59,7 @@ namespace pputil
             }
             catch(SocketException& ex)
             {
-                std::cout << ex.toString() << "\n";
+                PP_LOG_ERROR("Socket failed: {}", ex.toString());
                 return false;
             }
         }
@@ -80,14 +81,14 @@ namespace pputil
         }
         catch(SocketException& ex)
         {
-            std::cout << ex.toString() << "\n";
+            PP_LOG_ERROR("Connect to {}:{} failed: {}", host, port, ex.toString());
             return false;
         }
         
         // Start receiving
         receive();
         
-        std::cout << "TcpClient::connect() OK.\n";
+        PP_LOG_DEBUG("Connected to {}:{}", host, port);
         return true;
     }
 
@@ -33,29 +33,71 @@
 // **********************************************************************
 
 #include "TcpConnection.h"
-#include "ThreadException.h"
+#include "Metrics.h"
+#include "Logger.h"
+#include <IceUtil/ThreadException.h>
+
+#ifdef __linux__
+#   include <linux/errqueue.h>
+#   if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#       define PP_HAVE_ZEROCOPY
+#   endif
+#endif
 
 namespace pputil
 {
+    // Send queues over all connections
+    static Metrics& metrics = Metrics::instance();
+    static const int queuedMetric = metrics.gauge("tcp_send_queue_bytes", "", "Bytes queued to send over all connections");
+    static const int depthMetric = metrics.histogram("tcp_send_queue_depth_bytes", "", "Bytes queued on a connection as data is queued");
+    static const int droppedMetric = metrics.counter("tcp_send_dropped_total", "", "Sends refused as the queue is full or closed");
   
     TcpConnection::TcpConnection(ReceiveCallback* receiveCallback)
-    : _fd(INVALID_SOCKET)
+    : _running(false)
+	, _closing(false)
     , _receiveCallback(receiveCallback)
     , _inBuffer(NULL)
     , _outBuffer(NULL)
-    , _running(false)
-	, _closing(false)
+    , _fd(INVALID_SOCKET)
+    , _sendHead(0)
+    , _sendQueueBytes(0)
+    , _sendQueueLimit(4 * 1024 * 1024)
+    , _sendClosing(false)
+    , _batching(false)
+    , _flushing(false)
+    , _closeAfterSend(false)
+    , _wakeFd(-1)
+    , _sendingIndex(0)
+    , _sendingOffset(0)
+    , _corked(false)
+    , _zeroCopy(false)
+    , _zeroCopyThreshold(16 * 1024)
+    , _zeroCopySeq(0)
     {
 
     }
     
     TcpConnection::TcpConnection(SOCKET fd, ReceiveCallback* receiveCallback)
-    : _fd(fd)
+    : _running(false)
+	, _closing(true)
     , _receiveCallback(receiveCallback)
     , _inBuffer(NULL)
     , _outBuffer(NULL)
-    , _running(false)
-	, _closing(true)
+    , _fd(fd)
+    , _sendHead(0)
+    , _sendQueueBytes(0)
+    , _sendQueueLimit(4 * 1024 * 1024)
+    , _sendClosing(false)
+    , _batching(false)
+    , _flushing(false)
+    , _closeAfterSend(false)
+    , _wakeFd(-1)
+    , _sendingIndex(0)
+    , _sendingOffset(0)
+    , _corked(false)
+    , _zeroCopy(false)
+    , _zeroCopyThreshold(16 * 1024)
+    , _zeroCopySeq(0)
     {
 
     }
@@ -86,6 +128,23 @@ namespace pputil
         return _running;
     }
     
+    // Not locked, it is called while received data is handled
+    bool TcpConnection::remoteAddress(struct sockaddr_in& addr)
+    {
+        if(_fd == INVALID_SOCKET)
+        {
+            return false;
+        }
+        
+        // fdToRemoteAddress() returns true when not connected
+        return !fdToRemoteAddress(_fd, addr);
+    }
+    
+    SOCKET TcpConnection::fd()
+    {
+        return _fd;
+    }
+    
     // Close the connection 
     void TcpConnection::close()
     {     
@@ -95,6 +154,12 @@ namespace pputil
             _closing = true;
         }
         
+        {
+            IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+            _sendClosing = true;
+            _sendMonitor.notify();
+        }
+        
         // Wait for thread is joint
         try
         {
@@ -108,12 +173,13 @@ namespace pputil
                 _outputThread->getThreadControl().join();
             }
         }
-        catch(ThreadException& ex)
+        catch(IceUtil::Exception& ex)
         {
-            std::cout << ex.toString() << "\n";
+            PP_LOG_ERROR("Join threads of connection failed: {}", ex.what());
         }
         
         // Close socket
+        SOCKET fd = _fd;
         try
         {
             if(_fd != INVALID_SOCKET)
@@ -124,11 +190,25 @@ namespace pputil
         }
         catch(SocketException& ex)
         {
-            std::cerr << ex.toString() << "\n";
+            PP_LOG_ERROR("Close socket failed: {}", ex.toString());
         }
                 
+        // Pages of zero copy sends are released with the socket
+        _pinned.clear();
+        _sending = 0;
+        
+        // Data not sent is dropped
+        {
+            IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+            metrics.add(queuedMetric, -(int64_t)_sendQueueBytes);
+            _sendQueue.clear();
+            _sendHead = 0;
+            _sendQueueBytes = 0;
+            _spareBatch = 0;
+        }
+        
         _running = false;
-        std::cout << "TcpConnection::close().\n";
+        PP_LOG_DEBUG("Connection {} closed", (long)fd);
     }
     
     // Start receiving
@@ -136,15 +216,13 @@ namespace pputil
     {
         Mutex::Lock lock(_mutex);
 		_closing = false;
-
-        // FD_SET for receive and send selecting
-        FD_ZERO(&_fds);
-        FD_SET(_fd, &_fds);
-        
-        memset(&_timeout, 0, sizeof(_timeout));
-        _timeout.tv_sec = 1;
-        _timeout.tv_usec = 0;
         
+        {
+            IceUtil::Monitor<IceUtil::Mutex>::Lock sendLock(_sendMonitor);
+            _sendClosing = false;
+            _closeAfterSend = false;
+        }
+
         // Buffer
         if(_inBuffer == NULL)
         {
@@ -170,9 +248,9 @@ namespace pputil
             
             _inputThread->start();            
         } 
-        catch(ThreadException& ex) 
+        catch(IceUtil::Exception& ex) 
         {
-            std::cout << ex.toString() << "\n";
+            PP_LOG_ERROR("Start thread of connection failed: {}", ex.what());
         }
         
         // Start output thread
@@ -188,9 +266,9 @@ namespace pputil
             _outputThread->start();
             
         } 
-        catch(ThreadException& ex) 
+        catch(IceUtil::Exception& ex) 
         {
-            std::cout << ex.toString() << "\n";
+            PP_LOG_ERROR("Start thread of connection failed: {}", ex.what());
         }
         
         _running = true;
@@ -206,31 +284,45 @@ namespace pputil
     // concurrent.    
     bool TcpConnection::input()
     {
+        {
+            Mutex::Lock lock(_mutex);
+            if(_closing)
+            {
+                return false;
+            }
+        }
+        
+        // Poll to receive on socket, without holding _mutex, which 
+        // server thread takes to check the connection is alive
+        _polls.clear();
+        size_t index = _polls.add(_fd);
+        int rc = _polls.wait(1000);
+        
         Mutex::Lock lock(_mutex);
         if(_closing)
         {
             return false;
         }
-        
-        // Select to receive on socket
-        _readFds = _fds;
-        
-        int rc = select(_fd + 1, &_readFds, NULL, NULL, &_timeout);
-        if(rc < 0)
+        else if(rc < 0)
         {
+            // Socket failed, server closes it as a zombie
+            _closing = true;
+            _running = false;
             return false;
         }
         else if(rc == 0)
         {
 
         }
-        else if(FD_ISSET(_fd, &_readFds))
+        else if(_polls.readable(index, _fd))
         {
             assert(_inBuffer != NULL);
             long n = _inBuffer->receive(_fd);
             if(n <= 0)
             {
+                // Peer closed, server closes it as a zombie
                 _closing = true;
+                _running = false;
                 return false;
             }
             else
@@ -250,41 +342,280 @@ namespace pputil
         }
     }
     
-    // Select on socket to send data
+    // Write queued data to socket
+    // Output thread does not hold _mutex, which input thread holds 
+    // while it selects, but waits on the send queue
     bool TcpConnection::output()
     {
-        Mutex::Lock lock(_mutex);
-        if(_closing)
+        bool last = true;
+        if(!_sending)
+        {
+            IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+            while(!_sendClosing && (queuedChunks() == 0 || (_batching && !_flushing)))
+            {
+                // A batch not flushed in time is sent anyway
+                if(!_sendMonitor.timedWait(IceUtil::Time::seconds(1)) && queuedChunks() > 0)
+                {
+                    break;
+                }
+            }
+            
+            if(_sendClosing)
+            {
+                return false;
+            }
+            
+            // Take a batch, so producers are not blocked while writing
+            _sending = takeBatch(64);
+            _sendingIndex = 0;
+            _sendingOffset = 0;
+            
+            last = queuedChunks() == 0;
+            if(last)
+            {
+                _flushing = false;
+            }
+        }
+        
+        // Cork over all writes of a flush
+        if(_batching && !_corked)
         {
+            _corked = setCork(_fd, true);
+        }
+        
+        if(!writeChunks())
+        {
+            IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+            _sendClosing = true;
             return false;
-
         }
         
-        /*
-        if(_outBuffer == NULL || _outBuffer->size() == 0)
+        if(_corked && !_sending && last)
+        {
+            setCork(_fd, false);
+            _corked = false;
+        }
+        
+        if(!_sending && shutdownSent())
+        {
+            return false;
+        }
+        
+        if(!_pinned.empty())
+        {
+            reapZeroCopy(false);
+        }
+        
+        return true;
+    }
+    
+    // Gather heads and bodies of chunks into one write
+    bool TcpConnection::writeChunks()
+    {
+    #ifdef _WIN32
+        WSABUF iov[128];
+    #else
+        struct iovec iov[128];
+    #endif
+        std::vector<SendChunk>& chunks = _sending->chunks;
+        size_t count = 0;
+        size_t total = 0;
+        size_t skip = _sendingOffset;
+        
+        for(size_t c = _sendingIndex; c < chunks.size(); ++c)
+        {
+            SendChunk& chunk = chunks[c];
+            byte* parts[2] = { chunk.head, chunk.body ? chunk.body->data() : NULL };
+            size_t lens[2] = { chunk.headLen, chunk.body ? chunk.body->size() : 0 };
+            
+            for(int i = 0; i < 2; ++i)
+            {
+                if(skip >= lens[i])
+                {
+                    skip -= lens[i];
+                    continue;
+                }
+                
+            #ifdef _WIN32
+                iov[count].buf = (char*)parts[i] + skip;
+                iov[count].len = (ULONG)(lens[i] - skip);
+            #else
+                iov[count].iov_base = parts[i] + skip;
+                iov[count].iov_len = lens[i] - skip;
+            #endif
+                total += lens[i] - skip;
+                skip = 0;
+                count++;
+            }
+        }
+        
+        if(count == 0)
         {
+            _sending = 0;
             return true;
         }
         
-        // Select to send on socket
-        _writeFds = _fds;
-		std::cout << "TcpConnection select on socket for write\n";
-        int rc = select(_fd + 1, NULL, &_writeFds, NULL, &_timeout);
-        if(rc < 0)
+    #ifdef _WIN32
+        DWORD sent = 0;
+        if(WSASend(_fd, iov, (DWORD)count, &sent, 0, NULL, NULL) == SOCKET_ERROR)
         {
+            return interrupted() || wouldBlock();
+        }
+        size_t n = sent;
+    #else
+        ssize_t rc = -1;
+        
+    #ifdef PP_HAVE_ZEROCOPY
+        if(_zeroCopy && total >= _zeroCopyThreshold)
+        {
+            // Bound the memory pinned by sends not completed yet
+            if(_pinned.size() >= 256)
+            {
+                reapZeroCopy(true);
+            }
             
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            
+            rc = sendmsg(_fd, &msg, MSG_ZEROCOPY);
+            if(rc >= 0)
+            {
+                // Each successful call is numbered in completions
+                PinnedBatch pinned;
+                pinned.seq = _zeroCopySeq++;
+                pinned.batch = _sending;
+                _pinned.push_back(pinned);
+            }
+            else if(errno == ENOBUFS)
+            {
+                // Out of pinned memory, copy this one
+                rc = writev(_fd, iov, (int)count);
+            }
         }
-        else if(rc == 0)
+        else
+    #endif
+        {
+            rc = writev(_fd, iov, (int)count);
+        }
+        
+        if(rc < 0)
+        {
+            return interrupted() || wouldBlock();
+        }
+        size_t n = rc;
+    #endif
+        
+        // Skip chunks written, keep the offset into the first one left
+        n += _sendingOffset;
+        size_t bytes = 0;
+        while(_sendingIndex < chunks.size())
+        {
+            SendChunk& chunk = chunks[_sendingIndex];
+            size_t len = chunk.headLen + (chunk.body ? chunk.body->size() : 0);
+            if(n < len)
+            {
+                break;
+            }
+            n -= len;
+            bytes += len;
+            _sendingIndex++;
+        }
+        _sendingOffset = n;
+        
+        if(_sendingIndex == chunks.size())
+        {
+            _sending = 0;
+        }
+        
+        IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+        _sendQueueBytes -= bytes;
+        metrics.add(queuedMetric, -(int64_t)bytes);
+        return true;
+    }
+    
+    // Completions of zero copy sends are read from socket error queue
+    // (Documentation/networking/msg_zerocopy.rst)
+    void TcpConnection::reapZeroCopy(bool wait)
+    {
+    #ifdef PP_HAVE_ZEROCOPY
+        while(!_pinned.empty())
         {
+            if(wait)
+            {
+                // Error queue is reported as POLLERR
+                struct pollfd pfd;
+                pfd.fd = _fd;
+                pfd.events = 0;
+                pfd.revents = 0;
+                poll(&pfd, 1, 100);
+            }
+            
+            char control[128];
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            
+            if(recvmsg(_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            {
+                if(wait && !interrupted() && !wouldBlock())
+                {
+                    // Socket is gone, kernel does not hold the pages
+                    _pinned.clear();
+                }
+                return;
+            }
             
+            for(struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+            {
+                if(!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                     (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+                {
+                    continue;
+                }
+                
+                struct sock_extended_err* err = (struct sock_extended_err*)CMSG_DATA(cm);
+                if(err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                {
+                    continue;
+                }
+                
+                // Sends from ee_info to ee_data are complete
+                uint32_t hi = err->ee_data;
+                while(!_pinned.empty() && (int32_t)(_pinned.front().seq - hi) <= 0)
+                {
+                    _pinned.pop_front();
+                }
+            }
+            
+            wait = false;
         }
-        else if(FD_ISSET(_fd, &_writeFds))
+    #else
+        _pinned.clear();
+    #endif
+    }
+    
+    bool TcpConnection::setZeroCopy(bool zeroCopy, size_t threshold)
+    {
+        IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+        _zeroCopyThreshold = threshold;
+        
+    #ifdef PP_HAVE_ZEROCOPY
+        int flag = zeroCopy ? 1 : 0;
+        if(_fd == INVALID_SOCKET || setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &flag, sizeof(flag)) != 0)
         {
-            assert(_outBuffer != NULL);
-            long n = _outBuffer->send(_fd); 
+            _zeroCopy = false;
+            return !zeroCopy;
         }
-        */
+        
+        _zeroCopy = zeroCopy;
         return true;
+    #else
+        _zeroCopy = false;
+        return !zeroCopy;
+    #endif
     }
     
     long TcpConnection::send(const std::string& s)
@@ -321,20 +652,310 @@ namespace pputil
             return false;
         }
         
-        // Mark
+        return asynSend(NULL, 0, new Blob(bytes, n));
+    }
+    
+    bool TcpConnection::asynSend(Buffer* buffer)
+    {
+        if(buffer == NULL || buffer->size() == 0)
+        {
+            return false;
+        }
         
-        // Try to send immediately if there is nothing in cache already
+        if(!asynSend(NULL, 0, new Blob(buffer->read_pos(), buffer->size())))
+        {
+            return false;
+        }
         
-            // Cancel mark if send complete
+        buffer->remove(buffer->size());
+        return true;
+    }
+    
+    bool TcpConnection::asynSend(const byte* head, size_t headLen, const BlobPtr& body)
+    {
+        assert(headLen <= sizeof(((SendChunk*)0)->head));
         
-        // Cache if mark 
+        size_t len = headLen + (body ? body->size() : 0);
+        if(len == 0)
+        {
+            return false;
+        }
         
+        IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+        if(_sendClosing || _closeAfterSend || (_sendQueueLimit > 0 && _sendQueueBytes + len > _sendQueueLimit))
+        {
+            metrics.add(droppedMetric);
+            return false;
+        }
+        
+        _sendQueue.push_back(SendChunk());
+        SendChunk& chunk = _sendQueue.back();
+        if(headLen > 0)
+        {
+            memcpy(chunk.head, head, headLen);
+        }
+        chunk.headLen = headLen;
+        chunk.body = body;
+        _sendQueueBytes += len;
+        metrics.add(queuedMetric, (int64_t)len);
+        metrics.record(depthMetric, (int64_t)_sendQueueBytes);
+        
+        // A batch near the limit is flushed rather than dropped
+        if(_batching && _sendQueueLimit > 0 && _sendQueueBytes > _sendQueueLimit / 2)
+        {
+            _flushing = true;
+        }
+        
+        if(queuedChunks() == 1 || _flushing)
+        {
+            notifySend();
+        }
         return true;
     }
     
-    bool TcpConnection::asynSend(Buffer* buffer)
+    bool TcpConnection::asynSend(const BlobPtr* blobs, size_t n)
     {
-        return false;
+        size_t len = 0;
+        for(size_t i = 0; i < n; ++i)
+        {
+            len += blobs[i] ? blobs[i]->size() : 0;
+        }
+        
+        if(len == 0)
+        {
+            return false;
+        }
+        
+        IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+        if(_sendClosing || _closeAfterSend || (_sendQueueLimit > 0 && _sendQueueBytes + len > _sendQueueLimit))
+        {
+            metrics.add(droppedMetric);
+            return false;
+        }
+        
+        bool wasEmpty = queuedChunks() == 0;
+        for(size_t i = 0; i < n; ++i)
+        {
+            if(!blobs[i] || blobs[i]->size() == 0)
+            {
+                continue;
+            }
+            
+            _sendQueue.push_back(SendChunk());
+            SendChunk& chunk = _sendQueue.back();
+            chunk.headLen = 0;
+            chunk.body = blobs[i];
+        }
+        _sendQueueBytes += len;
+        metrics.add(queuedMetric, (int64_t)len);
+        metrics.record(depthMetric, (int64_t)_sendQueueBytes);
+        
+        if(_batching && _sendQueueLimit > 0 && _sendQueueBytes > _sendQueueLimit / 2)
+        {
+            _flushing = true;
+        }
+        
+        if(wasEmpty || _flushing)
+        {
+            notifySend();
+        }
+        return true;
+    }
+    
+    void TcpConnection::setBatching(bool batching)
+    {
+        IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+        _batching = batching;
+        _flushing = !batching;
+        notifySend();
+    }
+    
+    void TcpConnection::flush()
+    {
+        IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+        if(_batching && queuedChunks() > 0 && !_flushing)
+        {
+            _flushing = true;
+            notifySend();
+        }
+    }
+    
+    void TcpConnection::setSendQueueLimit(size_t bytes)
+    {
+        IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+        _sendQueueLimit = bytes;
+    }
+    
+    size_t TcpConnection::sendQueueSize()
+    {
+        IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+        return _sendQueueBytes;
+    }
+    
+    void TcpConnection::notifySend()
+    {
+    #ifndef _WIN32
+        if(_wakeFd >= 0)
+        {
+            uint64_t one = 1;
+            ::write(_wakeFd, &one, sizeof(one));
+            return;
+        }
+    #endif
+        _sendMonitor.notify();
+    }
+    
+    // Data queued already is flushed out of a batch
+    void TcpConnection::closeAfterSend()
+    {
+        _closing = true;
+        
+        IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+        if(_sendQueueBytes == 0)
+        {
+            _running = false;
+            return;
+        }
+        
+        _closeAfterSend = true;
+        _flushing = true;
+        notifySend();
+    }
+    
+    bool TcpConnection::shutdownSent()
+    {
+        {
+            IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+            if(!_closeAfterSend || _sendQueueBytes > 0)
+            {
+                return false;
+            }
+            _closeAfterSend = false;
+            _sendClosing = true;
+        }
+        
+        ::shutdown(_fd, SHUT_WR);
+        
+        Mutex::Lock lock(_mutex);
+        _running = false;
+        return true;
+    }
+    
+    size_t TcpConnection::queuedChunks() const
+    {
+        return _sendQueue.size() - _sendHead;
+    }
+    
+    // Taken chunks let go of their bodies in queue, which is compacted 
+    // when they are the larger part of it
+    // Chunks of the spare batch are held until the next batch is taken
+    TcpConnection::SendBatchPtr TcpConnection::takeBatch(size_t max)
+    {
+        if(!_spareBatch || _spareBatch->__getRef() > 1)
+        {
+            _spareBatch = new SendBatch();
+        }
+        
+        SendBatchPtr batch = _spareBatch;
+        batch->chunks.clear();
+        batch->chunks.reserve(std::min(queuedChunks(), max));
+        while(_sendHead < _sendQueue.size() && batch->chunks.size() < max)
+        {
+            SendChunk& chunk = _sendQueue[_sendHead++];
+            batch->chunks.push_back(chunk);
+            chunk.body = 0;
+        }
+        
+        if(_sendHead == _sendQueue.size())
+        {
+            _sendQueue.clear();
+            _sendHead = 0;
+        }
+        else if(_sendHead >= 1024 && _sendHead * 2 >= _sendQueue.size())
+        {
+            _sendQueue.erase(_sendQueue.begin(), _sendQueue.begin() + _sendHead);
+            _sendHead = 0;
+        }
+        return batch;
+    }
+    
+    // Attach to a server ring rather than start threads 
+    bool TcpConnection::attach(int wakeFd)
+    {
+        Mutex::Lock lock(_mutex);
+        if(_fd == INVALID_SOCKET || wakeFd < 0)
+        {
+            return false;
+        }
+        _closing = false;
+        
+        {
+            IceUtil::Monitor<IceUtil::Mutex>::Lock sendLock(_sendMonitor);
+            _sendClosing = false;
+            _wakeFd = wakeFd;
+        }
+        
+        if(_inBuffer == NULL)
+        {
+            _inBuffer = new Buffer();
+        }
+        assert(_inBuffer != NULL);
+        
+        _running = true;
+        return true;
+    }
+    
+    void TcpConnection::ringReceive(const byte* bytes, size_t n)
+    {
+        Mutex::Lock lock(_mutex);
+        if(_closing)
+        {
+            return;
+        }
+        
+        assert(_inBuffer != NULL);
+        _inBuffer->writeBlob(const_cast<byte*>(bytes), n);
+        onReceive();
+    }
+    
+    bool TcpConnection::ringTake(SendBatchPtr& batch)
+    {
+        IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+        if(_sendClosing || queuedChunks() == 0 || (_batching && !_flushing))
+        {
+            return false;
+        }
+        
+        batch = takeBatch(256);
+        if(queuedChunks() == 0)
+        {
+            _flushing = false;
+        }
+        return true;
+    }
+    
+    void TcpConnection::ringSent(size_t bytes)
+    {
+        {
+            IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+            bytes = std::min(bytes, _sendQueueBytes);
+            _sendQueueBytes -= bytes;
+            metrics.add(queuedMetric, -(int64_t)bytes);
+        }
+        shutdownSent();
+    }
+    
+    // Peer closed or socket failed, server closes it as a zombie
+    void TcpConnection::ringClosed()
+    {
+        {
+            IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_sendMonitor);
+            _sendClosing = true;
+        }
+        
+        Mutex::Lock lock(_mutex);
+        _closing = true;
+        _running = false;
     }
     
 }
@@ -1,169 +1,284 @@
-// **********************************************************************
-// 
-// Copyright (c) 2010, The PPEngine project authors.
-// 
-// Redistribution and use in source and binary forms, with or without
-// modification, are permitted provided that the following conditions 
-// are met:
-// 
-//   * Redistributions of source code must retain the above copyright
-//     notice, this list of conditions and the following disclaimer.
-// 
-//   * Redistributions in binary form must reproduce the above copyright
-//     notice, this list of conditions and the following disclaimer in
-//     the documentation and/or other materials provided with the
-//     distribution.
-// 
-//   * Neither the name of Google nor the names of its contributors may
-//     be used to endorse or promote products derived from this software
-//     without specific prior written permission.
-// 
-// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
-// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
-// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
-// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
-// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
-// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
-// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
-// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-// 
-// **********************************************************************
-
-#ifndef PPUTIL_TCP_CONNECTION_H
-#define PPUTIL_TCP_CONNECTION_H
-
-#include <pputil/Config.h>
-#include <pputil/Connection.h>
-#include <pputil/Buffer.h>
-#include <pputil/Socket.h>
-#include <IceUtil/Thread.h>
-#include <deque>
-
-using namespace IceUtil;
-
-namespace pputil
-{
-    //
-    // A recv thread recv data from socket into buffer and callback to user
-    // A send thread send data in buffer to socket
-    //    
-    class PPUTIL_API TcpConnection : public Connection
-    {
-    public:
-        TcpConnection(ReceiveCallback* receiveCallback); // As client side connection
-        TcpConnection(SOCKET fd, ReceiveCallback* receiveCallback); // As server side connection
-        virtual ~TcpConnection();
-            
-        // Connection interface
-        
-        virtual void close();
-        virtual bool isAlive();
-    
-        // Start receiving
-        virtual bool receive();
-        
-        // Send       
-        virtual long send(const std::string& s);
-        virtual long send(byte* bytes, size_t n);
-        virtual long send(Buffer* buffer);
-        
-        virtual bool asynSend(const std::string& s);
-        virtual bool asynSend(byte* bytes, size_t n);
-        virtual bool asynSend(Buffer* buffer);
-    
-    protected:
-        // State
-        bool _running;
-        bool _closing;
-        Mutex _mutex;
-        
-        // Callback
-        ReceiveCallback* _receiveCallback;
-        
-        virtual void onReceive();
-        
-        // Buffers
-        Buffer* _inBuffer;
-        Buffer* _outBuffer;
-        
-        // Socket
-        SOCKET _fd;
-        
-        // For select
-        fd_set _fds;
-        fd_set _readFds;
-        fd_set _writeFds;
-        struct timeval _timeout;
-        
-        virtual bool input();
-        virtual bool output();
-        
-    protected:
-        // Input thread
-        class InputThread : public Thread
-        {
-        public:
-            InputThread(TcpConnection* connection)
-            : _connection(connection)
-            {
-            }
-            
-            virtual ~InputThread()
-            {
-            }
-          
-            virtual void run()
-            {
-                while(_connection != NULL && _connection->input())
-                {
-                    
-                }
-            }
-            
-        private:
-            TcpConnection* _connection;
-        };
-        
-        friend class InputThread; 
-        
-        typedef IceUtil::Handle<InputThread> InputThreadPtr;
-        InputThreadPtr _inputThread;
-        
-    protected:
-        // Output thread
-        class OutputThread : public Thread
-        {
-        public:
-            OutputThread(TcpConnection* connection)
-            : _connection(connection)
-            {
-            }
-            
-            virtual ~OutputThread()
-            {
-
-            }
-            
-            virtual void run()
-            {
-                while(_connection != NULL && _connection->output())
-                {
-                    
-                }
-            }
-            
-        private:
-            TcpConnection* _connection;
-        };
-        
-        friend class OutputThread;
-        
-        typedef IceUtil::Handle<OutputThread> OutputThreadPtr;
-        OutputThreadPtr _outputThread;
-    };
-}
-
-#endif
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef PPUTIL_TCP_CONNECTION_H
+#define PPUTIL_TCP_CONNECTION_H
+
+#include <pputil/Config.h>
+#include <pputil/Connection.h>
+#include <pputil/Buffer.h>
+#include <pputil/Socket.h>
+#include <pputil/Blob.h>
+#include <IceUtil/Thread.h>
+#include <IceUtil/Monitor.h>
+#include <deque>
+
+using namespace IceUtil;
+
+namespace pputil
+{
+    //
+    // A recv thread recv data from socket into buffer and callback to user
+    // A send thread send data in buffer to socket
+    //    
+    class PPUTIL_API TcpConnection : public Connection
+    {
+    public:
+        TcpConnection(ReceiveCallback* receiveCallback); // As client side connection
+        TcpConnection(SOCKET fd, ReceiveCallback* receiveCallback); // As server side connection
+        virtual ~TcpConnection();
+            
+        // Connection interface
+        
+        virtual void close();
+        virtual bool isAlive();
+    
+        // Start receiving
+        virtual bool receive();
+        
+        // Send       
+        virtual long send(const std::string& s);
+        virtual long send(byte* bytes, size_t n);
+        virtual long send(Buffer* buffer);
+        
+        virtual bool asynSend(const std::string& s);
+        virtual bool asynSend(byte* bytes, size_t n);
+        virtual bool asynSend(Buffer* buffer);
+        
+        // Queue a short head (up to 8 bytes, copied) and a body (shared), 
+        // written together by output thread without copying the body
+        // Return false if the queue is over its limit, and nothing is queued
+        bool asynSend(const byte* head, size_t headLen, const BlobPtr& body);
+        
+        // Queue shared blobs together, so nothing is queued between them
+        // Return false if the queue is over its limit, and nothing is queued
+        bool asynSend(const BlobPtr* blobs, size_t n);
+        
+        // Bytes allowed in send queue, 0 for no limit
+        void setSendQueueLimit(size_t bytes);
+        size_t sendQueueSize();
+        
+        // In batching mode queued data waits for flush(), and is written
+        // with the socket corked, so packets queued in one tick go out 
+        // with a few writes in full segments
+        void setBatching(bool batching);
+        void flush();
+        
+        // Send large writes with MSG_ZEROCOPY where supported (Linux 4.14+)
+        // Packets are held until kernel reports the send complete, 
+        // writes smaller than threshold bytes are copied as usual
+        // Return false if it is not supported
+        bool setZeroCopy(bool zeroCopy, size_t threshold = 16 * 1024);
+        
+        // Address of the other end, false if not connected
+        bool remoteAddress(struct sockaddr_in& addr);
+        
+        SOCKET fd();
+        
+    public:
+        // Queued data
+        struct SendChunk
+        {
+            byte head[8];
+            size_t headLen;
+            BlobPtr body;
+        };
+        
+        // Chunks taken from queue and being written
+        // A batch is not changed once taken, so heads and bodies stay 
+        // in place while kernel refers to them (zero copy, io_uring)
+        struct SendBatch : public IceUtil::Shared
+        {
+            std::vector<SendChunk> chunks;
+        };
+        typedef IceUtil::Handle<SendBatch> SendBatchPtr;
+        
+        // Driven by io_uring of a server (TcpServerRing) instead of input 
+        // and output threads. Server passes in received data and sends the
+        // batches it takes, it is woken through wakeFd when data is queued
+        bool attach(int wakeFd);
+        void ringReceive(const byte* bytes, size_t n);
+        bool ringTake(SendBatchPtr& batch);
+        void ringSent(size_t bytes);
+        void ringClosed();
+    
+    protected:
+        // State
+        bool _running;
+        bool _closing;
+        Mutex _mutex;
+        
+        // Callback
+        ReceiveCallback* _receiveCallback;
+        
+        virtual void onReceive();
+        
+        // Buffers
+        Buffer* _inBuffer;
+        Buffer* _outBuffer;
+        
+        // Socket
+        SOCKET _fd;
+        
+        // Send queue, drained by output thread or server ring
+        // Chunks before _sendHead are taken, the vector is emptied (keeping 
+        // its memory) once all are taken, so queueing does not allocate
+        std::vector<SendChunk> _sendQueue;
+        size_t _sendHead;
+        size_t _sendQueueBytes;
+        size_t _sendQueueLimit;
+        bool _sendClosing;
+        bool _batching;
+        bool _flushing;
+        bool _closeAfterSend;
+        IceUtil::Monitor<IceUtil::Mutex> _sendMonitor;
+        int _wakeFd;
+        
+        // Wake whoever drains the queue, with _sendMonitor locked
+        void notifySend();
+        
+        // Stop receiving, and shut down the write side once queued data is
+        // sent, so that a last response is not lost as the server closes 
+        // the connection as a zombie. Nothing is queued after it
+        // Called with _mutex locked, as received data is handled
+        void closeAfterSend();
+        
+        // Shut down the write side if all is sent after closeAfterSend(),
+        // called by whoever drains the queue without _sendMonitor locked
+        bool shutdownSent();
+        
+        // Chunks in queue, and take up to max of them into a batch, 
+        // with _sendMonitor locked
+        size_t queuedChunks() const;
+        SendBatchPtr takeBatch(size_t max);
+        
+        // Batch taken last, taken again once its sender lets it go
+        SendBatchPtr _spareBatch;
+        
+        SendBatchPtr _sending;
+        size_t _sendingIndex;   // First chunk not written completely
+        size_t _sendingOffset;  // and bytes of it written already
+        bool _corked;
+        
+        // Write chunks in _sending, return false on error
+        bool writeChunks();
+        
+        // Zero copy sends, batches are pinned until kernel reports 
+        // the sends with their sequence numbers complete
+        struct PinnedBatch
+        {
+            uint32_t seq;
+            SendBatchPtr batch;
+        };
+        
+        bool _zeroCopy;
+        size_t _zeroCopyThreshold;
+        uint32_t _zeroCopySeq;
+        std::deque<PinnedBatch> _pinned;
+        
+        // Release batches of completed sends, wait for one if asked
+        void reapZeroCopy(bool wait);
+        
+        // Socket polled by receiving thread
+        PollSet _polls;
+        
+        virtual bool input();
+        virtual bool output();
+        
+    protected:
+        // Input thread
+        class InputThread : public Thread
+        {
+        public:
+            InputThread(TcpConnection* connection)
+            : _connection(connection)
+            {
+            }
+            
+            virtual ~InputThread()
+            {
+            }
+          
+            virtual void run()
+            {
+                while(_connection != NULL && _connection->input())
+                {
+                    
+                }
+            }
+            
+        private:
+            TcpConnection* _connection;
+        };
+        
+        friend class InputThread; 
+        
+        typedef IceUtil::Handle<InputThread> InputThreadPtr;
+        InputThreadPtr _inputThread;
+        
+    protected:
+        // Output thread
+        class OutputThread : public Thread
+        {
+        public:
+            OutputThread(TcpConnection* connection)
+            : _connection(connection)
+            {
+            }
+            
+            virtual ~OutputThread()
+            {
+
+            }
+            
+            virtual void run()
+            {
+                while(_connection != NULL && _connection->output())
+                {
+                    
+                }
+            }
+            
+        private:
+            TcpConnection* _connection;
+        };
+        
+        friend class OutputThread;
+        
+        typedef IceUtil::Handle<OutputThread> OutputThreadPtr;
+        OutputThreadPtr _outputThread;
+    };
+}
+
+#endif
@@ -33,21 +33,29 @@
 // **********************************************************************
 
 #include "TcpServer.h"
+#include "IoUring.h"
+#include "Metrics.h"
+#include "Logger.h"
 
 namespace pputil
 {
+    // Connections over all servers
+    static Metrics& metrics = Metrics::instance();
+    static const int acceptedMetric = metrics.counter("tcp_accepted_total", "", "Connections accepted");
+    static const int connectionsMetric = metrics.gauge("tcp_connections", "", "Connections open");
+    static const int refusedMetric = metrics.counter("tcp_refused_total", "", "Connections closed as accepted, over rate of their source");
     
     TcpServer::TcpServer(unsigned short port, bool passive)
     : Server(passive)
     , _port(port)
     , _backlog(SOMAXCONN)
     , _fd(INVALID_SOCKET)
-    , _receiveCallback(this)
-    , _connectCallback(this)
+    , _receiveCallback(NULL)
+    , _connectCallback(NULL)
+    , _timeout(1000000)
+    , _limiter(NULL)
+    , _ring(NULL)
     {
-        memset(&_timeout, 0, sizeof(_timeout));
-        _timeout.tv_sec = 1;
-        _timeout.tv_usec = 0;
     }
     
     TcpServer::TcpServer(unsigned short port, ReceiveCallback* receiveCallback, 
@@ -58,10 +66,10 @@ namespace pputil
     , _fd(INVALID_SOCKET)
     , _receiveCallback(receiveCallback)
     , _connectCallback(connectCallback)
+    , _timeout(1000000)
+    , _limiter(NULL)
+    , _ring(NULL)
     {
-        memset(&_timeout, 0, sizeof(_timeout));
-        _timeout.tv_sec = 1;
-        _timeout.tv_usec = 0;
     }
     
     TcpServer::~TcpServer()
@@ -71,6 +79,18 @@ namespace pputil
             closeSocket(_fd);
             _fd = INVALID_SOCKET;
         }
+        
+        if(_ring != NULL)
+        {
+            delete _ring;
+            _ring = NULL;
+        }
+        
+        if(_limiter != NULL)
+        {
+            delete _limiter;
+            _limiter = NULL;
+        }
     }
     
     unsigned short TcpServer::port()
@@ -78,6 +98,83 @@ namespace pputil
         return _port;
     }
     
+    bool TcpServer::setIoBackend(IoBackend backend)
+    {
+        if(backend == IO_URING)
+        {
+            if(!TcpServerRing::supported())
+            {
+                return false;
+            }
+            
+            if(_ring == NULL)
+            {
+                _ring = new TcpServerRing(this);
+            }
+        }
+        else if(_ring != NULL)
+        {
+            delete _ring;
+            _ring = NULL;
+        }
+        return true;
+    }
+    
+    TcpServer::IoBackend TcpServer::ioBackend()
+    {
+        return _ring != NULL ? IO_URING : IO_SELECT;
+    }
+    
+    void TcpServer::setConnectRate(double rate, uint32_t burst)
+    {
+        limiter().setConnectRate(rate, burst);
+    }
+    
+    SourceLimiter& TcpServer::limiter()
+    {
+        if(_limiter == NULL)
+        {
+            _limiter = new SourceLimiter();
+        }
+        return *_limiter;
+    }
+    
+    // Checked with the address of the peer, no allocation, and no 
+    // threads started, so a storm of reconnects costs a syscall each
+    bool TcpServer::admit(SOCKET fd)
+    {
+        if(_limiter == NULL)
+        {
+            return true;
+        }
+        
+        struct sockaddr_in addr;
+        try
+        {
+            // True if the peer is gone
+            if(fdToRemoteAddress(fd, addr) || addr.sin_family != AF_INET)
+            {
+                return true;
+            }
+        }
+        catch(SocketException& ex)
+        {
+            // The socket is closed already
+            return false;
+        }
+        
+        int64_t now = IceUtil::Time::now(IceUtil::Time::Monotonic).toMicroSeconds();
+        if(_limiter->connect(addr.sin_addr.s_addr, now) == 0)
+        {
+            return true;
+        }
+        
+        PP_LOG_DEBUG("Connection from {} refused, over rate", inet_ntoa(addr.sin_addr));
+        metrics.add(refusedMetric);
+        closeSocket(fd);
+        return false;
+    }
+    
     bool TcpServer::doActivate()
     {
         // Start listening
@@ -95,12 +192,20 @@ namespace pputil
             addr.sin_addr.s_addr = INADDR_ANY;
             addr.sin_port = htons(_port);
             
+            // Rebind while connections of last run are in TIME_WAIT
+            setReuseAddress(_fd, true);
             doBind(_fd, addr);
             doListen(_fd, SOMAXCONN);
         }
         catch(SocketException& ex)
         {
-            std::cout << ex.toString() << "\n";
+            PP_LOG_ERROR("Listen on port {} failed: {}", _port, ex.toString());
+            return false;
+        }
+        
+        if(_ring != NULL && !_ring->init())
+        {
+            PP_LOG_WARN("io_uring is not available");
             return false;
         }
         
@@ -111,13 +216,6 @@ namespace pputil
     {
         stopThread();
         
-        // Close socket
-        if(_fd != INVALID_SOCKET)
-        {
-            closeSocket(_fd);
-            _fd = INVALID_SOCKET;
-        }
-        
         // Clear Connections
         for(std::vector<TcpConnection*>::iterator it = _connections.begin(); it != _connections.end(); ++it)
         {
@@ -125,28 +223,69 @@ namespace pputil
             assert(p != NULL);
             if(p != NULL)
             {
+                if(_ring != NULL)
+                {
+                    _ring->detach(p);
+                }
                 p->close();
                 delete p;
             }
         }
+        metrics.add(connectionsMetric, -(int64_t)_connections.size());
         _connections.clear();
+        
+        if(_ring != NULL)
+        {
+            _ring->close();
+        }
+        
+        // Close socket
+        if(_fd != INVALID_SOCKET)
+        {
+            closeSocket(_fd);
+            _fd = INVALID_SOCKET;
+        }
     }
     
     bool TcpServer::doRun()
-    {        
-        // Select to accept conn
-        FD_ZERO(&_fds);
-        FD_SET(_fd, &_fds);
+    {
+        if(_ring != NULL)
+        {
+            _ring->run();
+            closeZombies();
+            return true;
+        }
+        
+        // Poll to accept conn
+        _polls.clear();
+        size_t listener = _polls.add(_fd);
+        preparePoll(_polls);
+        
+        int rc = _polls.wait((int)((_timeout + 999) / 1000));
+        if (rc > 0)
+        {
+            handlePoll(_polls);
+        }
         
-        int rc = select(_fd + 1, &_fds, NULL, NULL, &_timeout);
         if (rc < 0 )
         {
 
         }
-        else if (FD_ISSET(_fd, &_fds))
+        else if (_polls.readable(listener, _fd))
         {
-            SOCKET fd = doAccept(_fd);
-            if(fd != INVALID_SOCKET)
+            // Out of fds or buffers in a storm of connects, the server 
+            // goes on and accepts again when some are closed
+            SOCKET fd = INVALID_SOCKET;
+            try
+            {
+                fd = doAccept(_fd);
+            }
+            catch(SocketException& ex)
+            {
+                PP_LOG_WARN("Accept failed: {}", ex.toString());
+            }
+            
+            if(fd != INVALID_SOCKET && admit(fd))
             {
                 // Accept a new connection
                 TcpConnection* pConn = createConnection(fd);
@@ -155,36 +294,65 @@ namespace pputil
                     closeSocket(fd);
                     fd = INVALID_SOCKET;
                 }
-                
-                _connections.push_back(pConn);
-                
-                pConn->receive();
-                
-                // Connect callback
-                if(_connectCallback != NULL) 
+                else
                 {
-                    _connectCallback->onConnect(pConn);
+                    addConnection(pConn);
+                    
+                    pConn->receive();
+                    
+                    // Connect callback
+                    if(_connectCallback != NULL) 
+                    {
+                        _connectCallback->onConnect(pConn);
+                    }
                 }
             }
         }
         
-        // Monitor and close zombie connections
+        closeZombies();
+        
+        return true;
+    }
+    
+    // Monitor and close zombie connections
+    void TcpServer::closeZombies()
+    {
         for(std::vector<TcpConnection*>::iterator it = _connections.begin(); it != _connections.end(); )
         {
             TcpConnection* p = *it;
             if(!p->isAlive())
             {
+                if(_ring != NULL)
+                {
+                    _ring->detach(p);
+                }
                 p->close();
                 it = _connections.erase(it);
                 delete p;
+                metrics.add(connectionsMetric, -1);
             }
             else
             {
                 ++it;
             }
         }
+    }
+    
+    void TcpServer::addConnection(TcpConnection* conn)
+    {
+        _connections.push_back(conn);
+        metrics.add(acceptedMetric);
+        metrics.add(connectionsMetric, 1);
+    }
+    
+    void TcpServer::preparePoll(PollSet& /*fds*/)
+    {
+        
+    }
+    
+    void TcpServer::handlePoll(const PollSet& /*fds*/)
+    {
         
-        return true;
     }
     
     TcpConnection* TcpServer::createConnection(SOCKET fd)
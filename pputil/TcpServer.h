@@ -39,9 +39,12 @@
 #include <pputil/Server.h>
 #include <pputil/TcpConnection.h>
 #include <pputil/Socket.h>
+#include <pputil/SourceLimiter.h>
 
 namespace pputil
 {
+    class TcpServerRing;
+    
     //
     // Start TCP listener
     // Accept connections, start its receiving, call back to user
@@ -59,6 +62,24 @@ namespace pputil
         
         unsigned short port();
         
+        // I/O backend, select() loops with connection threads by default
+        // IO_URING serves all connections on server thread with io_uring
+        // Set before activate(), return false if it is not supported
+        enum IoBackend
+        {
+            IO_SELECT,
+            IO_URING
+        };
+        
+        bool setIoBackend(IoBackend backend);
+        IoBackend ioBackend();
+        
+        // Connections per second from a source address, up to burst at
+        // once, 0 for no limit. A connection over it is closed as it is 
+        // accepted, before anything is created for it
+        // Set before activate()
+        void setConnectRate(double rate, uint32_t burst);
+        
     protected:
         // Override to Server
         virtual bool doActivate();
@@ -75,15 +96,39 @@ namespace pputil
         ReceiveCallback* _receiveCallback;
         ConnectCallback* _connectCallback;
         
-        // Selector
-        fd_set _fds;
-        struct timeval _timeout;
+        // Sockets polled by server thread, and wait of a poll in
+        // microseconds
+        PollSet _polls;
+        int64_t _timeout;
+        
+        // Override to poll more sockets along with the listener
+        // and to handle those that are ready
+        virtual void preparePoll(PollSet& fds);
+        virtual void handlePoll(const PollSet& fds);
         
         // Create a connection
         virtual TcpConnection* createConnection(SOCKET fd);
         
         // TCP connections
         std::vector<TcpConnection*> _connections;
+        
+        // Keep an accepted connection, and count it in metrics
+        void addConnection(TcpConnection* conn);
+        
+        // Close connections that are not alive
+        void closeZombies();
+        
+        // Rates of sources, created when a rate is set
+        SourceLimiter* _limiter;
+        SourceLimiter& limiter();
+        
+        // Close an accepted socket if its source is over connect rate
+        // Return false if it is closed
+        bool admit(SOCKET fd);
+        
+        // io_uring backend, NULL for select
+        TcpServerRing* _ring;
+        friend class TcpServerRing;
     };
 }
 
@@ -0,0 +1,117 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "ThreadBlocks.h"
+
+namespace pputil
+{
+    
+    ThreadBlocks::Block::Block()
+    : next(NULL)
+    , _owner(NULL)
+    , _free(false)
+    {
+    }
+    
+    ThreadBlocks* ThreadBlocks::create(Factory factory)
+    {
+        return new ThreadBlocks(factory);
+    }
+    
+    ThreadBlocks::ThreadBlocks(Factory factory)
+    : _factory(factory)
+    , _blocks(NULL)
+    {
+    #ifdef _WIN32
+        _key = TlsAlloc();
+    #else
+        pthread_key_create(&_key, &ThreadBlocks::release);
+    #endif
+    }
+    
+    ThreadBlocks::~ThreadBlocks()
+    {
+    }
+    
+    ThreadBlocks::Block* ThreadBlocks::get()
+    {
+    #ifdef _WIN32
+        Block* b = (Block*)TlsGetValue(_key);
+    #else
+        Block* b = (Block*)pthread_getspecific(_key);
+    #endif
+        if(b != NULL)
+        {
+            return b;
+        }
+        
+        IceUtil::Mutex::Lock lock(_mutex);
+        for(b = _blocks; b != NULL && !b->_free; b = b->next)
+        {
+        }
+        
+        if(b == NULL)
+        {
+            b = _factory();
+            b->_owner = this;
+            b->next = _blocks;
+            _blocks = b;
+        }
+        b->_free = false;
+        
+    #ifdef _WIN32
+        TlsSetValue(_key, b);
+    #else
+        pthread_setspecific(_key, b);
+    #endif
+        return b;
+    }
+    
+    ThreadBlocks::Block* ThreadBlocks::head()
+    {
+        return _blocks;
+    }
+    
+    IceUtil::Mutex& ThreadBlocks::mutex()
+    {
+        return _mutex;
+    }
+    
+    void ThreadBlocks::release(void* block)
+    {
+        Block* b = (Block*)block;
+        IceUtil::Mutex::Lock lock(b->_owner->_mutex);
+        b->_free = true;
+    }
+}
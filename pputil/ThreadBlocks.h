@@ -0,0 +1,99 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef PPUTIL_THREAD_BLOCKS_H
+#define PPUTIL_THREAD_BLOCKS_H
+
+#include <pputil/Config.h>
+#include <IceUtil/Mutex.h>
+
+namespace pputil
+{
+    //
+    // Blocks of per thread data, e.g. counters written by a thread only
+    // A thread takes a block on its first call, blocks of exited threads 
+    // are kept with their data and reused by new threads
+    //
+    // Lists live as long as the process, threads may still use their 
+    // blocks while static objects are destroyed, so neither a list nor 
+    // its blocks are ever deleted
+    //
+    class PPUTIL_API ThreadBlocks
+    {
+    public:
+        // Data of a thread derives from Block
+        struct Block
+        {
+            Block();
+            
+            Block* next;
+            
+        private:
+            friend class ThreadBlocks;
+            ThreadBlocks* _owner;
+            bool _free;
+        };
+        
+        // A new block, called with the list locked when none is free
+        typedef Block* (*Factory)();
+        
+        static ThreadBlocks* create(Factory factory);
+        
+        // Block of calling thread
+        Block* get();
+        
+        // Blocks of all threads, newest first, walked with mutex() locked
+        Block* head();
+        IceUtil::Mutex& mutex();
+        
+    private:
+        ThreadBlocks(Factory factory);
+        ~ThreadBlocks();
+        
+        // A thread exits, its block is free
+        static void release(void* block);
+        
+        Factory _factory;
+        Block* _blocks;
+        IceUtil::Mutex _mutex;
+        
+    #ifdef _WIN32
+        DWORD _key;
+    #else
+        pthread_key_t _key;
+    #endif
+    };
+}
+
+#endif
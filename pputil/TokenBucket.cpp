@@ -0,0 +1,126 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "TokenBucket.h"
+
+namespace pputil 
+{
+    
+    TokenBucket::TokenBucket(uint64_t rate, uint64_t burst)
+    : _rate(0)
+    , _burst(0)
+    , _tokens(0)
+    , _last(0)
+    {
+        setRate(rate, burst);
+    }
+    
+    TokenBucket::~TokenBucket()
+    {
+        
+    }
+    
+    void TokenBucket::setRate(uint64_t rate, uint64_t burst)
+    {
+        _rate = rate;
+        _burst = burst > 0 ? burst : 1;
+        _tokens = static_cast<double>(_burst);
+        _last = 0;
+    }
+    
+    uint64_t TokenBucket::rate() const
+    {
+        return _rate;
+    }
+    
+    uint64_t TokenBucket::burst() const
+    {
+        return _burst;
+    }
+    
+    bool TokenBucket::consume(uint64_t n, int64_t now)
+    {
+        if(_rate == 0)
+        {
+            return true;
+        }
+        
+        refill(now);
+        
+        uint64_t need = std::min(n, _burst);
+        if(_tokens < static_cast<double>(need))
+        {
+            return false;
+        }
+        
+        _tokens -= static_cast<double>(n);
+        return true;
+    }
+    
+    int64_t TokenBucket::wait(uint64_t n, int64_t now)
+    {
+        if(_rate == 0)
+        {
+            return 0;
+        }
+        
+        refill(now);
+        
+        double need = static_cast<double>(std::min(n, _burst)) - _tokens;
+        if(need <= 0)
+        {
+            return 0;
+        }
+        
+        // Round up so that the tokens are there when the caller wakes up
+        return static_cast<int64_t>(need * 1000000 / _rate) + 1;
+    }
+    
+    void TokenBucket::refill(int64_t now)
+    {
+        if(_last == 0 || now <= _last)
+        {
+            _last = _last == 0 ? now : _last;
+            return;
+        }
+        
+        _tokens += static_cast<double>(now - _last) * _rate / 1000000;
+        if(_tokens > static_cast<double>(_burst))
+        {
+            _tokens = static_cast<double>(_burst);
+        }
+        _last = now;
+    }
+    
+}
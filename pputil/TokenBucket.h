@@ -0,0 +1,79 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef PPUTIL_TOKEN_BUCKET_H
+#define PPUTIL_TOKEN_BUCKET_H
+
+#include <pputil/Config.h>
+
+namespace pputil
+{
+    //
+    // Token bucket rate limiter
+    // Tokens are refilled at rate per second, up to burst tokens
+    // A rate of 0 means no limit
+    //
+    // Time is given by caller in microseconds, so one clock reading
+    // can serve all the buckets handled in a scheduler tick
+    //
+    class PPUTIL_API TokenBucket
+    {
+    public:
+        TokenBucket(uint64_t rate = 0, uint64_t burst = 0);
+        virtual ~TokenBucket();
+        
+        // Change rate and burst, the bucket starts full
+        void setRate(uint64_t rate, uint64_t burst);
+        uint64_t rate() const;
+        uint64_t burst() const;
+        
+        // Take n tokens if available at time now
+        // A request larger than burst is granted when the bucket is full,
+        // and the debt is paid by following refills
+        bool consume(uint64_t n, int64_t now);
+        
+        // Microseconds to wait from now until n tokens are available
+        int64_t wait(uint64_t n, int64_t now);
+        
+    protected:
+        void refill(int64_t now);
+        
+        uint64_t _rate;     // Tokens per second
+        uint64_t _burst;    // Capacity of the bucket
+        double _tokens;     // Tokens available, negative for debt
+        int64_t _last;      // Time of last refill
+    };
+}
+
+#endif
@@ -0,0 +1,238 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "Trace.h"
+#include "ThreadBlocks.h"
+#include <IceUtil/Mutex.h>
+#include <IceUtil/Time.h>
+#include <IceUtil/Thread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   include <x86intrin.h>
+#   define PP_HAVE_TSC
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#   include <intrin.h>
+#   define PP_HAVE_TSC
+#endif
+
+namespace pputil
+{
+    int Trace::_enabled = 0;
+    
+    namespace
+    {
+        // Spans of a thread, written by the thread only
+        struct Ring : public ThreadBlocks::Block
+        {
+            enum { CAPACITY = 4096 };
+            
+            struct Span
+            {
+                const char* name;
+                uint64_t begin;
+                uint64_t end;
+            };
+            
+            Span spans[CAPACITY];
+            uint64_t count;     // Spans recorded, the last CAPACITY are kept
+            int tid;
+        };
+        
+        // Rings and clock of the process, kept as long as the rings
+        struct State
+        {
+            State();
+            
+            ThreadBlocks* rings;
+            int tids;           // Counted with rings locked
+            
+            // Clock, ticks at a time, and ticks per microsecond
+            IceUtil::Mutex mutex;
+            uint64_t baseTicks;
+            int64_t baseTime;
+            double ticksPerMicro;
+        };
+        
+        static ThreadBlocks::Block* newRing();
+        
+        State::State()
+        : rings(ThreadBlocks::create(&newRing))
+        , tids(0)
+        , baseTicks(0)
+        , baseTime(0)
+        , ticksPerMicro(1000)
+        {
+        }
+        
+        static State& state()
+        {
+            static State* s = new State();
+            return *s;
+        }
+        
+        static ThreadBlocks::Block* newRing()
+        {
+            Ring* r = new Ring();
+            r->count = 0;
+            r->tid = ++state().tids;
+            return r;
+        }
+        
+        static int64_t micros()
+        {
+            return IceUtil::Time::now(IceUtil::Time::Monotonic).toMicroSeconds();
+        }
+        
+        // Ring of calling thread, taken on its first span
+        static Ring* ring()
+        {
+            return static_cast<Ring*>(state().rings->get());
+        }
+    }
+    
+    uint64_t Trace::now()
+    {
+    #ifdef PP_HAVE_TSC
+        return __rdtsc();
+    #else
+        return (uint64_t)micros() * 1000;
+    #endif
+    }
+    
+    // Rate of the counter is measured over a short while when enabled
+    void Trace::enable(bool enable)
+    {
+        State& s = state();
+        if(enable && !enabled())
+        {
+            IceUtil::Mutex::Lock lock(s.mutex);
+            s.baseTicks = now();
+            s.baseTime = micros();
+        #ifdef PP_HAVE_TSC
+            IceUtil::ThreadControl::sleep(IceUtil::Time::milliSeconds(10));
+            s.ticksPerMicro = (double)(now() - s.baseTicks) / (double)std::max(micros() - s.baseTime, (int64_t)1);
+        #endif
+        }
+        
+        store(&_enabled, enable ? 1 : 0);
+    }
+    
+    void Trace::record(const char* name, uint64_t begin, uint64_t end)
+    {
+        Ring* r = ring();
+        uint64_t count = r->count;
+        Ring::Span& span = r->spans[count % Ring::CAPACITY];
+        span.name = name;
+        span.begin = begin;
+        span.end = end;
+        
+        storeRelease(&r->count, count + 1);
+    }
+    
+    static std::string jsonString(const char* s)
+    {
+        std::string json = "\"";
+        for(; *s != '\0'; ++s)
+        {
+            if(*s == '"' || *s == '\\')
+            {
+                json += '\\';
+            }
+            json += *s;
+        }
+        return json + "\"";
+    }
+    
+    // Complete events ("ph":"X") in microseconds since tracing was enabled
+    std::string Trace::json()
+    {
+        State& s = state();
+        IceUtil::Mutex::Lock lock(s.mutex);
+        IceUtil::Mutex::Lock ringsLock(s.rings->mutex());
+        
+        std::ostringstream oss;
+        oss.setf(std::ios::fixed);
+        oss.precision(3);
+        oss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        
+        bool first = true;
+        for(ThreadBlocks::Block* b = s.rings->head(); b != NULL; b = b->next)
+        {
+            const Ring* r = static_cast<const Ring*>(b);
+            uint64_t count = loadAcquire(&r->count);
+            uint64_t from = count > Ring::CAPACITY ? count - Ring::CAPACITY : 0;
+            
+            std::vector<Ring::Span> spans;
+            spans.reserve((size_t)(count - from));
+            for(uint64_t i = from; i < count; ++i)
+            {
+                spans.push_back(r->spans[i % Ring::CAPACITY]);
+            }
+            
+            // Spans overwritten while they were copied are left out
+            uint64_t now = loadAcquire(&r->count);
+            size_t skip = now > from + Ring::CAPACITY ? (size_t)std::min(now - from - Ring::CAPACITY, (uint64_t)spans.size()) : 0;
+            
+            for(size_t i = skip; i < spans.size(); ++i)
+            {
+                const Ring::Span& span = spans[i];
+                if(span.begin < s.baseTicks)
+                {
+                    continue;
+                }
+                
+                oss << (first ? "" : ",") << "\n"
+                    << "{\"name\":" << jsonString(span.name)
+                    << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << r->tid
+                    << ",\"ts\":" << (double)(span.begin - s.baseTicks) / s.ticksPerMicro
+                    << ",\"dur\":" << (double)(span.end - span.begin) / s.ticksPerMicro
+                    << "}";
+                first = false;
+            }
+        }
+        
+        oss << "\n]}\n";
+        return oss.str();
+    }
+    
+    void Trace::clear()
+    {
+        State& s = state();
+        IceUtil::Mutex::Lock lock(s.mutex);
+        
+        // Counts are reset by writers only, spans before now are skipped
+        s.baseTicks = now();
+        s.baseTime = micros();
+    }
+}
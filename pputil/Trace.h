@@ -0,0 +1,114 @@
+// **********************************************************************
+// 
+// Copyright (c) 2010, The PPEngine project authors.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef PPUTIL_TRACE_H
+#define PPUTIL_TRACE_H
+
+#include <pputil/Config.h>
+#include <pputil/Atomic.h>
+
+namespace pputil
+{
+    //
+    // Tracing of spans, e.g. stages of handling a request
+    // Spans are recorded with CPU timestamp counter ticks into a ring 
+    // of the calling thread, the oldest are overwritten when it is full
+    // When tracing is disabled a span costs a check of a flag
+    //
+    // Dump gives the spans in Chrome trace event format, to be loaded 
+    // by chrome://tracing or https://ui.perfetto.dev
+    //
+    class PPUTIL_API Trace
+    {
+    public:
+        // Disabled by default
+        static void enable(bool enable);
+        
+        static bool enabled()
+        {
+            return load(&_enabled) != 0;
+        }
+        
+        // Ticks of timestamp counter, or nanoseconds of monotonic clock 
+        // where there is no counter
+        static uint64_t now();
+        
+        // A span of name, from begin to end ticks
+        // Name must be a literal, it is kept as a pointer
+        static void record(const char* name, uint64_t begin, uint64_t end);
+        
+        // Spans of all threads as Chrome trace JSON
+        // Spans being recorded meanwhile may be missed
+        static std::string json();
+        
+        // Forget spans recorded so far
+        static void clear();
+        
+    private:
+        static int _enabled;
+    };
+    
+    //
+    // Span of a scope
+    //
+    class TraceSpan
+    {
+    public:
+        TraceSpan(const char* name)
+        : _name(Trace::enabled() ? name : NULL)
+        , _begin(_name != NULL ? Trace::now() : 0)
+        {
+        }
+        
+        ~TraceSpan()
+        {
+            if(_name != NULL)
+            {
+                Trace::record(_name, _begin, Trace::now());
+            }
+        }
+        
+    private:
+        const char* _name;
+        uint64_t _begin;
+    };
+}
+
+#define PP_TRACE_CONCAT2(a, b) a##b
+#define PP_TRACE_CONCAT(a, b) PP_TRACE_CONCAT2(a, b)
+
+// Trace the rest of the scope as a span
+#define PP_TRACE_SPAN(name) pputil::TraceSpan PP_TRACE_CONCAT(ppTraceSpan, __LINE__)(name)
+
+#endif
@@ -0,0 +1,768 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "LoadGenerator.h"
+#include <IceUtil/Time.h>
+#include <pputil/Logger.h>
+
+#ifndef _WIN32
+#   include <poll.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/uio.h>
+#endif
+
+namespace rtsp
+{
+    
+    static int64_t now()
+    {
+        return IceUtil::Time::now(IceUtil::Time::Monotonic).toMicroSeconds();
+    }
+    
+    //
+    // A client of the generator, state of its round and its sockets
+    //
+    class LoadGenerator::Client : public RtspClient
+    {
+    public:
+        Client(LoadGenerator* generator)
+        : generator(generator)
+        , step(IDLE)
+        , track(0)
+        , deadline(0)
+        , holdEnd(0)
+        , rounds(0)
+        , waiting(false)
+        , failed(false)
+        , connected(false)
+        , chunk(0)
+        , offset(0)
+        , blocked(false)
+        {
+        }
+        
+        virtual ~Client()
+        {
+            for(size_t i = 0; i < udp.size(); ++i)
+            {
+                delete udp[i];
+            }
+        }
+        
+        // Last request of round sent
+        enum Step { IDLE, OPTIONS, DESCRIBE, SETUP, PLAY, HOLD, TEARDOWN, DONE };
+        
+        LoadGenerator* generator;
+        Step step;
+        size_t track;       // Tracks set up
+        int64_t deadline;   // Next round, or next keepalive
+        int64_t holdEnd;
+        int rounds;
+        bool waiting;       // Request sent and not answered
+        bool failed;
+        bool connected;
+        
+        // RTP and RTCP sockets of each track for UDP
+        std::vector<UdpSocket*> udp;
+        std::vector<unsigned short> ports;
+        
+        // Batch being written, and where
+        SendBatchPtr batch;
+        size_t chunk;
+        size_t offset;
+        bool blocked;
+        
+    protected:
+        
+        // Called by reactor thread while it is reading
+        virtual void onReply(const char* method, RtspResponse* msg, int64_t latency)
+        {
+            int code = msg->code();
+            generator->record(method, code, latency);
+            
+            waiting = false;
+            if(code < 200 || code >= 300)
+            {
+                failed = true;
+            }
+        }
+    };
+    
+    //
+    // LoadGenerator
+    //
+    
+    LoadGenerator::Scenario::Scenario()
+    : host("127.0.0.1")
+    , port(554)
+    , options(true)
+    , describe(true)
+    , udp(false)
+    , udpPort(40000)
+    , hold(5000000)
+    , keepalive(1000000)
+    , pause(0)
+    , rounds(1)
+    {
+    }
+    
+    LoadGenerator::Report::Report()
+    : requests(0)
+    , errors(0)
+    , rounds(0)
+    , connected(0)
+    , packets(0)
+    , bytes(0)
+    , elapsed(0)
+    {
+    }
+    
+    std::string LoadGenerator::Report::str() const
+    {
+        std::ostringstream oss;
+        double seconds = elapsed > 0 ? elapsed / 1000000.0 : 1;
+        
+        oss << "clients " << connected << ", rounds " << rounds 
+            << ", requests " << requests << ", errors " << errors << "\n";
+        oss << "rtp " << packets << " packets (" << (uint64_t)(packets / seconds) << "/s), "
+            << bytes << " bytes (" << (uint64_t)(bytes * 8 / seconds) << " bit/s)\n";
+        
+        for(std::map<std::string, LatencyHistogram>::const_iterator it = latency.begin(); it != latency.end(); ++it)
+        {
+            const LatencyHistogram& h = it->second;
+            oss << it->first << ": " << h.count() << " requests, us mean " << h.mean() 
+                << " p50 " << h.percentile(50) << " p90 " << h.percentile(90) 
+                << " p99 " << h.percentile(99) << " max " << h.max() << "\n";
+        }
+        return oss.str();
+    }
+    
+    LoadGenerator::LoadGenerator()
+    : _connected(0)
+    , _nextPort(0)
+    , _rampRate(0)
+    , _started(0)
+    , _stopping(false)
+    , _running(false)
+    {
+        _wakeFd[0] = -1;
+        _wakeFd[1] = -1;
+    }
+    
+    LoadGenerator::~LoadGenerator()
+    {
+        stop();
+    }
+    
+    bool LoadGenerator::start(const Scenario& scenario, size_t clients, size_t rampRate)
+    {
+        IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_monitor);
+        if(_running || _thread)
+        {
+            return false;
+        }
+        
+    #ifdef _WIN32
+        return false;
+    #else
+        // Clients queuing requests write to the pipe
+        if(pipe(_wakeFd) != 0)
+        {
+            return false;
+        }
+        fcntl(_wakeFd[0], F_SETFL, O_NONBLOCK);
+        fcntl(_wakeFd[1], F_SETFL, O_NONBLOCK);
+    #endif
+        
+        _scenario = scenario;
+        if(_scenario.tracks.empty())
+        {
+            _scenario.tracks.push_back("video");
+        }
+        
+        for(size_t i = 0; i < clients; ++i)
+        {
+            _clients.push_back(new Client(this));
+        }
+        _connected = 0;
+        _nextPort = _scenario.udpPort;
+        _rampRate = rampRate;
+        _started = now();
+        _stopping = false;
+        _report = Report();
+        
+        try
+        {
+            _thread = new ReactorThread(this);
+            _thread->start();
+        }
+        catch(IceUtil::ThreadSyscallException& ex)
+        {
+            PP_LOG_ERROR("Start load generator failed: {}", ex.what());
+            _thread = 0;
+            return false;
+        }
+        
+        _running = true;
+        return true;
+    }
+    
+    void LoadGenerator::wait()
+    {
+        IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_monitor);
+        while(_running)
+        {
+            _monitor.wait();
+        }
+    }
+    
+    void LoadGenerator::stop()
+    {
+        ReactorThreadPtr thread;
+        {
+            IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_monitor);
+            _stopping = true;
+            thread = _thread;
+            _thread = 0;
+        }
+        
+        if(thread)
+        {
+            thread->getThreadControl().join();
+        }
+        
+        for(size_t i = 0; i < _clients.size(); ++i)
+        {
+            delete _clients[i];
+        }
+        _clients.clear();
+        
+    #ifndef _WIN32
+        for(int i = 0; i < 2; ++i)
+        {
+            if(_wakeFd[i] >= 0)
+            {
+                ::close(_wakeFd[i]);
+                _wakeFd[i] = -1;
+            }
+        }
+    #endif
+    }
+    
+    bool LoadGenerator::running()
+    {
+        IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_monitor);
+        return _running;
+    }
+    
+    LoadGenerator::Report LoadGenerator::report()
+    {
+        IceUtil::Mutex::Lock lock(_statsMutex);
+        Report report = _report;
+        report.elapsed = now() - _started;
+        return report;
+    }
+    
+    void LoadGenerator::record(const char* method, int code, int64_t latency)
+    {
+        IceUtil::Mutex::Lock lock(_statsMutex);
+        _report.latency[method].add(latency);
+        if(code < 200 || code >= 300)
+        {
+            _report.errors++;
+        }
+    }
+    
+    // One pass of the reactor, return false when it is done
+    bool LoadGenerator::loop()
+    {
+    #ifdef _WIN32
+        return false;
+    #else
+        {
+            IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_monitor);
+            if(_stopping)
+            {
+                _running = false;
+                _monitor.notifyAll();
+                return false;
+            }
+        }
+        
+        int64_t t = now();
+        connectClients(t);
+        
+        // Next requests of clients, and queued data
+        bool done = _connected == _clients.size();
+        for(size_t i = 0; i < _connected; ++i)
+        {
+            Client* c = _clients[i];
+            if(c->connected)
+            {
+                advance(c, t);
+                flush(c);
+            }
+            done = done && c->step == Client::DONE;
+        }
+        
+        if(done)
+        {
+            IceUtil::Monitor<IceUtil::Mutex>::Lock lock(_monitor);
+            _running = false;
+            _monitor.notifyAll();
+            return false;
+        }
+        
+        // Sockets of connected clients, with the socket index of UDP
+        std::vector<struct pollfd> fds;
+        std::vector<std::pair<Client*, int> > owners;
+        
+        struct pollfd wake;
+        wake.fd = _wakeFd[0];
+        wake.events = POLLIN;
+        wake.revents = 0;
+        fds.push_back(wake);
+        owners.push_back(std::make_pair((Client*)NULL, -1));
+        
+        for(size_t i = 0; i < _connected; ++i)
+        {
+            Client* c = _clients[i];
+            if(!c->connected)
+            {
+                continue;
+            }
+            
+            struct pollfd pfd;
+            pfd.fd = c->fd();
+            pfd.events = POLLIN | (c->blocked ? POLLOUT : 0);
+            pfd.revents = 0;
+            fds.push_back(pfd);
+            owners.push_back(std::make_pair(c, -1));
+            
+            for(size_t k = 0; k < c->udp.size(); ++k)
+            {
+                pfd.fd = c->udp[k]->m_socket;
+                pfd.events = POLLIN;
+                fds.push_back(pfd);
+                owners.push_back(std::make_pair(c, (int)k));
+            }
+        }
+        
+        // Timers (keepalive, hold, ramp) are checked every 10ms
+        int n = poll(&fds[0], fds.size(), 10);
+        if(n <= 0)
+        {
+            return true;
+        }
+        
+        UdpBatch batch;
+        for(size_t i = 0; i < fds.size(); ++i)
+        {
+            if(fds[i].revents == 0)
+            {
+                continue;
+            }
+            
+            Client* c = owners[i].first;
+            int k = owners[i].second;
+            if(c == NULL)
+            {
+                char drain[256];
+                while(::read(_wakeFd[0], drain, sizeof(drain)) > 0)
+                {
+                }
+            }
+            else if(k >= 0)
+            {
+                // RTP on even sockets, RTCP of server is dropped
+                while(c->udp[k]->receive(batch) > 0)
+                {
+                    if(k % 2 != 0)
+                    {
+                        continue;
+                    }
+                    
+                    uint64_t bytes = 0;
+                    for(size_t j = 0; j < batch.count(); ++j)
+                    {
+                        bytes += batch.size(j);
+                    }
+                    
+                    IceUtil::Mutex::Lock lock(_statsMutex);
+                    _report.packets += batch.count();
+                    _report.bytes += bytes;
+                }
+            }
+            else
+            {
+                if(fds[i].revents & POLLOUT)
+                {
+                    flush(c);
+                }
+                if(c->connected && (fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                {
+                    input(c);
+                }
+            }
+        }
+        return true;
+    #endif
+    }
+    
+    // Connect clients due by ramp rate, and bind their UDP ports
+    void LoadGenerator::connectClients(int64_t t)
+    {
+        size_t due = _clients.size();
+        if(_rampRate > 0)
+        {
+            due = std::min(due, (size_t)((t - _started) * _rampRate / 1000000) + 1);
+        }
+        
+        while(_connected < due)
+        {
+            Client* c = _clients[_connected++];
+            
+            bool ok = c->connect(_scenario.host, _scenario.port, false) && c->attach(_wakeFd[1]);
+            
+            // A pair of ports for each track, from the next free pair
+            unsigned short& next = _nextPort;
+            for(size_t i = 0; ok && _scenario.udp && i < _scenario.tracks.size(); ++i)
+            {
+                UdpSocket* rtp = new UdpSocket();
+                UdpSocket* rtcp = new UdpSocket();
+                while(next < 65534 && !(rtp->init(next) && rtcp->init(next + 1)))
+                {
+                    rtp->close();
+                    rtcp->close();
+                    next += 2;
+                }
+                
+                c->udp.push_back(rtp);
+                c->udp.push_back(rtcp);
+                c->ports.push_back(next);
+                ok = next < 65534;
+                next += 2;
+            }
+            
+            if(!ok)
+            {
+                c->step = Client::DONE;
+                
+                IceUtil::Mutex::Lock lock(_statsMutex);
+                _report.errors++;
+                continue;
+            }
+            
+            c->connected = true;
+            c->step = Client::IDLE;
+            c->deadline = t;
+            
+            IceUtil::Mutex::Lock lock(_statsMutex);
+            _report.connected++;
+        }
+    }
+    
+    // Send next request of the round, if the last one is answered
+    void LoadGenerator::advance(Client* c, int64_t t)
+    {
+        std::ostringstream oss;
+        oss << "rtsp://" << _scenario.host << ":" << _scenario.port << "/" << _scenario.mid;
+        std::string url = oss.str();
+        
+        while(c->connected && !c->waiting && c->step != Client::DONE)
+        {
+            int cseq = 0;
+            bool ended = false;
+            
+            if(c->failed)
+            {
+                // Session is torn down before round ends
+                c->failed = false;
+                if(c->step != Client::TEARDOWN && !c->session().empty())
+                {
+                    c->step = Client::TEARDOWN;
+                    cseq = c->teardown(url);
+                }
+                else
+                {
+                    ended = true;
+                }
+            }
+            else switch(c->step)
+            {
+                case Client::IDLE:
+                    if(t < c->deadline)
+                    {
+                        return;
+                    }
+                    c->step = Client::OPTIONS;
+                    cseq = _scenario.options ? c->options(url) : 0;
+                    break;
+                    
+                case Client::OPTIONS:
+                    c->step = Client::DESCRIBE;
+                    cseq = _scenario.describe ? c->describe(url) : 0;
+                    break;
+                    
+                case Client::DESCRIBE:
+                    c->step = Client::SETUP;
+                    c->track = 0;
+                    break;
+                    
+                case Client::SETUP:
+                    if(c->track < _scenario.tracks.size())
+                    {
+                        size_t i = c->track++;
+                        std::ostringstream transport;
+                        if(_scenario.udp)
+                        {
+                            transport << "RTP/AVP;unicast;client_port=" << c->ports[i] << "-" << c->ports[i] + 1;
+                        }
+                        else
+                        {
+                            transport << "RTP/AVP/TCP;unicast;interleaved=" << 2 * i << "-" << 2 * i + 1;
+                        }
+                        cseq = c->setup(url + "/" + _scenario.tracks[i], transport.str());
+                    }
+                    else
+                    {
+                        c->step = Client::PLAY;
+                        cseq = c->play(url);
+                    }
+                    break;
+                    
+                case Client::PLAY:
+                    c->step = Client::HOLD;
+                    c->holdEnd = t + _scenario.hold;
+                    c->deadline = _scenario.keepalive > 0 ? t + _scenario.keepalive : c->holdEnd;
+                    break;
+                    
+                case Client::HOLD:
+                    if(t >= c->holdEnd)
+                    {
+                        c->step = Client::TEARDOWN;
+                        cseq = c->teardown(url);
+                    }
+                    else if(_scenario.keepalive > 0 && t >= c->deadline)
+                    {
+                        c->deadline = t + _scenario.keepalive;
+                        cseq = c->getParameter(url);
+                    }
+                    else
+                    {
+                        return;
+                    }
+                    break;
+                    
+                case Client::TEARDOWN:
+                    ended = true;
+                    break;
+                    
+                default:
+                    return;
+            }
+            
+            if(cseq < 0)
+            {
+                c->failed = true;
+                
+                IceUtil::Mutex::Lock lock(_statsMutex);
+                _report.errors++;
+            }
+            else if(cseq > 0)
+            {
+                c->waiting = true;
+                
+                IceUtil::Mutex::Lock lock(_statsMutex);
+                _report.requests++;
+            }
+            
+            if(ended)
+            {
+                c->rounds++;
+                c->step = _scenario.rounds > 0 && c->rounds >= _scenario.rounds ? Client::DONE : Client::IDLE;
+                c->deadline = t + _scenario.pause;
+                
+                IceUtil::Mutex::Lock lock(_statsMutex);
+                _report.rounds++;
+            }
+        }
+    }
+    
+    // Write queued requests without blocking
+    void LoadGenerator::flush(Client* c)
+    {
+    #ifndef _WIN32
+        while(c->connected)
+        {
+            if(!c->batch && !c->ringTake(c->batch))
+            {
+                c->blocked = false;
+                return;
+            }
+            
+            std::vector<pputil::TcpConnection::SendChunk>& chunks = c->batch->chunks;
+            struct iovec iov[64];
+            size_t count = 0;
+            size_t skip = c->offset;
+            for(size_t i = c->chunk; i < chunks.size() && count + 2 <= 64; ++i)
+            {
+                pputil::TcpConnection::SendChunk& chunk = chunks[i];
+                size_t bodyLen = chunk.body ? chunk.body->size() : 0;
+                
+                if(skip < chunk.headLen)
+                {
+                    iov[count].iov_base = chunk.head + skip;
+                    iov[count].iov_len = chunk.headLen - skip;
+                    count++;
+                    skip = 0;
+                }
+                else
+                {
+                    skip -= chunk.headLen;
+                }
+                
+                if(skip < bodyLen)
+                {
+                    iov[count].iov_base = chunk.body->data() + skip;
+                    iov[count].iov_len = bodyLen - skip;
+                    count++;
+                }
+                skip = 0;
+            }
+            
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            
+        #ifdef MSG_NOSIGNAL
+            ssize_t n = sendmsg(c->fd(), &msg, MSG_NOSIGNAL);
+        #else
+            ssize_t n = sendmsg(c->fd(), &msg, 0);
+        #endif
+            if(n < 0)
+            {
+                if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                {
+                    c->blocked = errno != EINTR;
+                    return;
+                }
+                drop(c);
+                return;
+            }
+            c->ringSent(n);
+            
+            // Skip what is written
+            size_t left = n;
+            while(c->chunk < chunks.size())
+            {
+                pputil::TcpConnection::SendChunk& chunk = chunks[c->chunk];
+                size_t len = chunk.headLen + (chunk.body ? chunk.body->size() : 0);
+                if(c->offset + left < len)
+                {
+                    c->offset += left;
+                    break;
+                }
+                left -= len - c->offset;
+                c->offset = 0;
+                c->chunk++;
+            }
+            
+            if(c->chunk == chunks.size())
+            {
+                c->batch = 0;
+                c->chunk = 0;
+                c->offset = 0;
+            }
+        }
+    #endif
+    }
+    
+    // Read responses and interleaved data
+    void LoadGenerator::input(Client* c)
+    {
+    #ifndef _WIN32
+        pputil::byte buf[64 * 1024];
+        while(c->connected)
+        {
+            ssize_t n = ::recv(c->fd(), buf, sizeof(buf), 0);
+            if(n > 0)
+            {
+                uint64_t packets = c->packets();
+                uint64_t bytes = c->bytes();
+                c->ringReceive(buf, n);
+                
+                if(c->packets() != packets)
+                {
+                    IceUtil::Mutex::Lock lock(_statsMutex);
+                    _report.packets += c->packets() - packets;
+                    _report.bytes += c->bytes() - bytes;
+                }
+            }
+            else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                return;
+            }
+            else if(n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else
+            {
+                drop(c);
+                return;
+            }
+        }
+    #endif
+    }
+    
+    // Server closed the connection or it failed, client is done
+    void LoadGenerator::drop(Client* c)
+    {
+        c->ringClosed();
+        c->connected = false;
+        c->batch = 0;
+        
+        if(c->step != Client::DONE)
+        {
+            c->step = Client::DONE;
+            
+            IceUtil::Mutex::Lock lock(_statsMutex);
+            _report.errors++;
+        }
+    }
+
+}
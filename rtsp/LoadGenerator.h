@@ -0,0 +1,165 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_LOAD_GENERATOR_H
+#define RTSP_LOAD_GENERATOR_H
+
+#include <rtsp/RtspClient.h>
+#include <rtsp/UdpSocket.h>
+#include <pputil/Histogram.h>
+#include <IceUtil/Thread.h>
+
+namespace rtsp
+{
+    //
+    // Latency histogram, in microseconds
+    //
+    typedef pputil::Histogram LatencyHistogram;
+    
+    //
+    // Load generator, many RtspClients driven by one thread
+    // Each client runs rounds of a scenario: OPTIONS, DESCRIBE, SETUP 
+    // of tracks over interleaved channels or UDP, PLAY, GET_PARAMETER 
+    // keepalives while the media is held, then TEARDOWN
+    // Latency of requests is kept by method, and RTP received is counted
+    //
+    class LoadGenerator
+    {
+    public:
+        LoadGenerator();
+        ~LoadGenerator();
+        
+        struct Scenario
+        {
+            Scenario();
+            
+            std::string host;
+            unsigned short port;
+            std::string mid;
+            std::vector<std::string> tracks;    // "video" if none
+            
+            bool options;
+            bool describe;
+            
+            // RTP over UDP to ports from udpPort, or interleaved
+            bool udp;
+            unsigned short udpPort;
+            
+            int64_t hold;       // Microseconds from PLAY to TEARDOWN
+            int64_t keepalive;  // Microseconds between GET_PARAMETER, 0 for none
+            int64_t pause;      // Microseconds between rounds
+            int rounds;         // Rounds of each client, 0 to run until stop()
+        };
+        
+        // Start clients on a thread, connecting rampRate a second 
+        // (0 for all at once)
+        bool start(const Scenario& scenario, size_t clients, size_t rampRate = 0);
+        
+        // Wait for clients to finish their rounds, or stop them
+        void wait();
+        void stop();
+        bool running();
+        
+        struct Report
+        {
+            Report();
+            
+            std::map<std::string, LatencyHistogram> latency;    // By method
+            uint64_t requests;
+            uint64_t errors;    // Failed connects and requests, non 2xx replies
+            uint64_t rounds;
+            uint64_t connected;
+            uint64_t packets;   // RTP received
+            uint64_t bytes;
+            int64_t elapsed;    // Microseconds since start
+            
+            std::string str() const;
+        };
+        
+        Report report();
+        
+    private:
+        class Client;
+        friend class Client;
+        
+        // Reactor
+        bool loop();
+        void connectClients(int64_t now);
+        void flush(Client* client);
+        void input(Client* client);
+        void drop(Client* client);
+        void advance(Client* client, int64_t now);
+        
+        // From clients, with _statsMutex locked
+        void record(const char* method, int code, int64_t latency);
+        
+        Scenario _scenario;
+        std::vector<Client*> _clients;
+        size_t _connected;
+        unsigned short _nextPort;
+        size_t _rampRate;
+        int64_t _started;
+        int _wakeFd[2];
+        bool _stopping;
+        
+        Report _report;
+        IceUtil::Mutex _statsMutex;
+        
+        class ReactorThread : public IceUtil::Thread
+        {
+        public:
+            ReactorThread(LoadGenerator* generator)
+            : _generator(generator)
+            {
+            }
+            
+            virtual void run()
+            {
+                while(_generator->loop())
+                {
+                }
+            }
+            
+        private:
+            LoadGenerator* _generator;
+        };
+        
+        typedef IceUtil::Handle<ReactorThread> ReactorThreadPtr;
+        ReactorThreadPtr _thread;
+        IceUtil::Monitor<IceUtil::Mutex> _monitor;
+        bool _running;
+    };
+}
+
+#endif
@@ -1,430 +1,599 @@
-// **********************************************************************
-//
-// Copyright (c) 2011, PPEngine
-// 
-// Redistribution and use in source and binary forms, with or without
-// modification, are permitted provided that the following conditions are
-// met:
-// 
-//   * Redistributions of source code must retain the above copyright
-//     notice, this list of conditions and the following disclaimer.
-// 
-//   * Redistributions in binary form must reproduce the above copyright
-//     notice, this list of conditions and the following disclaimer in
-//     the documentation and/or other materials provided with the
-//     distribution.
-// 
-//   * Neither the name of Google nor the names of its contributors may
-//     be used to endorse or promote products derived from this software
-//     without specific prior written permission.
-// 
-// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
-// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
-// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
-// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
-// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
-// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
-// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
-// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-// 
-// **********************************************************************
-
-#include "RtspMessage.h"
-
-namespace rtsp
-{
-
-    MessageHeader::MessageHeader(const std::string& key)
-    : _key(key)
-    {
-
-    }
-
-    MessageHeader::MessageHeader(const std::string& key, const std::string& value)
-    : _key(key)
-    , _value(value)
-    {
-
-    }
-
-    std::string MessageHeader::key() const
-    {
-        return _key;
-    }
-
-    std::string MessageHeader::value() const
-    {
-        return _value;
-    }
-
-    void MessageHeader::setValue(const std::string& value)
-    {
-       _value = value;
-    }
-
-    /////////////////////////////////////////////////////////////////////////
-
-    Message::Message() 
-    {
-        _protocol = "HTTP";
-        _version = "1.0";
-        _bodyLen = 0;
-        _body = NULL;
-    }
-
-    Message::Message(const std::string& version)
-    {
-        _protocol = "HTTP";
-        _version = version;
-        _bodyLen = 0;
-        _body = NULL;
-    }
-
-    Message::~Message()
-    {
-        for(MessageHeaderSeq::iterator it = _headers.begin(); it != _headers.end(); ++it)
-        {
-            MessageHeader* pHeader = *it;
-            if(pHeader != NULL)
-            {
-                delete pHeader;
-            }
-        }
-        _headers.clear();
-
-        if(_body != NULL)
-        {
-            delete[] _body; 
-            _body = NULL;
-            _bodyLen = 0;
-        }
-    }
-
-    MESSAGE_TYPE Message::type() const
-    {
-        return UNKNOWN_MESSAGE;
-    }
-
-    std::string Message::version() const
-    {
-        return _version;
-    }
-
-    void Message::setVersion(const std::string& version)
-    {
-        _version = version;
-    }
-
-    std::string Message::header(const std::string& key) const
-    {
-        std::string value;
-        MessageHeaderSeq::const_iterator it(_headers.begin());
-        while(it != _headers.end())
-        {
-            MessageHeader* pHeader = *it;
-            if(key == pHeader->key())
-            {
-                value = pHeader->value();
-                break;
-            }
-            ++it;
-        }
-
-        return value;
-    }
-
-    void Message::setHeader(const std::string& key, const std::string& value)
-    {
-        MessageHeaderSeq::iterator it(_headers.begin());
-        while(it != _headers.end())
-        {
-            MessageHeader* pHeader = *it;
-            if(key == pHeader->key())
-            {
-                pHeader->setValue(value);
-                return;
-            }
-            ++it;
-        }
-
-        _headers.push_back(new MessageHeader(key, value));
-    }
-
-    void Message::setHeader(const MessageHeader& header)
-    {
-        MessageHeaderSeq::iterator it(_headers.begin());
-        while(it != _headers.end())
-        {
-            MessageHeader* pHeader = *it;
-            if(header.key() == pHeader->key())
-            {
-                pHeader->setValue(header.value());
-                return;
-            }
-            ++it;
-        }
-
-        _headers.push_back(new MessageHeader(header));
-    }
-
-    void Message::removeHeader(const std::string&key) 
-    {
-        MessageHeaderSeq::iterator it(_headers.begin());
-        while(it != _headers.end())
-        {
-            MessageHeader* pHeader = *it;
-            if(key == pHeader->key())
-            {
-                it = _headers.erase(it);
-            }
-            else
-            {
-                ++it;
-            }
-        }
-    }
-
-    size_t Message::headerLen() const
-    {
-        size_t nLen = 0;
-        MessageHeaderSeq::const_iterator it(_headers.begin());
-        while(it != _headers.end())
-        {
-            MessageHeader* pHeader = *it;
-            if(pHeader != NULL)
-            {
-                nLen += (pHeader->key().size() + 2 + pHeader->value().size() + 2);
-            }
-            ++it;
-        }
-
-        return nLen;
-    }
-
-    size_t Message::headerCount() const
-    {
-        return _headers.size();
-    }
-
-    MessageHeader* Message::header(size_t index) const
-    {
-        if(index >= _headers.size())
-        {
-            return NULL;
-        }
-
-        return _headers.at(index);
-    }
-
-    size_t Message::bodyLen() const
-    {
-        return _bodyLen;
-    }
-
-    byte* Message::body() const
-    {
-        return _body;
-    }
-
-    void Message::setBody(byte* buf, size_t len)
-    {
-        if(_body != NULL)
-        {
-            delete[] _body; 
-            _body = NULL;
-        }
-
-        _bodyLen = len;
-        if(_bodyLen > 0)
-        {
-            _body = new byte[m_bodyLen];
-            memcpy(_body, buf, _bodyLen);
-        }
-    }
-
-    //////////////////////////////////////////////////////////////////////////
-
-    RequestMessage::RequestMessage() 
-    : Message()
-    {
-        _method = "GET";
-    }
-
-    RequestMessage::RequestMessage(const std::string& version) 
-    : Message(version)
-    {
-        _method = "GET";
-    }
-
-    RequestMessage::~RequestMessage()
-    {
-
-    }
-
-    MESSAGE_TYPE RequestMessage::type() const
-    {
-        return MESSAGE_REQUEST;
-    }
-
-    std::string RequestMessage::dump() const
-    {
-        // <verb> SP <url> SP <protocol/version> CRLF
-        // <headers> CRLF 
-        // <buf>
-        std::ostringstream oss;
-
-        oss << _method << " " << _url << " " << _protocol << "/" << _version << "\r\n";
-
-        for(size_t i = 0; i < headerCount(); i++)
-        {
-            MessageHeader* pHeader = header(i);
-            oss << pHeader->key() << ":" << pHeader->value() << "\r\n";
-        }
-
-        oss << "\r\n";
-
-        oss << "Body (" << _bodyLen << "bytes)\r\n";
-
-        return oss.str();
-    }
-
-    Buffer* RequestMessage::toBuffer() const
-    {
-        return NULL;
-    }
-
-    std::string RequestMessage::method() const
-    {
-        return _method;
-    }
-
-    void RequestMessage::setMehtod(const std::string& method)
-    {
-        _mehtod =  method;
-    }
-
-    std::string RequestMessage::url() const
-    {
-        return _url;
-    }
-
-    void RequestMessage::setUrl(const std::string& url)
-    {
-        _url = url;
-    }
-
-    //////////////////////////////////////////////////////////////////////////////////
-
-    ResponseMessage::ResponseMessage() 
-    : Message() 
-    {
-        _code = 0;
-    }
-
-    ResponseMessage::ResponseMessage(const std::string& version) 
-    : Message(version)
-    {
-        _code = 0;
-    }
-
-    ResponseMessage::~ResponseMessage()
-    {
-
-    }
-
-    MessageType ResponseMessage::type() const
-    {
-        return RESPONSE_MESSAGE;
-    }
-
-    std::string ResponseMessage::dump() const
-    {
-        // <protocol>/<version> code message CRLF
-        // <headers> CRLF 
-        // <buf>
-        std::ostringstream oss;
-
-        oss << _protocol << "/" << _version << " " << _code << " " << _reason << "\r\n";
-
-        for(size_t i = 0; i < headerCount(); i++)
-        {
-            MessageHeader* pHeader = header(i);
-            oss << pHeader->key() << ":" << pHeader->value() << "\r\n";
-        }
-
-        oss << "\r\n";
-
-        oss << "Body (" << _bodyLen << "bytes)" << "\r\n";
-
-        return oss.str();
-    }
-
-    Buffer* ResponseMessage::toBuffer()
-    {
-        unsigned int nCode = msg->code();
-        std::string sReason = msg->message();
-        size_t nHdrLen = msg->headerLen();
-        size_t nBufLen = msg->bufferLen();
-        
-        // "RTSP/1.0" SP <code> SP <reason> CRLF
-        // <headers> CRLF
-        // <buf> (or terminating NULL from sprintf() if no buffer)
-        size_t size = 8 + 1 + 3 + 1 + sReason.length() + 2 + nHdrLen + 2;
-        size += nBufLen != 0 ? nBufLen : 1;
-        
-        char* buf = new char[size];
-        assert(buf != NULL);
-        if(buf == NULL)
-        {
-            std::cout << "RTSPServer send response out of memory.\n";
-            return false;
-        }
-        
-        char* p = buf;
-        p += sprintf(p, "RTSP/1.0 %u %s\r\n", nCode, sReason.c_str());
-        
-        for(UINT n = 0; n < msg->headerCount(); n++ )
-        {
-            RTSPHeader* pHeader = msg->header(n);
-            p += sprintf(p, "%s: %s\r\n", pHeader->key().c_str(), pHeader->value().c_str());
-        }
-        p += sprintf(p, "\r\n");
-        
-        if( nBufLen )
-        {
-            memcpy(p, msg->buffer(), nBufLen );
-            p += nBufLen;
-        }
-        
-        m_pOutput->Add(buf, p - buf);
-        OnWrite();
-        delete[] buf;
-
-        return NULL;
-    }
-
-    int ResponseMessage::code() const
-    {
-        return _code;
-    }
-
-    std::string ResponseMessage::reason() const
-    {
-        return _reason;
-    }
-
-    void ResponseMessage::setStatus(int code, const std::string& reason)
-    {
-        _code = code;
-        _reason = reason;
-
-        if(_reason.empty())
-        {
-            _reason = code2reason(_code);
-        }
-    }
-
-}
\ No newline at end of file
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "Message.h"
+#include <ctype.h>
+#include <string.h>
+
+namespace rtsp
+{
+
+    MessageHeader::MessageHeader(const std::string& key)
+    : _key(key)
+    {
+
+    }
+
+    MessageHeader::MessageHeader(const std::string& key, const std::string& value)
+    : _key(key)
+    , _value(value)
+    {
+
+    }
+
+    const std::string& MessageHeader::key() const
+    {
+        return _key;
+    }
+
+    const std::string& MessageHeader::value() const
+    {
+        return _value;
+    }
+
+    void MessageHeader::setValue(const std::string& value)
+    {
+       _value = value;
+    }
+
+    void MessageHeader::set(const char* key, size_t keyLen, const char* value, size_t valueLen)
+    {
+        _key.assign(key, keyLen);
+        _value.assign(value, valueLen);
+    }
+
+    // Header names are case-insensitive (RFC 2326 section 4.2)
+    bool MessageHeader::is(const std::string& key) const
+    {
+        return is(key.data(), key.length());
+    }
+
+    bool MessageHeader::is(const char* key, size_t keyLen) const
+    {
+        if(_key.length() != keyLen)
+        {
+            return false;
+        }
+
+        for(size_t i = 0; i < keyLen; i++)
+        {
+            if(tolower(static_cast<unsigned char>(_key[i])) != tolower(static_cast<unsigned char>(key[i])))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+
+    Message::Message() 
+    : _protocol("HTTP")
+    , _version("1.0")
+    , _headerCount(0)
+    , _body(NULL)
+    , _bodyLen(0)
+    , _bodyCapacity(0)
+    {
+
+    }
+
+    Message::Message(const std::string& version)
+    : _protocol("HTTP")
+    , _version(version)
+    , _headerCount(0)
+    , _body(NULL)
+    , _bodyLen(0)
+    , _bodyCapacity(0)
+    {
+
+    }
+
+    Message::~Message()
+    {
+        for(MessageHeaderSeq::iterator it = _headers.begin(); it != _headers.end(); ++it)
+        {
+            MessageHeader* pHeader = *it;
+            if(pHeader != NULL)
+            {
+                delete pHeader;
+            }
+        }
+        _headers.clear();
+
+        if(_body != NULL)
+        {
+            delete[] _body; 
+            _body = NULL;
+            _bodyLen = 0;
+            _bodyCapacity = 0;
+        }
+    }
+
+    MESSAGE_TYPE Message::type() const
+    {
+        return UNKNOWN_MESSAGE;
+    }
+
+    void Message::reset()
+    {
+        _headerCount = 0;
+        _bodyLen = 0;
+        _bodyBlob = 0;
+    }
+
+    std::string Message::version() const
+    {
+        return _version;
+    }
+
+    void Message::setVersion(const std::string& version)
+    {
+        _version = version;
+    }
+
+    std::string Message::header(const std::string& key) const
+    {
+        for(size_t i = 0; i < _headerCount; i++)
+        {
+            if(_headers[i]->is(key))
+            {
+                return _headers[i]->value();
+            }
+        }
+
+        return std::string();
+    }
+
+    void Message::setHeader(const std::string& key, const std::string& value)
+    {
+        assignHeader(key.data(), key.size(), value.data(), value.size());
+    }
+
+    void Message::setHeader(const MessageHeader& header)
+    {
+        setHeader(header.key(), header.value());
+    }
+
+    void Message::setHeader(const char* key, const char* value)
+    {
+        assert(key != NULL && value != NULL);
+        assignHeader(key, strlen(key), value, strlen(value));
+    }
+
+    // Digits are written backwards from the end of the buffer
+    void Message::setHeader(const char* key, uint64_t value)
+    {
+        assert(key != NULL);
+        char digits[20];
+        size_t n = sizeof(digits);
+        do
+        {
+            digits[--n] = (char)('0' + value % 10);
+            value /= 10;
+        } while(value > 0);
+
+        assignHeader(key, strlen(key), digits + n, sizeof(digits) - n);
+    }
+
+    void Message::assignHeader(const char* key, size_t keyLen, const char* value, size_t valueLen)
+    {
+        for(size_t i = 0; i < _headerCount; i++)
+        {
+            if(_headers[i]->is(key, keyLen))
+            {
+                _headers[i]->set(key, keyLen, value, valueLen);
+                return;
+            }
+        }
+
+        nextHeader(key, keyLen, value, valueLen);
+    }
+
+    void Message::addHeader(const char* key, size_t keyLen, const char* value, size_t valueLen)
+    {
+        nextHeader(key, keyLen, value, valueLen);
+    }
+
+    // Take a spare header object, or create one
+    MessageHeader* Message::nextHeader(const char* key, size_t keyLen, const char* value, size_t valueLen)
+    {
+        if(_headerCount == _headers.size())
+        {
+            _headers.push_back(new MessageHeader(std::string()));
+        }
+
+        MessageHeader* pHeader = _headers[_headerCount++];
+        pHeader->set(key, keyLen, value, valueLen);
+        return pHeader;
+    }
+
+    // A removed header is kept as a spare
+    void Message::removeHeader(const std::string& key) 
+    {
+        size_t i = 0;
+        while(i < _headerCount)
+        {
+            if(_headers[i]->is(key))
+            {
+                MessageHeader* pHeader = _headers[i];
+                _headers.erase(_headers.begin() + i);
+                _headers.push_back(pHeader);
+                _headerCount--;
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+    size_t Message::headerLen() const
+    {
+        size_t nLen = 0;
+        for(size_t i = 0; i < _headerCount; i++)
+        {
+            MessageHeader* pHeader = _headers[i];
+            nLen += (pHeader->key().size() + 2 + pHeader->value().size() + 2);
+        }
+
+        return nLen;
+    }
+
+    size_t Message::headerCount() const
+    {
+        return _headerCount;
+    }
+
+    MessageHeader* Message::header(size_t index) const
+    {
+        if(index >= _headerCount)
+        {
+            return NULL;
+        }
+
+        return _headers[index];
+    }
+
+    size_t Message::bodyLen() const
+    {
+        return _bodyLen;
+    }
+
+    pputil::byte* Message::body() const
+    {
+        if(_bodyBlob)
+        {
+            return _bodyBlob->data();
+        }
+        return _bodyLen > 0 ? _body : NULL;
+    }
+
+    void Message::setBody(const pputil::BlobPtr& body)
+    {
+        _bodyBlob = body;
+        _bodyLen = body ? body->size() : 0;
+    }
+
+    pputil::BlobPtr Message::bodyBlob() const
+    {
+        return _bodyBlob;
+    }
+
+    void Message::setBody(const pputil::byte* buf, size_t len)
+    {
+        _bodyBlob = 0;
+
+        if(len > _bodyCapacity)
+        {
+            if(_body != NULL)
+            {
+                delete[] _body; 
+            }
+            _body = new pputil::byte[len];
+            _bodyCapacity = len;
+        }
+
+        _bodyLen = len;
+        if(_bodyLen > 0)
+        {
+            memcpy(_body, buf, _bodyLen);
+        }
+    }
+
+    size_t Message::length() const
+    {
+        return headLength() + _bodyLen;
+    }
+
+    size_t Message::serialize(pputil::byte* b) const
+    {
+        size_t n = serializeHead(b);
+        if(_bodyLen > 0)
+        {
+            memcpy(b + n, body(), _bodyLen);
+            n += _bodyLen;
+        }
+        return n;
+    }
+
+    // <key>: <value> CRLF for each header, CRLF
+    size_t Message::serializeHeaders(pputil::byte* b) const
+    {
+        pputil::byte* p = b;
+        for(size_t i = 0; i < _headerCount; i++)
+        {
+            MessageHeader* pHeader = _headers[i];
+            const std::string& key = pHeader->key();
+            const std::string& value = pHeader->value();
+
+            memcpy(p, key.data(), key.size());
+            p += key.size();
+            *p++ = ':';
+            *p++ = ' ';
+            memcpy(p, value.data(), value.size());
+            p += value.size();
+            *p++ = '\r';
+            *p++ = '\n';
+        }
+
+        *p++ = '\r';
+        *p++ = '\n';
+
+        return p - b;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+
+    RequestMessage::RequestMessage() 
+    : Message()
+    , _method("GET")
+    {
+
+    }
+
+    RequestMessage::RequestMessage(const std::string& version) 
+    : Message(version)
+    , _method("GET")
+    {
+
+    }
+
+    RequestMessage::~RequestMessage()
+    {
+
+    }
+
+    MESSAGE_TYPE RequestMessage::type() const
+    {
+        return REQUEST_MESSAGE;
+    }
+
+    void RequestMessage::reset()
+    {
+        Message::reset();
+        _method.clear();
+        _url.clear();
+    }
+
+    std::string RequestMessage::dump() const
+    {
+        // <verb> SP <url> SP <protocol/version> CRLF
+        // <headers> CRLF 
+        // <buf>
+        std::ostringstream oss;
+
+        oss << _method << " " << _url << " " << _protocol << "/" << _version << "\r\n";
+
+        for(size_t i = 0; i < headerCount(); i++)
+        {
+            MessageHeader* pHeader = header(i);
+            oss << pHeader->key() << ": " << pHeader->value() << "\r\n";
+        }
+
+        oss << "\r\n";
+
+        oss << "Body (" << _bodyLen << "bytes)\r\n";
+
+        return oss.str();
+    }
+
+    size_t RequestMessage::headLength() const
+    {
+        return _method.size() + 1 + _url.size() + 1 + _protocol.size() + 1 + _version.size() + 2 
+             + headerLen() + 2;
+    }
+
+    size_t RequestMessage::serializeHead(pputil::byte* b) const
+    {
+        pputil::byte* p = b;
+        memcpy(p, _method.data(), _method.size());
+        p += _method.size();
+        *p++ = ' ';
+        memcpy(p, _url.data(), _url.size());
+        p += _url.size();
+        *p++ = ' ';
+        memcpy(p, _protocol.data(), _protocol.size());
+        p += _protocol.size();
+        *p++ = '/';
+        memcpy(p, _version.data(), _version.size());
+        p += _version.size();
+        *p++ = '\r';
+        *p++ = '\n';
+
+        p += serializeHeaders(p);
+        return p - b;
+    }
+
+    std::string RequestMessage::method() const
+    {
+        return _method;
+    }
+
+    void RequestMessage::setMethod(const std::string& method)
+    {
+        _method = method;
+    }
+
+    void RequestMessage::setMethod(const char* method, size_t n)
+    {
+        _method.assign(method, n);
+    }
+
+    std::string RequestMessage::url() const
+    {
+        return _url;
+    }
+
+    void RequestMessage::setUrl(const std::string& url)
+    {
+        _url = url;
+    }
+
+    void RequestMessage::setUrl(const char* url, size_t n)
+    {
+        _url.assign(url, n);
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////
+
+    ResponseMessage::ResponseMessage() 
+    : Message() 
+    , _code(0)
+    {
+
+    }
+
+    ResponseMessage::ResponseMessage(const std::string& version) 
+    : Message(version)
+    , _code(0)
+    {
+
+    }
+
+    ResponseMessage::~ResponseMessage()
+    {
+
+    }
+
+    MESSAGE_TYPE ResponseMessage::type() const
+    {
+        return RESPONSE_MESSAGE;
+    }
+
+    void ResponseMessage::reset()
+    {
+        Message::reset();
+        _code = 0;
+        _reason.clear();
+    }
+
+    std::string ResponseMessage::dump() const
+    {
+        // <protocol>/<version> code message CRLF
+        // <headers> CRLF 
+        // <buf>
+        std::ostringstream oss;
+
+        oss << _protocol << "/" << _version << " " << _code << " " << _reason << "\r\n";
+
+        for(size_t i = 0; i < headerCount(); i++)
+        {
+            MessageHeader* pHeader = header(i);
+            oss << pHeader->key() << ": " << pHeader->value() << "\r\n";
+        }
+
+        oss << "\r\n";
+
+        oss << "Body (" << _bodyLen << "bytes)" << "\r\n";
+
+        return oss.str();
+    }
+
+    // <protocol>/<version> SP <code> SP <reason> CRLF
+    size_t ResponseMessage::headLength() const
+    {
+        return _protocol.size() + 1 + _version.size() + 1 + 3 + 1 + _reason.size() + 2
+             + headerLen() + 2;
+    }
+
+    size_t ResponseMessage::serializeHead(pputil::byte* b) const
+    {
+        pputil::byte* p = b;
+        memcpy(p, _protocol.data(), _protocol.size());
+        p += _protocol.size();
+        *p++ = '/';
+        memcpy(p, _version.data(), _version.size());
+        p += _version.size();
+        *p++ = ' ';
+
+        // Status codes are 3 digits
+        int code = (_code >= 100 && _code <= 999) ? _code : 500;
+        *p++ = (pputil::byte)('0' + code / 100);
+        *p++ = (pputil::byte)('0' + code / 10 % 10);
+        *p++ = (pputil::byte)('0' + code % 10);
+        *p++ = ' ';
+
+        memcpy(p, _reason.data(), _reason.size());
+        p += _reason.size();
+        *p++ = '\r';
+        *p++ = '\n';
+
+        p += serializeHeaders(p);
+        return p - b;
+    }
+
+    int ResponseMessage::code() const
+    {
+        return _code;
+    }
+
+    std::string ResponseMessage::reason() const
+    {
+        return _reason;
+    }
+
+    void ResponseMessage::setStatus(int code, const std::string& reason)
+    {
+        _code = code;
+        _reason = reason;
+
+        if(_reason.empty())
+        {
+            _reason = code2reason(_code);
+        }
+    }
+
+}
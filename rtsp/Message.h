@@ -1,150 +1,208 @@
-// **********************************************************************
-//
-// Copyright (c) 2011, PPEngine
-// 
-// Redistribution and use in source and binary forms, with or without
-// modification, are permitted provided that the following conditions are
-// met:
-// 
-//   * Redistributions of source code must retain the above copyright
-//     notice, this list of conditions and the following disclaimer.
-// 
-//   * Redistributions in binary form must reproduce the above copyright
-//     notice, this list of conditions and the following disclaimer in
-//     the documentation and/or other materials provided with the
-//     distribution.
-// 
-//   * Neither the name of Google nor the names of its contributors may
-//     be used to endorse or promote products derived from this software
-//     without specific prior written permission.
-// 
-// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
-// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
-// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
-// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
-// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
-// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
-// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
-// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-// 
-// **********************************************************************
-
-#ifndef RTSP_MESSAGE_H
-#define RTSP_MESSAGE_H
-
-#include <pputil/Buffer.h>
-
-namespace rtsp
-{
-	// A message header line
-	class MessageHeader
-	{
-	private:
-		MessageHeader();
-
-	public:
-		MessageHeader(const std::string& key);
-		MessageHeader(const std::string& key, const std::string& value);
-
-		std::string  key() const;
-		std::string  value() const;
-		void  setValue(const std::string& value);
-
-	protected:
-		std::string _key;
-		std::string _value;
-	};
-
-	typedef std::vector<MessageHeader*> MessageHeaderSeq;
-
-	enum MESSAGE_TYPE {UNKNOWN_MESSAGE, REQUEST_MESSAGE, RESPONSE_MESSAGE};
-
-	class Message
-	{
-	private:
-		bool operator==(const Message& msg) const;
-		bool operator!=(const Message& msg) const;
-		const HttpMessage& operator=(const Message& msg); 
-
-	public:
-		Message();
-		virtual ~Message();
-
-		virtual MESSAGE_TYPE type() const;
-		virtual std::string dump() const = 0;
-		virtual Buffer* toBuffer() const = 0;
-
-		std::string version() const
-		void setVersion(const std::string& version);
-
-		std::string header(const std::string& key) const;
-		void setHeader(const std::string& key, const std::string& value);
-		void setHeader(const MessageHeader& header);
-		void removeHeader(const std::string& key);
-
-		// Total header length for key/val pairs (incl. ": " and CRLF)
-		// but NOT separator CRLF
-		size_t headerLen() const;
-		size_t headerCount() const;
-		MessageHeader* header(size_t index) const;
-
-		// Body section
-		size_t bodyLen() const;
-		byte* body() const;
-		void setBody(byte* buf, size_t len);
-
-	protected:
-		std::string		_protocol;		// "HTTP", "RTSP"
-		std::string		_version;       // "1.0", "1.1", "2.0"
-		HttpHeaderSeq	_headers;
-		size_t			_bodyLen;
-		byte*			_body;
-	};
-
-	class RequestMessage : public Message
-	{
-	public:
-		RequestMessage();
-		RequestMessage(const std::string& version);
-		virtual ~RequestMessage();
-
-		virtual MESSAGE_TYPE type() const;
-		virtual std::string dump() const;
-		virtual Buffer* toBuffer() const;
-
-		std::string	method() const;
-		void setMethod(const std::string& method);
-
-		std::string url() const;
-		void setUrl(const std::string& url);
-
-	protected:
-		std::string	_method;
-		std::string _url;
-	};
-
-	class ResponseMessage : public Message
-	{
-	public:
-		ResponseMessage();
-		ResponseMessage(const std::string& version);
-		virtual ~ResponseMessage();
-
-		virtual MESSAGE_TYPE type() const;
-		virtual std::string dump() const;
-		virtual Buffer* toBuffer() const;
-
-		int code() const;
-		std::string reason() const;
-		void setStatus(int code, const std::string& reason = "");
-
-	protected:
-		virtual std::string code2reason() = 0;
-	};
-}
-
-#endif 
-
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_MESSAGE_H
+#define RTSP_MESSAGE_H
+
+#include <pputil/Buffer.h>
+#include <pputil/Blob.h>
+
+namespace rtsp
+{
+	// A message header line
+	class MessageHeader
+	{
+	private:
+		MessageHeader();
+
+	public:
+		MessageHeader(const std::string& key);
+		MessageHeader(const std::string& key, const std::string& value);
+
+		const std::string&  key() const;
+		const std::string&  value() const;
+		void  setValue(const std::string& value);
+
+		// Assign in place, strings keep their capacity
+		void set(const char* key, size_t keyLen, const char* value, size_t valueLen);
+		bool is(const std::string& key) const;
+		bool is(const char* key, size_t keyLen) const;
+
+	protected:
+		std::string _key;
+		std::string _value;
+	};
+
+	typedef std::vector<MessageHeader*> MessageHeaderSeq;
+
+	enum MESSAGE_TYPE {UNKNOWN_MESSAGE, REQUEST_MESSAGE, RESPONSE_MESSAGE};
+
+	//
+	// A message keeps its header objects and body memory when it is reset,
+	// so a message reused from a pool (MessagePool) is filled again without
+	// allocation once it has grown to the usual size
+	//
+	class Message
+	{
+	private:
+		Message(const Message& msg);
+		const Message& operator=(const Message& msg); 
+
+	public:
+		Message();
+		Message(const std::string& version);
+		virtual ~Message();
+
+		virtual MESSAGE_TYPE type() const;
+		virtual std::string dump() const = 0;
+
+		// Clear for reuse
+		virtual void reset();
+
+		// Bytes of message on wire, and write them to b
+		size_t length() const;
+		size_t serialize(pputil::byte* b) const;
+
+		// Initial line and headers only, without body
+		virtual size_t headLength() const = 0;
+		virtual size_t serializeHead(pputil::byte* b) const = 0;
+
+		std::string version() const;
+		void setVersion(const std::string& version);
+
+		std::string header(const std::string& key) const;
+		void setHeader(const std::string& key, const std::string& value);
+		void setHeader(const MessageHeader& header);
+
+		// Set literals and numbers in place, without temporary strings
+		void setHeader(const char* key, const char* value);
+		void setHeader(const char* key, uint64_t value);
+		void removeHeader(const std::string& key);
+
+		// Append a header without looking for the key, used by parser
+		void addHeader(const char* key, size_t keyLen, const char* value, size_t valueLen);
+
+		// Total header length for key/val pairs (incl. ": " and CRLF)
+		// but NOT separator CRLF
+		size_t headerLen() const;
+		size_t headerCount() const;
+		MessageHeader* header(size_t index) const;
+
+		// Body section
+		size_t bodyLen() const;
+		pputil::byte* body() const;
+
+		// Copy a body in
+		void setBody(const pputil::byte* buf, size_t len);
+
+		// Refer to a shared body, which is not copied in or out
+		// The blob is not changed after it is set
+		void setBody(const pputil::BlobPtr& body);
+
+		// The shared body, null if body was copied in
+		pputil::BlobPtr bodyBlob() const;
+
+	protected:
+		std::string		_protocol;		// "HTTP", "RTSP"
+		std::string		_version;       // "1.0", "1.1", "2.0"
+
+		// Headers in use are the first _headerCount, the rest are spare
+		MessageHeaderSeq	_headers;
+		size_t			_headerCount;
+
+		// Body memory is kept over resets
+		pputil::byte*	_body;
+		size_t			_bodyLen;
+		size_t			_bodyCapacity;
+		pputil::BlobPtr	_bodyBlob;
+
+		MessageHeader* nextHeader(const char* key, size_t keyLen, const char* value, size_t valueLen);
+		void assignHeader(const char* key, size_t keyLen, const char* value, size_t valueLen);
+		size_t serializeHeaders(pputil::byte* b) const;
+	};
+
+	class RequestMessage : public Message
+	{
+	public:
+		RequestMessage();
+		RequestMessage(const std::string& version);
+		virtual ~RequestMessage();
+
+		virtual MESSAGE_TYPE type() const;
+		virtual std::string dump() const;
+		virtual void reset();
+
+		virtual size_t headLength() const;
+		virtual size_t serializeHead(pputil::byte* b) const;
+
+		std::string	method() const;
+		void setMethod(const std::string& method);
+		void setMethod(const char* method, size_t n);
+
+		std::string url() const;
+		void setUrl(const std::string& url);
+		void setUrl(const char* url, size_t n);
+
+	protected:
+		std::string	_method;
+		std::string _url;
+	};
+
+	class ResponseMessage : public Message
+	{
+	public:
+		ResponseMessage();
+		ResponseMessage(const std::string& version);
+		virtual ~ResponseMessage();
+
+		virtual MESSAGE_TYPE type() const;
+		virtual std::string dump() const;
+		virtual void reset();
+
+		virtual size_t headLength() const;
+		virtual size_t serializeHead(pputil::byte* b) const;
+
+		int code() const;
+		std::string reason() const;
+		void setStatus(int code, const std::string& reason = "");
+
+	protected:
+		int _code;
+		std::string _reason;
+
+		virtual std::string code2reason(int code) = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,148 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "MessagePool.h"
+
+namespace rtsp
+{
+
+    MessagePool::MessagePool(size_t maxFree)
+    : _maxFree(maxFree)
+    , _created(0)
+    , _reused(0)
+    {
+        _requests.reserve(maxFree);
+        _responses.reserve(maxFree);
+        _blobs.reserve(maxFree);
+    }
+
+    MessagePool::~MessagePool()
+    {
+        for(std::vector<RtspRequest*>::iterator it = _requests.begin(); it != _requests.end(); ++it)
+        {
+            delete *it;
+        }
+        _requests.clear();
+
+        for(std::vector<RtspResponse*>::iterator it = _responses.begin(); it != _responses.end(); ++it)
+        {
+            delete *it;
+        }
+        _responses.clear();
+    }
+
+    RtspRequest* MessagePool::request()
+    {
+        if(_requests.empty())
+        {
+            _created++;
+            return new RtspRequest();
+        }
+
+        _reused++;
+        RtspRequest* msg = _requests.back();
+        _requests.pop_back();
+        return msg;
+    }
+
+    RtspResponse* MessagePool::response()
+    {
+        if(_responses.empty())
+        {
+            _created++;
+            return new RtspResponse();
+        }
+
+        _reused++;
+        RtspResponse* msg = _responses.back();
+        _responses.pop_back();
+        return msg;
+    }
+
+    // Messages over the free limit are deleted
+    void MessagePool::release(Message* msg)
+    {
+        if(msg == NULL)
+        {
+            return;
+        }
+
+        msg->reset();
+        msg->setVersion("1.0");
+
+        if(msg->type() == REQUEST_MESSAGE && _requests.size() < _maxFree)
+        {
+            _requests.push_back(static_cast<RtspRequest*>(msg));
+        }
+        else if(msg->type() == RESPONSE_MESSAGE && _responses.size() < _maxFree)
+        {
+            _responses.push_back(static_cast<RtspResponse*>(msg));
+        }
+        else
+        {
+            delete msg;
+        }
+    }
+
+    // Blobs in flight over the free limit are not kept
+    pputil::BlobPtr MessagePool::blob(size_t n)
+    {
+        for(std::vector<pputil::BlobPtr>::iterator it = _blobs.begin(); it != _blobs.end(); ++it)
+        {
+            if((*it)->__getRef() == 1)
+            {
+                (*it)->resize(n);
+                return *it;
+            }
+        }
+
+        pputil::BlobPtr b = new pputil::Blob(n);
+        if(_blobs.size() < _maxFree)
+        {
+            _blobs.push_back(b);
+        }
+        return b;
+    }
+
+    size_t MessagePool::created() const
+    {
+        return _created;
+    }
+
+    size_t MessagePool::reused() const
+    {
+        return _reused;
+    }
+
+}
@@ -0,0 +1,82 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_MESSAGE_POOL_H
+#define RTSP_MESSAGE_POOL_H
+
+#include <rtsp/RtspMessage.h>
+#include <pputil/Blob.h>
+
+namespace rtsp
+{
+    //
+    // Free lists of RTSP messages, and of blobs they are sent in
+    // A message given back is reset and handed out again, with its header 
+    // objects and body memory, so steady request handling does not go to
+    // allocator for messages, headers, bodies and the bytes sent
+    // Not thread safe, a pool belongs to a connection and is used on the 
+    // thread parsing it, where its requests are handled as well
+    //
+    class MessagePool
+    {
+    public:
+        MessagePool(size_t maxFree = 4);
+        ~MessagePool();
+
+        RtspRequest* request();
+        RtspResponse* response();
+
+        // Give back a message taken from pool
+        void release(Message* msg);
+
+        // A blob of n bytes to serialize a message into
+        // Blobs are not given back, a blob is handed out again once the 
+        // send queue lets it go and the pool holds the only reference
+        pputil::BlobPtr blob(size_t n);
+
+        // Messages created and handed out again, for benchmark
+        size_t created() const;
+        size_t reused() const;
+
+    private:
+        std::vector<RtspRequest*> _requests;
+        std::vector<RtspResponse*> _responses;
+        std::vector<pputil::BlobPtr> _blobs;
+        size_t _maxFree;
+        size_t _created;
+        size_t _reused;
+    };
+}
+
+#endif
@@ -0,0 +1,204 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "MulticastStream.h"
+#include "Rtp.h"
+
+namespace rtsp
+{
+
+    MulticastStream::MulticastStream(const std::string& name)
+    : RtspStream(name)
+    , _rtcpPoll(0)
+    , _port(0)
+    , _ttl(0)
+    , _started(false)
+    , _lastSeq(0)
+    , _members(0)
+    {
+
+    }
+
+    MulticastStream::~MulticastStream()
+    {
+        _rtpSocket.close();
+        _rtcpSocket.close();
+    }
+
+    bool MulticastStream::init(const std::string& group, unsigned short port, int ttl)
+    {
+        // RTP from any port, RTCP on the port receivers report to
+        if(!_rtpSocket.init(0) || !_rtpSocket.setMulticast(ttl, true))
+        {
+            _rtpSocket.close();
+            return false;
+        }
+        
+        if(!_rtcpSocket.init(group, port + 1) || !_rtcpSocket.setMulticast(ttl, true))
+        {
+            _rtpSocket.close();
+            _rtcpSocket.close();
+            return false;
+        }
+        
+        _rtpSocket.setPeer(group, port);
+        _rtcpSocket.setPeer(group, port + 1);
+        _rtcpSocket.setTimestamps(true);
+        
+        _group = group;
+        _port = port;
+        _ttl = ttl;
+        return true;
+    }
+
+    std::string MulticastStream::group() const
+    {
+        return _group;
+    }
+
+    unsigned short MulticastStream::port() const
+    {
+        return _port;
+    }
+
+    int MulticastStream::ttl() const
+    {
+        return _ttl;
+    }
+
+    bool MulticastStream::forward(const pputil::BlobPtr& packet)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        
+        if(!rtpValid(packet->data(), packet->size()))
+        {
+            return false;
+        }
+        
+        // Sent by another session
+        uint16_t seq = rtpSeq(packet->data());
+        if(_started && (int16_t)(seq - _lastSeq) <= 0)
+        {
+            return true;
+        }
+        
+        _started = true;
+        _lastSeq = seq;
+        return sendData(packet);
+    }
+
+    void MulticastStream::join()
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        _members++;
+    }
+
+    void MulticastStream::leave()
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        assert(_members > 0);
+        _members--;
+    }
+
+    size_t MulticastStream::members()
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        return _members;
+    }
+
+    bool MulticastStream::sendPacket(const pputil::BlobPtr& packet)
+    {
+        long len = _rtpSocket.send(packet->data(), packet->size());
+        return len == (long)packet->size();
+    }
+
+    bool MulticastStream::sendRtcp(pputil::byte* b, size_t n)
+    {
+        return _rtcpSocket.send(b, n) == (long)n;
+    }
+
+    void MulticastStream::preparePoll(pputil::PollSet& fds)
+    {
+        if(_rtcpSocket.m_socket != INVALID_SOCKET)
+        {
+            _rtcpPoll = fds.add(_rtcpSocket.m_socket);
+        }
+    }
+
+    // Our own reports are looped back as well, 
+    // they carry no report blocks and are ignored 
+    void MulticastStream::handlePoll(const pputil::PollSet& fds)
+    {
+        if(_rtcpSocket.m_socket != INVALID_SOCKET && fds.readable(_rtcpPoll, _rtcpSocket.m_socket))
+        {
+            long n = _rtcpSocket.receive(_rtcpBatch);
+            for(long i = 0; i < n; ++i)
+            {
+                onRtcp(_rtcpBatch.data(i), _rtcpBatch.size(i), _rtcpBatch.timestamp(i));
+            }
+        }
+    }
+    
+    //////////////////////////////////////////////////////////////////////
+
+    MulticastMember::MulticastMember(const std::string& name, const MulticastStreamPtr& stream)
+    : RtspStream(name)
+    , _stream(stream)
+    {
+        assert(_stream);
+        _stream->join();
+    }
+
+    MulticastMember::~MulticastMember()
+    {
+        _stream->leave();
+    }
+
+    MulticastStreamPtr MulticastMember::stream()
+    {
+        return _stream;
+    }
+
+    bool MulticastMember::sendPacket(const pputil::BlobPtr& packet)
+    {
+        return _stream->forward(packet);
+    }
+
+    // Reports are sent by the shared stream
+    bool MulticastMember::sendRtcp(pputil::byte* b, size_t n)
+    {
+        return false;
+    }
+    
+}
@@ -0,0 +1,121 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_MULTICAST_STREAM_H
+#define RTSP_MULTICAST_STREAM_H
+
+#include <rtsp/RtspStream.h>
+#include <IceUtil/Shared.h>
+#include <IceUtil/Handle.h>
+
+namespace rtsp
+{
+    //
+    // One sender of a media stream to a multicast group
+    // RTP is sent to group:port and RTCP to group:port + 1
+    // All sessions playing the stream with multicast transport share 
+    // it, so egress of a live media does not grow with viewers
+    //
+    class MulticastStream : public RtspStream, public IceUtil::Shared
+    {
+    public:
+        MulticastStream(const std::string& name);
+        virtual ~MulticastStream();
+        
+        bool init(const std::string& group, unsigned short port, int ttl);
+        
+        std::string group() const;
+        unsigned short port() const;
+        int ttl() const;
+        
+        // A packet from one of the sessions
+        // Sessions of a live media read the same packets, so a packet 
+        // not newer than the last one sent is dropped
+        bool forward(const pputil::BlobPtr& packet);
+        
+        // Sessions sharing the stream
+        void join();
+        void leave();
+        size_t members();
+        
+        // Receive RTCP of receivers in group
+        virtual void preparePoll(pputil::PollSet& fds);
+        virtual void handlePoll(const pputil::PollSet& fds);
+        
+    protected:
+        virtual bool sendPacket(const pputil::BlobPtr& packet);
+        virtual bool sendRtcp(pputil::byte* b, size_t n);
+        
+    private:
+        UdpSocket _rtpSocket;
+        UdpSocket _rtcpSocket;
+        UdpBatch _rtcpBatch;
+        size_t _rtcpPoll;       // Index in PollSet
+        
+        std::string _group;
+        unsigned short _port;
+        int _ttl;
+        
+        // Last packet sent
+        bool _started;
+        uint16_t _lastSeq;
+        
+        size_t _members;
+        IceUtil::Mutex _mutex;
+    };
+    
+    typedef IceUtil::Handle<MulticastStream> MulticastStreamPtr;
+    
+    //
+    // Stream of a session playing with multicast transport
+    // Packets are handed to the shared stream, which sends and reports
+    //
+    class MulticastMember : public RtspStream
+    {
+    public:
+        MulticastMember(const std::string& name, const MulticastStreamPtr& stream);
+        virtual ~MulticastMember();
+        
+        MulticastStreamPtr stream();
+        
+    protected:
+        virtual bool sendPacket(const pputil::BlobPtr& packet);
+        virtual bool sendRtcp(pputil::byte* b, size_t n);
+        
+    private:
+        MulticastStreamPtr _stream;
+    };
+}
+
+#endif
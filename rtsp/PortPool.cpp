@@ -0,0 +1,133 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "PortPool.h"
+
+namespace rtsp
+{
+
+    PortPool::PortPool()
+    : _first(0)
+    , _size(0)
+    {
+
+    }
+
+    PortPool::~PortPool()
+    {
+
+    }
+
+    void PortPool::setRange(unsigned short first, unsigned short last)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        
+        // RTP on even port
+        _first = (unsigned short)((first + 1) & ~1);
+        _size = last > _first ? (last - _first + 1) / 2 : 0;
+        
+        _bitmap.assign((_size + 31) / 32, 0);
+        _free.clear();
+        for(size_t i = 0; i < _size; ++i)
+        {
+            _free.push_back((uint16_t)i);
+        }
+    }
+
+    bool PortPool::acquire(unsigned short& port)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        
+        if(_free.empty())
+        {
+            return false;
+        }
+        
+        size_t index = _free.front();
+        _free.pop_front();
+        setInUse(index, true);
+        
+        port = (unsigned short)(_first + index * 2);
+        return true;
+    }
+
+    void PortPool::release(unsigned short port)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        
+        if(port < _first || ((port - _first) & 1) != 0)
+        {
+            return;
+        }
+        
+        size_t index = (port - _first) / 2;
+        if(index >= _size || !inUse(index))
+        {
+            return;
+        }
+        
+        setInUse(index, false);
+        _free.push_back((uint16_t)index);
+    }
+
+    size_t PortPool::size()
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        return _size;
+    }
+
+    size_t PortPool::available()
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        return _free.size();
+    }
+
+    bool PortPool::inUse(size_t index) const
+    {
+        return (_bitmap[index / 32] & (1u << (index % 32))) != 0;
+    }
+
+    void PortPool::setInUse(size_t index, bool used)
+    {
+        if(used)
+        {
+            _bitmap[index / 32] |= (1u << (index % 32));
+        }
+        else
+        {
+            _bitmap[index / 32] &= ~(1u << (index % 32));
+        }
+    }
+    
+}
@@ -0,0 +1,85 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_PORT_POOL_H
+#define RTSP_PORT_POOL_H
+
+#include <pputil/Config.h>
+#include <IceUtil/Mutex.h>
+#include <deque>
+
+namespace rtsp
+{
+    //
+    // Pairs of UDP ports for RTP (even) and RTCP (odd) in a range
+    // A pair is taken from the head of a free list and given back to 
+    // the tail, so allocation does not depend on how many pairs are 
+    // in use, and a released pair is reused as late as possible
+    // A bitmap marks pairs in use, to ignore double release
+    //
+    class PortPool
+    {
+    public:
+        PortPool();
+        virtual ~PortPool();
+        
+        // Ports from first to last, rounded to whole even/odd pairs
+        // Pairs in use are forgotten, so set it before any stream
+        void setRange(unsigned short first, unsigned short last);
+        
+        // Take a pair, port is the even one
+        // Return false if all pairs are in use
+        bool acquire(unsigned short& port);
+        
+        // Give back a pair taken by acquire()
+        void release(unsigned short port);
+        
+        // Number of pairs, and those not in use
+        size_t size();
+        size_t available();
+        
+    protected:
+        bool inUse(size_t index) const;
+        void setInUse(size_t index, bool used);
+        
+        unsigned short _first;
+        std::vector<uint32_t> _bitmap;
+        std::deque<uint16_t> _free;
+        size_t _size;
+        
+        IceUtil::Mutex _mutex;
+    };
+}
+
+#endif
@@ -0,0 +1,265 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "Rtcp.h"
+#include <pputil/Socket.h>
+
+namespace rtsp
+{
+
+    static inline uint16_t get16(const pputil::byte* p)
+    {
+        return (uint16_t)((p[0] << 8) | p[1]);
+    }
+
+    static inline uint32_t get32(const pputil::byte* p)
+    {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    static inline void put16(pputil::byte* p, uint16_t v)
+    {
+        p[0] = (pputil::byte)(v >> 8);
+        p[1] = (pputil::byte)v;
+    }
+
+    static inline void put32(pputil::byte* p, uint32_t v)
+    {
+        p[0] = (pputil::byte)(v >> 24);
+        p[1] = (pputil::byte)(v >> 16);
+        p[2] = (pputil::byte)(v >> 8);
+        p[3] = (pputil::byte)v;
+    }
+
+    // Report blocks follow the sender info of SR, or the sender SSRC of RR
+    static void parseReportBlocks(const pputil::byte* p, size_t count, RtcpFeedback& feedback)
+    {
+        for(size_t i = 0; i < count; ++i, p += 24)
+        {
+            RtcpReportBlock block;
+            block.ssrc = get32(p);
+            block.fractionLost = p[4];
+            
+            // 24 bits signed
+            int32_t lost = (int32_t)((p[5] << 16) | (p[6] << 8) | p[7]);
+            block.cumulativeLost = (lost & 0x800000) ? lost - 0x1000000 : lost;
+            
+            block.highestSeq = get32(p + 8);
+            block.jitter = get32(p + 12);
+            block.lsr = get32(p + 16);
+            block.dlsr = get32(p + 20);
+            feedback.reports.push_back(block);
+        }
+    }
+
+    bool parseRtcp(const pputil::byte* b, size_t n, RtcpFeedback& feedback)
+    {
+        feedback.sender = 0;
+        feedback.bye = false;
+        
+        const pputil::byte* p = b;
+        const pputil::byte* end = b + n;
+        
+        while(end - p >= 4)
+        {
+            // Version 2, count or format, type, length in 32-bit words minus one
+            if((p[0] >> 6) != 2)
+            {
+                return false;
+            }
+            
+            size_t count = p[0] & 0x1f;
+            uint8_t type = p[1];
+            size_t len = ((size_t)get16(p + 2) + 1) * 4;
+            if(len > (size_t)(end - p))
+            {
+                return false;
+            }
+            
+            switch(type)
+            {
+                case RTCP_SR:
+                    if(len < 28 + count * 24)
+                    {
+                        return false;
+                    }
+                    feedback.sender = get32(p + 4);
+                    parseReportBlocks(p + 28, count, feedback);
+                    break;
+                case RTCP_RR:
+                    if(len < 8 + count * 24)
+                    {
+                        return false;
+                    }
+                    feedback.sender = get32(p + 4);
+                    parseReportBlocks(p + 8, count, feedback);
+                    break;
+                case RTCP_RTPFB:
+                    // Generic NACK, FCI entries of pid and blp
+                    if(count == 1 && len >= 12)
+                    {
+                        uint32_t media = get32(p + 8);
+                        for(const pputil::byte* q = p + 12; q + 4 <= p + len; q += 4)
+                        {
+                            RtcpNack nack;
+                            nack.ssrc = media;
+                            nack.pid = get16(q);
+                            nack.blp = get16(q + 2);
+                            feedback.nacks.push_back(nack);
+                        }
+                    }
+                    break;
+                case RTCP_PSFB:
+                    if(count == 1 && len >= 12)
+                    {
+                        feedback.plis.push_back(get32(p + 8));
+                    }
+                    break;
+                case RTCP_BYE:
+                    feedback.bye = true;
+                    break;
+                default:
+                    break;
+            }
+            
+            p += len;
+        }
+        
+        return p == end;
+    }
+
+    uint32_t rtcpMediaSsrc(const pputil::byte* b, size_t n)
+    {
+        const pputil::byte* p = b;
+        const pputil::byte* end = b + n;
+        
+        while(end - p >= 4)
+        {
+            size_t len = ((size_t)get16(p + 2) + 1) * 4;
+            if((p[0] >> 6) != 2 || len > (size_t)(end - p))
+            {
+                break;
+            }
+            
+            size_t count = p[0] & 0x1f;
+            switch(p[1])
+            {
+                case RTCP_SR:
+                    if(count > 0 && len >= 32)
+                    {
+                        return get32(p + 28);
+                    }
+                    break;
+                case RTCP_RR:
+                    if(count > 0 && len >= 12)
+                    {
+                        return get32(p + 8);
+                    }
+                    break;
+                case RTCP_RTPFB:
+                case RTCP_PSFB:
+                    if(len >= 12)
+                    {
+                        return get32(p + 8);
+                    }
+                    break;
+                default:
+                    break;
+            }
+            
+            p += len;
+        }
+        
+        return 0;
+    }
+
+    size_t buildSenderReport(pputil::byte* b, size_t n, uint32_t ssrc, 
+                             uint64_t ntp, uint32_t rtpTime, 
+                             uint32_t packets, uint32_t octets, 
+                             const std::string& cname)
+    {
+        // SR without report blocks: 28 bytes
+        // SDES with one chunk: header, SSRC, CNAME item, end and padding
+        size_t nameLen = std::min<size_t>(cname.size(), 255);
+        size_t sdesLen = (8 + 2 + nameLen + 1 + 3) & ~(size_t)3;
+        if(n < 28 + sdesLen)
+        {
+            return 0;
+        }
+        
+        pputil::byte* p = b;
+        p[0] = 0x80;
+        p[1] = RTCP_SR;
+        put16(p + 2, 28 / 4 - 1);
+        put32(p + 4, ssrc);
+        put32(p + 8, (uint32_t)(ntp >> 32));
+        put32(p + 12, (uint32_t)ntp);
+        put32(p + 16, rtpTime);
+        put32(p + 20, packets);
+        put32(p + 24, octets);
+        
+        p += 28;
+        memset(p, 0, sdesLen);
+        p[0] = 0x81;
+        p[1] = RTCP_SDES;
+        put16(p + 2, (uint16_t)(sdesLen / 4 - 1));
+        put32(p + 4, ssrc);
+        p[8] = 1;  // CNAME
+        p[9] = (pputil::byte)nameLen;
+        memcpy(p + 10, cname.data(), nameLen);
+        
+        return 28 + sdesLen;
+    }
+
+    // NTP counts seconds from 1900, 
+    // fraction is in 1/2^32 seconds
+    uint64_t ntpTime(int64_t us)
+    {
+        uint64_t seconds = (uint64_t)(us / 1000000) + 2208988800ULL;
+        uint64_t fraction = ((uint64_t)(us % 1000000) << 32) / 1000000;
+        return (seconds << 32) | fraction;
+    }
+
+    std::string rtcpCname()
+    {
+        char host[256];
+        memset(host, 0, sizeof(host));
+        if(gethostname(host, sizeof(host) - 1) != 0 || host[0] == 0)
+        {
+            return "rtsp@localhost";
+        }
+        return std::string("rtsp@") + host;
+    }
+
+}
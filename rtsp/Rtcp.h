@@ -0,0 +1,118 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_RTCP_H
+#define RTSP_RTCP_H
+
+#include <pputil/Config.h>
+
+namespace rtsp
+{
+    //
+    // RTCP packets (RFC 3550, RFC 4585)
+    // Sender reports are built for streams we send, 
+    // receiver reports and feedback from clients are parsed
+    //
+    
+    enum RTCP_PACKET_TYPE 
+    {
+        RTCP_SR    = 200,   // Sender report
+        RTCP_RR    = 201,   // Receiver report
+        RTCP_SDES  = 202,   // Source description
+        RTCP_BYE   = 203,   // Goodbye
+        RTCP_APP   = 204,   // Application defined
+        RTCP_RTPFB = 205,   // Transport layer feedback, FMT 1 is generic NACK
+        RTCP_PSFB  = 206    // Payload specific feedback, FMT 1 is PLI
+    };
+    
+    // Report block of a receiver report
+    struct RtcpReportBlock
+    {
+        uint32_t ssrc;              // Source the report is about
+        uint8_t fractionLost;       // Loss since last report, in 1/256
+        int32_t cumulativeLost;     // Total packets lost
+        uint32_t highestSeq;        // Extended highest sequence number received
+        uint32_t jitter;            // Interarrival jitter, in timestamp units
+        uint32_t lsr;               // Middle 32 bits of NTP time of last SR
+        uint32_t dlsr;              // Delay since last SR, in 1/65536 seconds
+    };
+    
+    // Generic NACK, packet pid and the 16 following packets marked in blp
+    struct RtcpNack
+    {
+        uint32_t ssrc;              // Media source
+        uint16_t pid;
+        uint16_t blp;
+    };
+    
+    // Feedback found in a compound RTCP packet
+    struct RtcpFeedback
+    {
+        uint32_t sender;
+        std::vector<RtcpReportBlock> reports;
+        std::vector<RtcpNack> nacks;
+        std::vector<uint32_t> plis;  // Media sources asked for a key frame
+        bool bye;
+    };
+    
+    // Parse a compound RTCP packet
+    // Return false if the packet is malformed, feedback before the error is kept
+    bool parseRtcp(const pputil::byte* b, size_t n, RtcpFeedback& feedback);
+    
+    // Media source the first report block or feedback message of a 
+    // compound packet is about, 0 if there is none
+    // Cheap enough to route packets before they are fully parsed
+    uint32_t rtcpMediaSsrc(const pputil::byte* b, size_t n);
+    
+    // Build a compound packet of SR and SDES CNAME into b (at least 128 bytes)
+    // Return the length of packet
+    size_t buildSenderReport(pputil::byte* b, size_t n, uint32_t ssrc, 
+                             uint64_t ntp, uint32_t rtpTime, 
+                             uint32_t packets, uint32_t octets, 
+                             const std::string& cname);
+    
+    // NTP time (RFC 1305 64-bit format) of a wall clock time in microseconds
+    uint64_t ntpTime(int64_t us);
+    
+    // Middle 32 bits of NTP time, as used by LSR and DLSR
+    inline uint32_t ntpMiddle(uint64_t ntp)
+    {
+        return (uint32_t)(ntp >> 16);
+    }
+    
+    // Canonical name of this host for SDES
+    std::string rtcpCname();
+}
+
+#endif
@@ -0,0 +1,83 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_RTP_H
+#define RTSP_RTP_H
+
+#include <pputil/Config.h>
+
+namespace rtsp
+{
+    //
+    // RTP fixed header (RFC 3550, 5.1)
+    //
+    //  0                   1                   2                   3
+    //  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+    // |V=2|P|X|  CC   |M|     PT      |       sequence number         |
+    // |                           timestamp                           |
+    // |           synchronization source (SSRC) identifier            |
+    //
+    // Fields are read in network byte order from a packet in memory
+    // Inline for performance
+    //
+    
+    const size_t RTP_HEADER_SIZE = 12;
+    
+    inline bool rtpValid(const pputil::byte* b, size_t n)
+    {
+        return b != NULL && n >= RTP_HEADER_SIZE && (b[0] >> 6) == 2;
+    }
+    
+    inline uint8_t rtpPayloadType(const pputil::byte* b)
+    {
+        return b[1] & 0x7f;
+    }
+    
+    inline uint16_t rtpSeq(const pputil::byte* b)
+    {
+        return (uint16_t)((b[2] << 8) | b[3]);
+    }
+    
+    inline uint32_t rtpTimestamp(const pputil::byte* b)
+    {
+        return ((uint32_t)b[4] << 24) | ((uint32_t)b[5] << 16) | ((uint32_t)b[6] << 8) | b[7];
+    }
+    
+    inline uint32_t rtpSsrc(const pputil::byte* b)
+    {
+        return ((uint32_t)b[8] << 24) | ((uint32_t)b[9] << 16) | ((uint32_t)b[10] << 8) | b[11];
+    }
+}
+
+#endif
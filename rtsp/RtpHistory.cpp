@@ -0,0 +1,182 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "RtpHistory.h"
+#include "Rtp.h"
+
+namespace rtsp
+{
+
+    RtpHistory::RtpHistory(size_t slots, size_t maxBytes, int64_t maxAge)
+    : _mask(0)
+    , _empty(true)
+    , _first(0)
+    , _last(0)
+    , _bytes(0)
+    , _maxBytes(maxBytes)
+    , _maxAge(maxAge)
+    {
+        // Half of the sequence space at most, so that ranges do not wrap
+        size_t n = 1;
+        while(n < slots && n < 32768)
+        {
+            n <<= 1;
+        }
+        
+        _slots.resize(n);
+        _mask = n - 1;
+    }
+
+    RtpHistory::~RtpHistory()
+    {
+        clear();
+    }
+
+    void RtpHistory::setLimits(size_t maxBytes, int64_t maxAge)
+    {
+        clear();
+        _maxBytes = maxBytes;
+        _maxAge = maxAge;
+    }
+
+    void RtpHistory::add(const pputil::BlobPtr& packet, int64_t now)
+    {
+        if(!packet || !rtpValid(packet->data(), packet->size()))
+        {
+            return;
+        }
+        
+        uint16_t seq = rtpSeq(packet->data());
+        
+        if(!_empty)
+        {
+            int16_t ahead = (int16_t)(seq - _last);
+            if(ahead <= 0)
+            {
+                return;
+            }
+            
+            if((size_t)ahead >= _slots.size())
+            {
+                // A jump over the whole ring
+                clear();
+            }
+            else
+            {
+                // Make room in the ring
+                while(!_empty && (uint16_t)(seq - _first) > _mask)
+                {
+                    evictFirst();
+                }
+            }
+        }
+        
+        Slot& slot = _slots[seq & _mask];
+        slot.packet = packet;
+        slot.seq = seq;
+        slot.time = now;
+        _bytes += packet->size();
+        
+        if(_empty)
+        {
+            _first = seq;
+            _empty = false;
+        }
+        _last = seq;
+        
+        // Byte and age limits, the newest packet is always kept
+        while(_first != _last)
+        {
+            const Slot& first = _slots[_first & _mask];
+            bool stale = !first.packet || first.seq != _first || now - first.time > _maxAge;
+            if(!stale && _bytes <= _maxBytes)
+            {
+                break;
+            }
+            evictFirst();
+        }
+    }
+
+    pputil::BlobPtr RtpHistory::find(uint16_t seq, int64_t now)
+    {
+        if(_empty || (uint16_t)(seq - _first) > (uint16_t)(_last - _first))
+        {
+            return NULL;
+        }
+        
+        const Slot& slot = _slots[seq & _mask];
+        if(!slot.packet || slot.seq != seq || now - slot.time > _maxAge)
+        {
+            return NULL;
+        }
+        
+        return slot.packet;
+    }
+
+    void RtpHistory::clear()
+    {
+        for(std::vector<Slot>::iterator it = _slots.begin(); it != _slots.end(); ++it)
+        {
+            it->packet = NULL;
+        }
+        
+        _empty = true;
+        _bytes = 0;
+    }
+
+    size_t RtpHistory::bytes() const
+    {
+        return _bytes;
+    }
+
+    void RtpHistory::evictFirst()
+    {
+        Slot& slot = _slots[_first & _mask];
+        if(slot.packet && slot.seq == _first)
+        {
+            _bytes -= slot.packet->size();
+            slot.packet = NULL;
+        }
+        
+        if(_first == _last)
+        {
+            _empty = true;
+        }
+        else
+        {
+            ++_first;
+        }
+    }
+
+}
@@ -0,0 +1,96 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_RTP_HISTORY_H
+#define RTSP_RTP_HISTORY_H
+
+#include <pputil/Blob.h>
+
+namespace rtsp
+{
+    //
+    // Recently sent RTP packets of a stream, kept for retransmission
+    // Packets are held by reference, so keeping them costs no copy
+    // 
+    // A ring indexed by sequence number gives O(1) lookup, 
+    // the oldest packets are dropped when the ring is over its byte limit, 
+    // and packets older than the age limit are not served 
+    //
+    class RtpHistory
+    {
+    public:
+        // slots is rounded up to a power of 2, at most 32768
+        RtpHistory(size_t slots = 1024, size_t maxBytes = 1024 * 1024, int64_t maxAge = 1000000);
+        virtual ~RtpHistory();
+        
+        // Change limits, packets kept are dropped
+        void setLimits(size_t maxBytes, int64_t maxAge);
+        
+        // Keep a packet sent at time now (microseconds)
+        // Packets must be added in sequence order, late ones are ignored
+        void add(const pputil::BlobPtr& packet, int64_t now);
+        
+        // Packet of sequence number seq, or NULL if it is gone
+        pputil::BlobPtr find(uint16_t seq, int64_t now);
+        
+        void clear();
+        
+        // Bytes of packets kept
+        size_t bytes() const;
+        
+    protected:
+        void evictFirst();
+        
+        struct Slot
+        {
+            pputil::BlobPtr packet;
+            uint16_t seq;
+            int64_t time;
+        };
+        
+        std::vector<Slot> _slots;
+        size_t _mask;
+        
+        // Sequence range kept, from first to last
+        bool _empty;
+        uint16_t _first;
+        uint16_t _last;
+        
+        size_t _bytes;
+        size_t _maxBytes;
+        int64_t _maxAge;
+    };
+}
+
+#endif
@@ -0,0 +1,342 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "RtpMux.h"
+#include "RtspStream.h"
+#include "Rtcp.h"
+#include <pputil/Capture.h>
+
+namespace rtsp
+{
+
+    RtpMux::RtpMux()
+    : _batch(BATCH_SIZE)
+    , _port(0)
+    , _rtpPoll(0)
+    , _rtcpPoll(0)
+    {
+        _rtpQueue.reserve(BATCH_SIZE);
+        _rtcpQueue.reserve(BATCH_SIZE);
+        _rtpBatch.reserve(BATCH_SIZE);
+        _rtcpBatch.reserve(BATCH_SIZE);
+    }
+
+    RtpMux::~RtpMux()
+    {
+        close();
+    }
+
+    bool RtpMux::init(unsigned short port)
+    {
+        if(!_rtpSocket.init(port))
+        {
+            return false;
+        }
+        
+        if(!_rtcpSocket.init(port + 1))
+        {
+            _rtpSocket.close();
+            return false;
+        }
+        
+        // Many streams share the buffers
+        try
+        {
+            pputil::setSendBufferSize(_rtpSocket.m_socket, 4 * 1024 * 1024);
+            pputil::setRecvBufferSize(_rtcpSocket.m_socket, 1024 * 1024);
+        }
+        catch(pputil::SocketException& ex)
+        {
+        }
+        _rtcpSocket.setTimestamps(true);
+        
+        _port = port;
+        return true;
+    }
+
+    void RtpMux::close()
+    {
+        _rtpSocket.close();
+        _rtcpSocket.close();
+    }
+
+    unsigned short RtpMux::port() const
+    {
+        return _port;
+    }
+
+    uint64_t RtpMux::key(const sockaddr_in& addr)
+    {
+        return ((uint64_t)ntohl(addr.sin_addr.s_addr) << 16) | ntohs(addr.sin_port);
+    }
+
+    void RtpMux::add(RtspStream* stream, const sockaddr_in& rtcpPeer)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        rekey(stream, key(rtcpPeer));
+    }
+
+    // A stream has one address, so the map does not grow with NAT rebinds
+    void RtpMux::rekey(RtspStream* stream, uint64_t k)
+    {
+        StreamMap::iterator it = _streams.find(stream);
+        if(it != _streams.end())
+        {
+            PeerMap::iterator pit = _peers.find(it->second);
+            if(pit != _peers.end() && pit->second == stream)
+            {
+                _peers.erase(pit);
+            }
+            it->second = k;
+        }
+        else
+        {
+            _streams[stream] = k;
+        }
+        
+        _peers[k] = stream;
+    }
+
+    void RtpMux::bind(RtspStream* stream, uint32_t ssrc)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        _ssrcs[ssrc] = stream;
+    }
+
+    void RtpMux::remove(RtspStream* stream)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        
+        StreamMap::iterator it = _streams.find(stream);
+        if(it != _streams.end())
+        {
+            PeerMap::iterator pit = _peers.find(it->second);
+            if(pit != _peers.end() && pit->second == stream)
+            {
+                _peers.erase(pit);
+            }
+            _streams.erase(it);
+        }
+        
+        for(SsrcMap::iterator it = _ssrcs.begin(); it != _ssrcs.end(); )
+        {
+            if(it->second == stream)
+            {
+                _ssrcs.erase(it++);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    size_t RtpMux::size()
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        return _streams.size();
+    }
+
+    void RtpMux::send(const pputil::BlobPtr& packet, const sockaddr_in& peer, bool rtcp)
+    {
+        bool full = false;
+        {
+            IceUtil::Mutex::Lock lock(_queueMutex);
+            
+            std::vector<Datagram>& queue = rtcp ? _rtcpQueue : _rtpQueue;
+            queue.push_back(Datagram());
+            queue.back().packet = packet;
+            queue.back().peer = peer;
+            full = queue.size() >= BATCH_SIZE;
+        }
+        
+        if(full)
+        {
+            flush();
+        }
+    }
+
+    void RtpMux::flush()
+    {
+        IceUtil::Mutex::Lock flushLock(_flushMutex);
+        
+        {
+            IceUtil::Mutex::Lock lock(_queueMutex);
+            if(_rtpQueue.empty() && _rtcpQueue.empty())
+            {
+                return;
+            }
+            
+            _rtpBatch.swap(_rtpQueue);
+            _rtcpBatch.swap(_rtcpQueue);
+        }
+        
+        sendBatch(_rtpSocket, _rtpBatch);
+        sendBatch(_rtcpSocket, _rtcpBatch);
+        
+        // Packets are released, the capacity is kept
+        _rtpBatch.clear();
+        _rtcpBatch.clear();
+    }
+
+    void RtpMux::sendBatch(UdpSocket& socket, std::vector<Datagram>& queue)
+    {
+        if(queue.empty() || socket.m_socket == INVALID_SOCKET)
+        {
+            return;
+        }
+        
+        if(pputil::Capture::enabled())
+        {
+            for(std::vector<Datagram>::iterator it = queue.begin(); it != queue.end(); ++it)
+            {
+                pputil::Capture::udp(socket.m_local, it->peer, it->packet->data(), it->packet->size());
+            }
+        }
+        
+    #ifdef __linux__
+        struct mmsghdr msgs[BATCH_SIZE];
+        struct iovec iovs[BATCH_SIZE];
+        
+        size_t i = 0;
+        while(i < queue.size())
+        {
+            size_t count = std::min(queue.size() - i, (size_t)BATCH_SIZE);
+            memset(msgs, 0, sizeof(msgs[0]) * count);
+            for(size_t j = 0; j < count; ++j)
+            {
+                Datagram& d = queue[i + j];
+                iovs[j].iov_base = d.packet->data();
+                iovs[j].iov_len = d.packet->size();
+                msgs[j].msg_hdr.msg_name = &d.peer;
+                msgs[j].msg_hdr.msg_namelen = sizeof(d.peer);
+                msgs[j].msg_hdr.msg_iov = &iovs[j];
+                msgs[j].msg_hdr.msg_iovlen = 1;
+            }
+            
+            int sent = sendmmsg(socket.m_socket, msgs, (unsigned int)count, 0);
+            if(sent <= 0)
+            {
+                if(sent < 0 && pputil::interrupted())
+                {
+                    continue;
+                }
+                
+                // Drop the failed datagram, as sendto() would
+                sent = 1;
+            }
+            i += sent;
+        }
+    #else
+        for(std::vector<Datagram>::iterator it = queue.begin(); it != queue.end(); ++it)
+        {
+            sendto(socket.m_socket, (const char*)it->packet->data(), it->packet->size(), 0, 
+                   (sockaddr*)&it->peer, sizeof(it->peer));
+        }
+    #endif
+    }
+
+    void RtpMux::preparePoll(pputil::PollSet& fds)
+    {
+        if(_rtcpSocket.m_socket != INVALID_SOCKET)
+        {
+            _rtcpPoll = fds.add(_rtcpSocket.m_socket);
+        }
+        
+        // Clients may send to RTP port to open NAT bindings
+        if(_rtpSocket.m_socket != INVALID_SOCKET)
+        {
+            _rtpPoll = fds.add(_rtpSocket.m_socket);
+        }
+    }
+
+    void RtpMux::handlePoll(const pputil::PollSet& fds)
+    {
+        if(_rtcpSocket.m_socket != INVALID_SOCKET && fds.readable(_rtcpPoll, _rtcpSocket.m_socket))
+        {
+            if(_rtcpSocket.receive(_batch) > 0)
+            {
+                dispatch(_batch);
+            }
+        }
+        
+        // Keep-alives are dropped
+        if(_rtpSocket.m_socket != INVALID_SOCKET && fds.readable(_rtpPoll, _rtpSocket.m_socket))
+        {
+            _rtpSocket.receive(_batch);
+        }
+    }
+
+    void RtpMux::dispatch(const UdpBatch& batch)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        
+        for(size_t i = 0; i < batch.count(); ++i)
+        {
+            const pputil::byte* b = batch.data(i);
+            size_t n = batch.size(i);
+            
+            RtspStream* stream = NULL;
+            uint64_t k = key(batch.from(i));
+            
+            PeerMap::iterator it = _peers.find(k);
+            if(it != _peers.end())
+            {
+                stream = it->second;
+            }
+            else
+            {
+                // Source port changed by NAT, learn it from SSRC
+                // A source on other host is not taken, or anyone knowing
+                // the SSRC could send NACKs and BYEs to the stream
+                SsrcMap::iterator sit = _ssrcs.find(rtcpMediaSsrc(b, n));
+                if(sit != _ssrcs.end())
+                {
+                    StreamMap::iterator pit = _streams.find(sit->second);
+                    if(pit != _streams.end() && (pit->second >> 16) == (k >> 16))
+                    {
+                        stream = sit->second;
+                        rekey(stream, k);
+                    }
+                }
+            }
+            
+            if(stream != NULL)
+            {
+                stream->onRtcp(b, n, batch.timestamp(i));
+            }
+        }
+    }
+    
+}
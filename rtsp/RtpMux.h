@@ -0,0 +1,146 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_RTP_MUX_H
+#define RTSP_RTP_MUX_H
+
+#include <rtsp/UdpSocket.h>
+#include <pputil/Blob.h>
+#include <IceUtil/Mutex.h>
+
+namespace rtsp
+{
+    class RtspStream;
+    
+    //
+    // A pair of UDP sockets shared by RTP streams of all sessions
+    // RTP is sent on port and RTCP on port + 1, so SETUP does not need 
+    // to bind ports, and the number of streams is not bound by fds
+    //
+    // Inbound RTCP is routed to a stream by the address it is from,
+    // or by the SSRC it reports on if the address is not known and the 
+    // host is that of the stream's peer, which then replaces its address
+    // Outbound packets are queued and sent in batches by flush()
+    //
+    class RtpMux
+    {
+    public:
+        RtpMux();
+        virtual ~RtpMux();
+        
+        // Bind RTP on port and RTCP on port + 1
+        bool init(unsigned short port);
+        void close();
+        
+        // Port of RTP, RTCP is on the next
+        unsigned short port() const;
+        
+        // A stream expecting RTCP from peer
+        void add(RtspStream* stream, const sockaddr_in& rtcpPeer);
+        
+        // SSRC of a stream, known when the stream sends its first packet
+        void bind(RtspStream* stream, uint32_t ssrc);
+        
+        // Remove a stream, called before the stream is deleted
+        void remove(RtspStream* stream);
+        
+        // Queue a packet, sent on RTP or RTCP socket by flush()
+        // A full batch is sent at once
+        void send(const pputil::BlobPtr& packet, const sockaddr_in& peer, bool rtcp = false);
+        
+        // Send all queued packets
+        void flush();
+        
+        // Receive RTCP, driven by server thread
+        void preparePoll(pputil::PollSet& fds);
+        void handlePoll(const pputil::PollSet& fds);
+        
+        // Number of streams
+        size_t size();
+        
+        // Packets queued together are sent with one system call
+        static const size_t BATCH_SIZE = 64;
+        
+    protected:
+        struct Datagram
+        {
+            pputil::BlobPtr packet;
+            sockaddr_in peer;
+        };
+        
+        void sendBatch(UdpSocket& socket, std::vector<Datagram>& queue);
+        
+        // Route received RTCP to streams, under one lock for the batch
+        void dispatch(const UdpBatch& batch);
+        
+        // Host in the high bits, port in the low 16
+        static uint64_t key(const sockaddr_in& addr);
+        
+        // Route RTCP from address of key to stream, in place of its last
+        void rekey(RtspStream* stream, uint64_t k);
+        
+        UdpSocket _rtpSocket;
+        UdpSocket _rtcpSocket;
+        UdpBatch _batch;
+        unsigned short _port;
+        
+        // Indexes of sockets in PollSet
+        size_t _rtpPoll;
+        size_t _rtcpPoll;
+        
+        // Streams by RTCP peer and by SSRC, and the peer of each stream
+        // Routing holds the lock, so a stream is not deleted while it receives
+        typedef std::map<uint64_t, RtspStream*> PeerMap;
+        typedef std::map<uint32_t, RtspStream*> SsrcMap;
+        typedef std::map<RtspStream*, uint64_t> StreamMap;
+        PeerMap _peers;
+        SsrcMap _ssrcs;
+        StreamMap _streams;
+        IceUtil::Mutex _mutex;
+        
+        // Packets are queued by any thread sending media,
+        // and sent in order by one thread at a time
+        std::vector<Datagram> _rtpQueue;
+        std::vector<Datagram> _rtcpQueue;
+        IceUtil::Mutex _queueMutex;
+        
+        // Queues are swapped with these to be sent, under the flush lock,
+        // and the capacity goes back and forth
+        std::vector<Datagram> _rtpBatch;
+        std::vector<Datagram> _rtcpBatch;
+        IceUtil::Mutex _flushMutex;
+    };
+}
+
+#endif
@@ -33,11 +33,21 @@
 // **********************************************************************
 
 #include "RtspClient.h"
+#include <pputil/Logger.h>
+#include <IceUtil/Time.h>
 
 namespace rtsp 
 {
     
+    static int64_t now()
+    {
+        return IceUtil::Time::now(IceUtil::Time::Monotonic).toMicroSeconds();
+    }
+    
     RtspClient::RtspClient()
+    : _cseq(0)
+    , _packets(0)
+    , _bytes(0)
     {
 
     }
@@ -47,12 +57,189 @@ namespace rtsp
 
     }
     
+    bool RtspClient::connect(const std::string& host, unsigned short port, bool threads)
+    {
+        if(_fd != INVALID_SOCKET)
+        {
+            return false;
+        }
+        
+        try
+        {
+            // Socket is closed by doConnect() when connect fails
+            SOCKET fd = pputil::createTcpSocket();
+            
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_addr.s_addr = inet_addr(host.c_str());
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            
+            if(!pputil::doConnect(fd, addr))
+            {
+                pputil::closeSocket(fd);
+                return false;
+            }
+            _fd = fd;
+            
+            pputil::setTcpNoDelay(_fd);
+            if(!threads)
+            {
+                pputil::setBlock(_fd, false);
+            }
+        }
+        catch(pputil::SocketException& ex)
+        {
+            PP_LOG_ERROR("Connect to {}:{} failed: {}", host, port, ex.toString());
+            return false;
+        }
+        
+        return threads ? receive() : true;
+    }
+    
+    int RtspClient::options(const std::string& url)
+    {
+        return request("OPTIONS", url);
+    }
+    
+    int RtspClient::describe(const std::string& url)
+    {
+        return request("DESCRIBE", url);
+    }
+    
+    int RtspClient::setup(const std::string& url, const std::string& transport)
+    {
+        return request("SETUP", url, transport);
+    }
+    
+    int RtspClient::play(const std::string& url)
+    {
+        return request("PLAY", url);
+    }
+    
+    int RtspClient::getParameter(const std::string& url)
+    {
+        return request("GET_PARAMETER", url);
+    }
+    
+    int RtspClient::teardown(const std::string& url)
+    {
+        return request("TEARDOWN", url);
+    }
+    
+    std::string RtspClient::session()
+    {
+        IceUtil::Mutex::Lock lock(_requestsMutex);
+        return _session;
+    }
+    
+    size_t RtspClient::outstanding()
+    {
+        IceUtil::Mutex::Lock lock(_requestsMutex);
+        return _pending.size();
+    }
+    
+    uint64_t RtspClient::packets()
+    {
+        return _packets;
+    }
+    
+    uint64_t RtspClient::bytes()
+    {
+        return _bytes;
+    }
+    
+    // Request is taken from pool of the connection, and queued 
+    // with its send time to be matched by CSeq of response
+    int RtspClient::request(const char* method, const std::string& url, const std::string& transport)
+    {
+        IceUtil::Mutex::Lock lock(_requestsMutex);
+        
+        RtspRequest* pmsg = pool().request();
+        pmsg->setMethod(method);
+        pmsg->setUrl(url);
+        pmsg->setVersion("1.0");
+        
+        int cseq = ++_cseq;
+        pmsg->setHeader("CSeq", (uint64_t)cseq);
+        if(!_session.empty())
+        {
+            pmsg->setHeader("Session", _session);
+        }
+        if(!transport.empty())
+        {
+            pmsg->setHeader("Transport", transport);
+        }
+        
+        Pending pending;
+        pending.cseq = cseq;
+        pending.method = method;
+        pending.sent = now();
+        _pending.push_back(pending);
+        
+        bool sent = sendRequest(pmsg);
+        pool().release(pmsg);
+        
+        if(!sent)
+        {
+            _pending.pop_back();
+            return -1;
+        }
+        return cseq;
+    }
+    
     void RtspClient::onResponse(RtspResponse* msg)
+    {
+        int cseq = atoi(msg->header("CSeq").c_str());
+        Pending pending;
+        {
+            IceUtil::Mutex::Lock lock(_requestsMutex);
+            
+            // Responses come in order, earlier requests without one are dropped
+            while(!_pending.empty() && _pending.front().cseq != cseq)
+            {
+                _pending.pop_front();
+            }
+            
+            if(_pending.empty())
+            {
+                return;
+            }
+            
+            pending = _pending.front();
+            _pending.pop_front();
+            
+            // Session: <id>[;timeout=n], ended by TEARDOWN
+            std::string session = msg->header("Session");
+            if(strcmp(pending.method, "TEARDOWN") == 0)
+            {
+                _session.clear();
+            }
+            else if(!session.empty())
+            {
+                _session = session.substr(0, session.find(';'));
+            }
+        }
+        
+        onReply(pending.method, msg, now() - pending.sent);
+    }
+    
+    void RtspClient::onData(int channel, const pputil::byte* b, size_t n)
+    {
+        if(channel % 2 == 0)
+        {
+            _packets++;
+            _bytes += n;
+        }
+        onPacket(channel, b, n);
+    }
+    
+    void RtspClient::onReply(const char* method, RtspResponse* msg, int64_t latency)
     {
         
     }
     
-    void RtspClient::onData(Buffer* buffer)
+    void RtspClient::onPacket(int channel, const pputil::byte* b, size_t n)
     {
         
     }
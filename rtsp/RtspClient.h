@@ -36,6 +36,7 @@
 #define RTSP_RTSP_CLIENT_H
 
 #include <rtsp/RtspConnection.h>
+#include <deque>
 
 namespace rtsp
 {
@@ -53,13 +54,65 @@ namespace rtsp
         RtspClient();
         virtual ~RtspClient(); 
         
+        // Connect to server, and start receiving with threads 
+        // With threads == false the socket is left non-blocking for a 
+        // reactor to drive (attach), like a LoadGenerator does
+        bool connect(const std::string& host, unsigned short port, bool threads = true);
+        
+        // Send requests, return CSeq, or -1 if it is not queued
+        // Session returned by SETUP is sent with requests after it
+        int options(const std::string& url);
+        int describe(const std::string& url);
+        int setup(const std::string& url, const std::string& transport);
+        int play(const std::string& url);
+        int getParameter(const std::string& url);   // Keepalive
+        int teardown(const std::string& url);
+        
+        std::string session();
+        
+        // Requests sent and not answered yet
+        size_t outstanding();
+        
+        // Interleaved RTP received, packets and bytes
+        uint64_t packets();
+        uint64_t bytes();
+        
     protected:
         
-        // Override to handle received RTSP response message 
-        // and interleaved raw data
+        // Override to handle a response, with method of its request and 
+        // microseconds since the request was queued
+        virtual void onReply(const char* method, RtspResponse* msg, int64_t latency);
+        
+        // Override to handle interleaved packets, RTP on even channels
+        // and RTCP on odd channels
+        virtual void onPacket(int channel, const pputil::byte* b, size_t n);
         
+    private:
+        
+        // From RtspConnection
         virtual void onResponse(RtspResponse* msg);
-        virtual void onData(Buffer* buffer);
+        virtual void onData(int channel, const pputil::byte* b, size_t n);
+        
+        int request(const char* method, const std::string& url, const std::string& transport = std::string());
+        
+        // Requests in the order they are sent
+        struct Pending
+        {
+            int cseq;
+            const char* method;
+            int64_t sent;
+        };
+        
+        std::deque<Pending> _pending;
+        int _cseq;
+        std::string _session;
+        
+        // Not _mutex, which is held while responses are handled, so
+        // requests can be sent from onReply()
+        IceUtil::Mutex _requestsMutex;
+        
+        uint64_t _packets;
+        uint64_t _bytes;
     };
 }
 
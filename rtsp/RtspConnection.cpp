@@ -33,44 +33,210 @@
 // **********************************************************************
 
 #include "RtspConnection.h"
+#include <pputil/Atomic.h>
+#include <pputil/Capture.h>
+#include <pputil/Logger.h>
+#include <pputil/Metrics.h>
+#include <pputil/Trace.h>
 #include "RtspServer.h"
+#include "RtspStream.h"
+#include <ctype.h>
 
 namespace rtsp
 {
+    // Messages rejected over all connections
+    static const int rejectedMetric = pputil::Metrics::instance().counter("rtsp_rejected_total", "", 
+                                                                          "Messages rejected as malformed or over limits");
 
-    RtspConnection::RtspConnection(pputil::SOCKET fd, RtspServer* server)
+    RtspConnection::RtspConnection()
+    : TcpConnection(NULL)
+    , _server(NULL)
+    , _state(RMS_READY)
+    , _message(NULL)
+    , _bodyLen(0)
+    , _headers(0)
+    , _headerBytes(0)
+    , _unanswered(0)
+    , _source(0)
+    , _sourced(false)
+    , _captured(0)
+    , _addressed(false)
+    {
+
+    }
+
+    RtspConnection::RtspConnection(SOCKET fd, RtspServer* server)
     : TcpConnection(fd, NULL)
     , _server(server)
     , _state(RMS_READY)
     , _message(NULL)
     , _bodyLen(0)
+    , _headers(0)
+    , _headerBytes(0)
+    , _unanswered(0)
+    , _source(0)
+    , _sourced(false)
+    , _captured(0)
+    , _addressed(false)
     {
         assert(_server != NULL);
     }
 
+    // Sessions are not tied to connections, their streams outlive it
     RtspConnection::~RtspConnection()
     {
+        if(_server != NULL)
+        {
+            _server->detachStreams(this);
+        }
+        
         if(_message != NULL)
         {
-            delete _message;
+            _pool.release(_message);
             _message = NULL;
         }
     }
+
+    MessagePool& RtspConnection::pool()
+    {
+        return _pool;
+    }
+    
+    void RtspConnection::setLimits(const RtspLimits& limits)
+    {
+        _limits = limits;
+    }
+    
+    uint32_t RtspConnection::source()
+    {
+        if(!_sourced)
+        {
+            struct sockaddr_in addr;
+            try
+            {
+                if(remoteAddress(addr) && addr.sin_family == AF_INET)
+                {
+                    _source = addr.sin_addr.s_addr;
+                }
+            }
+            catch(pputil::SocketException& ex)
+            {
+                
+            }
+            _sourced = true;
+        }
+        return _source;
+    }
     
     // Send interleaved data
-    bool RtspConnection::sendData(byte* b, size_t n)
+    bool RtspConnection::sendData(int channel, const pputil::BlobPtr& packet)
+    {
+        if(!packet || packet->size() == 0 || packet->size() > 0xffff)
+        {
+            return false;
+        }
+        
+        pputil::byte head[4];
+        head[0] = '$';
+        head[1] = (pputil::byte)channel;
+        head[2] = (pputil::byte)(packet->size() >> 8);
+        head[3] = (pputil::byte)packet->size();
+        
+        if(!asynSend(head, sizeof(head), packet))
+        {
+            return false;
+        }
+        
+        if(pputil::Capture::enabled())
+        {
+            capture(false, head, sizeof(head), packet->data(), packet->size());
+        }
+        return true;
+    }
+
+    void RtspConnection::addChannel(int channel, RtspStream* stream)
+    {
+        IceUtil::Mutex::Lock lock(_channelsMutex);
+        _channels[channel] = stream;
+    }
+
+    void RtspConnection::removeChannel(int channel)
+    {
+        IceUtil::Mutex::Lock lock(_channelsMutex);
+        _channels.erase(channel);
+    }
+
+    void RtspConnection::detachStreams()
+    {
+        IceUtil::Mutex::Lock lock(_channelsMutex);
+        
+        for(std::map<int, RtspStream*>::iterator it = _channels.begin(); it != _channels.end(); ++it)
+        {
+            TcpStream* stream = dynamic_cast<TcpStream*>(it->second);
+            if(stream != NULL)
+            {
+                stream->detach();
+            }
+        }
+        _channels.clear();
+    }
+
+    // Streams take a pair, RTP on the even channel and RTCP on the odd
+    int RtspConnection::freeChannel()
     {
-        Buffer b;
-        b.write8u('$');
-        b.write8u('$');
-        b.write16u(n);
-        b.writeBlob(b, n);
+        IceUtil::Mutex::Lock lock(_channelsMutex);
         
-        return send(&b);
+        int channel = 0;
+        while(_channels.find(channel + 1) != _channels.end())
+        {
+            channel += 2;
+        }
+        return channel;
+    }
+
+    // RTCP of streams, other channels are dropped
+    // Streams take it on server thread, as it updates their statistics
+    void RtspConnection::onData(int channel, const pputil::byte* b, size_t n)
+    {
+        IceUtil::Mutex::Lock lock(_channelsMutex);
+        
+        std::map<int, RtspStream*>::iterator it = _channels.find(channel);
+        if(it != _channels.end())
+        {
+            TcpStream* stream = dynamic_cast<TcpStream*>(it->second);
+            if(stream != NULL)
+            {
+                stream->queueRtcp(b, n);
+            }
+        }
+    }
+
+    void RtspConnection::onResponse(RtspResponse* msg)
+    {
+
+    }
+
+    // Send a request message
+    bool RtspConnection::sendRequest(RtspRequest* msg)
+    {
+        return sendMessage(msg);
     }
 
     // Send a response message
     bool RtspConnection::sendResponse(RtspResponse* msg)
+    {
+        PP_TRACE_SPAN("RtspConnection::sendResponse");
+
+        // One request less waiting, a response sent unasked does not count
+        uint64_t n = pputil::load(&_unanswered);
+        while(n > 0 && !pputil::compareExchange(&_unanswered, n, n - 1))
+        {
+        }
+
+        return sendMessage(msg);
+    }
+
+    bool RtspConnection::sendMessage(Message* msg)
     {
         assert(msg != NULL);
 
@@ -78,16 +244,107 @@ namespace rtsp
         std::cout << ">>> " << msg->dump();
     #endif
         
-        Buffer b;
-        msg->toBuffer(&b);
+        // Queued in order with interleaved data
+        // A shared body is queued as it is, right after the head
+        pputil::BlobPtr body = msg->bodyBlob();
+        if(body)
+        {
+            pputil::BlobPtr blobs[2];
+            blobs[0] = _pool.blob(msg->headLength());
+            msg->serializeHead(blobs[0]->data());
+            blobs[1] = body;
+            if(!asynSend(blobs, 2))
+            {
+                return false;
+            }
+            
+            if(pputil::Capture::enabled())
+            {
+                capture(false, blobs[0]->data(), blobs[0]->size(), body->data(), body->size());
+            }
+            return true;
+        }
+        
+        pputil::BlobPtr b = _pool.blob(msg->length());
+        if(msg->serialize(b->data()) != b->size() || !asynSend(NULL, 0, b))
+        {
+            return false;
+        }
+        
+        if(pputil::Capture::enabled())
+        {
+            capture(false, b->data(), b->size());
+        }
+        return true;
+    }
+    
+    // Outbound bytes are captured as they are queued, in the order 
+    // of the queue as long as one thread sends on the connection
+    void RtspConnection::capture(bool received, const pputil::byte* head, size_t headLen, 
+                                 const pputil::byte* body, size_t bodyLen)
+    {
+        {
+            IceUtil::Mutex::Lock lock(_captureMutex);
+            if(!_addressed)
+            {
+                // Ends other than IPv4 (e.g. socket pairs) are captured as 0.0.0.0:0
+                socklen_t len = sizeof(_localAddress);
+                if(getsockname(_fd, (sockaddr*)&_localAddress, &len) == SOCKET_ERROR || _localAddress.sin_family != AF_INET)
+                {
+                    memset(&_localAddress, 0, sizeof(_localAddress));
+                }
+                if(!remoteAddress(_remoteAddress) || _remoteAddress.sin_family != AF_INET)
+                {
+                    memset(&_remoteAddress, 0, sizeof(_remoteAddress));
+                }
+                _addressed = true;
+            }
+        }
         
-        return send(&b);
+        if(received)
+        {
+            pputil::Capture::tcp(_remoteAddress, _localAddress, head, headLen, body, bodyLen);
+        }
+        else
+        {
+            pputil::Capture::tcp(_localAddress, _remoteAddress, head, headLen, body, bodyLen);
+        }
     }
 
     // Called when data is received and appended to _inBuffer
     // Parse RtspRequest, forward to RtspServer to handle
     void RtspConnection::onReceive()
     {
+        PP_TRACE_SPAN("RtspConnection::onReceive");
+
+        // New bytes are after those left from the last time
+        if(pputil::Capture::enabled() && _inBuffer->size() > _captured)
+        {
+            capture(true, _inBuffer->read_pos() + _captured, _inBuffer->size() - _captured);
+        }
+
+        // Parse all complete packets in buffer
+        RTSP_MESSAGE_STATE state;
+        do
+        {
+            state = _state;
+            parse();
+        }
+        while(_state != state && _inBuffer->size() > 0);
+        
+        // Nothing is kept for a rejected peer
+        if(_state == RMS_REJECTED)
+        {
+            _inBuffer->remove(_inBuffer->size());
+        }
+        
+        _captured = _inBuffer->size();
+    }
+
+    void RtspConnection::parse()
+    {
+        PP_TRACE_SPAN("RtspConnection::parse");
+
         switch(_state) 
         {
             case RMS_READY:
@@ -111,32 +368,52 @@ namespace rtsp
         
         if(_state == RMS_READ_OK)
         {
+            // Peer sending requests faster than they are answered
+            if(_server != NULL && _message->type() == REQUEST_MESSAGE && 
+               pputil::fetchAdd(&_unanswered, (uint64_t)1) >= _limits.maxPipeline)
+            {
+                reject(503, "too many pipelined requests");
+                return;
+            }
             onMessage();
         }
     }
       
-    // First two bytes marks the type of data
-    // $$ leads to a raw data packet (2 bytes dataLen + data)
-    // otherwise RTSP message packet
+    // First byte marks the type of data
+    // '$' leads to an interleaved data packet 
+    // ('$' + 1 byte channel + 2 bytes dataLen + data)
+    // otherwise RTSP message packet, which starts with a method, 
+    // "RTSP/" or a blank line, anything else (e.g. TLS) is rejected
     void RtspConnection::readType()
     {
         assert(_state == RMS_READY);
         assert(_message == NULL);
-        assert(_dataLen == 0);
+        assert(_bodyLen == 0);
         
         if(_inBuffer->size() >= 1)
         {
-            m_state = (_inBuffer->peek8u() == '$') ? RMS_READ_DATA : RMS_READ_INITIAL;
+            int c = _inBuffer->peek8u();
+            if(c == '$')
+            {
+                _state = RMS_READ_DATA;
+            }
+            else if(isalpha(c) || c == '\r' || c == '\n')
+            {
+                _state = RMS_READ_INITIAL;
+            }
+            else
+            {
+                reject(400, "not a RTSP message");
+            }
         }
     }
 
-    // Read raw data packet  
+    // Read interleaved data packet  
     void RtspConnection::readData()
     {
         assert(_state == RMS_READ_DATA);
         assert(_inBuffer->peek8u() == '$');
         assert(_message == NULL);
-        assert(_dataLen == 0);
        
         // Check data length and availability in buffer
         if(_inBuffer->size() < 4)
@@ -144,18 +421,14 @@ namespace rtsp
            return;
         }
 
-        size_t dataLen = _inBuffer->peek16u(2);
-        assert(dataLen > 0);
+        // Length in network order
+        int channel = _inBuffer->peek8u(1);
+        size_t dataLen = ((size_t)_inBuffer->peek8u(2) << 8) | _inBuffer->peek8u(3);
 
         if(_inBuffer->size() >= dataLen + 4)
         {
-           // Read data
-           _inBuffer.remove(4);
-
-           Buffer dataBuffer;
-           dataBuffer.writeBlob(_inBuffer->read_pos(), dataLen);
-           onData(&dataBuffer);
-
+           _inBuffer->remove(4);
+           onData(channel, _inBuffer->read_pos(), dataLen);
            _inBuffer->remove(dataLen);
            
            _state = RMS_READY;
@@ -165,96 +438,158 @@ namespace rtsp
     // Read initial line of RTSP message
     // Request: <verb> <url> RTSP/1.0
     // Response: RTSP/1.0 <code> <reason>
-    void RtspConnection::ReadInitial()
+    // Message is taken from pool, and the line is read into a member 
+    // string, so a request costs no allocation once they are warm
+    void RtspConnection::readInitial()
     {
         assert(_state == RMS_READ_INITIAL);
         assert(_message == NULL);
         assert(_bodyLen == 0);
         
-        try
+        // Read a line
+        if(!_inBuffer->readLine(_line))
         {
-            // Read a line
-            std::string initialLine = _inBuffer->readLine();
-            assert(!initialLine.empty());
-
-            // Split sring with space
-            std::istringstream iss(initialLine);
-            std::string sVerb;
-            iss >> sVerb;
-
-            if(sVerb.substr(0,4) == "RTSP")
+            // There is no complete line
+            if(_inBuffer->size() > _limits.maxLine)
             {
-                // Response: RTSP/#.# <code> <reason>
-                std::string sCode;
-                iss >> sCode;
-
-                RtspResponse* pmsg = new RtspResponse();
-                pmsg->setStatus(atoi(sCode.c_str()));
-                _message = pmsg;
+                reject(414, "initial line too long");
             }
-            else
+            return;
+        }
+        
+        // Empty lines between messages are skipped
+        if(_line.empty())
+        {
+            _state = RMS_READY;
+            return;
+        }
+        
+        if(_line.size() > _limits.maxLine)
+        {
+            reject(414, "initial line too long");
+            return;
+        }
+        _headers = 0;
+        _headerBytes = _line.size() + 2;
+        
+        // Split with spaces
+        size_t p1 = _line.find(' ');
+        size_t p2 = p1 == std::string::npos ? std::string::npos : _line.find(' ', p1 + 1);
+        
+        if(_line.compare(0, 5, "RTSP/") == 0)
+        {
+            // Response: RTSP/#.# <code> <reason>
+            RtspResponse* pmsg = _pool.response();
+            int code = p1 == std::string::npos ? 0 : atoi(_line.c_str() + p1 + 1);
+            pmsg->setStatus(code, p2 == std::string::npos ? std::string() : _line.substr(p2 + 1));
+            _message = pmsg;
+        }
+        else
+        {
+            // Request: <verb> <url> RTSP/#.#
+            RtspRequest* pmsg = _pool.request();
+            pmsg->setMethod(_line.data(), p1 == std::string::npos ? _line.size() : p1);
+            if(p1 != std::string::npos)
             {
-                // Request: <verb> <url> RTSP/#.#
-                std::string sUrl;
-                iss >> sUrl;
-
-                RtspRequest* pmsg = new RtspRequest();
-                pmsg->setMethod(sVerb);
-                pmsg->setUrl( sUrl );
-                m_message = pmsg;
+                size_t end = p2 == std::string::npos ? _line.size() : p2;
+                pmsg->setUrl(_line.data() + p1 + 1, end - p1 - 1);
             }
-            
-            _state = RMS_READ_HEADER;
+            _message = pmsg;
         }
-        catch(OutofBoundException& ex)
+        
+        _state = RMS_READ_HEADER;
+    }
+
+    // Content-Length, digits with trailing spaces, absent is 0
+    // A length over limit is given as limit + 1
+    static bool parseLength(const std::string& s, size_t limit, size_t& n)
+    {
+        size_t end = s.size();
+        while(end > 0 && (s[end - 1] == ' ' || s[end - 1] == '\t'))
         {
-            // There is no complete line
+            end--;
         }
+        
+        n = 0;
+        for(size_t i = 0; i < end; ++i)
+        {
+            if(!isdigit((unsigned char)s[i]))
+            {
+                return false;
+            }
+            n = n <= limit ? n * 10 + (s[i] - '0') : n;
+        }
+        
+        if(n > limit)
+        {
+            n = limit + 1;
+        }
+        return true;
     }
 
     // Read header lines
     // Read each complete line, until a blank line
-    bool RtspConnection::readHeader()
+    // Lines, their number and bytes are checked as they come, so a 
+    // message over limits is rejected before it is buffered
+    void RtspConnection::readHeader()
     {
-        assert(_state == RTSP_READ_HEADER);
+        assert(_state == RMS_READ_HEADER);
         assert(_message != NULL);
         assert(_bodyLen == 0);
 
         // Read all complete lines
-        while(true)
+        while(_inBuffer->readLine(_line))
         {
-            try
+            _headerBytes += _line.size() + 2;
+            if(_line.size() > _limits.maxLine || _headerBytes > _limits.maxHeaderBytes)
             {
-                std::string line = buffer->readLine();
-                
-                if(line.empty())
-                {
-                    // Separator line of headers and body
-                    std::string sBodyLen = _message->header("Content-Length");
-                    _bodyLen = atoi(sBodyLen.c_str());
-                    _state = _bodyLen > 0 ? RMS_READ_BODY : RMS_READ_OK;
-                    break;
-                }
-                else if(line.size() > 512)
+                reject(400, "header too long");
+                return;
+            }
+            
+            if(_line.empty())
+            {
+                // Separator line of headers and body
+                if(!parseLength(_message->header("Content-Length"), _limits.maxBody, _bodyLen))
                 {
-                   // Line is too long
-                   std::cout << "RtspConnection::readHeader() too long line.\n";
+                    reject(400, "bad Content-Length");
+                    return;
                 }
-                else
+                if(_bodyLen > _limits.maxBody)
                 {
-                    // Key and value
-                    size_t pos = line.find(":");
-                    assert(pos != std::string::npos);
-                    std::string key = line.substr(0, pos);
-                    std::string value = line.substr(pos + 1);
-                    _message->setHeader(key, value);
+                    reject(413, "body too large");
+                    return;
                 }
+                _state = _bodyLen > 0 ? RMS_READ_BODY : RMS_READ_OK;
+                return;
             }
-            catch(OutOfBoundsException& ex)
+            
+            if(++_headers > _limits.maxHeaders)
             {
-                // There is no complete line
-                break;
+                reject(400, "too many headers");
+                return;
+            }
+            
+            // Key and value, with leading spaces of value skipped
+            size_t pos = _line.find(':');
+            if(pos == std::string::npos || pos == 0)
+            {
+                reject(400, "header without name");
+                return;
+            }
+            
+            size_t value = pos + 1;
+            while(value < _line.size() && _line[value] == ' ')
+            {
+                value++;
             }
+            _message->addHeader(_line.data(), pos, _line.data() + value, _line.size() - value);
+        }
+        
+        // Part of a line waiting for the rest
+        if(_inBuffer->size() > _limits.maxLine || _headerBytes + _inBuffer->size() > _limits.maxHeaderBytes)
+        {
+            reject(400, "header too long");
         }
     }
 
@@ -264,9 +599,11 @@ namespace rtsp
         assert(_message != NULL);
         assert(_bodyLen > 0);
         
-        if(_inBuffer.size() >= _bodyLen)
+        if(_inBuffer->size() >= _bodyLen)
         {
-            _message->setBody(_inBuffer->read_pos(), _bodyLen);
+            // Body is handed to handler as a shared blob, which it may 
+            // keep (ANNOUNCE) or send on (SET_PARAMETER) without copying
+            _message->setBody(new pputil::Blob(_inBuffer->read_pos(), _bodyLen));
             _inBuffer->remove(_bodyLen);
             
             _state = RMS_READ_OK;
@@ -277,7 +614,9 @@ namespace rtsp
     // Forward to RtspServer
     void RtspConnection::onMessage()
     {
-        assert(_state = RMS_READ_OK);
+        PP_TRACE_SPAN("RtspConnection::onMessage");
+
+        assert(_state == RMS_READ_OK);
         assert(_message != NULL);
         
     #ifdef _DEBUG
@@ -288,9 +627,12 @@ namespace rtsp
         {
             case REQUEST_MESSAGE:
             {
-                assert(_server != NULL);
-                RtspRequest* pmsg = dynamic_cast<RtspRequest*>(_message);
-                _server->onRequest(pmsg, this);
+                // Requests from server to client are not handled
+                if(_server != NULL)
+                {
+                    RtspRequest* pmsg = dynamic_cast<RtspRequest*>(_message);
+                    _server->onRequest(pmsg, this);
+                }
                 break;
             }
             case RESPONSE_MESSAGE:
@@ -304,10 +646,44 @@ namespace rtsp
                 break;
         }
 
-        delete _message; 
+        _pool.release(_message); 
         _message = NULL;
         _bodyLen = 0;
         _state = RMS_READY;
     }
 
+    void RtspConnection::reject(int code, const char* reason)
+    {
+        PP_LOG_WARN("RTSP message rejected, {}, {} bytes buffered", reason, _inBuffer->size());
+        pputil::Metrics::instance().add(rejectedMetric);
+        
+        // Peer of a client connection is a server, it is just not read
+        if(_server != NULL)
+        {
+            RtspResponse* pResponse = _pool.response();
+            pResponse->setStatus(code);
+            pResponse->setVersion("1.0");
+            if(_message != NULL)
+            {
+                pResponse->setHeader("CSeq", _message->header("CSeq"));
+            }
+            pResponse->setHeader("Connection", "close");
+            sendMessage(pResponse);
+            _pool.release(pResponse);
+        }
+        
+        if(_message != NULL)
+        {
+            _pool.release(_message);
+            _message = NULL;
+        }
+        _bodyLen = 0;
+        _state = RMS_REJECTED;
+        
+        // Called while received data is handled, with _mutex locked
+        // Server closes the connection as a zombie once the response 
+        // is written
+        closeAfterSend();
+    }
+
 }
\ No newline at end of file
@@ -36,6 +36,9 @@
 #define RTSP_RTSP_CONNECTION_H
 
 #include <pputil/TcpConnection.h>
+#include <pputil/Blob.h>
+#include <rtsp/RtspMessage.h>
+#include <rtsp/MessagePool.h>
 
 namespace rtsp
 {
@@ -45,12 +48,37 @@ namespace rtsp
     //
     
     class RtspServer;
+    class RtspStream;
+    
+    //
+    // Bounds of what a peer may send on a connection
+    // A message over them is answered with an error, and the connection 
+    // is closed without reading more, so a connection holds at most 
+    // about maxHeaderBytes or maxBody bytes, whatever the peer sends
+    //
+    struct RtspLimits
+    {
+        RtspLimits()
+        : maxLine(4096)
+        , maxHeaders(64)
+        , maxHeaderBytes(16 * 1024)
+        , maxBody(64 * 1024)
+        , maxPipeline(32)
+        {
+        }
+        
+        size_t maxLine;         // Bytes of initial or a header line
+        size_t maxHeaders;      // Header lines of a message
+        size_t maxHeaderBytes;  // Bytes of initial and header lines
+        size_t maxBody;         // Content-Length
+        size_t maxPipeline;     // Requests received and not answered yet
+    };
     
     class RtspConnection : public pputil::TcpConnection
     {
     public:
         RtspConnection(); // For client 
-        RtspConnection(pputil::SOCKET fd, RtspServer* server); // For server
+        RtspConnection(SOCKET fd, RtspServer* server); // For server
         virtual ~RtspConnection();
 
         // For client, send request to server
@@ -59,13 +87,51 @@ namespace rtsp
         // For server, send response to client
         // send interleaved data to client
         bool sendResponse(RtspResponse* msg);
-        bool sendData(byte* b, size_t n);
+        
+        // Interleaved data (RFC 2326, 10.12), '$' + channel + 16-bit length
+        // The packet is queued with the header, not copied
+        bool sendData(int channel, const pputil::BlobPtr& packet);
+        
+        // Interleaved data received on channel goes to stream as RTCP
+        void addChannel(int channel, RtspStream* stream);
+        void removeChannel(int channel);
+        
+        // Streams on channels stop using the connection, it is deleted
+        // Called with sessions of the server locked
+        void detachStreams();
+        
+        // A pair of channels not bound to streams yet
+        int freeChannel();
+        
+        // Messages of this connection, requests parsed and responses 
+        // sent to them are taken from here and given back
+        MessagePool& pool();
+        
+        // Bounds of messages received, set before receiving
+        void setLimits(const RtspLimits& limits);
+        
+        // IPv4 address of the peer (network order), 0 if it is not
+        // Taken once, on the receiving thread
+        uint32_t source();
+        
+    protected:
+        // For client, receive data and response
+        virtual void onData(int channel, const pputil::byte* b, size_t n);
+        virtual void onResponse(RtspResponse* msg);
         
     private:
         // From Connection
         virtual void onReceive();
+        
+        // Serialize and queue a message
+        bool sendMessage(Message* msg);
+        
+        // Bytes received or queued, written to capture when it is open
+        void capture(bool received, const pputil::byte* head, size_t headLen, 
+                     const pputil::byte* body = NULL, size_t bodyLen = 0);
             
         // Parse packet
+        void parse();
         void readType();
         void readData();
         void readInitial();
@@ -73,9 +139,9 @@ namespace rtsp
         void readBody();
         void onMessage();
         
-        // For client, receive data and response
-        virtual onData(Buffer* buffer) = 0;
-        virtual onResponse(RtspResponse* msg) = 0;
+        // Answer a message over limits or malformed with code (server side),
+        // and stop reading, the connection is closed by its server
+        void reject(int code, const char* reason);
 
     private:
         // Owner RTSP server
@@ -89,7 +155,8 @@ namespace rtsp
             RMS_READ_INITIAL, // Reading initial line of request or response
             RMS_READ_HEADER,  // Reading header lines
             RMS_READ_BODY,    // Reading body
-            RMS_READ_OK       // Complete a message packet
+            RMS_READ_OK,      // Complete a message packet
+            RMS_REJECTED      // Rejected, the rest is dropped
         };
 
         RTSP_MESSAGE_STATE _state;
@@ -97,6 +164,28 @@ namespace rtsp
         // Incoming Message packet
         Message* _message;  // RtspRequest or RtspResponse message
         size_t _bodyLen;	// Length of body
+        std::string _line;  // Line being parsed
+        MessagePool _pool;
+        
+        RtspLimits _limits;
+        size_t _headers;        // Header lines of incoming message
+        size_t _headerBytes;    // and bytes of its lines
+        uint64_t _unanswered;   // Requests not answered yet, by any thread
+        
+        uint32_t _source;
+        bool _sourced;
+        
+        // Bytes in _inBuffer written to capture already, and addresses 
+        // of both ends, taken when the first bytes are captured
+        size_t _captured;
+        sockaddr_in _localAddress;
+        sockaddr_in _remoteAddress;
+        bool _addressed;
+        IceUtil::Mutex _captureMutex;
+        
+        // Streams by channel of their RTCP
+        std::map<int, RtspStream*> _channels;
+        IceUtil::Mutex _channelsMutex;
     };
 }
 
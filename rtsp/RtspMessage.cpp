@@ -38,18 +38,15 @@ namespace rtsp
 {
 
     RtspRequest::RtspRequest() 
-    : _protocol("RTSP")
-    , _method("");
+    : RequestMessage()
     {
-
+        _protocol = "RTSP";
     }
 
     RtspRequest::RtspRequest(const std::string& version) 
     : RequestMessage(version)
-    , _protocol("RTSP")
-    , _method("");
     {
-     
+        _protocol = "RTSP";
     }
 
     RtspRequest::~RtspRequest()
@@ -60,16 +57,15 @@ namespace rtsp
     //////////////////////////////////////////////////////////////////////////////////
 
     RtspResponse::RtspResponse() 
-    : _protocol("RTSP")
+    : ResponseMessage()
     {
-
+        _protocol = "RTSP";
     }
 
     RtspResponse::RtspResponse(const std::string& version) 
     : ResponseMessage(version)
-    : _protocol("RTSP")
     {
-
+        _protocol = "RTSP";
     }
 
     RtspResponse::~RtspResponse()
@@ -81,7 +77,7 @@ namespace rtsp
     struct RtspResponseStatus 
     { 
         int code; 
-        char* reason; 
+        const char* reason; 
     };
 
     // These must be sorted
@@ -140,7 +136,7 @@ namespace rtsp
 
     static const size_t s_nRtspStatus = sizeof(s_pRtspStatus)/sizeof(RtspResponseStatus) - 1;
 
-    std::string RtspResponse::code2reason(UINT code)
+    std::string RtspResponse::code2reason(int code)
     {
         int hi = s_nRtspStatus;
         int lo = -1;
@@ -148,13 +144,13 @@ namespace rtsp
         while(hi - lo > 1)
         {
             mid = (hi + lo)/2;
-            if(_code <= s_pRtspStatus[mid].code)
+            if(code <= s_pRtspStatus[mid].code)
                 hi = mid;
             else
                 lo = mid;
         }
 
-        if(_code == s_pRtspStatus[hi].code)
+        if(hi < (int)s_nRtspStatus && code == s_pRtspStatus[hi].code)
         {
             return s_pRtspStatus[hi].reason;
         }
@@ -1,491 +1,1310 @@
-// **********************************************************************
-//
-// Copyright (c) 2011, PPEngine
-// 
-// Redistribution and use in source and binary forms, with or without
-// modification, are permitted provided that the following conditions are
-// met:
-// 
-//   * Redistributions of source code must retain the above copyright
-//     notice, this list of conditions and the following disclaimer.
-// 
-//   * Redistributions in binary form must reproduce the above copyright
-//     notice, this list of conditions and the following disclaimer in
-//     the documentation and/or other materials provided with the
-//     distribution.
-// 
-//   * Neither the name of Google nor the names of its contributors may
-//     be used to endorse or promote products derived from this software
-//     without specific prior written permission.
-// 
-// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
-// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
-// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
-// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
-// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
-// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
-// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
-// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-// 
-// **********************************************************************
-
-#include "RtspServer.h"
-
-namespace rtsp
-{
-
-    RtspServer::RtspServer(unsigned short port, bool passive)
-    : TcpServer(port, passive)
-    {
-
-    }
-
-    RtspServer::~RtspServer()
-    {
-        if(_sessions.size() > 0)
-        {
-            std::cout << "Rtsp Server is not shutdown before delete.\n";
-            shutdown();	
-        }
-    }
-    
-    // Override to clear sessions when shutdown
-    void RtspServer::doShutdown()
-    {
-        // Shutdown Tcp Server
-        TcpServer::doShutdown();
-        
-        // Clear RtspSessions
-        for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); ++it)
-        {
-            RtspSession* p = *it;
-            assert(p != NULL);;
-            if(p != NULL)
-            {
-                p->close();
-                delete p;
-            }
-        }
-        _sessions.clear();
-    }
-
-    // Override to run sessions
-    bool RtspServer::doRun()
-    {
-        // Schedule streaming over sessions
-        // If a session work failed, close the session
-        for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); )
-        {
-            RtspSession* p = *it;
-            assert(p != NULL);
-
-            if(!p->run())
-            {
-                p->close();
-                delete p;
-                it = _sessions.erase(it);
-            }
-            else
-            {
-                ++it;
-            }
-        }
-        
-        // Run tcp server
-        return TcpServer::doRun();
-    }
-    
-    TcpConnection* RtspServer::createConnection(SOCKET fd)
-    {
-        return new RtspConnection(fd, this);
-    }
-
-    void RtspServer::removeSession(const std::string& sid)
-    {
-        for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); )
-        {
-            RtspSession* p = *it;
-            if(p != NULL && p->sid() == sid)
-            {
-                p->close();
-                delete p;
-                it = _sessions.erase(it);
-            }
-            else
-            {
-                ++it;
-            }
-        }
-    }
-
-    // Close all sessions related to the given media
-    void RtspServer::removeMedia(const std::string& mid)
-    {
-        for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); )
-        {
-            RtspSession* p = *it;
-            if(p != NULL && p->mid() == mid)
-            {
-                p->close();
-                delete p;
-                it = _sessions.erase(it);
-            }
-            else
-            {
-                ++it;
-            }
-        }
-    }
-
-    RtspSession* RtspServer::findSession(const std::string& sid)
-    {
-        for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); )
-        {
-            RtspSession* p = *it;
-            if(p != NULL && p->sid() == sid)
-            {
-                return p;
-            }
-        }
-        
-        return NULL;
-    }
-    
-    // Receive Rtsp request
-    void onRequest(RtspRequest* msg, RtspConnection* conn)
-    {
-        assert(msg != NULL);
-        assert(conn != NULL);
-        assert(msg->type() == REQUEST_MESSAGE);
-
-        switch(msg->method())
-        {
-            case VERB_OPTIONS:  OnOptionsRequest( msg, conn );	break;
-            case VERB_DESCRIBE: OnDescribeRequest( msg, conn );	break;
-            case VERB_GETPARAM: OnGetParamRequest( msg, conn );	break;
-            case VERB_SETPARAM: OnSetParamRequest( msg, conn );	break;
-            case VERB_PAUSE:    OnPauseRequest( msg, conn );	break;
-            case VERB_PLAY:     OnPlayRequest( msg, conn );		break;
-            case VERB_SETUP:    OnSetupRequest( msg, conn );	break;
-            case VERB_TEARDOWN: OnTeardownRequest( msg, conn );	break;
-            default: assert(false);                             break;
-        }
-    }
-
-    // Query supported commands
-    // Not affect session state
-    void RtspServer::OnOptionsRequest(RtspRequest* pmsg, RtspConnection* conn)
-    {
-        assert(pmsg != NULL);
-        assert(conn != NULL);
-
-        RtspResponse *pResponse	= new RtspResponse();
-
-        pResponse->setStatus(200);
-        pResponse->setVersion("1.0");
-        pResponse->setHeader("CSeq", pmsg->header("CSeq"));
-
-        pResponse->setHeader("Server", "Helix Server Version 9.0.8.1427 (linux-2.2-libc6-i586-server) (RealServer compatible)");
-        pResponse->setHeader("Public", "OPTIONS, DESCRIBE, SETUP, GET_PARAMETER, SET_PARAMETER, PLAY, PAUSE, TEARDOWN");
-        
-        pResponse->setHeader("RealChallenge1", "d12f6756d0027a12ee0afbfd64a5cedd");
-
-        conn->sendResponse(pResponse);
-        delete pResponse;
-    }
-
-    // Query SDP of media
-    // Not affect session state
-    void RtspServer::OnDescribeRequest(RtspRequest* pmsg, RtspConnection* conn)
-    {
-        assert(pmsg != NULL);
-        assert(conn != NULL);
-
-        // URL: rtsp://127.0.0.1:9960/3012
-        std::string url = pmsg->url(); 
-        int midStartPos = url.rfind("/");
-        std::string mid = url.substr(midStartPos + 1);
-        
-        // SDP
-        std::string sdp = mediaSDP(mid);
-        assert(!sdp.empty());
-
-        std::ostringstream oss;
-        oss << sdp.size();
-        std::string sdpLen = oss.str();
-
-        // Response
-        RtspResponse *pResponse	= new RtspResponse();
-        
-        pResponse->setStatus(200);
-        pResponse->setVersion("1.0");
-        pResponse->setHeader("CSeq", pmsg->header("CSeq"));    
-        pResponse->setHeader("Content-base", url);
-        pResponse->setHeader("Content-type","application/sdp");
-        pResponse->setHeader("Content-length",sdpLen);
-        pResponse->setBody((byte*)sdp.c_str(),sdp.size());
-
-        conn->sendResponse(pResponse);
-        delete pResponse;
-    }
-
-    // Rtsp SETUP request
-    // Negotiation to establish a session and the streams in the session
-    void RtspServer::OnSetupRequest(RtspRequest* pmsg, RtspConnection* conn)
-    {	
-        assert(pmsg != NULL);
-        assert(conn != NULL);
-
-        // URL: rtsp://127.0.0.1:9960/3201/(rtx/audio/video)
-        std::string url = pmsg->url(); 
-
-        // mid and stream name
-        int urlEndPos = url.rfind("/");
-        std::string streamName = url.substr(urlEndPos + 1);
-        url = url.erase(urlEndPos);
-        int midStartPos = url.rfind("/");
-        std::string mid = url.substr(midStartPos + 1);
-
-        // Session
-        std::string sid = pmsg->header("Session");
-        RtspSession* pSession = NULL;
-
-        // Session exist already
-        if(!sid.empty())
-        {
-            pSession = findSession(sid);
-            if(pSession != NULL)
-            {
-                assert(mid == pSession->mid());
-            }
-        }
-
-        // Create new session
-        if(pSession == NULL)
-        {
-            m_sid ++;
-            std::ostringstream oss;
-            oss << m_sid;
-            sid = oss.str();
-
-            // Create new session
-            pSession = createSession(sid, mid);
-            if(pSession != NULL)
-            {
-                m_sessions.push_back(pSession);
-            }
-        }
-
-        assert(pSession != NULL);
-
-        // Setup stream for session
-        unsigned short serverPort = m_port + 10;
-
-        unsigned short  clientPort = 0;
-        int nPorts = 0;
-        std::string strTran = pmsg->header( "Transport" );
-        CRequestTransportHdr rqtHdr(strTran);
-        rqtHdr.GetBasePort(&clientPort, &nPorts );
-
-        if( rqtHdr.CanUDP() )
-        {
-            // Over UDP
-            pSession->setupStream(streamName, serverPort, clientPort);
-        }
-        else
-        {	
-            // Over TCP
-            pSession->setupStream(streamName, conn);		
-        }
-
-        // Response
-        RtspResponse *pResponse	= new RtspResponse();
-
-        pResponse->setStatus(200);
-        pResponse->setVersion("1.0");
-        pResponse->setHeader("CSeq",pmsg->header("CSeq"));
-        pResponse->setHeader("Date","Thu, 15 Dec 2005 03:00:04 GMT");
-        pResponse->setHeader("Session", sid);
-
-        // Stream name: rtx, audio, video 
-        if( streamName == "rtx" ) 
-        {
-            pResponse->setHeader("RealChallenge3","d67b8f21bf272fd5020e9fbb08428cfa4f213d09,sdr=abcdabcd");
-
-            std::ostringstream oss;
-            oss << "RTP/AVP/UDP;unicast;server_port=" << serverPort << "-" << serverPort + 1 
-                << ";client_port=" << clientPort << "-" << clientPort + 1 << ";ssrc=f2bde83e;mode=PLAY";
-            pResponse->setHeader("Transport",oss.str());
-        } 
-        else if(streamName == "audio" )
-        {
-            pResponse->setHeader("RealChallenge3","d67b8f21bf272fd5020e9fbb08428cfa4f213d09,sdr=abcdabcd");
-            pResponse->setHeader("Transport","RTP/AVP/TCP;unicast;interleaved=2-3;ssrc=bedf8d08;mode=PLAY");
-        }
-        else if(streamName == "video" ) 
-        {
-            pResponse->setHeader("Transport","RTP/AVP/TCP;unicast;interleaved=4-5;ssrc=bedf8d2d;mode=PLAY");
-        }
-        else
-        {
-            assert(false);
-        }
-
-        conn->sendResponse(pResponse);
-        delete pResponse;
-    }
-
-
-    // Get parameter of stream 
-    void RtspServer::OnGetParamRequest(RtspRequest* pmsg, RtspConnection* conn)
-    {
-        assert(pmsg != NULL);
-        assert(conn != NULL);
-     
-        std::string sid = pmsg->header("Session");
-        
-        RtspResponse* pResponse = new RtspResponse();
-        pResponse->setStatus(200);
-        pResponse->setVersion("1.0");
-        pResponse->setHeader("CSeq", pmsg->header("CSeq"));
-        pResponse->setHeader("Session", sid);
-
-        conn->sendResponse(pResponse);
-        delete pResponse; 
-    }
-
-    // Set parameter of stream
-    void RtspServer::OnSetParamRequest(RtspRequest* pmsg, RtspConnection* conn)
-    {
-        assert(pmsg != NULL);
-        assert(conn != NULL);
-
-        std::string sid = pmsg->header("Session");
-
-        RtspResponse *	pResponse	= new RtspResponse();
-
-        std::string ping = pmsg->header("Ping");
-        if( ping.empty())
-            pResponse->setStatus(200);
-        else
-            pResponse->setStatus( 451 );
-
-        pResponse->setVersion("1.0");
-        pResponse->setHeader("CSeq", pmsg->header("CSeq"));
-        pResponse->setHeader("Session", sid);
-
-        conn->sendResponse( pResponse );
-        delete pResponse;
-    }
-
-    // Start to play
-    void RtspServer::OnPlayRequest(RtspRequest* pmsg, RtspConnection* conn)
-    {
-        assert(pmsg != NULL);
-        assert(conn != NULL);
-
-        std::string sid = pmsg->header("Session");
-
-        // Start position
-        int nStartTime = -1;
-        std::string strTime = pmsg->header("Range");
-        if( !strTime.empty() )
-        {
-            strTime = strTime.substr(4);
-            int nPos = strTime.find("-");
-            std::string strStartTime = strTime.substr(0, nPos);
-            nStartTime = atoi(strStartTime.c_str());
-        }
-
-        // Seek to pos
-        RtspSession* pSession = findSession(sid);
-        assert(pSession != NULL);
-        if(pSession != NULL)
-        {
-            pSession->seek(nStartTime);
-        }
-
-        // RTP Info
-        std::string rtpInfo;
-        if(pSession != NULL)
-        {
-            rtpInfo = pSession->streamsInfo();
-        }
-
-        // Response
-        RtspResponse* pResponse	= new RtspResponse();
-
-        pResponse->setStatus(200);
-        pResponse->setVersion("1.0");
-        pResponse->setHeader("CSeq", pmsg->header("CSeq"));
-        pResponse->setHeader("Session", sid);
-        pResponse->setHeader("RTP-Info",rtpInfo);
-
-        conn->sendResponse(pResponse);
-        delete pResponse;
-
-        // Play
-        if(pSession != NULL)
-        {
-            pSession->play(); 
-        }
-    }
-
-    void RtspServer::OnPauseRequest(RtspRequest* pmsg, RtspConnection* conn)
-    {
-        assert(pmsg != NULL);
-        assert(conn != NULL);
-
-        std::string sid = pmsg->header("Session");
-
-        // Pause
-        RtspSession* pSession = findSession(sid);
-        assert(pSession != NULL);
-        if(pSession != NULL)
-        {
-            pSession->pause();
-        }
-
-        // Response
-        RtspResponse* pResponse	= new RtspResponse();
-        pResponse->setStatus(200);
-        pResponse->setVersion("1.0");
-        pResponse->setHeader("CSeq", pmsg->header("CSeq"));
-        pResponse->setHeader("Session",sid);
-
-        conn->sendResponse(pResponse);
-        delete pResponse;
-    }
-
-    // Close session
-    void RtspServer::OnTeardownRequest(RtspRequest* pmsg, RtspConnection* conn)
-    {
-        assert(pmsg != NULL);
-        assert(conn != NULL);
-
-        std::string sid = pmsg->header("Session");
-
-        // Stop and remove
-        RtspSession* pSession = findSession(sid);
-        assert(pSession != NULL);
-        if(pSession != NULL)
-        {
-            pSession->teardown();
-            removeSession(sid);
-        }
-
-        // Response
-        RtspResponse* pResponse	= new RtspResponse();
-        pResponse->setStatus(200);
-        pResponse->setVersion("1.0");
-        pResponse->setHeader("CSeq", pmsg->header("CSeq"));
-        pResponse->setHeader("Session",sid);
-
-        conn->sendResponse(pResponse);
-        delete pResponse;
-    }
-
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "RtspServer.h"
+#include <pputil/Metrics.h>
+#include <pputil/Logger.h>
+#include <pputil/Trace.h>
+
+namespace rtsp
+{
+    // Methods of requests handled by server
+    static const char* requestMethods[] = 
+    {
+        "OPTIONS", "DESCRIBE", "GET_PARAMETER", "SET_PARAMETER", 
+        "PAUSE", "PLAY", "SETUP", "TEARDOWN"
+    };
+    
+    // b=AS: lines (kbps) of session and of each media by its a=control,
+    // and the a=control names of all media
+    static void parseBitrates(const std::string& sdp, uint64_t& session, std::map<std::string, uint64_t>& streams, std::vector<std::string>& controls)
+    {
+        session = 0;
+        streams.clear();
+        controls.clear();
+        
+        bool media = false;
+        uint64_t bitrate = 0;
+        std::string control;
+        
+        size_t pos = 0;
+        while(pos < sdp.size())
+        {
+            size_t end = sdp.find('\n', pos);
+            if(end == std::string::npos)
+            {
+                end = sdp.size();
+            }
+            std::string line = sdp.substr(pos, end - pos);
+            if(!line.empty() && line[line.size() - 1] == '\r')
+            {
+                line.erase(line.size() - 1);
+            }
+            pos = end + 1;
+            
+            if(line.compare(0, 2, "m=") == 0)
+            {
+                if(bitrate > 0 && !control.empty())
+                {
+                    streams[control] = bitrate;
+                }
+                media = true;
+                bitrate = 0;
+                control.clear();
+            }
+            else if(line.compare(0, 5, "b=AS:") == 0)
+            {
+                uint64_t kbps = strtoull(line.c_str() + 5, NULL, 10);
+                if(media)
+                {
+                    bitrate = kbps * 1000;
+                }
+                else
+                {
+                    session = kbps * 1000;
+                }
+            }
+            else if(media && line.compare(0, 10, "a=control:") == 0)
+            {
+                // Last part of the URL, as track of SETUP
+                size_t slash = line.rfind('/');
+                control = line.substr(slash != std::string::npos && slash >= 10 ? slash + 1 : 10);
+                controls.push_back(control);
+            }
+        }
+        
+        if(bitrate > 0 && !control.empty())
+        {
+            streams[control] = bitrate;
+        }
+    }
+    
+    // Path of rtsp://host:port/path, with the leading slash
+    static std::string urlPath(const std::string& url)
+    {
+        size_t scheme = url.find("://");
+        size_t path = url.find('/', scheme == std::string::npos ? 0 : scheme + 3);
+        return path == std::string::npos ? std::string("/") : url.substr(path);
+    }
+
+    RtspServer::RtspServer(unsigned short port, bool passive)
+    : TcpServer(port, passive)
+    , _sid(0)
+    , _runInterval(1000000)
+    , _pacing(false)
+    , _pacingRate(0)
+    , _pacingBurst(0)
+    , _rtxBytes(0)
+    , _rtxAge(0)
+    , _mux(NULL)
+    , _batching(false)
+    , _maxBitrate(0)
+    , _maxSessions(0)
+    , _retryAfter(10)
+    , _committedBitrate(0)
+    , _groupBase(0)
+    , _groupFirstPort(0)
+    , _groupTtl(16)
+    {
+        _rtxTrack = _router.track("rtx");
+        _audioTrack = _router.track("audio");
+        
+        pputil::Metrics& metrics = pputil::Metrics::instance();
+        for(size_t i = 0; i <= REQUEST_METHODS; ++i)
+        {
+            std::string method = i < REQUEST_METHODS ? requestMethods[i] : "other";
+            _requestMetrics[i] = metrics.histogram("rtsp_request_duration_us", pputil::Metrics::label("method", method), 
+                                                   "Time to handle a request, in microseconds");
+        }
+        _limitedMetric = metrics.counter("rtsp_limited_total", "", "Requests answered 503, over rate of their source");
+        _committedMetric = metrics.gauge("rtsp_committed_bps", "", "Egress bitrate committed to sessions at SETUP");
+        _sessionsMetric = metrics.gauge("rtsp_sessions", "", "Sessions open");
+        
+        static const char* refusedCodes[] = { "302", "453", "503" };
+        for(size_t i = 0; i < 3; ++i)
+        {
+            _refusedMetrics[i] = metrics.counter("rtsp_setup_refused_total", pputil::Metrics::label("code", refusedCodes[i]), 
+                                                 "SETUP over budget, redirected or refused");
+        }
+    }
+
+    RtspServer::~RtspServer()
+    {
+        if(_sessions.size() > 0)
+        {
+            PP_LOG_WARN("RTSP server is not shutdown before delete");
+            shutdown();	
+        }
+
+        // Streams on shared sockets are gone with sessions
+        if(_mux != NULL)
+        {
+            delete _mux;
+            _mux = NULL;
+        }
+    }
+    
+    // Override to clear sessions when shutdown
+    void RtspServer::doShutdown()
+    {
+        // Shutdown Tcp Server
+        TcpServer::doShutdown();
+        
+        // Clear RtspSessions
+        IceUtil::RecMutex::Lock lock(_sessionsMutex);
+        for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); ++it)
+        {
+            RtspSession* p = *it;
+            assert(p != NULL);;
+            if(p != NULL)
+            {
+                closeSession(p);
+            }
+        }
+        _sessions.clear();
+    }
+
+    // Override to run sessions
+    bool RtspServer::doRun()
+    {
+        // Schedule streaming over sessions
+        // If a session work failed, close the session
+        {
+            IceUtil::RecMutex::Lock lock(_sessionsMutex);
+            for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); )
+            {
+                RtspSession* p = *it;
+                assert(p != NULL);
+
+                p->receive();
+                if(!p->run())
+                {
+                    closeSession(p);
+                    it = _sessions.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+            
+            if(!_status || StreamScheduler::now() - _status->time >= 1000000)
+            {
+                publishStatus(StreamScheduler::now());
+            }
+        }
+        
+        removeIdleGroups();
+        
+        // Release paced packets that are due
+        // Wake up for the next deadline rather than a full poll timeout
+        int64_t now = StreamScheduler::now();
+        int64_t next = _scheduler.run(now);
+        
+        // Packets released by all streams go out together
+        if(_mux != NULL)
+        {
+            _mux->flush();
+        }
+        
+        if(_batching)
+        {
+            for(std::vector<pputil::TcpConnection*>::iterator it = _connections.begin(); it != _connections.end(); ++it)
+            {
+                (*it)->flush();
+            }
+        }
+        
+        int64_t wait = _runInterval;
+        if(next > 0 && next - now < wait)
+        {
+            wait = next - now;
+        }
+        _timeout = wait;
+        
+        // Run tcp server
+        return TcpServer::doRun();
+    }
+    
+    void RtspServer::publishStatus(int64_t now)
+    {
+        // Bit rate of a session is taken from bytes in last status
+        std::map<std::string, uint64_t> last;
+        int64_t elapsed = 0;
+        if(_status)
+        {
+            elapsed = now - _status->time;
+            for(size_t i = 0; i < _status->sessions.size(); ++i)
+            {
+                last[_status->sessions[i].sid] = _status->sessions[i].bytes;
+            }
+        }
+        
+        SessionsStatusPtr status = new SessionsStatus();
+        status->time = now;
+        status->sessions.reserve(_sessions.size());
+        for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); ++it)
+        {
+            RtspSession* p = *it;
+            StreamStats stats = p->stats();
+            
+            SessionStatus s;
+            s.sid = p->sid();
+            s.mid = p->mid();
+            s.state = p->state();
+            s.packets = stats.packets;
+            s.bytes = stats.octets;
+            s.bitrate = 0;
+            s.pending = p->pending();
+            s.queued = p->queued();
+            
+            std::map<std::string, uint64_t>::iterator prev = last.find(s.sid);
+            if(prev != last.end() && elapsed > 0 && s.bytes >= prev->second)
+            {
+                s.bitrate = (s.bytes - prev->second) * 8 * 1000000 / elapsed;
+            }
+            status->sessions.push_back(s);
+        }
+        
+        IceUtil::Mutex::Lock lock(_statusMutex);
+        _status = status;
+    }
+    
+    RtspServer::SessionsStatusPtr RtspServer::sessionsStatus()
+    {
+        IceUtil::Mutex::Lock lock(_statusMutex);
+        return _status;
+    }
+    
+    void RtspServer::preparePoll(pputil::PollSet& fds)
+    {
+        {
+            IceUtil::RecMutex::Lock lock(_sessionsMutex);
+            for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); ++it)
+            {
+                (*it)->preparePoll(fds);
+            }
+        }
+        
+        if(_mux != NULL)
+        {
+            _mux->preparePoll(fds);
+        }
+        
+        IceUtil::Mutex::Lock lock(_groupsMutex);
+        for(std::map<std::string, MulticastStreamPtr>::iterator it = _groups.begin(); it != _groups.end(); ++it)
+        {
+            it->second->preparePoll(fds);
+        }
+    }
+    
+    void RtspServer::handlePoll(const pputil::PollSet& fds)
+    {
+        {
+            IceUtil::RecMutex::Lock lock(_sessionsMutex);
+            for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); ++it)
+            {
+                (*it)->handlePoll(fds);
+            }
+        }
+        
+        // Send retransmissions asked by RTCP
+        if(_mux != NULL)
+        {
+            _mux->handlePoll(fds);
+            _mux->flush();
+        }
+        
+        IceUtil::Mutex::Lock lock(_groupsMutex);
+        for(std::map<std::string, MulticastStreamPtr>::iterator it = _groups.begin(); it != _groups.end(); ++it)
+        {
+            it->second->handlePoll(fds);
+        }
+    }
+    
+    void RtspServer::setPacing(bool pacing, uint64_t peakRate, uint64_t burst)
+    {
+        _pacing = pacing;
+        _pacingRate = peakRate / 8;
+        
+        // Default burst of 10ms at peak rate, but at least a few packets
+        _pacingBurst = burst;
+        if(_pacingBurst == 0)
+        {
+            _pacingBurst = std::max<uint64_t>(_pacingRate / 100, 4 * 1500);
+        }
+    }
+    
+    void RtspServer::setRetransmission(size_t maxBytes, int64_t maxAge)
+    {
+        _rtxBytes = maxBytes;
+        _rtxAge = maxAge;
+    }
+
+    void RtspServer::setPortRange(unsigned short first, unsigned short last)
+    {
+        _ports.setRange(first, last);
+    }
+    
+    void RtspServer::setBatching(bool batching)
+    {
+        _batching = batching;
+    }
+    
+    void RtspServer::setLimits(const RtspLimits& limits)
+    {
+        _limits = limits;
+    }
+    
+    void RtspServer::setRequestRate(double rate, uint32_t burst)
+    {
+        limiter().setRequestRate(rate, burst);
+    }
+    
+    void RtspServer::setAdmission(uint64_t maxBitrate, size_t maxSessions, int retryAfter)
+    {
+        IceUtil::RecMutex::Lock lock(_sessionsMutex);
+        _maxBitrate = maxBitrate;
+        _maxSessions = maxSessions;
+        _retryAfter = std::max(retryAfter, 1);
+    }
+    
+    void RtspServer::setPeer(const std::string& url, double load)
+    {
+        IceUtil::Mutex::Lock lock(_peersMutex);
+        _peers[url] = load;
+    }
+    
+    void RtspServer::removePeer(const std::string& url)
+    {
+        IceUtil::Mutex::Lock lock(_peersMutex);
+        _peers.erase(url);
+    }
+    
+    double RtspServer::load()
+    {
+        IceUtil::RecMutex::Lock lock(_sessionsMutex);
+        double load = 0;
+        if(_maxBitrate > 0)
+        {
+            load = std::max(load, (double)_committedBitrate / _maxBitrate);
+        }
+        if(_maxSessions > 0)
+        {
+            load = std::max(load, (double)_sessions.size() / _maxSessions);
+        }
+        return load;
+    }
+    
+    std::string RtspServer::findPeer()
+    {
+        IceUtil::Mutex::Lock lock(_peersMutex);
+        std::map<std::string, double>::iterator best = _peers.end();
+        for(std::map<std::string, double>::iterator it = _peers.begin(); it != _peers.end(); ++it)
+        {
+            if(it->second < 1 && (best == _peers.end() || it->second < best->second))
+            {
+                best = it;
+            }
+        }
+        return best != _peers.end() ? best->first : std::string();
+    }
+    
+    bool RtspServer::setSharedPort(unsigned short port)
+    {
+        assert(_mux == NULL);
+        
+        RtpMux* mux = new RtpMux();
+        if(!mux->init(port))
+        {
+            delete mux;
+            return false;
+        }
+        
+        _mux = mux;
+        return true;
+    }
+
+    void RtspServer::setMulticast(const std::string& baseAddress, unsigned short port, size_t groups, int ttl)
+    {
+        IceUtil::Mutex::Lock lock(_groupsMutex);
+        
+        _groupBase = ntohl(inet_addr(baseAddress.c_str()));
+        _groupFirstPort = (unsigned short)((port + 1) & ~1);
+        _groupTtl = ttl;
+        _groupPorts.setRange(_groupFirstPort, (unsigned short)(_groupFirstPort + groups * 2 - 1));
+    }
+    
+    // Group of a media stream, created when the first session joins
+    // The n-th port pair is bound to the n-th address from base
+    MulticastStreamPtr RtspServer::findGroup(const std::string& mid, const std::string& stream, int track)
+    {
+        IceUtil::Mutex::Lock lock(_groupsMutex);
+        
+        std::string key = mid + "/" + stream;
+        std::map<std::string, MulticastStreamPtr>::iterator it = _groups.find(key);
+        if(it != _groups.end())
+        {
+            return it->second;
+        }
+        
+        unsigned short port = 0;
+        if(!_groupPorts.acquire(port))
+        {
+            return 0;
+        }
+        
+        in_addr addr;
+        addr.s_addr = htonl(_groupBase + (port - _groupFirstPort) / 2);
+        
+        MulticastStreamPtr group = new MulticastStream(stream);
+        if(!group->init(inet_ntoa(addr), port, _groupTtl))
+        {
+            _groupPorts.release(port);
+            return 0;
+        }
+        
+        setMetrics(group.get(), track);
+        group->setScheduler(&_scheduler, mediaClockRate(mid, stream));
+        if(_pacing)
+        {
+            group->setPacing(_pacingRate, _pacingBurst);
+        }
+        
+        _groups[key] = group;
+        return group;
+    }
+    
+    // Groups left by all sessions
+    void RtspServer::removeIdleGroups()
+    {
+        IceUtil::Mutex::Lock lock(_groupsMutex);
+        
+        for(std::map<std::string, MulticastStreamPtr>::iterator it = _groups.begin(); it != _groups.end(); )
+        {
+            if(it->second->members() == 0)
+            {
+                _groupPorts.release(it->second->port());
+                _groups.erase(it++);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    int RtspServer::mediaRtxPayloadType(const std::string& /*mid*/, const std::string& /*stream*/)
+    {
+        return -1;
+    }
+
+    unsigned int RtspServer::mediaClockRate(const std::string& /*mid*/, const std::string& /*stream*/)
+    {
+        return 90000;
+    }
+    
+    pputil::TcpConnection* RtspServer::createConnection(SOCKET fd)
+    {
+        RtspConnection* conn = new RtspConnection(fd, this);
+        conn->setBatching(_batching);
+        conn->setLimits(_limits);
+        return conn;
+    }
+
+    void RtspServer::removeSession(const std::string& sid)
+    {
+        IceUtil::RecMutex::Lock lock(_sessionsMutex);
+        for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); )
+        {
+            RtspSession* p = *it;
+            if(p != NULL && p->sid() == sid)
+            {
+                closeSession(p);
+                it = _sessions.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    // Close all sessions related to the given media
+    void RtspServer::removeMedia(const std::string& mid)
+    {
+        {
+            IceUtil::RecMutex::Lock lock(_sessionsMutex);
+            for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); )
+            {
+                RtspSession* p = *it;
+                if(p != NULL && p->mid() == mid)
+                {
+                    closeSession(p);
+                    it = _sessions.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        invalidateSDP(mid);
+    }
+
+    void RtspServer::setMetrics(RtspStream* stream, int track)
+    {
+        assert(stream != NULL);
+        
+        IceUtil::Mutex::Lock lock(_trackMetricsMutex);
+        std::map<int, std::pair<int, int> >::iterator it = _trackMetrics.find(track < 0 ? -1 : track);
+        if(it == _trackMetrics.end())
+        {
+            pputil::Metrics& metrics = pputil::Metrics::instance();
+            std::string label = pputil::Metrics::label("stream", track < 0 ? std::string("other") : _router.trackName(track));
+            std::pair<int, int> ids;
+            ids.first = metrics.counter("rtp_packets_sent_total", label, "RTP packets sent");
+            ids.second = metrics.counter("rtp_bytes_sent_total", label, "RTP bytes sent");
+            it = _trackMetrics.insert(std::make_pair(track < 0 ? -1 : track, ids)).first;
+        }
+        
+        stream->setMetrics(it->second.first, it->second.second);
+    }
+    
+    void RtspServer::closeSession(RtspSession* p)
+    {
+        assert(p != NULL);
+        
+        assert(_committedBitrate >= p->bitrate());
+        _committedBitrate -= p->bitrate();
+        pputil::Metrics::instance().add(_committedMetric, -(int64_t)p->bitrate());
+        pputil::Metrics::instance().add(_sessionsMetric, -1);
+        
+        p->close();
+        delete p;
+    }
+    
+    RtspSession* RtspServer::findSession(const std::string& sid)
+    {
+        IceUtil::RecMutex::Lock lock(_sessionsMutex);
+        for(std::vector<RtspSession*>::iterator it = _sessions.begin(); it != _sessions.end(); ++it)
+        {
+            RtspSession* p = *it;
+            if(p != NULL && p->sid() == sid)
+            {
+                return p;
+            }
+        }
+        
+        return NULL;
+    }
+    
+    // Receive Rtsp request
+    void RtspServer::onRequest(RtspRequest* msg, RtspConnection* conn)
+    {
+        assert(msg != NULL);
+        assert(conn != NULL);
+        assert(msg->type() == REQUEST_MESSAGE);
+
+        int64_t start = StreamScheduler::now();
+        
+        // A source over its rate is told when to come back, without 
+        // holding up requests of others
+        if(_limiter != NULL)
+        {
+            int64_t wait = _limiter->request(conn->source(), start);
+            if(wait > 0)
+            {
+                RtspResponse* pResponse = conn->pool().response();
+                pResponse->setStatus(503);
+                pResponse->setVersion("1.0");
+                pResponse->setHeader("CSeq", msg->header("CSeq"));
+                pResponse->setHeader("Retry-After", (uint64_t)((wait + 999999) / 1000000));
+                conn->sendResponse(pResponse);
+                conn->pool().release(pResponse);
+                pputil::Metrics::instance().add(_limitedMetric);
+                return;
+            }
+        }
+        
+        std::string method = msg->method();
+        
+        // Requests come from threads of connections, sessions are 
+        // not changed while server thread runs them
+        {
+            IceUtil::RecMutex::Lock lock(_sessionsMutex);
+            
+            if(method == "OPTIONS")             OnOptionsRequest( msg, conn );
+            else if(method == "DESCRIBE")       OnDescribeRequest( msg, conn );
+            else if(method == "GET_PARAMETER")  OnGetParamRequest( msg, conn );
+            else if(method == "SET_PARAMETER")  OnSetParamRequest( msg, conn );
+            else if(method == "PAUSE")          OnPauseRequest( msg, conn );
+            else if(method == "PLAY")           OnPlayRequest( msg, conn );
+            else if(method == "SETUP")          OnSetupRequest( msg, conn );
+            else if(method == "TEARDOWN")       OnTeardownRequest( msg, conn );
+            else
+            {
+                // 501 Not Implemented
+                RtspResponse* pResponse = conn->pool().response();
+                pResponse->setStatus(501);
+                pResponse->setVersion("1.0");
+                pResponse->setHeader("CSeq", msg->header("CSeq"));
+                conn->sendResponse(pResponse);
+                conn->pool().release(pResponse);
+            }
+        }
+        
+        // Latency includes the wait for sessions
+        size_t i = 0;
+        while(i < REQUEST_METHODS && method != requestMethods[i])
+        {
+            i++;
+        }
+        pputil::Metrics::instance().record(_requestMetrics[i], StreamScheduler::now() - start);
+    }
+
+    void RtspServer::detachStreams(RtspConnection* conn)
+    {
+        IceUtil::RecMutex::Lock lock(_sessionsMutex);
+        conn->detachStreams();
+    }
+
+    // Query supported commands
+    // Not affect session state
+    void RtspServer::OnOptionsRequest(RtspRequest* pmsg, RtspConnection* conn)
+    {
+        PP_TRACE_SPAN("RtspServer::OnOptionsRequest");
+
+        assert(pmsg != NULL);
+        assert(conn != NULL);
+
+        RtspResponse* pResponse = conn->pool().response();
+
+        pResponse->setStatus(200);
+        pResponse->setVersion("1.0");
+        pResponse->setHeader("CSeq", pmsg->header("CSeq"));
+
+        pResponse->setHeader("Server", "Helix Server Version 9.0.8.1427 (linux-2.2-libc6-i586-server) (RealServer compatible)");
+        pResponse->setHeader("Public", "OPTIONS, DESCRIBE, SETUP, GET_PARAMETER, SET_PARAMETER, PLAY, PAUSE, TEARDOWN");
+        
+        pResponse->setHeader("RealChallenge1", "d12f6756d0027a12ee0afbfd64a5cedd");
+
+        conn->sendResponse(pResponse);
+        conn->pool().release(pResponse);
+    }
+
+    // Query SDP of media
+    // Not affect session state
+    void RtspServer::OnDescribeRequest(RtspRequest* pmsg, RtspConnection* conn)
+    {
+        PP_TRACE_SPAN("RtspServer::OnDescribeRequest");
+
+        assert(pmsg != NULL);
+        assert(conn != NULL);
+
+        // URL: rtsp://127.0.0.1:9960/3012
+        // A mid not interned yet is interned once it has SDP
+        std::string url = pmsg->url();
+        UrlRouter::Route route;
+        SdpEntry sdp;
+        bool found = _router.route(url, false, route);
+        if(found && route.mid >= 0)
+        {
+            found = findSDP(_router.midName(route.mid), sdp);
+        }
+        else if(found)
+        {
+            std::string mid = url.substr(route.midPos, route.midLen);
+            found = findSDP(mid, sdp);
+            if(found)
+            {
+                _router.mid(mid);
+            }
+        }
+        
+        if(!found)
+        {
+            RtspResponse* pResponse = conn->pool().response();
+            pResponse->setStatus(404);
+            pResponse->setVersion("1.0");
+            pResponse->setHeader("CSeq", pmsg->header("CSeq"));
+            conn->sendResponse(pResponse);
+            conn->pool().release(pResponse);
+            return;
+        }
+
+        // Response
+        RtspResponse* pResponse = conn->pool().response();
+        
+        pResponse->setStatus(200);
+        pResponse->setVersion("1.0");
+        pResponse->setHeader("CSeq", pmsg->header("CSeq"));    
+        pResponse->setHeader("Content-base", url);
+        pResponse->setHeader("Content-type","application/sdp");
+        pResponse->setHeader("Content-Length", sdp.body->size());
+        pResponse->setBody(sdp.body);
+
+        conn->sendResponse(pResponse);
+        conn->pool().release(pResponse);
+    }
+
+    // Rendered once, DESCRIBEs of a mid share the blob until invalidated
+    // mediaSDP() is called without the lock, a concurrent miss may render 
+    // it twice and keep either
+    bool RtspServer::findSDP(const std::string& mid, SdpEntry& entry)
+    {
+        {
+            IceUtil::Mutex::Lock lock(_sdpsMutex);
+            std::map<std::string, SdpEntry>::iterator it = _sdps.find(mid);
+            if(it != _sdps.end())
+            {
+                entry = it->second;
+                return true;
+            }
+        }
+
+        std::string sdp = mediaSDP(mid);
+        if(sdp.empty())
+        {
+            return false;
+        }
+
+        entry.body = new pputil::Blob((const pputil::byte*)sdp.data(), sdp.size());
+        std::vector<std::string> controls;
+        parseBitrates(sdp, entry.bitrate, entry.streams, controls);
+        
+        // Tracks are interned only as the SDP declares them
+        for(std::vector<std::string>::iterator it = controls.begin(); it != controls.end(); ++it)
+        {
+            _router.track(*it);
+        }
+
+        IceUtil::Mutex::Lock lock(_sdpsMutex);
+        _sdps[mid] = entry;
+        return true;
+    }
+
+    uint64_t RtspServer::streamBitrate(const std::string& mid, const std::string& stream, RtspSession* pSession)
+    {
+        SdpEntry sdp;
+        if(!findSDP(mid, sdp))
+        {
+            return 0;
+        }
+        
+        std::map<std::string, uint64_t>::iterator it = sdp.streams.find(stream);
+        if(it != sdp.streams.end())
+        {
+            return it->second;
+        }
+        
+        // No other stream of the session has taken it
+        return sdp.streams.empty() && (pSession == NULL || pSession->bitrate() == pSession->bitrate(stream)) ? sdp.bitrate : 0;
+    }
+    
+    // Checked before a session is created for the SETUP
+    bool RtspServer::refuseSetup(RtspRequest* pmsg, RtspConnection* conn, bool newSession, uint64_t bitrate)
+    {
+        bool overSessions = newSession && _maxSessions > 0 && _sessions.size() >= _maxSessions;
+        bool overBitrate = _maxBitrate > 0 && bitrate > 0 && _committedBitrate + bitrate > _maxBitrate;
+        if(!overSessions && !overBitrate)
+        {
+            return false;
+        }
+        
+        RtspResponse* pResponse = conn->pool().response();
+        pResponse->setVersion("1.0");
+        pResponse->setHeader("CSeq", pmsg->header("CSeq"));
+        
+        // A session not started here may go to a peer
+        std::string peer = newSession ? findPeer() : std::string();
+        if(!peer.empty())
+        {
+            if(peer[peer.size() - 1] == '/')
+            {
+                peer.erase(peer.size() - 1);
+            }
+            pResponse->setStatus(302);
+            pResponse->setHeader("Location", peer + urlPath(pmsg->url()));
+            pputil::Metrics::instance().add(_refusedMetrics[0]);
+        }
+        else if(overBitrate)
+        {
+            pResponse->setStatus(453);
+            pputil::Metrics::instance().add(_refusedMetrics[1]);
+        }
+        else
+        {
+            pResponse->setStatus(503);
+            pResponse->setHeader("Retry-After", (uint64_t)_retryAfter);
+            pputil::Metrics::instance().add(_refusedMetrics[2]);
+        }
+        
+        conn->sendResponse(pResponse);
+        conn->pool().release(pResponse);
+        return true;
+    }
+
+    void RtspServer::setRunInterval(int64_t interval)
+    {
+        _runInterval = std::max(interval, (int64_t)0);
+    }
+    
+    void RtspServer::invalidateSDP(const std::string& mid)
+    {
+        IceUtil::Mutex::Lock lock(_sdpsMutex);
+        _sdps.erase(mid);
+    }
+
+    void RtspServer::invalidateSDP()
+    {
+        IceUtil::Mutex::Lock lock(_sdpsMutex);
+        _sdps.clear();
+    }
+
+    // Rtsp SETUP request
+    // Negotiation to establish a session and the streams in the session
+    void RtspServer::OnSetupRequest(RtspRequest* pmsg, RtspConnection* conn)
+    {	
+        PP_TRACE_SPAN("RtspServer::OnSetupRequest");
+
+        assert(pmsg != NULL);
+        assert(conn != NULL);
+
+        // URL: rtsp://127.0.0.1:9960/3201/(rtx/audio/video)
+        std::string url = pmsg->url();
+        UrlRouter::Route route;
+        if(!_router.route(url, true, route))
+        {
+            RtspResponse* pResponse = conn->pool().response();
+            pResponse->setStatus(404);
+            pResponse->setVersion("1.0");
+            pResponse->setHeader("CSeq", pmsg->header("CSeq"));
+            conn->sendResponse(pResponse);
+            conn->pool().release(pResponse);
+            return;
+        }
+
+        // Tracks are interned when the SDP declaring them is rendered, 
+        // which a SETUP without DESCRIBE has not done yet
+        if(route.track < 0)
+        {
+            SdpEntry sdp;
+            if(findSDP(route.mid >= 0 ? _router.midName(route.mid) : url.substr(route.midPos, route.midLen), sdp))
+            {
+                _router.route(url, true, route);
+            }
+        }
+
+        // mid and stream name, taken from URL if they are not interned
+        // yet, a mid is interned once the stream is set up
+        // Track names the SDP does not declare are never interned
+        std::string midSegment = route.mid < 0 ? url.substr(route.midPos, route.midLen) : std::string();
+        std::string trackSegment = route.track < 0 ? url.substr(route.trackPos, route.trackLen) : std::string();
+        const std::string& mid = route.mid >= 0 ? _router.midName(route.mid) : midSegment;
+        const std::string& streamName = route.track >= 0 ? _router.trackName(route.track) : trackSegment;
+
+        // Session
+        std::string sid = pmsg->header("Session");
+        RtspSession* pSession = NULL;
+
+        // Session exist already
+        if(!sid.empty())
+        {
+            // A session of other media is not found for this one
+            pSession = findSession(sid);
+            if(pSession != NULL && mid != pSession->mid())
+            {
+                RtspResponse* pResponse = conn->pool().response();
+                pResponse->setStatus(454);
+                pResponse->setVersion("1.0");
+                pResponse->setHeader("CSeq", pmsg->header("CSeq"));
+                conn->sendResponse(pResponse);
+                conn->pool().release(pResponse);
+                return;
+            }
+        }
+
+        // Admission, before a session is created for it
+        // Streams of a multicast group are shared, not committed to sessions
+        // A stream set up again gives back what it committed
+        RtspTransport transport(pmsg->header("Transport"));
+        uint64_t previous = pSession != NULL ? pSession->bitrate(streamName) : 0;
+        uint64_t bitrate = transport.multicast ? 0 : streamBitrate(mid, streamName, pSession);
+        if(refuseSetup(pmsg, conn, pSession == NULL, bitrate > previous ? bitrate - previous : 0))
+        {
+            return;
+        }
+
+        // Create new session
+        bool created = false;
+        if(pSession == NULL)
+        {
+            _sid ++;
+            std::ostringstream oss;
+            oss << _sid;
+            sid = oss.str();
+
+            // Create new session
+            {
+                PP_TRACE_SPAN("RtspServer::createSession");
+                pSession = createSession(sid, mid);
+            }
+            if(pSession != NULL)
+            {
+                _sessions.push_back(pSession);
+                pputil::Metrics::instance().add(_sessionsMetric);
+                created = true;
+            }
+        }
+
+        // Application has no session for the media
+        if(pSession == NULL)
+        {
+            RtspResponse* pResponse = conn->pool().response();
+            pResponse->setStatus(500);
+            pResponse->setVersion("1.0");
+            pResponse->setHeader("CSeq", pmsg->header("CSeq"));
+            conn->sendResponse(pResponse);
+            conn->pool().release(pResponse);
+            return;
+        }
+
+        // Setup stream for session
+        unsigned short serverPort = port() + 10;
+
+        unsigned short clientPort = transport.clientPort[0];
+
+        bool setup = false;
+        sockaddr_in peer;
+        if( transport.multicast )
+        {
+            // To a group shared by sessions of the media
+            MulticastStreamPtr group = findGroup(mid, streamName, route.track);
+            if(group)
+            {
+                setup = pSession->setupStream(streamName, group);
+                transport.destination = group->group();
+                transport.port[0] = group->port();
+                transport.port[1] = group->port() + 1;
+                transport.ttl = group->ttl();
+                transport.clientPort[0] = transport.clientPort[1] = 0;
+            }
+        }
+        else if( transport.udp() && _mux != NULL && conn->remoteAddress(peer))
+        {
+            // Over UDP, on shared sockets
+            serverPort = _mux->port();
+            setup = pSession->setupStream(streamName, _mux, inet_ntoa(peer.sin_addr), clientPort);
+        }
+        else if( transport.udp() && _ports.size() > 0 )
+        {
+            // Over UDP, on ports from pool
+            setup = pSession->setupStream(streamName, &_ports, serverPort, clientPort);
+        }
+        else if( transport.udp() )
+        {
+            // Over UDP
+            setup = pSession->setupStream(streamName, serverPort, clientPort);
+        }
+        else
+        {	
+            // Over TCP, on channels asked by client or the next free pair
+            if(transport.interleaved[0] < 0)
+            {
+                transport.interleaved[0] = conn->freeChannel();
+                transport.interleaved[1] = transport.interleaved[0] + 1;
+            }
+            setup = pSession->setupStream(streamName, conn, transport.interleaved[0]);
+        }
+
+        // The stream replaced, or removed by a failed setup, took its 
+        // commitment from the session
+        uint64_t released = previous - pSession->bitrate(streamName);
+        if(released > 0)
+        {
+            assert(_committedBitrate >= released);
+            _committedBitrate -= released;
+            pputil::Metrics::instance().add(_committedMetric, -(int64_t)released);
+        }
+
+        // Out of ports, or multicast is not enabled
+        // A session created for this request is not left without streams,
+        // it would count against the budget and nothing would reap it
+        if(!setup)
+        {
+            if(created)
+            {
+                removeSession(sid);
+            }
+            
+            RtspResponse* pResponse = conn->pool().response();
+            pResponse->setStatus(transport.multicast ? 461 : 503);
+            pResponse->setVersion("1.0");
+            pResponse->setHeader("CSeq", pmsg->header("CSeq"));
+            conn->sendResponse(pResponse);
+            conn->pool().release(pResponse);
+            return;
+        }
+        
+        pSession->commit(streamName, bitrate);
+        _committedBitrate += bitrate;
+        pputil::Metrics::instance().add(_committedMetric, (int64_t)bitrate);
+        
+        if(route.mid < 0)
+        {
+            _router.mid(mid);
+        }
+
+        // Timer for RTCP reports, and pacing
+        // The shared stream of a multicast group has them already
+        RtspStream* pStream = pSession->findStream(streamName);
+        if(pStream != NULL && !transport.multicast)
+        {
+            setMetrics(pStream, route.track);
+            pStream->setScheduler(&_scheduler, mediaClockRate(mid, streamName));
+            if(_pacing)
+            {
+                pStream->setPacing(_pacingRate, _pacingBurst);
+            }
+
+            RtpStream* pRtp = dynamic_cast<RtpStream*>(pStream);
+            if(pRtp != NULL && _rtxBytes > 0)
+            {
+                pRtp->setRetransmission(_rtxBytes, _rtxAge, mediaRtxPayloadType(mid, streamName));
+            }
+        }
+
+        // Response
+        RtspResponse* pResponse = conn->pool().response();
+
+        pResponse->setStatus(200);
+        pResponse->setVersion("1.0");
+        pResponse->setHeader("CSeq",pmsg->header("CSeq"));
+        pResponse->setHeader("Date","Thu, 15 Dec 2005 03:00:04 GMT");
+        pResponse->setHeader("Session", sid);
+
+        // Stream name: rtx, audio, video 
+        if( transport.multicast )
+        {
+            pResponse->setHeader("Transport", transport.str());
+        }
+        else if( !transport.udp() )
+        {
+            if( route.track == _rtxTrack || route.track == _audioTrack )
+            {
+                pResponse->setHeader("RealChallenge3","d67b8f21bf272fd5020e9fbb08428cfa4f213d09,sdr=abcdabcd");
+            }
+            pResponse->setHeader("Transport", transport.str());
+        }
+        else
+        {
+            // Over UDP, on the ports the stream is set up with
+            if( route.track == _rtxTrack || route.track == _audioTrack )
+            {
+                pResponse->setHeader("RealChallenge3","d67b8f21bf272fd5020e9fbb08428cfa4f213d09,sdr=abcdabcd");
+            }
+            
+            std::ostringstream oss;
+            oss << "RTP/AVP/UDP;unicast;server_port=" << serverPort << "-" << serverPort + 1 
+                << ";client_port=" << clientPort << "-" << clientPort + 1;
+            if( route.track == _rtxTrack )
+            {
+                oss << ";ssrc=f2bde83e";
+            }
+            oss << ";mode=PLAY";
+            pResponse->setHeader("Transport", oss.str());
+        }
+
+        conn->sendResponse(pResponse);
+        conn->pool().release(pResponse);
+    }
+
+
+    // Get parameter of stream 
+    void RtspServer::OnGetParamRequest(RtspRequest* pmsg, RtspConnection* conn)
+    {
+        PP_TRACE_SPAN("RtspServer::OnGetParamRequest");
+
+        assert(pmsg != NULL);
+        assert(conn != NULL);
+     
+        std::string sid = pmsg->header("Session");
+        
+        RtspResponse* pResponse = conn->pool().response();
+        pResponse->setStatus(200);
+        pResponse->setVersion("1.0");
+        pResponse->setHeader("CSeq", pmsg->header("CSeq"));
+        pResponse->setHeader("Session", sid);
+
+        conn->sendResponse(pResponse);
+        conn->pool().release(pResponse);
+    }
+
+    // Set parameter of stream
+    void RtspServer::OnSetParamRequest(RtspRequest* pmsg, RtspConnection* conn)
+    {
+        PP_TRACE_SPAN("RtspServer::OnSetParamRequest");
+
+        assert(pmsg != NULL);
+        assert(conn != NULL);
+
+        std::string sid = pmsg->header("Session");
+
+        RtspResponse* pResponse = conn->pool().response();
+
+        std::string ping = pmsg->header("Ping");
+        if( ping.empty())
+            pResponse->setStatus(200);
+        else
+            pResponse->setStatus( 451 );
+
+        pResponse->setVersion("1.0");
+        pResponse->setHeader("CSeq", pmsg->header("CSeq"));
+        pResponse->setHeader("Session", sid);
+
+        conn->sendResponse( pResponse );
+        conn->pool().release(pResponse);
+    }
+
+    // Start to play
+    void RtspServer::OnPlayRequest(RtspRequest* pmsg, RtspConnection* conn)
+    {
+        PP_TRACE_SPAN("RtspServer::OnPlayRequest");
+
+        assert(pmsg != NULL);
+        assert(conn != NULL);
+
+        std::string sid = pmsg->header("Session");
+
+        // Start position
+        int nStartTime = -1;
+        // npt=<start>-[end], digits after "npt=" up to '-'
+        std::string strTime = pmsg->header("Range");
+        if( strTime.size() > 4 )
+        {
+            nStartTime = atoi(strTime.c_str() + 4);
+        }
+
+        // Seek to pos
+        RtspSession* pSession = findSession(sid);
+        if(pSession != NULL)
+        {
+            pSession->seek(nStartTime);
+        }
+
+        // RTP Info
+        std::string rtpInfo;
+        if(pSession != NULL)
+        {
+            rtpInfo = pSession->streamsInfo();
+        }
+
+        // Response
+        RtspResponse* pResponse = conn->pool().response();
+
+        pResponse->setStatus(200);
+        pResponse->setVersion("1.0");
+        pResponse->setHeader("CSeq", pmsg->header("CSeq"));
+        pResponse->setHeader("Session", sid);
+        pResponse->setHeader("RTP-Info",rtpInfo);
+
+        conn->sendResponse(pResponse);
+        conn->pool().release(pResponse);
+
+        // Play
+        if(pSession != NULL)
+        {
+            pSession->play(); 
+        }
+    }
+
+    void RtspServer::OnPauseRequest(RtspRequest* pmsg, RtspConnection* conn)
+    {
+        PP_TRACE_SPAN("RtspServer::OnPauseRequest");
+
+        assert(pmsg != NULL);
+        assert(conn != NULL);
+
+        std::string sid = pmsg->header("Session");
+
+        // Pause
+        RtspSession* pSession = findSession(sid);
+        if(pSession != NULL)
+        {
+            pSession->pause();
+        }
+
+        // Response
+        RtspResponse* pResponse = conn->pool().response();
+        pResponse->setStatus(200);
+        pResponse->setVersion("1.0");
+        pResponse->setHeader("CSeq", pmsg->header("CSeq"));
+        pResponse->setHeader("Session",sid);
+
+        conn->sendResponse(pResponse);
+        conn->pool().release(pResponse);
+    }
+
+    // Close session
+    void RtspServer::OnTeardownRequest(RtspRequest* pmsg, RtspConnection* conn)
+    {
+        PP_TRACE_SPAN("RtspServer::OnTeardownRequest");
+
+        assert(pmsg != NULL);
+        assert(conn != NULL);
+
+        std::string sid = pmsg->header("Session");
+
+        // Stop and remove
+        RtspSession* pSession = findSession(sid);
+        if(pSession != NULL)
+        {
+            pSession->teardown();
+            removeSession(sid);
+        }
+
+        // Response
+        RtspResponse* pResponse = conn->pool().response();
+        pResponse->setStatus(200);
+        pResponse->setVersion("1.0");
+        pResponse->setHeader("CSeq", pmsg->header("CSeq"));
+        pResponse->setHeader("Session",sid);
+
+        conn->sendResponse(pResponse);
+        conn->pool().release(pResponse);
+    }
+
 }
\ No newline at end of file
@@ -1,109 +1,337 @@
-// **********************************************************************
-//
-// Copyright (c) 2011, PPEngine
-// 
-// Redistribution and use in source and binary forms, with or without
-// modification, are permitted provided that the following conditions are
-// met:
-// 
-//   * Redistributions of source code must retain the above copyright
-//     notice, this list of conditions and the following disclaimer.
-// 
-//   * Redistributions in binary form must reproduce the above copyright
-//     notice, this list of conditions and the following disclaimer in
-//     the documentation and/or other materials provided with the
-//     distribution.
-// 
-//   * Neither the name of Google nor the names of its contributors may
-//     be used to endorse or promote products derived from this software
-//     without specific prior written permission.
-// 
-// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
-// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
-// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
-// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
-// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
-// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
-// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
-// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-// 
-// **********************************************************************
-
-#ifndef RTSP_RTSP_SERVER_H
-#define RTSP_RTSP_SERVER_H
-
-#include <rtsp/RtspMessage.h>
-#include <rtsp/RtspConnection.h>
-#include <tcp/TcpServer.h>
-
-namespace rtsp 
-{
-    //
-    // RTSP server is extension of a TCP server
-    // Handle RTSP requests from multiple RtspConnections
-    // 
-    class RtspServer : public TcpServer
-    {
-    public:
-        
-        RtspServer(unsigned short port, bool passive = true);
-        virtual ~RtspServer();
-        
-        // Receive a request from a RtspConnection
-        void onRequest(RtspRequest* msg, RtspConnection* conn);
-        
-    protected:
-        
-        // Override to clear sessions when shutdown
-        virtual void doShutdown();
-        
-        // Override to run sessions
-        virtual bool doRun();
-        
-        // Override to create RtspConnection
-        virtual TcpConnection* createConnection(SOCKET fd);
-        
-    protected:
-
-        // RTSP serve handle RTSP messages received over multiple RTSP connections
-        void OnDescribeRequest(RtspRequest* msg, RtspConnection* conn);
-        void OnOptionsRequest(RtspRequest* msg, RtspConnection* conn);
-        void OnSetupRequest(RtspRequest* msg, RtspConnection* conn);
-        void OnGetParamRequest(RtspRequest* msg, RtspConnection* conn);
-        void OnSetParamRequest(RtspRequest* msg, RtspConnection* conn);
-        void OnPlayRequest(RtspRequest* msg, RtspConnection* conn);
-        void OnPauseRequest(RtspRequest* msg, RtspConnection* conn);
-        void OnTeardownRequest(RtspRequest* msg, RtspConnection* conn);
-
-        // RtspServer need to know some media info
-        // that is bound to medias managed by application
-        virtual std::string mediaSDP(const std::string& mid) = 0;
-
-    protected:
-        
-        // Session based stream managements
-        std::vector<RtspSession*> _sessions;
-
-        // Session ID, automatically increased with new session
-        unsigned int _sid;
-
-        // A session is identified with sid
-        RtspSession* findSession(const std::string& sid);
-
-        // A RTSP server is resided between media and player
-        // A session is linked to a player with session ID
-        // A session is linked to a media with media ID
-        void removeSession(const std::string& sid);
-        void removeMedia(const std::string& mid);
-
-        // RTSPSession is linked to client player with RTSP session ID (sid)
-        // RTSPSession is linked to local media with media ID (mid)
-        // Medias are managed by application
-        virtual RtspSession* createSession(const std::string& sid, const std::string& mid) = 0;
-    };
-}
-
-#endif 
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_RTSP_SERVER_H
+#define RTSP_RTSP_SERVER_H
+
+#include <rtsp/RtspMessage.h>
+#include <rtsp/RtspConnection.h>
+#include <rtsp/RtspSession.h>
+#include <rtsp/StreamScheduler.h>
+#include <rtsp/RtspTransport.h>
+#include <rtsp/UrlRouter.h>
+#include <pputil/TcpServer.h>
+#include <IceUtil/RecMutex.h>
+
+namespace rtsp 
+{
+    //
+    // RTSP server is extension of a TCP server
+    // Handle RTSP requests from multiple RtspConnections
+    // 
+    class RtspServer : public pputil::TcpServer
+    {
+    public:
+        
+        RtspServer(unsigned short port, bool passive = true);
+        virtual ~RtspServer();
+        
+        // Receive a request from a RtspConnection
+        void onRequest(RtspRequest* msg, RtspConnection* conn);
+        
+        // A RtspConnection is deleted, streams of sessions on it stop
+        // using it. Streams are used with sessions locked, or on server
+        // thread which deletes connections
+        void detachStreams(RtspConnection* conn);
+        
+        // Pacing of streams set up after the call
+        // Packets are spread by their RTP timestamps and capped at
+        // peakRate (bits per second, 0 for no cap)
+        void setPacing(bool pacing, uint64_t peakRate = 0, uint64_t burst = 0);
+        
+        // Retransmission of RTP streams set up after the call
+        // Sent packets are kept up to maxBytes and maxAge (microseconds)
+        // per stream to answer NACKs, maxBytes == 0 to disable
+        void setRetransmission(size_t maxBytes, int64_t maxAge = 1000000);
+        
+        // Interleaved packets of connections accepted after the call are
+        // written once per scheduler tick with the socket corked
+        // For sessions sending from run(), packets sent from other threads
+        // wait for the next tick
+        void setBatching(bool batching);
+        
+        // Bounds of requests on connections accepted after the call,
+        // a peer going over them is answered with an error and closed
+        void setLimits(const RtspLimits& limits);
+        
+        // Requests per second from a source address, up to burst at once,
+        // 0 for no limit. A request over it is answered with 503 and 
+        // Retry-After, before it takes the sessions lock
+        // Set before activate()
+        void setRequestRate(double rate, uint32_t burst);
+        
+        // Admission of SETUP against a budget of egress bitrate (bits per 
+        // second, from b=AS: of SDP) and sessions of this server, 0 for 
+        // no limit. Over it, a new session is redirected to a peer with
+        // room if there is one, otherwise SETUP is answered with 453 for 
+        // bitrate, or 503 and Retry-After (seconds) for sessions
+        void setAdmission(uint64_t maxBitrate, size_t maxSessions, int retryAfter = 10);
+        
+        // Servers to redirect to (rtsp://host:port), with their load as
+        // a fraction of their budget, 1 or more for full. Fed by whatever 
+        // watches them, e.g. rtsp_committed_bps of their /metrics
+        void setPeer(const std::string& url, double load);
+        void removePeer(const std::string& url);
+        
+        // Load of this server, the larger fraction of its budgets taken
+        double load();
+        
+        // RTP streams set up over UDP take their ports from the range
+        // Without a range, each stream searches free ports from port + 10
+        void setPortRange(unsigned short first, unsigned short last);
+        
+        // RTP streams set up over UDP after the call share one pair of 
+        // sockets on port (RTP) and port + 1 (RTCP), instead of binding 
+        // a pair of ports for each stream
+        bool setSharedPort(unsigned short port);
+        
+        // Streams set up with multicast transport share a group per 
+        // media stream, up to groups groups on addresses from baseAddress 
+        // (e.g. 239.255.42.1) and port pairs from port
+        // Without it multicast SETUP is refused with 461
+        void setMulticast(const std::string& baseAddress, unsigned short port, size_t groups = 256, int ttl = 16);
+        
+        // DESCRIBE bodies are rendered from mediaSDP() once per mid and 
+        // kept, call when SDP of a media changes, or with no mid for all
+        void invalidateSDP(const std::string& mid);
+        void invalidateSDP();
+        
+        // Sessions are run at least every interval microseconds, 1s by 
+        // default, when no stream is due earlier
+        void setRunInterval(int64_t interval);
+        
+        // Mids of request URLs are interned once they have SDP, tracks as
+        // the SDP declares them, register mount points ahead with router().mid()
+        UrlRouter& router() { return _router; }
+        
+        // State of sessions, published by server thread every second
+        // Readers take the last one without waiting for sessions to run
+        struct SessionStatus
+        {
+            std::string sid;
+            std::string mid;
+            std::string state;
+            uint64_t packets;       // RTP sent
+            uint64_t bytes;
+            uint64_t bitrate;       // Bits per second since last status
+            size_t pending;         // Packets held for pacing
+            size_t queued;          // Bytes in send queue
+        };
+        
+        class SessionsStatus : public IceUtil::Shared
+        {
+        public:
+            int64_t time;           // Monotonic microseconds
+            std::vector<SessionStatus> sessions;
+        };
+        
+        typedef IceUtil::Handle<SessionsStatus> SessionsStatusPtr;
+        
+        SessionsStatusPtr sessionsStatus();
+        
+    protected:
+        
+        // Override to clear sessions when shutdown
+        virtual void doShutdown();
+        
+        // Override to run sessions
+        virtual bool doRun();
+        
+        // Override to create RtspConnection
+        virtual pputil::TcpConnection* createConnection(SOCKET fd);
+        
+        // Override to receive RTCP of streams along with connections
+        virtual void preparePoll(pputil::PollSet& fds);
+        virtual void handlePoll(const pputil::PollSet& fds);
+        
+    protected:
+
+        // RTSP serve handle RTSP messages received over multiple RTSP connections
+        void OnDescribeRequest(RtspRequest* msg, RtspConnection* conn);
+        void OnOptionsRequest(RtspRequest* msg, RtspConnection* conn);
+        void OnSetupRequest(RtspRequest* msg, RtspConnection* conn);
+        void OnGetParamRequest(RtspRequest* msg, RtspConnection* conn);
+        void OnSetParamRequest(RtspRequest* msg, RtspConnection* conn);
+        void OnPlayRequest(RtspRequest* msg, RtspConnection* conn);
+        void OnPauseRequest(RtspRequest* msg, RtspConnection* conn);
+        void OnTeardownRequest(RtspRequest* msg, RtspConnection* conn);
+
+        // RtspServer need to know some media info
+        // that is bound to medias managed by application
+        virtual std::string mediaSDP(const std::string& mid) = 0;
+        
+        // RTP clock rate of a stream, used to pace packets by timestamp
+        // and to map RTP time to wall clock in sender reports
+        virtual unsigned int mediaClockRate(const std::string& mid, const std::string& stream);
+        
+        // RTX payload type (RFC 4588) of a stream, -1 to resend lost 
+        // packets as they are. The SDP from mediaSDP must declare it.
+        virtual int mediaRtxPayloadType(const std::string& mid, const std::string& stream);
+
+    protected:
+        
+        // Session based stream managements
+        std::vector<RtspSession*> _sessions;
+
+        // Session ID, automatically increased with new session
+        unsigned int _sid;
+        
+        // Sessions are run at least this often (microseconds)
+        int64_t _runInterval;
+        
+        // Sessions are changed by requests on threads of connections,
+        // and run by server thread
+        IceUtil::RecMutex _sessionsMutex;
+
+        // A session is identified with sid
+        RtspSession* findSession(const std::string& sid);
+        
+        // Close, give back bitrate of, and delete a session taken out 
+        // of _sessions, with sessions locked
+        void closeSession(RtspSession* p);
+
+        // A RTSP server is resided between media and player
+        // A session is linked to a player with session ID
+        // A session is linked to a media with media ID
+        void removeSession(const std::string& sid);
+        void removeMedia(const std::string& mid);
+
+        // RTSPSession is linked to client player with RTSP session ID (sid)
+        // RTSPSession is linked to local media with media ID (mid)
+        // Medias are managed by application
+        virtual RtspSession* createSession(const std::string& sid, const std::string& mid) = 0;
+        
+    protected:
+        
+        // Shared timer of all streams, driven by server thread
+        StreamScheduler _scheduler;
+        
+        // Pacing configuration
+        bool _pacing;
+        uint64_t _pacingRate;   // Bytes per second
+        uint64_t _pacingBurst;  // Bytes
+        
+        // Retransmission
+        size_t _rtxBytes;
+        int64_t _rtxAge;
+        
+        // Ports of RTP streams
+        PortPool _ports;
+        
+        // Shared sockets of RTP streams, NULL if each stream binds its own
+        RtpMux* _mux;
+        
+        // Batched egress of interleaved streams
+        bool _batching;
+        
+        // Bounds of requests
+        RtspLimits _limits;
+        
+        // Admission of sessions, committed bitrate is changed with 
+        // sessions locked
+        uint64_t _maxBitrate;
+        size_t _maxSessions;
+        int _retryAfter;
+        uint64_t _committedBitrate;
+        
+        // Answer SETUP over budget, return false if it is admitted
+        bool refuseSetup(RtspRequest* pmsg, RtspConnection* conn, bool newSession, uint64_t bitrate);
+        
+        // Peer with least load under 1, empty if none
+        std::string findPeer();
+        
+        std::map<std::string, double> _peers;
+        IceUtil::Mutex _peersMutex;
+        
+        // Multicast groups by mid/stream
+        MulticastStreamPtr findGroup(const std::string& mid, const std::string& stream, int track);
+        void removeIdleGroups();
+        
+        std::map<std::string, MulticastStreamPtr> _groups;
+        PortPool _groupPorts;
+        uint32_t _groupBase;
+        unsigned short _groupFirstPort;
+        int _groupTtl;
+        IceUtil::Mutex _groupsMutex;
+        
+        // Rendered SDP by mid, shared by DESCRIBE responses
+        struct SdpEntry
+        {
+            pputil::BlobPtr body;
+            
+            // b=AS: of session, and of media by last part of a=control,
+            // in bits per second
+            uint64_t bitrate;
+            std::map<std::string, uint64_t> streams;
+        };
+        
+        // False if the media has no SDP
+        bool findSDP(const std::string& mid, SdpEntry& entry);
+        
+        // Bitrate committed by a unicast stream of a session
+        // Without b=AS: of media, b=AS: of session goes with its first stream
+        uint64_t streamBitrate(const std::string& mid, const std::string& stream, RtspSession* pSession);
+        
+        std::map<std::string, SdpEntry> _sdps;
+        IceUtil::Mutex _sdpsMutex;
+        
+        // mid and track of request URLs
+        UrlRouter _router;
+        int _rtxTrack;
+        int _audioTrack;
+        
+        // Status of sessions, built with sessions locked
+        void publishStatus(int64_t now);
+        
+        SessionsStatusPtr _status;
+        IceUtil::Mutex _statusMutex;
+        
+        // Latency metrics of requests by method, the last of other methods
+        enum { REQUEST_METHODS = 8 };
+        int _requestMetrics[REQUEST_METHODS + 1];
+        int _limitedMetric;
+        int _committedMetric;
+        int _sessionsMetric;
+        int _refusedMetrics[3];     // 302, 453, 503
+        
+        // Packets and bytes sent by streams of a track, registered once
+        // per interned track, tracks not interned add up as "other"
+        void setMetrics(RtspStream* stream, int track);
+        
+        std::map<int, std::pair<int, int> > _trackMetrics;
+        IceUtil::Mutex _trackMetricsMutex;
+    };
+}
+
+#endif 
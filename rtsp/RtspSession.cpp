@@ -33,6 +33,7 @@
 // **********************************************************************
 
 #include "RtspSession.h"
+#include <pputil/Logger.h>
 
 namespace rtsp
 {
@@ -41,13 +42,25 @@ namespace rtsp
     : m_sid(sid)
     , m_mid(mid)
     , m_state(INIT)
+    , m_bitrate(0)
     {
 
     }
 
     RtspSession::~RtspSession()
     {
-        std::cout << "RtspSession::~RtspSession() " << m_sid << "\n";
+        // Streams are off the scheduler before any of them is deleted
+        for(std::vector<RtspStream*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+        {
+            (*it)->close();
+        }
+        for(std::vector<RtspStream*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+        {
+            delete *it;
+        }
+        m_streams.clear();
+        
+        PP_LOG_DEBUG("Session {} of {} deleted", m_sid, m_mid);
     }
 
     void RtspSession::close()
@@ -65,6 +78,39 @@ namespace rtsp
         return m_mid;
     }
 
+    std::string RtspSession::state()
+    {
+        switch(m_state)
+        {
+        case READY:
+            return "READY";
+        case PLAYING:
+            return "PLAYING";
+        default:
+            return "INIT";
+        }
+    }
+
+    uint64_t RtspSession::bitrate()
+    {
+        return m_bitrate;
+    }
+    
+    uint64_t RtspSession::bitrate(const std::string& stream)
+    {
+        std::map<std::string, uint64_t>::iterator it = m_bitrates.find(stream);
+        return it != m_bitrates.end() ? it->second : 0;
+    }
+    
+    void RtspSession::commit(const std::string& stream, uint64_t bitrate)
+    {
+        if(bitrate > 0)
+        {
+            m_bitrates[stream] += bitrate;
+            m_bitrate += bitrate;
+        }
+    }
+
     std::string RtspSession::streamsInfo()
     {
         std::ostringstream oss;
@@ -102,12 +148,21 @@ namespace rtsp
 
     void RtspSession::removeStream(const std::string& name)
     {
+        // Release what the stream committed
+        std::map<std::string, uint64_t>::iterator bit = m_bitrates.find(name);
+        if(bit != m_bitrates.end())
+        {
+            m_bitrate -= bit->second;
+            m_bitrates.erase(bit);
+        }
+        
         // Delete existing stream
         for(std::vector<RtspStream*>::iterator it = m_streams.begin(); it != m_streams.end(); )
         {
             RtspStream* p = *it;
             if(p != NULL && p->name() == name)
             {
+                p->close();
                 delete p;
                 it = m_streams.erase(it);
             }
@@ -126,7 +181,7 @@ namespace rtsp
         removeStream(name);
 
         // Add a new stream
-        RTPStream* pStream = new RTPStream(name);
+        RtpStream* pStream = new RtpStream(name);
         if(pStream != NULL && pStream->init(serverPort, clientPort))
         {
             m_streams.push_back(pStream);
@@ -135,17 +190,18 @@ namespace rtsp
             return true;
         }
 
+        delete pStream;
         return false;
     }
 
-    bool RtspSession::setupStream(const std::string& name, RtspConnection* connection)
+    bool RtspSession::setupStream(const std::string& name, RtspConnection* connection, int channel)
     {
         // Remove existing stream
         removeStream(name);
 
         // Add a new stream
-        TCPStream* pStream = new TCPStream(name);
-        if(pStream != NULL && pStream->init(connection))
+        TcpStream* pStream = new TcpStream(name);
+        if(pStream != NULL && pStream->init(connection, channel))
         {
             m_streams.push_back(pStream);
             m_state = READY;
@@ -153,9 +209,133 @@ namespace rtsp
             return true;
         }
 
+        delete pStream;
         return false;
     }
 
+    // Ports taken from pool, no search for free ports
+    bool RtspSession::setupStream(const std::string& name, PortPool* pool, unsigned short& serverPort, unsigned short clientPort)
+    {
+        // Remove existing stream
+        removeStream(name);
+
+        // Add a new stream
+        RtpStream* pStream = new RtpStream(name);
+        if(pStream != NULL && pStream->init(pool, serverPort, clientPort))
+        {
+            m_streams.push_back(pStream);
+            m_state = READY;
+
+            return true;
+        }
+
+        delete pStream;
+        return false;
+    }
+
+    // Streams on shared sockets, no ports to bind
+    bool RtspSession::setupStream(const std::string& name, RtpMux* mux, const std::string& host, unsigned short clientPort)
+    {
+        // Remove existing stream
+        removeStream(name);
+
+        // Add a new stream
+        RtpStream* pStream = new RtpStream(name);
+        if(pStream != NULL && pStream->init(mux, host, clientPort))
+        {
+            m_streams.push_back(pStream);
+            m_state = READY;
+
+            return true;
+        }
+
+        delete pStream;
+        return false;
+    }
+
+    // Streams sending to a multicast group shared with other sessions
+    bool RtspSession::setupStream(const std::string& name, const MulticastStreamPtr& stream)
+    {
+        // Remove existing stream
+        removeStream(name);
+
+        // Add a new stream
+        m_streams.push_back(new MulticastMember(name, stream));
+        m_state = READY;
+
+        return true;
+    }
+
+    void RtspSession::preparePoll(pputil::PollSet& fds)
+    {
+        for(std::vector<RtspStream*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+        {
+            (*it)->preparePoll(fds);
+        }
+    }
+
+    void RtspSession::handlePoll(const pputil::PollSet& fds)
+    {
+        for(std::vector<RtspStream*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+        {
+            (*it)->handlePoll(fds);
+        }
+    }
+
+    void RtspSession::receive()
+    {
+        for(std::vector<RtspStream*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+        {
+            (*it)->receive();
+        }
+    }
+
+    StreamStats RtspSession::stats()
+    {
+        StreamStats total;
+        memset(&total, 0, sizeof(total));
+        total.rtt = -1;
+
+        for(std::vector<RtspStream*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+        {
+            StreamStats s = (*it)->stats();
+            total.packets += s.packets;
+            total.octets += s.octets;
+            total.reports += s.reports;
+            total.nacks += s.nacks;
+            total.plis += s.plis;
+            total.retransmits += s.retransmits;
+            total.cumulativeLost += s.cumulativeLost;
+            total.fractionLost = std::max(total.fractionLost, s.fractionLost);
+            total.jitter = std::max(total.jitter, s.jitter);
+            total.rtt = std::max(total.rtt, s.rtt);
+        }
+
+        return total;
+    }
+
+    size_t RtspSession::pending()
+    {
+        size_t n = 0;
+        for(std::vector<RtspStream*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+        {
+            n += (*it)->pending();
+        }
+        return n;
+    }
+
+    // Interleaved streams of a session share the send queue of
+    // the connection, so the deepest one is taken rather than a sum
+    size_t RtspSession::queued()
+    {
+        size_t n = 0;
+        for(std::vector<RtspStream*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+        {
+            n = std::max(n, (*it)->queued());
+        }
+        return n;
+    }
+
     void RtspSession::play()
     {
         m_state = PLAYING;
@@ -37,6 +37,7 @@
 
 #include <rtsp/RtspConnection.h>
 #include <rtsp/RtspStream.h>
+#include <rtsp/MulticastStream.h>
 
 namespace rtsp
 {
@@ -58,19 +59,48 @@ namespace rtsp
         // Identifier
         std::string sid();
         std::string mid();
+        
+        // INIT, READY or PLAYING
+        std::string state();
 
+        // Egress committed to unicast streams of the session at SETUP,
+        // in bits per second, released as a stream is removed, and the 
+        // rest when the session is closed
+        uint64_t bitrate();
+        uint64_t bitrate(const std::string& stream);
+        void commit(const std::string& stream, uint64_t bitrate);
+        
         // Get all streams info	(for RTSP response)	
         std::string streamsInfo();
 
         // find a stream 
-        MediaStream* findStream(const std::string& name);
+        RtspStream* findStream(const std::string& name);
 
         // Delet a stream
         void removeStream(const std::string& name);
 
         // Setup a stream
         bool setupStream(const std::string& name, unsigned short& serverPort, unsigned short clientPort);
-        bool setupStream(const std::string& name, RtspConnection* conn);
+        bool setupStream(const std::string& name, RtspConnection* conn, int channel);
+        bool setupStream(const std::string& name, PortPool* pool, unsigned short& serverPort, unsigned short clientPort);
+        bool setupStream(const std::string& name, RtpMux* mux, const std::string& host, unsigned short clientPort);
+        bool setupStream(const std::string& name, const MulticastStreamPtr& stream);
+
+        // Poll sockets of streams, driven by server thread
+        void preparePoll(pputil::PollSet& fds);
+        void handlePoll(const pputil::PollSet& fds);
+        
+        // RTCP held by streams for server thread, on each of its ticks
+        void receive();
+
+        // Statistics of all streams
+        // Packets and bytes are summed, loss and RTT are the worst stream
+        StreamStats stats();
+        
+        // Packets held for pacing by all streams, and bytes waiting in 
+        // the send queue of the deepest stream
+        size_t pending();
+        size_t queued();
 
         // Seek to a position, return actual result position 
         // With -1 to return current position
@@ -92,6 +122,10 @@ namespace rtsp
         // State of session
         enum {INIT, READY, PLAYING};
         int m_state;
+        
+        // Committed bitrate, in total and by stream
+        uint64_t m_bitrate;
+        std::map<std::string, uint64_t> m_bitrates;
 
         // One or more streams
         std::vector<RtspStream*> m_streams;			
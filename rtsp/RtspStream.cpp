@@ -33,104 +33,750 @@
 // **********************************************************************
 
 #include "RtspStream.h"
+#include "Rtp.h"
+#include <IceUtil/Time.h>
+#include <pputil/Metrics.h>
+#include <pputil/Trace.h>
 
 namespace rtsp
 {
 
-    RtspStream::RtspStream(const std::string& name)
-    : m_name(name)
-    , m_seq(0)
+    // RTCP report interval (RFC 3550, 6.2), 5 seconds randomized by half
+    static int64_t reportInterval()
     {
+        return 2500000 + (int64_t)(rand() % 5000) * 1000;
+    }
 
+    RtspStream::RtspStream(const std::string& name)
+    : _name(name)
+    , _seq(0)
+    , _scheduler(NULL)
+    , _timer(0)
+    , _clockRate(90000)
+    , _paced(false)
+    , _synced(false)
+    , _baseTime(0)
+    , _baseTimestamp(0)
+    , _lastTimestamp(0)
+    , _lastTime(0)
+    , _nextReport(0)
+    , _lastReport(0)
+    , _lastReportTime(0)
+    , _packetsMetric(-1)
+    , _bytesMetric(-1)
+    {
+        memset(&_stats, 0, sizeof(_stats));
+        _stats.rtt = -1;
     }
 
     RtspStream::~RtspStream()
     {
+        close();
+        _queue.clear();
+    }
 
+    void RtspStream::close()
+    {
+        if(_scheduler != NULL)
+        {
+            _scheduler->cancel(this);
+            _scheduler = NULL;
+        }
     }
 
     std::string RtspStream::name()
     {
-        return m_name;
+        return _name;
     }
 
     unsigned int RtspStream::seq(bool update)
     { 
-        return update ? m_seq++ : m_seq;
+        return update ? _seq++ : _seq;
+    }
+
+    bool RtspStream::sendData(pputil::byte* b, size_t n)
+    {
+        if(b == NULL || n == 0)
+        {
+            return false;
+        }
+
+        return sendData(new pputil::Blob(b, n));
+    }
+
+    bool RtspStream::sendData(const pputil::BlobPtr& packet)
+    {
+        int64_t now = StreamScheduler::now();
+
+        bool ret = true;
+        if(_paced)
+        {
+            _queue.push_back(packet);
+        }
+        else
+        {
+            ret = transmit(packet, now);
+        }
+
+        // Put the stream on timer when it is idle, 
+        // or when the new packet may be due before the timer fires
+        if(_scheduler != NULL && (_timer == 0 || (_paced && _queue.size() == 1)))
+        {
+            int64_t next = onSchedule(now);
+            if(next > 0)
+            {
+                _scheduler->schedule(this, next);
+            }
+        }
+
+        return ret;
+    }
+
+    void RtspStream::flush()
+    {
+
+    }
+
+    void RtspStream::setMetrics(int packets, int bytes)
+    {
+        _packetsMetric = packets;
+        _bytesMetric = bytes;
+    }
+
+    void RtspStream::setScheduler(StreamScheduler* scheduler, unsigned int clockRate)
+    {
+        if(_scheduler != NULL)
+        {
+            _scheduler->cancel(this);
+        }
+
+        _scheduler = scheduler;
+        _timer = 0;
+        _clockRate = clockRate > 0 ? clockRate : 90000;
+    }
+
+    void RtspStream::setPacing(uint64_t peakRate, uint64_t burst)
+    {
+        assert(_scheduler != NULL);
+
+        _paced = _scheduler != NULL;
+        _bucket.setRate(peakRate, burst);
+        _synced = false;
+    }
+
+    size_t RtspStream::pending()
+    {
+        return _queue.size();
+    }
+
+    // Datagrams are not queued in user space
+    size_t RtspStream::queued()
+    {
+        return 0;
+    }
+
+    int64_t RtspStream::onSchedule(int64_t now)
+    {
+        int64_t next = pace(now);
+
+        if(_nextReport > 0 && now >= _nextReport)
+        {
+            sendReport(now);
+            _nextReport = now + reportInterval();
+        }
+
+        if(_nextReport > 0 && (next == 0 || _nextReport < next))
+        {
+            next = _nextReport;
+        }
+
+        _timer = next;
+        return next;
+    }
+
+    // Send queued packets that are due and allowed by the token bucket
+    int64_t RtspStream::pace(int64_t now)
+    {
+        while(!_queue.empty())
+        {
+            pputil::BlobPtr packet = _queue.front();
+
+            int64_t release = releaseTime(packet, now);
+            if(release > now)
+            {
+                return release;
+            }
+
+            if(!_bucket.consume(packet->size(), now))
+            {
+                return now + _bucket.wait(packet->size(), now);
+            }
+
+            _queue.pop_front();
+            transmit(packet, now);
+        }
+
+        return 0;
+    }
+
+    // The first packet is released at once and maps RTP time to local time
+    // Mapping is reset when a packet is far behind (pause, slow reader) 
+    // or far ahead (seek, timestamp jump) of local time
+    int64_t RtspStream::releaseTime(const pputil::BlobPtr& packet, int64_t now)
+    {
+        if(!rtpValid(packet->data(), packet->size()))
+        {
+            return now;
+        }
+
+        uint32_t timestamp = rtpTimestamp(packet->data());
+        if(_synced)
+        {
+            int32_t delta = (int32_t)(timestamp - _baseTimestamp);
+            int64_t release = _baseTime + (int64_t)delta * 1000000 / _clockRate;
+            
+            if(release > now - 1000000 && release < now + 10000000)
+            {
+                return release;
+            }
+        }
+
+        _synced = true;
+        _baseTime = now;
+        _baseTimestamp = timestamp;
+        return now;
+    }
+
+    bool RtspStream::transmit(const pputil::BlobPtr& packet, int64_t now)
+    {
+        if(!sendPacket(packet))
+        {
+            return false;
+        }
+
+        _stats.packets++;
+        _stats.octets += packet->size();
+        
+        pputil::Metrics& metrics = pputil::Metrics::instance();
+        metrics.add(_packetsMetric);
+        metrics.add(_bytesMetric, (int64_t)packet->size());
+
+        if(rtpValid(packet->data(), packet->size()))
+        {
+            _stats.ssrc = rtpSsrc(packet->data());
+            _lastTimestamp = rtpTimestamp(packet->data());
+            _lastTime = now;
+
+            // First report shortly after media starts
+            if(_nextReport == 0)
+            {
+                _nextReport = now + reportInterval() / 2;
+            }
+        }
+
+        return true;
+    }
+
+    // SR maps RTP time of the stream to wall clock for lip sync,
+    // with RTP time extrapolated from the last packet sent
+    void RtspStream::sendReport(int64_t now)
+    {
+        uint64_t ntp = ntpTime(IceUtil::Time::now().toMicroSeconds());
+        uint32_t rtpTime = _lastTimestamp + (uint32_t)((now - _lastTime) * _clockRate / 1000000);
+
+        pputil::byte b[512];
+        size_t n = buildSenderReport(b, sizeof(b), _stats.ssrc, ntp, rtpTime, 
+                                     (uint32_t)_stats.packets, (uint32_t)_stats.octets, rtcpCname());
+        if(n > 0 && sendRtcp(b, n))
+        {
+            _lastReport = ntpMiddle(ntp);
+            _lastReportTime = now;
+        }
+    }
+
+    void RtspStream::onRtcp(const pputil::byte* b, size_t n, int64_t arrival)
+    {
+        RtcpFeedback feedback;
+        parseRtcp(b, n, feedback);
+
+        for(std::vector<RtcpReportBlock>::iterator it = feedback.reports.begin(); it != feedback.reports.end(); ++it)
+        {
+            if(it->ssrc != _stats.ssrc)
+            {
+                continue;
+            }
+
+            _stats.reports++;
+            _stats.fractionLost = it->fractionLost;
+            _stats.cumulativeLost = it->cumulativeLost;
+            _stats.jitter = it->jitter;
+
+            // RTT = arrival - LSR - DLSR, in 1/65536 seconds
+            if(it->lsr != 0)
+            {
+                if(arrival == 0)
+                {
+                    arrival = IceUtil::Time::now().toMicroSeconds();
+                }
+                int32_t rtt = (int32_t)(ntpMiddle(ntpTime(arrival)) - it->lsr - it->dlsr);
+                if(rtt >= 0)
+                {
+                    _stats.rtt = (int64_t)rtt * 1000000 / 65536;
+                }
+            }
+        }
+
+        for(std::vector<RtcpNack>::iterator it = feedback.nacks.begin(); it != feedback.nacks.end(); ++it)
+        {
+            if(it->ssrc == _stats.ssrc)
+            {
+                onNack(*it);
+            }
+        }
+
+        for(std::vector<uint32_t>::iterator it = feedback.plis.begin(); it != feedback.plis.end(); ++it)
+        {
+            if(*it == _stats.ssrc)
+            {
+                onPli();
+            }
+        }
+    }
+
+    // Count lost packets, packet pid and those marked in blp
+    void RtspStream::onNack(const RtcpNack& nack)
+    {
+        _stats.nacks++;
+        for(uint16_t blp = nack.blp; blp != 0; blp >>= 1)
+        {
+            if(blp & 1)
+            {
+                _stats.nacks++;
+            }
+        }
+    }
+
+    void RtspStream::onPli()
+    {
+        _stats.plis++;
+    }
+
+    void RtspStream::preparePoll(pputil::PollSet& /*fds*/)
+    {
+
+    }
+
+    void RtspStream::receive()
+    {
+
+    }
+
+    void RtspStream::handlePoll(const pputil::PollSet& /*fds*/)
+    {
+
+    }
+
+    StreamStats RtspStream::stats()
+    {
+        return _stats;
     }
     
     /////////////////////////////////////////////////////////////////////
 
     RtpStream::RtpStream(const std::string& name)
     : RtspStream(name)
+    , _rtcpBatch(8)
+    , _rtcpPoll(0)
+    , _pool(NULL)
+    , _poolPort(0)
+    , _mux(NULL)
+    , _bound(false)
+    , _history(NULL)
+    , _rtxPayloadType(-1)
+    , _rtxSsrc((uint32_t)rand())
+    , _rtxSeq((uint16_t)rand())
     {
 
     }
 
     RtpStream::~RtpStream()
     {
-        m_rtpSocket.close();
-        m_rtcpSocket.close();
+        if(_mux != NULL)
+        {
+            _mux->remove(this);
+            _mux = NULL;
+        }
+
+        _rtpSocket.close();
+        _rtcpSocket.close();
+
+        if(_pool != NULL)
+        {
+            _pool->release(_poolPort);
+            _pool = NULL;
+        }
+
+        if(_history != NULL)
+        {
+            delete _history;
+            _history = NULL;
+        }
+    }
+
+    void RtpStream::setRetransmission(size_t maxBytes, int64_t maxAge, int rtxPayloadType)
+    {
+        if(_history != NULL)
+        {
+            delete _history;
+            _history = NULL;
+        }
+
+        if(maxBytes > 0)
+        {
+            _history = new RtpHistory(1024, maxBytes, maxAge);
+        }
+
+        _rtxPayloadType = rtxPayloadType;
     }
 
     bool RtpStream::init(unsigned short& serverPort, unsigned short clientPort)
     {
+        PP_TRACE_SPAN("RtpStream::init");
+
         // Try to do until available ports
-        for(int i=0; i<10; i++)
+        bool bound = false;
+        for(int i=0; i<10 && !bound; i++)
         {
-            if(m_rtpSocket.init(serverPort))
+            if(_rtpSocket.init(serverPort))
             {
-                if(m_rtcpSocket.init(serverPort + 1))
+                if(_rtcpSocket.init(serverPort + 1))
                 {
+                    bound = true;
                     break;
                 }
                 else
                 {
-                    m_rtpSocket.close();
+                    _rtpSocket.close();
                 }
             }
 
             serverPort += 2;
         }
 
-        m_rtpSocket.setPeer("127.0.0.1", clientPort);
-        m_rtcpSocket.setPeer("127.0.0.1", clientPort + 1);
+        if(!bound)
+        {
+            return false;
+        }
+
+        _rtpSocket.setPeer("127.0.0.1", clientPort);
+        _rtcpSocket.setPeer("127.0.0.1", clientPort + 1);
+        _rtcpSocket.setTimestamps(true);
+
+        return true;
+    }
+
+    bool RtpStream::init(PortPool* pool, unsigned short& serverPort, unsigned short clientPort)
+    {
+        PP_TRACE_SPAN("RtpStream::init");
+
+        assert(pool != NULL);
+        assert(_pool == NULL);
+
+        // A pair free in pool may still be bound by other process,
+        // it is given back to the tail and the next pair is tried
+        for(int i=0; i<10; i++)
+        {
+            unsigned short port = 0;
+            if(!pool->acquire(port))
+            {
+                return false;
+            }
+
+            if(_rtpSocket.init(port))
+            {
+                if(_rtcpSocket.init(port + 1))
+                {
+                    _pool = pool;
+                    _poolPort = port;
+                    serverPort = port;
+
+                    _rtpSocket.setPeer("127.0.0.1", clientPort);
+                    _rtcpSocket.setPeer("127.0.0.1", clientPort + 1);
+                    _rtcpSocket.setTimestamps(true);
+                    return true;
+                }
+
+                _rtpSocket.close();
+            }
+
+            pool->release(port);
+        }
+
+        return false;
+    }
+
+    bool RtpStream::init(RtpMux* mux, const std::string& host, unsigned short clientPort)
+    {
+        PP_TRACE_SPAN("RtpStream::init");
+
+        assert(mux != NULL);
 
+        memset(&_rtpPeer, 0, sizeof(_rtpPeer));
+        _rtpPeer.sin_family = AF_INET;
+        _rtpPeer.sin_port = htons(clientPort);
+        _rtpPeer.sin_addr.s_addr = inet_addr(host.c_str());
+
+        _rtcpPeer = _rtpPeer;
+        _rtcpPeer.sin_port = htons(clientPort + 1);
+
+        _mux = mux;
+        _mux->add(this, _rtcpPeer);
         return true;
     }
 
-    bool RtpStream::sendData(byte* b, size_t n)
+    bool RtpStream::sendPacket(const pputil::BlobPtr& packet)
+    {
+        if(_mux != NULL)
+        {
+            // RTCP may come from a peer other than the one set up, 
+            // and is routed by the SSRC of the stream
+            if(!_bound && rtpValid(packet->data(), packet->size()))
+            {
+                _mux->bind(this, rtpSsrc(packet->data()));
+                _bound = true;
+            }
+
+            _mux->send(packet, _rtpPeer);
+            if(_history != NULL)
+            {
+                _history->add(packet, StreamScheduler::now());
+            }
+            return true;
+        }
+
+        long len = _rtpSocket.send(packet->data(), packet->size());
+
+        // History shares the packet with send path
+        if(_history != NULL)
+        {
+            _history->add(packet, StreamScheduler::now());
+        }
+
+        return len == (long)packet->size();
+    }
+
+    void RtpStream::onNack(const RtcpNack& nack)
+    {
+        RtspStream::onNack(nack);
+
+        if(_history == NULL)
+        {
+            return;
+        }
+
+        int64_t now = StreamScheduler::now();
+        for(int i = 0; i <= 16; ++i)
+        {
+            if(i == 0 || (nack.blp & (1 << (i - 1))))
+            {
+                pputil::BlobPtr packet = _history->find((uint16_t)(nack.pid + i), now);
+                if(packet)
+                {
+                    retransmit(packet);
+                }
+            }
+        }
+    }
+
+    // RTX packet (RFC 4588, 4) has the header of original packet with 
+    // RTX payload type, SSRC and sequence number, followed by original 
+    // sequence number and payload. The payload is sent from the kept packet.
+    void RtpStream::retransmit(const pputil::BlobPtr& packet)
+    {
+        _stats.retransmits++;
+
+        if(_rtxPayloadType < 0)
+        {
+            if(_mux != NULL)
+            {
+                _mux->send(packet, _rtpPeer);
+                return;
+            }
+
+            _rtpSocket.send(packet->data(), packet->size());
+            return;
+        }
+
+        const pputil::byte* b = packet->data();
+        size_t n = packet->size();
+
+        // Header length with CSRC list and extension
+        size_t headLen = RTP_HEADER_SIZE + (b[0] & 0x0f) * 4;
+        if((b[0] & 0x10) && n >= headLen + 4)
+        {
+            headLen += 4 + (((size_t)b[headLen + 2] << 8) | b[headLen + 3]) * 4;
+        }
+        if(headLen > n || headLen > 256)
+        {
+            return;
+        }
+
+        pputil::byte head[256 + 2];
+        memcpy(head, b, headLen);
+        head[1] = (pputil::byte)((b[1] & 0x80) | (_rtxPayloadType & 0x7f));
+        head[2] = (pputil::byte)(_rtxSeq >> 8);
+        head[3] = (pputil::byte)_rtxSeq;
+        head[8] = (pputil::byte)(_rtxSsrc >> 24);
+        head[9] = (pputil::byte)(_rtxSsrc >> 16);
+        head[10] = (pputil::byte)(_rtxSsrc >> 8);
+        head[11] = (pputil::byte)_rtxSsrc;
+        head[headLen] = b[2];
+        head[headLen + 1] = b[3];
+        _rtxSeq++;
+
+        // Shared sockets send whole packets in batches
+        if(_mux != NULL)
+        {
+            pputil::BlobPtr rtx = new pputil::Blob(n + 2);
+            memcpy(rtx->data(), head, headLen + 2);
+            memcpy(rtx->data() + headLen + 2, b + headLen, n - headLen);
+            _mux->send(rtx, _rtpPeer);
+            return;
+        }
+
+        _rtpSocket.send(head, headLen + 2, b + headLen, n - headLen);
+    }
+
+    void RtpStream::flush()
+    {
+        if(_mux != NULL)
+        {
+            _mux->flush();
+        }
+    }
+
+    bool RtpStream::sendRtcp(pputil::byte* b, size_t n)
+    {
+        if(_mux != NULL)
+        {
+            _mux->send(new pputil::Blob(b, n), _rtcpPeer, true);
+            return true;
+        }
+
+        return _rtcpSocket.send(b, n) == (long)n;
+    }
+
+    void RtpStream::preparePoll(pputil::PollSet& fds)
+    {
+        if(_rtcpSocket.m_socket != INVALID_SOCKET)
+        {
+            _rtcpPoll = fds.add(_rtcpSocket.m_socket);
+        }
+    }
+
+    void RtpStream::handlePoll(const pputil::PollSet& fds)
     {
-        int len = m_rtpSocket.send(b, n);
-        return len == n;
+        if(_rtcpSocket.m_socket != INVALID_SOCKET && fds.readable(_rtcpPoll, _rtcpSocket.m_socket))
+        {
+            long n = _rtcpSocket.receive(_rtcpBatch);
+            for(long i = 0; i < n; ++i)
+            {
+                onRtcp(_rtcpBatch.data(i), _rtcpBatch.size(i), _rtcpBatch.timestamp(i));
+            }
+        }
     }
     
     //////////////////////////////////////////////////////////////////////
 
     TcpStream::TcpStream(const std::string& name)
     : RtspStream(name)
-    , m_connection(NULL)
+    , _connection(NULL)
+    , _channel(0)
     {
 
     }
 
     TcpStream::~TcpStream()
     {
-        m_connection = NULL;
+        if(_connection != NULL)
+        {
+            _connection->removeChannel(_channel + 1);
+            _connection = NULL;
+        }
     }
 
-    bool TcpStream::init(RtspConnection* conn)
+    bool TcpStream::init(RtspConnection* conn, int channel)
     {
-        m_connection = conn;
+        assert(conn != NULL);
+
+        _connection = conn;
+        _channel = channel;
+        _connection->addChannel(_channel + 1, this);
         return true;
     }
 
-    bool TcpStream::sendData(byte* b, size_t n)
+    void TcpStream::detach()
+    {
+        _connection = NULL;
+    }
+
+    // A peer flooding RTCP faster than the server ticks loses the excess
+    void TcpStream::queueRtcp(const pputil::byte* b, size_t n)
     {
-        if(m_connection != NULL)
+        IceUtil::Mutex::Lock lock(_feedbackMutex);
+        if(_feedback.size() < 16)
         {
-            m_connection->sendData(b, n);
-            return true;
+            _feedback.push_back(Feedback());
+            _feedback.back().packet = new pputil::Blob(b, n);
+            _feedback.back().arrival = IceUtil::Time::now().toMicroSeconds();
+        }
+    }
+
+    void TcpStream::receive()
+    {
+        std::vector<Feedback> feedback;
+        {
+            IceUtil::Mutex::Lock lock(_feedbackMutex);
+            if(_feedback.empty())
+            {
+                return;
+            }
+            feedback.swap(_feedback);
+        }
+
+        for(std::vector<Feedback>::iterator it = feedback.begin(); it != feedback.end(); ++it)
+        {
+            onRtcp(it->packet->data(), it->packet->size(), it->arrival);
+        }
+    }
+
+    int TcpStream::channel() const
+    {
+        return _channel;
+    }
+
+    size_t TcpStream::queued()
+    {
+        return _connection != NULL ? _connection->sendQueueSize() : 0;
+    }
+
+    // Header and packet go to connection's send queue, 
+    // the packet is shared rather than copied
+    bool TcpStream::sendPacket(const pputil::BlobPtr& packet)
+    {
+        if(_connection != NULL)
+        {
+            return _connection->sendData(_channel, packet);
+        }
+
+        return false;
+    }
+
+    bool TcpStream::sendRtcp(pputil::byte* b, size_t n)
+    {
+        if(_connection != NULL)
+        {
+            return _connection->sendData(_channel + 1, new pputil::Blob(b, n));
         }
 
         return false;
@@ -1,100 +1,301 @@
-// **********************************************************************
-//
-// Copyright (c) 2011, PPEngine
-// 
-// Redistribution and use in source and binary forms, with or without
-// modification, are permitted provided that the following conditions are
-// met:
-// 
-//   * Redistributions of source code must retain the above copyright
-//     notice, this list of conditions and the following disclaimer.
-// 
-//   * Redistributions in binary form must reproduce the above copyright
-//     notice, this list of conditions and the following disclaimer in
-//     the documentation and/or other materials provided with the
-//     distribution.
-// 
-//   * Neither the name of Google nor the names of its contributors may
-//     be used to endorse or promote products derived from this software
-//     without specific prior written permission.
-// 
-// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
-// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
-// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
-// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
-// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
-// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
-// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
-// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-// 
-// **********************************************************************
-
-#ifndef RTSP_RTSP_STREAM_H
-#define RTSP_RTSP_STREAM_H
-
-#include <rtsp/UdpSocket.h>
-#include <rtsp/RtspConnection.h>
-
-namespace rtsp
-{
-	// 
-	// RTSP server using a session to keep state of a presentation
-	// A RTSPSession using one or more streams to send media to client
-	// The stream may be RTP based or TCP based
-	//
-	class RtspStream
-	{
-	public:
-		RtspStream(const std::string& name);
-		virtual ~RtspStream();
-
-		// Configuration name of the stream
-		// SDP and SETUP of RTSP request
-		std::string name();
-
-		// update == true, get current seq and generate new one
-		// update == false, peek current seq only
-		unsigned int seq(bool update = true);
-
-		// Data send interface
-		virtual bool sendData(byte* b, size_t n) = 0;
-
-	protected:
-		std::string _name;
-		unsigned int _seq;
-	};
-
-	class RtpStream : public RtspStream
-	{
-	public:
-		RtpStream(const std::string& name);
-		virtual ~RtpStream();
-
-		bool init(unsigned short& serverPort, unsigned short clientPort);
-		virtual bool sendData(byte* b, size_t n);
-
-	private:
-		UdpSocket _rtpSocket;
-		UdpSocket _rtcpSocket;
-	};
-
-
-	class TcpStream : public RtspStream
-	{
-	public:
-		TcpStream(const std::string& name);
-		virtual ~TcpStream();
-
-		bool init(RtspConnection* conn);
-		virtual bool sendData(byte* b, size_t n);
-
-	private:
-		RtspConnection* _connection;
-	};
-
-}
-
-#endif 
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_RTSP_STREAM_H
+#define RTSP_RTSP_STREAM_H
+
+#include <rtsp/UdpSocket.h>
+#include <rtsp/RtspConnection.h>
+#include <rtsp/StreamScheduler.h>
+#include <rtsp/Rtcp.h>
+#include <rtsp/RtpHistory.h>
+#include <rtsp/RtpMux.h>
+#include <rtsp/PortPool.h>
+#include <pputil/Blob.h>
+#include <pputil/TokenBucket.h>
+#include <deque>
+
+namespace rtsp
+{
+	//
+	// Statistics of a stream
+	// Sent packets are counted by the stream,
+	// loss, jitter and round trip time are reported by client via RTCP
+	//
+	struct StreamStats
+	{
+		uint32_t ssrc;
+		uint64_t packets;			// Packets sent
+		uint64_t octets;			// Payload and header bytes sent
+		uint8_t fractionLost;		// Loss in last report, in 1/256
+		int32_t cumulativeLost;		// Total packets lost
+		uint32_t jitter;			// Interarrival jitter, in timestamp units
+		int64_t rtt;				// Round trip time in microseconds, -1 unknown
+		uint64_t reports;			// Receiver reports received
+		uint64_t nacks;				// Packets asked for retransmission
+		uint64_t retransmits;		// Packets retransmitted
+		uint64_t plis;				// Key frames asked for
+	};
+
+	// 
+	// RTSP server using a session to keep state of a presentation
+	// A RTSPSession using one or more streams to send media to client
+	// The stream may be RTP based or TCP based
+	//
+	class RtspStream
+	{
+	public:
+		RtspStream(const std::string& name);
+		virtual ~RtspStream();
+
+		// Configuration name of the stream
+		// SDP and SETUP of RTSP request
+		std::string name();
+
+		// Take the stream off the scheduler, waiting for a call in progress
+		// Must be called before the stream is deleted, as the scheduler may
+		// otherwise reach it while derived parts are being destroyed
+		void close();
+
+		// update == true, get current seq and generate new one
+		// update == false, peek current seq only
+		unsigned int seq(bool update = true);
+
+		// Data send interface
+		// A RTP packet is sent at once, or queued when pacing is enabled
+		// Called on the server thread only, which also runs the scheduler, 
+		// so the pacing queue needs no lock
+		bool sendData(pputil::byte* b, size_t n);
+		bool sendData(const pputil::BlobPtr& packet);
+
+		// Packets on shared sockets are held and go out together at the 
+		// end of the server's tick. A session sending outside run() 
+		// flushes them itself
+		virtual void flush();
+
+		// Timer of the stream, for pacing and RTCP sender reports
+		// clockRate is the RTP clock of the stream in Hz
+		void setScheduler(StreamScheduler* scheduler, unsigned int clockRate);
+
+		// Counters of sent packets and bytes, shared by streams of a track
+		// Not counted until they are set
+		void setMetrics(int packets, int bytes);
+
+		// Pacing, packets are released at the time of their RTP timestamp
+		// and no faster than peakRate (bytes per second, 0 for no limit) 
+		// with bursts up to burst bytes
+		// Must be called after setScheduler()
+		void setPacing(uint64_t peakRate = 0, uint64_t burst = 0);
+
+		// Packets queued for pacing
+		// A session reading ahead should hold off when it grows
+		size_t pending();
+
+		// Bytes waiting in the send queue of the transport
+		virtual size_t queued();
+
+		// Called by scheduler when the stream is due
+		// Return next deadline, or 0 if there is nothing to do
+		virtual int64_t onSchedule(int64_t now);
+
+		// RTCP packet received from client, arrival in microseconds 
+		// since epoch as stamped by kernel, 0 for now
+		void onRtcp(const pputil::byte* b, size_t n, int64_t arrival = 0);
+
+		// Poll sockets owned by stream, driven by server thread
+		virtual void preparePoll(pputil::PollSet& fds);
+		virtual void handlePoll(const pputil::PollSet& fds);
+
+		// RTCP received by other threads and held for the server thread, 
+		// which owns the statistics, called on each of its ticks
+		virtual void receive();
+
+		// Statistics
+		StreamStats stats();
+
+	protected:
+		// Transmit a packet to client
+		virtual bool sendPacket(const pputil::BlobPtr& packet) = 0;
+
+		// Transmit a RTCP packet to client
+		virtual bool sendRtcp(pputil::byte* b, size_t n) = 0;
+
+		// Feedback from client
+		virtual void onNack(const RtcpNack& nack);
+		virtual void onPli();
+
+		// Send a packet and count it
+		bool transmit(const pputil::BlobPtr& packet, int64_t now);
+
+		// Time to release a packet, based on its RTP timestamp
+		int64_t releaseTime(const pputil::BlobPtr& packet, int64_t now);
+
+		// Send pending packets that are due, return next release time or 0
+		int64_t pace(int64_t now);
+
+		// Send RTCP sender report
+		void sendReport(int64_t now);
+
+	protected:
+		std::string _name;
+		unsigned int _seq;
+
+		// Timer
+		StreamScheduler* _scheduler;
+		int64_t _timer;
+		unsigned int _clockRate;
+
+		// Pacing
+		bool _paced;
+		std::deque<pputil::BlobPtr> _queue;
+		pputil::TokenBucket _bucket;
+
+		// Mapping between RTP timestamp and local time
+		bool _synced;
+		int64_t _baseTime;
+		uint32_t _baseTimestamp;
+
+		// RTCP 
+		StreamStats _stats;
+		uint32_t _lastTimestamp;	// RTP timestamp of last packet sent
+		int64_t _lastTime;			// and when it was sent
+		int64_t _nextReport;
+		uint32_t _lastReport;		// Middle 32 bits of NTP time of last SR
+		int64_t _lastReportTime;
+
+		// Metrics of sent packets
+		int _packetsMetric;
+		int _bytesMetric;
+	};
+
+	class RtpStream : public RtspStream
+	{
+	public:
+		RtpStream(const std::string& name);
+		virtual ~RtpStream();
+
+		bool init(unsigned short& serverPort, unsigned short clientPort);
+
+		// Bind a pair of ports taken from pool
+		bool init(PortPool* pool, unsigned short& serverPort, unsigned short clientPort);
+
+		// Send and receive on sockets shared with other streams
+		bool init(RtpMux* mux, const std::string& host, unsigned short clientPort);
+
+		virtual void preparePoll(pputil::PollSet& fds);
+		virtual void handlePoll(const pputil::PollSet& fds);
+
+		virtual void flush();
+
+		// Keep sent packets up to maxBytes and maxAge (microseconds)
+		// to serve NACKs, maxBytes == 0 to disable
+		// Lost packets are resent as they are, or in RTX format (RFC 4588) 
+		// when a RTX payload type is given
+		void setRetransmission(size_t maxBytes, int64_t maxAge, int rtxPayloadType = -1);
+
+	protected:
+		virtual bool sendPacket(const pputil::BlobPtr& packet);
+		virtual bool sendRtcp(pputil::byte* b, size_t n);
+		virtual void onNack(const RtcpNack& nack);
+
+		void retransmit(const pputil::BlobPtr& packet);
+
+	private:
+		UdpSocket _rtpSocket;
+		UdpSocket _rtcpSocket;
+		UdpBatch _rtcpBatch;
+		size_t _rtcpPoll;		// Index in PollSet
+
+		// Ports taken from pool, given back when the stream is deleted
+		PortPool* _pool;
+		unsigned short _poolPort;
+
+		// Shared sockets
+		RtpMux* _mux;
+		sockaddr_in _rtpPeer;
+		sockaddr_in _rtcpPeer;
+		bool _bound;
+
+		// Retransmission
+		RtpHistory* _history;
+		int _rtxPayloadType;
+		uint32_t _rtxSsrc;
+		uint16_t _rtxSeq;
+	};
+
+
+	class TcpStream : public RtspStream
+	{
+	public:
+		TcpStream(const std::string& name);
+		virtual ~TcpStream();
+
+		// RTP on channel and RTCP on channel + 1, as negotiated by 
+		// interleaved parameter of Transport
+		bool init(RtspConnection* conn, int channel);
+
+		int channel() const;
+
+		virtual size_t queued();
+
+		// The connection is deleted, the stream stops using it
+		// Called by the connection with sessions locked
+		void detach();
+
+		// RTCP on channel + 1, called by the connection input thread
+		// Held until receive(), up to a few packets
+		void queueRtcp(const pputil::byte* b, size_t n);
+		virtual void receive();
+
+	protected:
+		virtual bool sendPacket(const pputil::BlobPtr& packet);
+		virtual bool sendRtcp(pputil::byte* b, size_t n);
+
+	private:
+		RtspConnection* _connection;
+		int _channel;
+
+		// RTCP held for the server thread, stamped as it arrives
+		struct Feedback
+		{
+			pputil::BlobPtr packet;
+			int64_t arrival;
+		};
+		std::vector<Feedback> _feedback;
+		IceUtil::Mutex _feedbackMutex;
+	};
+
+}
+
+#endif 
@@ -0,0 +1,220 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "RtspTransport.h"
+#include <pputil/StringUtil.h>
+#include <cstdlib>
+
+namespace rtsp
+{
+
+    // "a-b" or "a"
+    static void parseRange(const std::string& s, int& a, int& b)
+    {
+        a = atoi(s.c_str());
+        b = a + 1;
+
+        size_t pos = s.find('-');
+        if(pos != std::string::npos)
+        {
+            b = atoi(s.c_str() + pos + 1);
+        }
+    }
+
+    static void parsePorts(const std::string& s, unsigned short ports[2])
+    {
+        int a = 0;
+        int b = 0;
+        parseRange(s, a, b);
+        ports[0] = (unsigned short)a;
+        ports[1] = (unsigned short)b;
+    }
+
+    RtspTransport::RtspTransport()
+    : multicast(false)
+    , ttl(-1)
+    {
+        clientPort[0] = clientPort[1] = 0;
+        serverPort[0] = serverPort[1] = 0;
+        port[0] = port[1] = 0;
+        interleaved[0] = interleaved[1] = -1;
+    }
+
+    RtspTransport::RtspTransport(const std::string& s)
+    : multicast(false)
+    , ttl(-1)
+    {
+        clientPort[0] = clientPort[1] = 0;
+        serverPort[0] = serverPort[1] = 0;
+        port[0] = port[1] = 0;
+        interleaved[0] = interleaved[1] = -1;
+
+        parse(s);
+    }
+
+    bool RtspTransport::parse(const std::string& s)
+    {
+        std::string spec = s.substr(0, s.find(','));
+
+        pputil::StringSeq params = pputil::splitString(spec, ";");
+        if(params.empty())
+        {
+            return false;
+        }
+
+        // RTP/AVP[/UDP|/TCP]
+        std::string spec0 = pputil::toUpper(pputil::trim(params[0]));
+        size_t pos = spec0.find('/', 4);
+        protocol = spec0.substr(0, pos);
+        lowerTransport = pos == std::string::npos ? "UDP" : spec0.substr(pos + 1);
+
+        for(size_t i = 1; i < params.size(); ++i)
+        {
+            std::string param = pputil::trim(params[i]);
+            std::string name = param;
+            std::string value;
+
+            pos = param.find('=');
+            if(pos != std::string::npos)
+            {
+                name = pputil::trim(param.substr(0, pos));
+                value = pputil::trim(param.substr(pos + 1));
+            }
+            name = pputil::toLower(name);
+
+            if(name == "unicast")
+            {
+                multicast = false;
+            }
+            else if(name == "multicast")
+            {
+                multicast = true;
+            }
+            else if(name == "destination")
+            {
+                destination = value;
+            }
+            else if(name == "source")
+            {
+                source = value;
+            }
+            else if(name == "client_port")
+            {
+                parsePorts(value, clientPort);
+            }
+            else if(name == "server_port")
+            {
+                parsePorts(value, serverPort);
+            }
+            else if(name == "port")
+            {
+                parsePorts(value, port);
+            }
+            else if(name == "interleaved")
+            {
+                parseRange(value, interleaved[0], interleaved[1]);
+            }
+            else if(name == "ttl")
+            {
+                ttl = atoi(value.c_str());
+            }
+            else if(name == "ssrc")
+            {
+                ssrc = value;
+            }
+            else if(name == "mode")
+            {
+                mode = value;
+            }
+        }
+
+        return protocol == "RTP/AVP";
+    }
+
+    bool RtspTransport::udp() const
+    {
+        return lowerTransport != "TCP";
+    }
+
+    std::string RtspTransport::str() const
+    {
+        std::ostringstream oss;
+        oss << (protocol.empty() ? "RTP/AVP" : protocol);
+        if(lowerTransport == "TCP")
+        {
+            oss << "/TCP";
+        }
+        oss << (multicast ? ";multicast" : ";unicast");
+
+        if(!destination.empty())
+        {
+            oss << ";destination=" << destination;
+        }
+        if(!source.empty())
+        {
+            oss << ";source=" << source;
+        }
+        if(port[0] != 0)
+        {
+            oss << ";port=" << port[0] << "-" << port[1];
+        }
+        if(ttl >= 0)
+        {
+            oss << ";ttl=" << ttl;
+        }
+        if(clientPort[0] != 0)
+        {
+            oss << ";client_port=" << clientPort[0] << "-" << clientPort[1];
+        }
+        if(serverPort[0] != 0)
+        {
+            oss << ";server_port=" << serverPort[0] << "-" << serverPort[1];
+        }
+        if(interleaved[0] >= 0)
+        {
+            oss << ";interleaved=" << interleaved[0] << "-" << interleaved[1];
+        }
+        if(!ssrc.empty())
+        {
+            oss << ";ssrc=" << ssrc;
+        }
+        if(!mode.empty())
+        {
+            oss << ";mode=" << mode;
+        }
+
+        return oss.str();
+    }
+    
+}
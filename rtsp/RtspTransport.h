@@ -0,0 +1,82 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_RTSP_TRANSPORT_H
+#define RTSP_RTSP_TRANSPORT_H
+
+#include <pputil/Config.h>
+
+namespace rtsp
+{
+    //
+    // Transport header of SETUP (RFC 2326, 12.39)
+    // RTP/AVP[/UDP|/TCP];unicast|multicast;destination=..;
+    // client_port=a-b;server_port=a-b;port=a-b;ttl=n;interleaved=a-b;ssrc=..;mode=..
+    // Only the first of a comma separated list is taken
+    //
+    class RtspTransport
+    {
+    public:
+        RtspTransport();
+        RtspTransport(const std::string& s);
+        
+        // Parse a header, return false if it is not RTP/AVP
+        bool parse(const std::string& s);
+        
+        // Build a header
+        std::string str() const;
+        
+        // RTP over UDP, rather than interleaved in RTSP connection
+        bool udp() const;
+        
+    public:
+        std::string protocol;       // RTP/AVP
+        std::string lowerTransport; // UDP or TCP
+        bool multicast;
+        std::string destination;
+        std::string source;
+        
+        // Pairs of RTP and RTCP, 0 if not given
+        unsigned short clientPort[2];
+        unsigned short serverPort[2];
+        unsigned short port[2];         // Multicast
+        int interleaved[2];             // -1 if not given
+        
+        int ttl;                        // -1 if not given
+        std::string ssrc;
+        std::string mode;
+    };
+}
+
+#endif
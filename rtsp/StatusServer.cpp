@@ -0,0 +1,264 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "StatusServer.h"
+#include <pputil/Trace.h>
+
+namespace rtsp
+{
+    // Headers of a request are limited, a request is never larger
+    static const size_t maxRequest = 8192;
+    
+    StatusServer::StatusServer(unsigned short port, RtspServer* server, bool passive)
+    : TcpServer(port, this, NULL, passive)
+    , _server(server)
+    {
+        
+    }
+    
+    StatusServer::~StatusServer()
+    {
+        
+    }
+    
+    // One request per call, connections are kept alive for next scrape
+    void StatusServer::onReceive(pputil::Buffer* buffer, pputil::Connection* conn)
+    {
+        assert(buffer != NULL);
+        assert(conn != NULL);
+        
+        for(;;)
+        {
+            std::string data((const char*)buffer->read_pos(), buffer->size());
+            size_t end = data.find("\r\n\r\n");
+            if(end == std::string::npos)
+            {
+                if(data.size() > maxRequest)
+                {
+                    buffer->remove(buffer->size());
+                    reply(conn, 400, "text/plain", "Bad Request\n");
+                }
+                return;
+            }
+            buffer->remove(end + 4);
+            
+            // Request line: method, path and version
+            std::string line = data.substr(0, data.find("\r\n"));
+            std::istringstream iss(line);
+            std::string method;
+            std::string path;
+            iss >> method >> path;
+            path = path.substr(0, path.find('?'));
+            
+            if(method != "GET")
+            {
+                reply(conn, 405, "text/plain", "Method Not Allowed\n");
+            }
+            else if(path == "/metrics")
+            {
+                std::vector<pputil::Metrics::Sample> samples;
+                pputil::Metrics::instance().snapshot(samples);
+                reply(conn, 200, "text/plain; version=0.0.4", metricsText(samples));
+            }
+            else if(path == "/sessions")
+            {
+                RtspServer::SessionsStatusPtr status;
+                if(_server != NULL)
+                {
+                    status = _server->sessionsStatus();
+                }
+                reply(conn, 200, "application/json", sessionsJson(status));
+            }
+            else if(path == "/trace")
+            {
+                reply(conn, 200, "application/json", pputil::Trace::json());
+            }
+            else
+            {
+                reply(conn, 404, "text/plain", "Not Found\n");
+            }
+        }
+    }
+    
+    void StatusServer::reply(pputil::Connection* conn, int status, const std::string& type, const std::string& body)
+    {
+        const char* reason = "OK";
+        switch(status)
+        {
+        case 400: reason = "Bad Request"; break;
+        case 404: reason = "Not Found"; break;
+        case 405: reason = "Method Not Allowed"; break;
+        }
+        
+        std::ostringstream oss;
+        oss << "HTTP/1.1 " << status << " " << reason << "\r\n"
+            << "Content-Type: " << type << "\r\n"
+            << "Content-Length: " << body.size() << "\r\n"
+            << "Cache-Control: no-cache\r\n"
+            << "\r\n"
+            << body;
+        
+        std::string s = oss.str();
+        conn->asynSend((pputil::byte*)s.data(), s.size());
+    }
+    
+    // Metric with labels, and one more label
+    static std::string series(const std::string& name, const std::string& labels, const std::string& label = "")
+    {
+        std::string all = labels;
+        if(!label.empty())
+        {
+            all += all.empty() ? label : "," + label;
+        }
+        return all.empty() ? name : name + "{" + all + "}";
+    }
+    
+    // Histograms are given as cumulative counts at each power of 2, 
+    // up to the bucket of the largest value
+    std::string StatusServer::metricsText(const std::vector<pputil::Metrics::Sample>& samples)
+    {
+        std::ostringstream oss;
+        std::map<std::string, bool> described;
+        
+        for(size_t i = 0; i < samples.size(); ++i)
+        {
+            const std::string& name = samples[i].name;
+            if(described[name])
+            {
+                continue;
+            }
+            described[name] = true;
+            
+            const char* type = "counter";
+            if(samples[i].type == pputil::Metrics::GAUGE)
+            {
+                type = "gauge";
+            }
+            else if(samples[i].type == pputil::Metrics::HISTOGRAM)
+            {
+                type = "histogram";
+            }
+            
+            if(!samples[i].help.empty())
+            {
+                oss << "# HELP " << name << " " << samples[i].help << "\n";
+            }
+            oss << "# TYPE " << name << " " << type << "\n";
+            
+            // Series of the metric, by labels
+            for(size_t j = i; j < samples.size(); ++j)
+            {
+                const pputil::Metrics::Sample& s = samples[j];
+                if(s.name != name)
+                {
+                    continue;
+                }
+                
+                if(s.type != pputil::Metrics::HISTOGRAM)
+                {
+                    oss << series(name, s.labels) << " " << s.value << "\n";
+                    continue;
+                }
+                
+                const pputil::Histogram& h = s.histogram;
+                size_t last = pputil::Histogram::bucket(h.max());
+                uint64_t count = 0;
+                for(size_t b = 0; b <= last; ++b)
+                {
+                    count += h.at(b);
+                    if(b % pputil::Histogram::STEPS == pputil::Histogram::STEPS - 1 || b == last)
+                    {
+                        std::ostringstream le;
+                        le << "le=\"" << pputil::Histogram::bound(b) << "\"";
+                        oss << series(name + "_bucket", s.labels, le.str()) << " " << count << "\n";
+                    }
+                }
+                oss << series(name + "_bucket", s.labels, "le=\"+Inf\"") << " " << h.count() << "\n";
+                oss << series(name + "_sum", s.labels) << " " << h.sum() << "\n";
+                oss << series(name + "_count", s.labels) << " " << h.count() << "\n";
+            }
+        }
+        
+        return oss.str();
+    }
+    
+    static std::string jsonString(const std::string& s)
+    {
+        std::string json = "\"";
+        for(size_t i = 0; i < s.length(); ++i)
+        {
+            unsigned char c = (unsigned char)s[i];
+            if(c == '"' || c == '\\')
+            {
+                json += '\\';
+                json += (char)c;
+            }
+            else if(c < 0x20)
+            {
+                char esc[8];
+                sprintf(esc, "\\u%04x", c);
+                json += esc;
+            }
+            else
+            {
+                json += (char)c;
+            }
+        }
+        return json + "\"";
+    }
+    
+    std::string StatusServer::sessionsJson(const RtspServer::SessionsStatusPtr& status)
+    {
+        std::ostringstream oss;
+        oss << "{\"time\":" << (status ? status->time : 0) << ",\"sessions\":[";
+        
+        for(size_t i = 0; status && i < status->sessions.size(); ++i)
+        {
+            const RtspServer::SessionStatus& s = status->sessions[i];
+            oss << (i > 0 ? "," : "") << "\n"
+                << "{\"sid\":" << jsonString(s.sid)
+                << ",\"mid\":" << jsonString(s.mid)
+                << ",\"state\":" << jsonString(s.state)
+                << ",\"packets\":" << s.packets
+                << ",\"bytes\":" << s.bytes
+                << ",\"bitrate\":" << s.bitrate
+                << ",\"pending\":" << s.pending
+                << ",\"queued\":" << s.queued
+                << "}";
+        }
+        
+        oss << "\n]}\n";
+        return oss.str();
+    }
+}
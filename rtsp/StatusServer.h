@@ -0,0 +1,74 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_STATUS_SERVER_H
+#define RTSP_STATUS_SERVER_H
+
+#include <rtsp/RtspServer.h>
+#include <pputil/TcpServer.h>
+#include <pputil/Metrics.h>
+
+namespace rtsp
+{
+    //
+    // HTTP endpoint to monitor a running server, on its own port
+    //   GET /metrics   metrics in Prometheus text format
+    //   GET /sessions  sessions of the RTSP server in JSON
+    //   GET /trace     spans traced so far in Chrome trace JSON, 
+    //                  see pputil::Trace
+    // Pages are rendered from snapshots of metrics and the last status
+    // of sessions, so a scrape does not hold up streaming threads
+    //
+    class StatusServer : public pputil::TcpServer, public pputil::ReceiveCallback
+    {
+    public:
+        // Without a RTSP server, /sessions is an empty list
+        StatusServer(unsigned short port, RtspServer* server = NULL, bool passive = true);
+        virtual ~StatusServer();
+        
+        // Request received on a connection
+        virtual void onReceive(pputil::Buffer* buffer, pputil::Connection* conn);
+        
+        // Page bodies
+        static std::string metricsText(const std::vector<pputil::Metrics::Sample>& samples);
+        static std::string sessionsJson(const RtspServer::SessionsStatusPtr& status);
+        
+    protected:
+        void reply(pputil::Connection* conn, int status, const std::string& type, const std::string& body);
+        
+        RtspServer* _server;
+    };
+}
+
+#endif
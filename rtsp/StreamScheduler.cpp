@@ -0,0 +1,117 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "StreamScheduler.h"
+#include "RtspStream.h"
+#include <IceUtil/Time.h>
+
+namespace rtsp
+{
+
+    StreamScheduler::StreamScheduler()
+    {
+
+    }
+
+    StreamScheduler::~StreamScheduler()
+    {
+        _timers.clear();
+        _entries.clear();
+    }
+
+    int64_t StreamScheduler::now()
+    {
+        return IceUtil::Time::now(IceUtil::Time::Monotonic).toMicroSeconds();
+    }
+
+    void StreamScheduler::schedule(RtspStream* stream, int64_t when)
+    {
+        assert(stream != NULL);
+        
+        IceUtil::Mutex::Lock lock(_mutex);
+        remove(stream);
+        add(stream, when);
+    }
+
+    void StreamScheduler::cancel(RtspStream* stream)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        remove(stream);
+    }
+
+    // The lock is held while streams are called, so cancel() returns 
+    // only after a stream in the middle of its sending is done
+    // Streams are cancelled by RtspStream::close() before they are deleted
+    int64_t StreamScheduler::run(int64_t now)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        
+        while(!_timers.empty() && _timers.begin()->first <= now)
+        {
+            RtspStream* stream = _timers.begin()->second;
+            remove(stream);
+            
+            int64_t next = stream->onSchedule(now);
+            if(next > 0)
+            {
+                // Not before next tick
+                add(stream, next > now ? next : now + 1);
+            }
+        }
+        
+        return _timers.empty() ? 0 : _timers.begin()->first;
+    }
+
+    size_t StreamScheduler::size()
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        return _entries.size();
+    }
+
+    void StreamScheduler::add(RtspStream* stream, int64_t when)
+    {
+        _entries[stream] = _timers.insert(std::make_pair(when, stream));
+    }
+
+    void StreamScheduler::remove(RtspStream* stream)
+    {
+        std::map<RtspStream*, TimerMap::iterator>::iterator it = _entries.find(stream);
+        if(it != _entries.end())
+        {
+            _timers.erase(it->second);
+            _entries.erase(it);
+        }
+    }
+
+}
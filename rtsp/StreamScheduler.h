@@ -0,0 +1,92 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_STREAM_SCHEDULER_H
+#define RTSP_STREAM_SCHEDULER_H
+
+#include <pputil/Config.h>
+#include <IceUtil/Mutex.h>
+
+namespace rtsp
+{
+    class RtspStream;
+    
+    //
+    // A shared timer for all streams driven by one server thread
+    // Streams are ordered by their next deadline, so a tick only 
+    // touches the streams that are due, rather than polling all of them
+    // 
+    // Time is in microseconds of a monotonic clock
+    //
+    class StreamScheduler
+    {
+    public:
+        StreamScheduler();
+        virtual ~StreamScheduler();
+        
+        // Current time 
+        static int64_t now();
+        
+        // Call stream->onSchedule() at time when
+        // Reschedule a stream that is scheduled already
+        void schedule(RtspStream* stream, int64_t when);
+        
+        // Remove a stream, called before the stream is deleted
+        // Waits for the stream if it is being called by run()
+        void cancel(RtspStream* stream);
+        
+        // Call due streams, return the earliest deadline left, 
+        // or 0 if there is nothing scheduled
+        int64_t run(int64_t now);
+        
+        // Number of streams scheduled
+        size_t size();
+        
+    protected:
+        void add(RtspStream* stream, int64_t when);
+        void remove(RtspStream* stream);
+        
+        typedef std::multimap<int64_t, RtspStream*> TimerMap;
+        TimerMap _timers;
+        
+        // Position of each stream in timers
+        std::map<RtspStream*, TimerMap::iterator> _entries;
+        
+        // Streams are scheduled by server thread, 
+        // and cancelled by the thread which handles TEARDOWN
+        IceUtil::Mutex _mutex;
+    };
+}
+
+#endif
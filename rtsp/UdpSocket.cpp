@@ -33,6 +33,7 @@
 // **********************************************************************
 
 #include "UdpSocket.h"
+#include <pputil/Capture.h>
 
 namespace rtsp
 {
@@ -40,6 +41,8 @@ namespace rtsp
     UdpSocket::UdpSocket()
     : m_socket(INVALID_SOCKET)
     {
+        memset(&m_peer, 0, sizeof(m_peer));
+        memset(&m_local, 0, sizeof(m_local));
     }
 
     UdpSocket::~UdpSocket()
@@ -61,8 +64,47 @@ namespace rtsp
             addr.sin_addr.s_addr = INADDR_ANY;
 
             pputil::doBind(m_socket, addr);
+            m_local = addr;
+        }
+        catch(pputil::SocketException& ex)
+        {
+            // doBind() has closed the socket
+            m_socket = INVALID_SOCKET;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool UdpSocket::init(const std::string& group, unsigned short port)
+    {
+        assert(m_socket == INVALID_SOCKET );
+        
+        try
+        {
+            m_socket = pputil::createUdpSocket();
+            pputil::setReuseAddress(m_socket, true);
+
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = INADDR_ANY;
+
+            pputil::doBind(m_socket, addr);
+            m_local = addr;
         }
         catch(pputil::SocketException& ex)
+        {
+            m_socket = INVALID_SOCKET;
+            return false;
+        }
+
+        struct ip_mreq mreq;
+        memset(&mreq, 0, sizeof(mreq));
+        mreq.imr_multiaddr.s_addr = inet_addr(group.c_str());
+        mreq.imr_interface.s_addr = INADDR_ANY;
+        if(setsockopt(m_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&mreq, sizeof(mreq)) == SOCKET_ERROR)
         {
             close();
             return false;
@@ -71,6 +113,24 @@ namespace rtsp
         return true;
     }
 
+    bool UdpSocket::setMulticast(int ttl, bool loop)
+    {
+    #ifdef _WIN32
+        int t = ttl;
+        int l = loop ? 1 : 0;
+    #else
+        unsigned char t = (unsigned char)ttl;
+        unsigned char l = loop ? 1 : 0;
+    #endif
+        
+        if(setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&t, sizeof(t)) == SOCKET_ERROR)
+        {
+            return false;
+        }
+        
+        return setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*)&l, sizeof(l)) != SOCKET_ERROR;
+    }
+
     void UdpSocket::close()
     {
         if(m_socket != INVALID_SOCKET)
@@ -90,7 +150,253 @@ namespace rtsp
 
     long UdpSocket::send(unsigned char* b, size_t n)
     {
-        return sendto(m_socket, (const char*)b, n, 0, (sockaddr*)&m_peer, sizeof(m_peer));
+        long sent = sendto(m_socket, (const char*)b, n, 0, (sockaddr*)&m_peer, sizeof(m_peer));
+        if(sent >= 0 && pputil::Capture::enabled())
+        {
+            pputil::Capture::udp(m_local, m_peer, b, n);
+        }
+        return sent;
+    }
+
+    long UdpSocket::send(const unsigned char* head, size_t headLen, const unsigned char* body, size_t bodyLen)
+    {
+    #ifdef _WIN32
+        WSABUF bufs[2];
+        bufs[0].buf = (char*)head;
+        bufs[0].len = (ULONG)headLen;
+        bufs[1].buf = (char*)body;
+        bufs[1].len = (ULONG)bodyLen;
+        
+        DWORD bytes = 0;
+        long sent = -1;
+        if(WSASendTo(m_socket, bufs, 2, &bytes, 0, (sockaddr*)&m_peer, sizeof(m_peer), NULL, NULL) != SOCKET_ERROR)
+        {
+            sent = (long)bytes;
+        }
+    #else
+        struct iovec iov[2];
+        iov[0].iov_base = (void*)head;
+        iov[0].iov_len = headLen;
+        iov[1].iov_base = (void*)body;
+        iov[1].iov_len = bodyLen;
+        
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &m_peer;
+        msg.msg_namelen = sizeof(m_peer);
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+        
+        long sent = sendmsg(m_socket, &msg, 0);
+    #endif
+        
+        if(sent >= 0 && pputil::Capture::enabled())
+        {
+            pputil::Capture::udp(m_local, m_peer, head, headLen, body, bodyLen);
+        }
+        return sent;
+    }
+
+    long UdpSocket::receive(unsigned char* b, size_t n, sockaddr_in* from)
+    {
+        sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        long ret = recvfrom(m_socket, (char*)b, n, 0, (sockaddr*)&addr, &len);
+        if(ret >= 0 && from != NULL)
+        {
+            *from = addr;
+        }
+        if(ret >= 0 && pputil::Capture::enabled())
+        {
+            pputil::Capture::udp(addr, m_local, b, ret);
+        }
+        return ret;
+    }
+
+    bool UdpSocket::setTimestamps(bool on)
+    {
+    #ifdef SO_TIMESTAMP
+        int v = on ? 1 : 0;
+        return setsockopt(m_socket, SOL_SOCKET, SO_TIMESTAMP, (const char*)&v, sizeof(v)) != SOCKET_ERROR;
+    #else
+        return false;
+    #endif
+    }
+
+#ifndef _WIN32
+    static const size_t CONTROL_SIZE = CMSG_SPACE(sizeof(struct timeval));
+
+    static int64_t arrivalTime(struct msghdr& msg)
+    {
+    #ifdef SCM_TIMESTAMP
+        for(struct cmsghdr* c = CMSG_FIRSTHDR(&msg); c != NULL; c = CMSG_NXTHDR(&msg, c))
+        {
+            if(c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMP)
+            {
+                struct timeval tv;
+                memcpy(&tv, CMSG_DATA(c), sizeof(tv));
+                return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+            }
+        }
+    #endif
+        return 0;
+    }
+
+    static void prepareHeader(struct msghdr& msg, sockaddr_in* from, struct iovec* iov, char* control)
+    {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = from;
+        msg.msg_namelen = sizeof(*from);
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = CONTROL_SIZE;
+    }
+#endif
+
+    long UdpSocket::receive(UdpBatch& batch)
+    {
+        batch.allocate();
+        batch._count = 0;
+
+    #if defined(__linux__)
+        for(size_t i = 0; i < batch._capacity; ++i)
+        {
+            prepareHeader(batch._msgs[i].msg_hdr, &batch._from[i], &batch._iovs[i], &batch._controls[i * CONTROL_SIZE]);
+            batch._msgs[i].msg_len = 0;
+        }
+
+        int n = recvmmsg(m_socket, &batch._msgs[0], (unsigned int)batch._capacity, MSG_DONTWAIT, NULL);
+        if(n < 0)
+        {
+            return pputil::wouldBlock() || pputil::interrupted() ? 0 : -1;
+        }
+
+        for(int i = 0; i < n; ++i)
+        {
+            batch._sizes[i] = batch._msgs[i].msg_len;
+            batch._stamps[i] = arrivalTime(batch._msgs[i].msg_hdr);
+        }
+        batch._count = n;
+    #elif !defined(_WIN32)
+        while(batch._count < batch._capacity)
+        {
+            size_t i = batch._count;
+            struct msghdr msg;
+            prepareHeader(msg, &batch._from[i], &batch._iovs[i], &batch._controls[i * CONTROL_SIZE]);
+
+            long n = recvmsg(m_socket, &msg, MSG_DONTWAIT);
+            if(n < 0)
+            {
+                if(batch._count == 0 && !pputil::wouldBlock() && !pputil::interrupted())
+                {
+                    return -1;
+                }
+                break;
+            }
+
+            batch._sizes[i] = n;
+            batch._stamps[i] = arrivalTime(msg);
+            batch._count++;
+        }
+    #else
+        // Only the datagram poll found waiting
+        long n = receive(&batch._arena[0], batch._size, &batch._from[0]);
+        if(n < 0)
+        {
+            return pputil::wouldBlock() ? 0 : -1;
+        }
+
+        batch._sizes[0] = n;
+        batch._stamps[0] = 0;
+        batch._count = 1;
+    #endif
+
+    #ifndef _WIN32
+        // On Windows receive() has captured the datagram
+        if(pputil::Capture::enabled())
+        {
+            for(size_t i = 0; i < batch._count; ++i)
+            {
+                pputil::Capture::udp(batch._from[i], m_local, batch.data(i), batch._sizes[i], NULL, 0, batch._stamps[i]);
+            }
+        }
+    #endif
+
+        return (long)batch._count;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    UdpBatch::UdpBatch(size_t capacity, size_t size)
+    : _count(0)
+    , _capacity(capacity > 0 ? capacity : 1)
+    , _size(size)
+    {
+    }
+
+    UdpBatch::~UdpBatch()
+    {
+    }
+
+    void UdpBatch::allocate()
+    {
+        if(!_arena.empty())
+        {
+            return;
+        }
+
+        _arena.resize(_capacity * _size);
+        _from.resize(_capacity);
+        _sizes.resize(_capacity);
+        _stamps.resize(_capacity);
+
+    #ifndef _WIN32
+        _iovs.resize(_capacity);
+        _controls.resize(_capacity * CONTROL_SIZE);
+        for(size_t i = 0; i < _capacity; ++i)
+        {
+            _iovs[i].iov_base = &_arena[i * _size];
+            _iovs[i].iov_len = _size;
+        }
+    #endif
+    #ifdef __linux__
+        _msgs.resize(_capacity);
+    #endif
+    }
+
+    size_t UdpBatch::count() const
+    {
+        return _count;
+    }
+
+    size_t UdpBatch::capacity() const
+    {
+        return _capacity;
+    }
+
+    const unsigned char* UdpBatch::data(size_t i) const
+    {
+        assert(i < _count);
+        return &_arena[i * _size];
+    }
+
+    size_t UdpBatch::size(size_t i) const
+    {
+        assert(i < _count);
+        return _sizes[i];
+    }
+
+    const sockaddr_in& UdpBatch::from(size_t i) const
+    {
+        assert(i < _count);
+        return _from[i];
+    }
+
+    int64_t UdpBatch::timestamp(size_t i) const
+    {
+        assert(i < _count);
+        return _stamps[i];
     }
     
 }
@@ -36,9 +36,57 @@
 #define RTSP_UDP_SOCKET_H
 
 #include <pputil/Socket.h>
+#include <vector>
 
 namespace rtsp
 {
+    //
+    // Datagrams taken by one receive, in an arena allocated on first use,
+    // with the peer address and kernel arrival time of each
+    //
+    class UdpBatch
+    {
+    public:
+        UdpBatch(size_t capacity = 64, size_t size = 1500);
+        ~UdpBatch();
+
+        // Datagrams received
+        size_t count() const;
+        size_t capacity() const;
+
+        const unsigned char* data(size_t i) const;
+        size_t size(size_t i) const;
+        const sockaddr_in& from(size_t i) const;
+
+        // Arrival time in microseconds since epoch, 0 if kernel gave none
+        int64_t timestamp(size_t i) const;
+
+    private:
+        friend class UdpSocket;
+
+        void allocate();
+
+        size_t _count;
+        size_t _capacity;
+        size_t _size;
+        std::vector<unsigned char> _arena;
+        std::vector<sockaddr_in> _from;
+        std::vector<size_t> _sizes;
+        std::vector<int64_t> _stamps;
+
+    #ifndef _WIN32
+        std::vector<struct iovec> _iovs;
+        std::vector<char> _controls;
+    #endif
+    #ifdef __linux__
+        std::vector<struct mmsghdr> _msgs;
+    #endif
+    };
+
+    //
+    // Datagrams sent and received are written to capture when it is 
+    // open (pputil::Capture), with the bound address as this end
+    //
     class UdpSocket
     {
     public:
@@ -49,13 +97,36 @@ namespace rtsp
         bool init(unsigned short port);
         void close();
 
+        // Init with local port number shared with other sockets,
+        // and receive datagrams sent to a multicast group on it
+        bool init(const std::string& group, unsigned short port);
+
+        // Sending to multicast groups, with TTL and whether packets 
+        // are looped back to receivers on this host
+        bool setMulticast(int ttl, bool loop);
+
         // Peer address
         void setPeer(const std::string& host, unsigned short port);
         long send(unsigned char* b, size_t n);
 
+        // Send a datagram gathered from a header and a body
+        long send(const unsigned char* head, size_t headLen, const unsigned char* body, size_t bodyLen);
+
+        // Receive a datagram, with the address it is from
+        long receive(unsigned char* b, size_t n, sockaddr_in* from = NULL);
+
+        // Receive datagrams waiting on socket into batch without blocking,
+        // with one recvmmsg() on Linux
+        // Return number of datagrams, 0 if none, -1 on error
+        long receive(UdpBatch& batch);
+
+        // Stamp received datagrams with kernel arrival time
+        bool setTimestamps(bool on);
+
     public:
-        pputil::SOCKET m_socket;
+        SOCKET m_socket;
         sockaddr_in m_peer;
+        sockaddr_in m_local;
     };
 }
 
@@ -0,0 +1,222 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#include "UrlRouter.h"
+
+namespace rtsp
+{
+
+    UrlRouter::UrlRouter(size_t maxMids, size_t maxTracks)
+    {
+        Node root;
+        root.c = 0;
+        root.id = -1;
+        root.child = -1;
+        root.sibling = -1;
+
+        _mids.nodes.push_back(root);
+        _mids.limit = maxMids;
+        _tracks.nodes.push_back(root);
+        _tracks.limit = maxTracks;
+    }
+
+    UrlRouter::~UrlRouter()
+    {
+    }
+
+    int UrlRouter::walk(const Trie& trie, const char* s, size_t n, size_t& matched)
+    {
+        int node = 0;
+        for(matched = 0; matched < n; ++matched)
+        {
+            int child = trie.nodes[node].child;
+            while(child >= 0 && trie.nodes[child].c != s[matched])
+            {
+                child = trie.nodes[child].sibling;
+            }
+
+            if(child < 0)
+            {
+                break;
+            }
+            node = child;
+        }
+        return node;
+    }
+
+    // Walk down the trie, adding nodes for the rest of a new name
+    int UrlRouter::intern(Trie& trie, const char* s, size_t n)
+    {
+        size_t i = 0;
+        int node = walk(trie, s, n, i);
+        if(i == n && trie.nodes[node].id >= 0)
+        {
+            return trie.nodes[node].id;
+        }
+
+        if(trie.names.size() >= trie.limit)
+        {
+            return -1;
+        }
+
+        for(; i < n; ++i)
+        {
+            Node next;
+            next.c = s[i];
+            next.id = -1;
+            next.child = -1;
+            next.sibling = trie.nodes[node].child;
+
+            trie.nodes.push_back(next);
+            int added = (int)trie.nodes.size() - 1;
+            trie.nodes[node].child = added;
+            node = added;
+        }
+
+        trie.nodes[node].id = (int)trie.names.size();
+        trie.names.push_back(std::string(s, n));
+        return trie.nodes[node].id;
+    }
+
+    // rtsp://host:port/a/b/<mid>/<track>, query is ignored
+    bool UrlRouter::route(const std::string& url, bool withTrack, Route& route)
+    {
+        const char* p = url.c_str();
+        const char* end = p + url.size();
+
+        const char* scheme = strstr(p, "://");
+        if(scheme != NULL)
+        {
+            p = scheme + 3;
+        }
+
+        const char* query = (const char*)memchr(p, '?', end - p);
+        if(query != NULL)
+        {
+            end = query;
+        }
+
+        while(end > p && end[-1] == '/')
+        {
+            --end;
+        }
+
+        // Last two segments of path, host is not one
+        const char* path = (const char*)memchr(p, '/', end - p);
+        if(path == NULL)
+        {
+            return false;
+        }
+
+        const char* last = end;
+        while(last > path && last[-1] != '/')
+        {
+            --last;
+        }
+
+        const char* midBegin = last;
+        const char* midEnd = end;
+        const char* trackBegin = NULL;
+        if(withTrack)
+        {
+            if(last - 1 <= path)
+            {
+                return false;
+            }
+
+            trackBegin = last;
+            midEnd = last - 1;
+            midBegin = midEnd;
+            while(midBegin > path && midBegin[-1] != '/')
+            {
+                --midBegin;
+            }
+        }
+
+        if(midBegin == midEnd || (trackBegin != NULL && trackBegin == end))
+        {
+            return false;
+        }
+
+        route.midPos = midBegin - url.c_str();
+        route.midLen = midEnd - midBegin;
+        route.trackPos = trackBegin != NULL ? trackBegin - url.c_str() : 0;
+        route.trackLen = trackBegin != NULL ? end - trackBegin : 0;
+
+        IceUtil::Mutex::Lock lock(_mutex);
+        size_t matched = 0;
+        int node = walk(_mids, midBegin, route.midLen, matched);
+        route.mid = matched == route.midLen ? _mids.nodes[node].id : -1;
+        route.track = -1;
+        if(trackBegin != NULL)
+        {
+            node = walk(_tracks, trackBegin, route.trackLen, matched);
+            route.track = matched == route.trackLen ? _tracks.nodes[node].id : -1;
+        }
+        return true;
+    }
+
+    int UrlRouter::mid(const std::string& name)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        return intern(_mids, name.data(), name.size());
+    }
+
+    int UrlRouter::track(const std::string& name)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        return intern(_tracks, name.data(), name.size());
+    }
+
+    const std::string& UrlRouter::midName(int id)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        assert(id >= 0 && (size_t)id < _mids.names.size());
+        return _mids.names[id];
+    }
+
+    const std::string& UrlRouter::trackName(int id)
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        assert(id >= 0 && (size_t)id < _tracks.names.size());
+        return _tracks.names[id];
+    }
+
+    size_t UrlRouter::mids()
+    {
+        IceUtil::Mutex::Lock lock(_mutex);
+        return _mids.names.size();
+    }
+
+}
@@ -0,0 +1,111 @@
+// **********************************************************************
+//
+// Copyright (c) 2011, PPEngine
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// 
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in
+//     the documentation and/or other materials provided with the
+//     distribution.
+// 
+//   * Neither the name of Google nor the names of its contributors may
+//     be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// **********************************************************************
+
+#ifndef RTSP_URL_ROUTER_H
+#define RTSP_URL_ROUTER_H
+
+#include <pputil/Config.h>
+#include <IceUtil/Mutex.h>
+#include <deque>
+
+namespace rtsp
+{
+    //
+    // Maps request URLs rtsp://host:port/<mid>[/<track>] to interned ids
+    // A URL is split in one pass and its segments are looked up in tries,
+    // without building substrings. Names are interned with mid() and 
+    // track(), up to a limit, and an id names the same mid or track for
+    // the life of the router. Routing does not intern, so that requests 
+    // for media that do not exist can not fill the tables
+    //
+    class UrlRouter
+    {
+    public:
+        UrlRouter(size_t maxMids = 100000, size_t maxTracks = 64);
+        ~UrlRouter();
+
+        struct Route
+        {
+            int mid;        // -1 if the name is not interned
+            int track;      // -1 if URL has no track, or it is not interned
+            
+            // Segments of the names in URL
+            size_t midPos;
+            size_t midLen;
+            size_t trackPos;
+            size_t trackLen;    // 0 if URL has no track
+        };
+
+        // Parse URL of a media (DESCRIBE), or of a track in a media (SETUP)
+        // and look its names up. Return false if it has no such segments
+        bool route(const std::string& url, bool withTrack, Route& route);
+
+        // Intern a name ahead of requests, return its id or -1 over limit
+        int mid(const std::string& name);
+        int track(const std::string& name);
+
+        // Names of ids, references stay valid
+        const std::string& midName(int id);
+        const std::string& trackName(int id);
+
+        size_t mids();
+
+    private:
+        // Trie of names, children of a node are linked by sibling
+        struct Node
+        {
+            char c;
+            int id;         // -1 if no name ends here
+            int child;
+            int sibling;
+        };
+
+        struct Trie
+        {
+            std::vector<Node> nodes;
+            std::deque<std::string> names;
+            size_t limit;
+        };
+
+        // Deepest node on the path of a name, and chars of it matched
+        int walk(const Trie& trie, const char* s, size_t n, size_t& matched);
+        int intern(Trie& trie, const char* s, size_t n);
+
+        Trie _mids;
+        Trie _tracks;
+        IceUtil::Mutex _mutex;
+    };
+}
+
+#endif